@@ -42,10 +42,18 @@
 #include <unistd.h>
 #include <math.h>
 #include <float.h>
+#include <stdint.h>
 #include <assert.h>
 
 #include <fitsio.h>
 
+#if defined HAVE_SYS_MMAN_H && defined HAVE_FCNTL_H && defined HAVE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#define CPL_IMAGE_IO_MMAP
+#endif
+
 
 /*-----------------------------------------------------------------------------
                                    Defines
@@ -85,6 +93,11 @@ cpl_image * cpl_image_load_one(const char *, cpl_type, cpl_size, cpl_size,
                                cpl_boolean, cpl_size, cpl_size, cpl_size,
                                cpl_size) CPL_ATTR_ALLOC;
 
+static void * cpl_image_load_mmap_(fitsfile *, const char *, cpl_type,
+                                   const CPL_FITSIO_TYPE[], cpl_size,
+                                   cpl_size, cpl_size, cpl_size, cpl_size)
+    CPL_ATTR_NONNULL;
+
 #define CPL_CLASS CPL_CLASS_DOUBLE
 #include "cpl_image_io_body.h"
 #undef CPL_CLASS
@@ -2694,6 +2707,236 @@ skip:       for (x++; x<=x2 && pii[x+y*lab->nx]!=ov; x++) {
 }
 
 
+/*----------------------------------------------------------------------------*/
+/*
+  @internal
+  @brief Read a window of an uncompressed image Data Unit via mmap()
+  @param fptr      CFITSIO structure of the already opened FITS file
+  @param filename  The name of the opened file
+  @param pix_type  The pixel type of the created image
+  @param naxes     NAXIS1, NAXIS2 of the Data Unit
+  @param pnum      Plane number in the Data Unit (0 for first)
+  @param llx       Lower left x position (FITS convention, 1 for leftmost)
+  @param lly       Lower left y position (FITS convention, 1 for lowest)
+  @param urx       Upper right x position (FITS convention)
+  @param ury       Upper right y position (FITS convention)
+  @return The newly allocated pixel buffer or NULL when not applicable
+  @see cpl_image_load_()
+
+  The current HDU of fptr must be the one to read from, and the window must
+  have been verified. Only the file pages covering the rows of the window are
+  mapped, and the pixels of the window are converted from the big-endian FITS
+  representation directly into the returned buffer, bypassing the buffers of
+  CFITSIO.
+
+  The fast path is only taken when the result is identical to that of
+  fits_read_img(): the file must be opened read-only (so CFITSIO cannot hold
+  modified data not yet written to disk), must be a plain, uncompressed FITS
+  file, and the conversion must be exact or a plain cast as done by CFITSIO,
+  i.e. BSCALE must be 1, BZERO must be 0 (or 32768 for unsigned 16 bit data),
+  and floating point data are never converted to integer. In all other cases
+  NULL is returned, without setting any error, and the caller must fall back
+  to CFITSIO.
+
+ */
+/*----------------------------------------------------------------------------*/
+static void * cpl_image_load_mmap_(fitsfile              * fptr,
+                                   const char            * filename,
+                                   cpl_type                pix_type,
+                                   const CPL_FITSIO_TYPE   naxes[],
+                                   cpl_size                pnum,
+                                   cpl_size                llx,
+                                   cpl_size                lly,
+                                   cpl_size                urx,
+                                   cpl_size                ury)
+{
+#ifdef CPL_IMAGE_IO_MMAP
+
+    int            error  = 0;
+    int            bitpix = 0;
+    double         bscale = 1.0;
+    double         bzero  = 0.0;
+    LONGLONG       headstart, datastart, dataend;
+    size_t         elsize;
+    const cpl_size nx = urx - llx + 1;
+    const cpl_size ny = ury - lly + 1;
+    const long     pagesize = sysconf(_SC_PAGESIZE);
+    off_t          offset, mapstart;
+    size_t         rowsize, maplen;
+    unsigned char  magic[6];
+    struct stat    sb;
+    unsigned char * map;
+    const unsigned char * first;
+    void         * pixels;
+    cpl_size       i, j;
+    int            fd;
+
+    if (fptr->Fptr->writemode != READONLY || pagesize <= 0) return NULL;
+
+    if (fits_is_compressed_image(fptr, &error) || error) return NULL;
+
+    if (fits_get_img_type(fptr, &bitpix, &error)) return NULL;
+
+    if (fits_read_key(fptr, TDOUBLE, "BSCALE", &bscale, NULL, &error)) {
+        if (error != KEY_NO_EXIST) return NULL;
+        error = 0;
+        bscale = 1.0;
+    }
+    if (fits_read_key(fptr, TDOUBLE, "BZERO", &bzero, NULL, &error)) {
+        if (error != KEY_NO_EXIST) return NULL;
+        error = 0;
+        bzero = 0.0;
+    }
+    if (bscale != 1.0) return NULL;
+    if (bzero != 0.0 && !(bitpix == SHORT_IMG && bzero == 32768.0))
+        return NULL;
+
+    switch (bitpix) {
+    case SHORT_IMG:
+        elsize = 2;
+        break;
+    case LONG_IMG:
+        elsize = 4;
+        if (pix_type != CPL_TYPE_INT && pix_type != CPL_TYPE_FLOAT &&
+            pix_type != CPL_TYPE_DOUBLE) return NULL;
+        break;
+    case FLOAT_IMG:
+        elsize = 4;
+        if (pix_type == CPL_TYPE_INT) return NULL;
+        break;
+    case DOUBLE_IMG:
+        elsize = 8;
+        if (pix_type == CPL_TYPE_INT) return NULL;
+        break;
+    default:
+        return NULL;
+    }
+
+    if (fits_get_hduaddrll(fptr, &headstart, &datastart, &dataend, &error))
+        return NULL;
+
+    rowsize = (size_t)naxes[0] * elsize;
+    offset  = (off_t)datastart
+        + (off_t)rowsize * ((off_t)naxes[1] * (off_t)pnum + (off_t)(lly - 1));
+    mapstart = offset - offset % pagesize;
+    maplen   = (size_t)(offset - mapstart) + rowsize * (size_t)ny;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    /* A gzip'ed file is uncompressed in memory by CFITSIO: the offsets of
+       the HDU refer to the uncompressed data, not to the file on disk */
+    if (fstat(fd, &sb)
+        || (off_t)sb.st_size < offset + (off_t)(rowsize * (size_t)ny)
+        || pread(fd, magic, sizeof(magic), 0) != (ssize_t)sizeof(magic)
+        || memcmp(magic, "SIMPLE", sizeof(magic))) {
+        close(fd);
+        return NULL;
+    }
+
+    map = mmap(NULL, maplen, PROT_READ, MAP_PRIVATE, fd, mapstart);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    first  = map + (offset - mapstart) + (size_t)(llx - 1) * elsize;
+    pixels = cpl_malloc((size_t)nx * (size_t)ny
+                        * cpl_type_get_sizeof(pix_type));
+
+    /* Convert from big-endian, one row of the window at a time */
+#define CPL_IMAGE_IO_MMAP_CONVERT(OTYPE, ITYPE, READ)                     \
+    do {                                                                  \
+        OTYPE * out = (OTYPE *)pixels;                                    \
+        for (j = 0; j < ny; j++) {                                        \
+            const unsigned char * in = first + (size_t)j * rowsize;       \
+            for (i = 0; i < nx; i++, in += elsize) {                       \
+                ITYPE value;                                              \
+                READ;                                                     \
+                *out++ = (OTYPE)value;                                    \
+            }                                                             \
+        }                                                                 \
+    } while (0)
+
+#define CPL_IMAGE_IO_MMAP_READ16                                          \
+    value = bzero != 0.0                                                  \
+        ? (int)(((unsigned)in[0] << 8 | in[1]) ^ 0x8000U)                 \
+        : (int)(short)((unsigned)in[0] << 8 | in[1])
+
+#define CPL_IMAGE_IO_MMAP_READ32                                          \
+    do {                                                                  \
+        const uint32_t u = (uint32_t)in[0] << 24 | (uint32_t)in[1] << 16  \
+            | (uint32_t)in[2] << 8 | (uint32_t)in[3];                     \
+        (void)memcpy(&value, &u, 4);                                      \
+    } while (0)
+
+#define CPL_IMAGE_IO_MMAP_READ64                                          \
+    do {                                                                  \
+        const uint64_t u = (uint64_t)in[0] << 56 | (uint64_t)in[1] << 48  \
+            | (uint64_t)in[2] << 40 | (uint64_t)in[3] << 32               \
+            | (uint64_t)in[4] << 24 | (uint64_t)in[5] << 16               \
+            | (uint64_t)in[6] << 8  | (uint64_t)in[7];                    \
+        (void)memcpy(&value, &u, 8);                                      \
+    } while (0)
+
+    switch (bitpix) {
+    case SHORT_IMG:
+        if (pix_type == CPL_TYPE_INT) {
+            CPL_IMAGE_IO_MMAP_CONVERT(int, int, CPL_IMAGE_IO_MMAP_READ16);
+        } else if (pix_type == CPL_TYPE_FLOAT) {
+            CPL_IMAGE_IO_MMAP_CONVERT(float, int,
+                                      CPL_IMAGE_IO_MMAP_READ16);
+        } else {
+            CPL_IMAGE_IO_MMAP_CONVERT(double, int,
+                                      CPL_IMAGE_IO_MMAP_READ16);
+        }
+        break;
+    case LONG_IMG:
+        if (pix_type == CPL_TYPE_INT) {
+            CPL_IMAGE_IO_MMAP_CONVERT(int, int32_t, CPL_IMAGE_IO_MMAP_READ32);
+        } else if (pix_type == CPL_TYPE_FLOAT) {
+            CPL_IMAGE_IO_MMAP_CONVERT(float, int32_t,
+                                      CPL_IMAGE_IO_MMAP_READ32);
+        } else {
+            CPL_IMAGE_IO_MMAP_CONVERT(double, int32_t,
+                                      CPL_IMAGE_IO_MMAP_READ32);
+        }
+        break;
+    case FLOAT_IMG:
+        if (pix_type == CPL_TYPE_FLOAT) {
+            CPL_IMAGE_IO_MMAP_CONVERT(float, float, CPL_IMAGE_IO_MMAP_READ32);
+        } else {
+            CPL_IMAGE_IO_MMAP_CONVERT(double, float,
+                                      CPL_IMAGE_IO_MMAP_READ32);
+        }
+        break;
+    default:
+        if (pix_type == CPL_TYPE_DOUBLE) {
+            CPL_IMAGE_IO_MMAP_CONVERT(double, double,
+                                      CPL_IMAGE_IO_MMAP_READ64);
+        } else {
+            CPL_IMAGE_IO_MMAP_CONVERT(float, double,
+                                      CPL_IMAGE_IO_MMAP_READ64);
+        }
+        break;
+    }
+
+#undef CPL_IMAGE_IO_MMAP_CONVERT
+#undef CPL_IMAGE_IO_MMAP_READ16
+#undef CPL_IMAGE_IO_MMAP_READ32
+#undef CPL_IMAGE_IO_MMAP_READ64
+
+    (void)munmap(map, maplen);
+
+    return pixels;
+
+#else
+    CPL_UNUSED(fptr); CPL_UNUSED(filename); CPL_UNUSED(pix_type);
+    CPL_UNUSED(naxes); CPL_UNUSED(pnum); CPL_UNUSED(llx); CPL_UNUSED(lly);
+    CPL_UNUSED(urx); CPL_UNUSED(ury);
+    return NULL;
+#endif
+}
+
+
 /*----------------------------------------------------------------------------*/
 /*
   @internal
@@ -2946,35 +3189,43 @@ cpl_image * cpl_image_load_(fitsfile      * fptr,
     nx = urx - llx + 1;
     ny = ury - lly + 1;
 
-    pixels = cpl_malloc((size_t)nx * (size_t)ny
-                        * cpl_type_get_sizeof(*ppix_type));
+    /* Uncompressed data on disk are read directly, when possible */
+    pixels = cpl_image_load_mmap_(fptr, filename, *ppix_type, naxes, pnum,
+                                  llx, lly, urx, ury);
+
+    if (pixels == NULL) {
 
-    if (nx == (cpl_size)naxes[0]) {
-        const LONGLONG nelem     =     naxes[0] * (LONGLONG)ny;
-        const LONGLONG firstelem = 1 + naxes[0] * (LONGLONG)(lly - 1)
-                                     + naxes[0] * naxes[1] * (LONGLONG)pnum;
+        pixels = cpl_malloc((size_t)nx * (size_t)ny
+                            * cpl_type_get_sizeof(*ppix_type));
 
-        if (fits_read_img(fptr, loadtype, firstelem, nelem,
-                          NULL, pixels, NULL, &error)) {
+        if (nx == (cpl_size)naxes[0]) {
+            const LONGLONG nelem     =     naxes[0] * (LONGLONG)ny;
+            const LONGLONG firstelem = 1 + naxes[0] * (LONGLONG)(lly - 1)
+                                         + naxes[0] * naxes[1] * (LONGLONG)pnum;
+
+            if (fits_read_img(fptr, loadtype, firstelem, nelem,
+                              NULL, pixels, NULL, &error)) {
+                cpl_free(pixels);
+                (void)cpl_error_set_fits(CPL_ERROR_BAD_FILE_FORMAT, error,
+                                         fits_read_img, "filename='%s', "
+                                         "pnum=%" CPL_SIZE_FORMAT
+                                         ", hdumov=%d, NAXIS=%d, "
+                                         "NAXIS1=%ld, NAXIS2=%ld",
+                                         filename, pnum, hdumov, *pnaxis,
+                                         (long)naxes[0], (long)naxes[1]);
+                return NULL;
+            }
+        } else if (cpl_fits_read_subset(fptr, loadtype, fpixel, lpixel, inc,
+                                        NULL, pixels, NULL, &error)) {
             cpl_free(pixels);
             (void)cpl_error_set_fits(CPL_ERROR_BAD_FILE_FORMAT, error,
-                                     fits_read_img, "filename='%s', "
+                                     fits_read_subset, "filename='%s', "
                                      "pnum=%" CPL_SIZE_FORMAT ", hdumov=%d, "
                                      "NAXIS=%d, NAXIS1=%ld, NAXIS2=%ld",
                                      filename, pnum, hdumov, *pnaxis,
                                      (long)naxes[0], (long)naxes[1]);
             return NULL;
         }
-    } else if (cpl_fits_read_subset(fptr, loadtype, fpixel, lpixel, inc,
-                                    NULL, pixels, NULL, &error)) {
-        cpl_free(pixels);
-        (void)cpl_error_set_fits(CPL_ERROR_BAD_FILE_FORMAT, error,
-                                 fits_read_subset, "filename='%s', "
-                                 "pnum=%" CPL_SIZE_FORMAT ", hdumov=%d, "
-                                 "NAXIS=%d, NAXIS1=%ld, NAXIS2=%ld",
-                                 filename, pnum, hdumov, *pnaxis,
-                                 (long)naxes[0], (long)naxes[1]);
-        return NULL;
     }
 
     self = cpl_image_wrap_(nx, ny, *ppix_type, pixels);
@@ -107,11 +107,39 @@ struct _cpl_table_ {
     cpl_size         nc;
     cpl_size         nr;
     cpl_column     **columns;
-    cpl_column_flag *select;
+    cpl_bitmask     *select;
     cpl_size         selectcount;
+    cpl_column     **index;
+    cpl_size         indexsize;
 };
 
 
+/*
+ * Tables with at least CPL_TABLE_INDEX_MIN columns keep an open
+ * addressing hash index of their columns by name, so that a column
+ * lookup does not need to compare its name with all the column names.
+ * The index size is a power of two, and at least twice the number of
+ * columns. Smaller tables are searched linearly.
+ */
+
+#define CPL_TABLE_INDEX_MIN  16
+
+
+/*
+ * The row selection flags are packed one bit per row into cpl_bitmask
+ * words. The bits of the last word beyond the table length are always
+ * zero, so that selected rows can be counted word by word. The bitmap
+ * is only allocated while some, but not all, rows are selected.
+ */
+
+#define CPL_TABLE_SELECT_BITS       ((cpl_size)(8 * sizeof(cpl_bitmask)))
+#define CPL_TABLE_SELECT_WORDS(n)   (((n) + CPL_TABLE_SELECT_BITS - 1) \
+                                     / CPL_TABLE_SELECT_BITS)
+#define CPL_TABLE_SELECT_WORD(i)    ((i) / CPL_TABLE_SELECT_BITS)
+#define CPL_TABLE_SELECT_BIT(i)     ((cpl_bitmask)1 \
+                                     << ((i) % CPL_TABLE_SELECT_BITS))
+
+
  /*
   * Prototypes for CPL_TYPE_LONG columns. Support for this type is implemented,
   * but disabled, since the FITS standard has no counterpart for this type.
@@ -177,6 +205,65 @@ static int strmatch(regex_t *, const char *)
  */
 
 
+/*
+ * Count the bits set in a selection word
+ */
+
+inline static cpl_size
+cpl_table_select_popcount_(cpl_bitmask word)
+{
+
+#if defined __GNUC__ && (__GNUC__ > 3 || __GNUC__ == 3 && __GNUC_MINOR__ > 3)
+    return (cpl_size)__builtin_popcountll(word);
+#else
+    word = word - ((word >> 1) & 0x5555555555555555ULL);
+    word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+    word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (cpl_size)((word * 0x0101010101010101ULL) >> 56);
+#endif
+
+}
+
+
+/*
+ * Allocate the selection bitmap of a table with all rows selected
+ * (flag != 0), or with none (flag == 0). The unused bits of the last
+ * word are cleared.
+ */
+
+inline static cpl_bitmask *
+cpl_table_select_new_(cpl_size nr, int flag)
+{
+
+    cpl_size     nw     = CPL_TABLE_SELECT_WORDS(nr);
+    cpl_bitmask *select = cpl_malloc(nw * sizeof(cpl_bitmask));
+
+    memset(select, flag ? 0xff : 0x00, nw * sizeof(cpl_bitmask));
+
+    if (flag && nr % CPL_TABLE_SELECT_BITS)
+        select[nw - 1] = CPL_TABLE_SELECT_BIT(nr) - 1;
+
+    return select;
+
+}
+
+
+/*
+ * Drop the selection bitmap if all, or none, of the rows are selected.
+ */
+
+inline static void
+cpl_table_select_trim_(cpl_table *table)
+{
+
+    if (table->selectcount == 0 || table->selectcount == table->nr) {
+        cpl_free(table->select);
+        table->select = NULL;
+    }
+
+}
+
+
 /*
  * Find the length of the longest string in the input array of strings
  */
@@ -685,6 +772,97 @@ const cpl_column *cpl_table_find_column_type_const(const cpl_table *table,
 }
 
 
+/*
+ * @brief
+ *   Hash a column name.
+ *
+ * @param name   Column name.
+ *
+ * @return The FNV-1a hash of the name.
+ */
+
+inline static cpl_size cpl_table_index_hash(const char *name)
+{
+
+    unsigned long long hash = 14695981039346656037ULL;
+
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 1099511628211ULL;
+    }
+
+    return (cpl_size)(hash >> 1);
+
+}
+
+
+/*
+ * @brief
+ *   Find the slot of a column name in the column index.
+ *
+ * @param table  Pointer to table with a column index.
+ * @param name   Column name.
+ *
+ * @return The slot holding the named column, or the empty slot where
+ *   it would be inserted.
+ */
+
+inline static cpl_size cpl_table_index_slot(const cpl_table *table,
+                                            const char *name)
+{
+
+    const cpl_size mask = table->indexsize - 1;
+    cpl_size       slot = cpl_table_index_hash(name) & mask;
+
+    while (table->index[slot] &&
+           strcmp(name, cpl_column_get_name(table->index[slot])) != 0)
+        slot = (slot + 1) & mask;
+
+    return slot;
+
+}
+
+
+/*
+ * @brief
+ *   Rebuild the column index of a table.
+ *
+ * @param table  Pointer to table.
+ *
+ * @return Nothing.
+ *
+ * The index is rebuilt from the current column list, or dropped if the
+ * table has too few columns to need one. This must be called whenever
+ * a column is removed from the table, or renamed.
+ */
+
+static void cpl_table_index_rebuild(cpl_table *table)
+{
+
+    cpl_size i;
+
+
+    cpl_free(table->index);
+    table->index = NULL;
+    table->indexsize = 0;
+
+    if (table->nc < CPL_TABLE_INDEX_MIN)
+        return;
+
+    table->indexsize = 2 * CPL_TABLE_INDEX_MIN;
+    while (table->indexsize < 2 * table->nc)
+        table->indexsize *= 2;
+
+    table->index = cpl_calloc(table->indexsize, sizeof(cpl_column *));
+
+    for (i = 0; i < table->nc; i++) {
+        const char *name = cpl_column_get_name(table->columns[i]);
+        table->index[cpl_table_index_slot(table, name)] = table->columns[i];
+    }
+
+}
+
+
 /*
  * @brief
  *   Find a column.
@@ -707,6 +885,9 @@ static const cpl_column *cpl_table_find_column_const(const cpl_table *table,
     const cpl_column * const *column =
         (const cpl_column * const *)table->columns;
 
+    if (table->index)
+        return table->index[cpl_table_index_slot(table, name)];
+
     for (cpl_size i = 0; i < table->nc; i++, column++) {
         const char *column_name = cpl_column_get_name(*column);
         if (strcmp(name, column_name) == 0) {
@@ -739,6 +920,9 @@ static cpl_column *cpl_table_find_column(cpl_table *table,
 
     cpl_column **column = table->columns;
 
+    if (table->index)
+        return table->index[cpl_table_index_slot(table, name)];
+
     for (cpl_size i = 0; i < table->nc; i++, column++) {
         const char *column_name = cpl_column_get_name(*column);
         if (strcmp(name, column_name) == 0) {
@@ -797,6 +981,8 @@ static cpl_column *cpl_table_extract_column(cpl_table *table, const char *name)
             table->columns = NULL;
         }
 
+        cpl_table_index_rebuild(table);
+
         if (table->nc == 0)          /* Last column deleted         */
             cpl_table_select_all(table);
 
@@ -839,6 +1025,14 @@ static cpl_error_code cpl_table_append_column(cpl_table *table,
 
     table->nc++;
 
+    if (table->index && 2 * table->nc <= table->indexsize) {
+        const char *name = cpl_column_get_name(column);
+        table->index[cpl_table_index_slot(table, name)] = column;
+    }
+    else if (table->nc >= CPL_TABLE_INDEX_MIN) {
+        cpl_table_index_rebuild(table);
+    }
+
     return CPL_ERROR_NONE;
 
 }
@@ -1472,6 +1666,8 @@ cpl_table *cpl_table_new(cpl_size length)
     table->columns = NULL;
     table->select = NULL;
     table->selectcount = length;
+    table->index = NULL;
+    table->indexsize = 0;
 
     return table;
 
@@ -2832,6 +3028,7 @@ void cpl_table_delete(cpl_table *table)
             cpl_free(table->columns);
         if (table->select)
             cpl_free(table->select);
+        cpl_free(table->index);
         cpl_free(table);
     }
 
@@ -4634,8 +4831,9 @@ cpl_error_code cpl_table_erase_window(cpl_table *table,
 cpl_error_code cpl_table_erase_selected(cpl_table *table)
 {
 
-    cpl_size    length = cpl_table_get_nrow(table);
-    cpl_size    i, width;
+    cpl_size         length = cpl_table_get_nrow(table);
+    cpl_size         i, width;
+    cpl_column_flag *pattern;
 
     if (table == NULL)
         return cpl_error_set_(CPL_ERROR_NULL_INPUT);
@@ -4648,11 +4846,19 @@ cpl_error_code cpl_table_erase_selected(cpl_table *table)
 
     width = cpl_table_get_ncol(table);
 
+    pattern = cpl_malloc(length * sizeof(cpl_column_flag));
+    for (i = 0; i < length; i++)
+        pattern[i] = (table->select[CPL_TABLE_SELECT_WORD(i)]
+                      & CPL_TABLE_SELECT_BIT(i)) != 0;
+
     for (i = 0; i < width; i++)
-        if (cpl_column_erase_pattern(table->columns[i], table->select)) {
+        if (cpl_column_erase_pattern(table->columns[i], pattern)) {
+            cpl_free(pattern);
             return cpl_error_set_where_();
         }
 
+    cpl_free(pattern);
+
     table->nr -= table->selectcount;
 
     return cpl_table_select_all(table);
@@ -7690,7 +7896,8 @@ cpl_error_code cpl_table_name_column(cpl_table *table, const char *from_name,
                                        const char *to_name)
 {
 
-    cpl_column  *column;
+    cpl_column     *column;
+    cpl_error_code  error;
 
 
     if (from_name == NULL || to_name == NULL || table == NULL)
@@ -7704,7 +7911,11 @@ cpl_error_code cpl_table_name_column(cpl_table *table, const char *from_name,
     if (!column)
         return cpl_error_set_(CPL_ERROR_DATA_NOT_FOUND);
 
-    return cpl_column_set_name(column, to_name);
+    error = cpl_column_set_name(column, to_name);
+
+    cpl_table_index_rebuild(table);
+
+    return error;
 
 }
 
@@ -8024,9 +8235,10 @@ cpl_table *cpl_table_duplicate(const cpl_table *table)
 
     if (table->select) {
 
-        new_table->select = cpl_malloc(length * sizeof(cpl_column_flag));
+        new_table->select = cpl_malloc(CPL_TABLE_SELECT_WORDS(length)
+                                       * sizeof(cpl_bitmask));
         memcpy(new_table->select, table->select,
-               length * sizeof(cpl_column_flag));
+               CPL_TABLE_SELECT_WORDS(length) * sizeof(cpl_bitmask));
 
     }
 
@@ -10228,16 +10440,13 @@ cpl_error_code cpl_table_select_row(cpl_table *table, cpl_size row)
         return CPL_ERROR_NONE;
 
     if (table->selectcount == 0)
-        table->select = cpl_calloc(table->nr, sizeof(cpl_column_flag));
+        table->select = cpl_table_select_new_(table->nr, 0);
 
-    if (table->select[row] == 0) {
-        table->select[row] = 1;
+    if (!(table->select[CPL_TABLE_SELECT_WORD(row)]
+          & CPL_TABLE_SELECT_BIT(row))) {
+        table->select[CPL_TABLE_SELECT_WORD(row)] |= CPL_TABLE_SELECT_BIT(row);
         table->selectcount++;
-
-        if (table->selectcount == table->nr) {
-            cpl_free(table->select);
-            table->select = NULL;
-        }
+        cpl_table_select_trim_(table);
     }
 
     return CPL_ERROR_NONE;
@@ -10320,9 +10529,6 @@ cpl_error_code cpl_table_select_all(cpl_table *table)
 cpl_error_code cpl_table_unselect_row(cpl_table *table, cpl_size row)
 {
 
-    int          length;
-
-
     if (table == NULL)
         return cpl_error_set_(CPL_ERROR_NULL_INPUT);
 
@@ -10332,24 +10538,13 @@ cpl_error_code cpl_table_unselect_row(cpl_table *table, cpl_size row)
     if (table->selectcount == 0)
         return CPL_ERROR_NONE;
 
-    length = table->nr;
-
-    if (table->selectcount == length)
-        table->select = cpl_malloc(table->nr * sizeof(cpl_column_flag));
-
-    if (table->selectcount == length)
-        while (length--)
-            table->select[length] = 1;
+    if (table->selectcount == table->nr)
+        table->select = cpl_table_select_new_(table->nr, 1);
 
-    if (table->select[row] == 1) {
-        table->select[row] = 0;
+    if (table->select[CPL_TABLE_SELECT_WORD(row)] & CPL_TABLE_SELECT_BIT(row)) {
+        table->select[CPL_TABLE_SELECT_WORD(row)] &= ~CPL_TABLE_SELECT_BIT(row);
         table->selectcount--;
-
-        if (table->selectcount == 0) {
-            if (table->select)
-                cpl_free(table->select);
-            table->select = NULL;
-        }
+        cpl_table_select_trim_(table);
     }
 
     return CPL_ERROR_NONE;
@@ -14460,7 +14655,7 @@ cpl_size cpl_table_and_selected_window(cpl_table *table,
                                        cpl_size start, cpl_size count)
 {
 
-    cpl_size    i;
+    cpl_size    i, first, last;
 
 
     if (table == NULL) {
@@ -14488,45 +14683,39 @@ cpl_size cpl_table_and_selected_window(cpl_table *table,
     if (count == table->nr)       /* "Anding" the whole table, no change */
         return table->selectcount;
 
-    if (table->selectcount == table->nr) {
+    if (count == 0) {             /* "Anding" an empty segment */
+        cpl_table_unselect_all(table);
+        return 0;
+    }
 
-        table->select = cpl_calloc(table->nr, sizeof(cpl_column_flag));
+    if (table->selectcount == table->nr)
+        table->select = cpl_table_select_new_(table->nr, 1);
 
-        i = start;
-        table->selectcount = count;
-        while (count--) {
-            table->select[i] = 1;
-            i++;
-        }
 
-    }
-    else {
+    /*
+     * Clear the words entirely outside the window, and mask the
+     * partial words at its edges.
+     */
 
-        i = 0;
-        while (i < start) {
-            if (table->select[i] == 1) {
-                table->select[i] = 0;
-                table->selectcount--;
-            }
-            i++;
-        }
+    first = CPL_TABLE_SELECT_WORD(start);
+    last  = CPL_TABLE_SELECT_WORD(start + count - 1);
 
-        i += count;
-        while (i < table->nr) {
-            if (table->select[i] == 1) {
-                table->select[i] = 0;
-                table->selectcount--;
-            }
-            i++;
-        }
+    for (i = 0; i < first; i++)
+        table->select[i] = 0;
 
-        if (table->selectcount == 0) {
-            if (table->select)
-                cpl_free(table->select);
-            table->select = NULL;
-        }
+    for (i = last + 1; i < CPL_TABLE_SELECT_WORDS(table->nr); i++)
+        table->select[i] = 0;
 
-    }
+    table->select[first] &= ~(CPL_TABLE_SELECT_BIT(start) - 1);
+
+    if ((start + count) % CPL_TABLE_SELECT_BITS)
+        table->select[last] &= CPL_TABLE_SELECT_BIT(start + count) - 1;
+
+    table->selectcount = 0;
+    for (i = first; i <= last; i++)
+        table->selectcount += cpl_table_select_popcount_(table->select[i]);
+
+    cpl_table_select_trim_(table);
 
     return table->selectcount;
 
@@ -14578,7 +14767,7 @@ cpl_size cpl_table_or_selected_window(cpl_table *table,
                                       cpl_size start, cpl_size count)
 {
 
-    cpl_size    i   = start;
+    cpl_size    i, first, last;
 
 
     if (table == NULL) {
@@ -14605,35 +14794,41 @@ cpl_size cpl_table_or_selected_window(cpl_table *table,
     if (table->selectcount == table->nr) /* All was selected, no "or" is due */
         return table->selectcount;
 
-    if (table->selectcount == 0) {
+    if (count == 0)
+        return table->selectcount;
 
-        table->select = cpl_calloc(table->nr, sizeof(cpl_column_flag));
+    if (table->selectcount == 0)
+        table->select = cpl_table_select_new_(table->nr, 0);
 
-        table->selectcount = count;
-        while (count--) {
-            table->select[i] = 1;
-            i++;
-        }
 
-    }
-    else {
+    /*
+     * Set the words entirely inside the window, and the masked
+     * partial words at its edges.
+     */
 
-        while (count--) {
-            if (table->select[i] == 0) {
-                table->select[i] = 1;
-                table->selectcount++;
-            }
-            i++;
-        }
+    first = CPL_TABLE_SELECT_WORD(start);
+    last  = CPL_TABLE_SELECT_WORD(start + count - 1);
 
-        if (table->selectcount == table->nr) {
-            if (table->select)
-                cpl_free(table->select);
-            table->select = NULL;
-        }
+    for (i = first; i <= last; i++)
+        table->selectcount -= cpl_table_select_popcount_(table->select[i]);
 
+    if (first == last) {
+        table->select[first] |= (CPL_TABLE_SELECT_BIT(start + count - 1) << 1)
+                              - CPL_TABLE_SELECT_BIT(start);
+    }
+    else {
+        table->select[first] |= ~(CPL_TABLE_SELECT_BIT(start) - 1);
+        for (i = first + 1; i < last; i++)
+            table->select[i] = ~(cpl_bitmask)0;
+        table->select[last] |= (CPL_TABLE_SELECT_BIT(start + count - 1) << 1)
+                             - 1;
     }
 
+    for (i = first; i <= last; i++)
+        table->selectcount += cpl_table_select_popcount_(table->select[i]);
+
+    cpl_table_select_trim_(table);
+
     return table->selectcount;
 
 }
@@ -14665,7 +14860,8 @@ cpl_size cpl_table_or_selected_window(cpl_table *table,
 cpl_size cpl_table_not_selected(cpl_table *table)
 {
 
-    cpl_size    length;
+    cpl_size    nw;
+    cpl_size    i;
 
 
     if (table == NULL) {
@@ -14679,14 +14875,13 @@ cpl_size cpl_table_not_selected(cpl_table *table)
     if (table->selectcount == table->nr)
         return table->selectcount = 0;
 
-    length = table->nr;
+    nw = CPL_TABLE_SELECT_WORDS(table->nr);
 
-    while (length--) {
-        if (table->select[length])
-            table->select[length] = 0;
-        else
-            table->select[length] = 1;
-    }
+    for (i = 0; i < nw; i++)
+        table->select[i] = ~table->select[i];
+
+    if (table->nr % CPL_TABLE_SELECT_BITS)
+        table->select[nw - 1] &= CPL_TABLE_SELECT_BIT(table->nr) - 1;
 
     return table->selectcount = table->nr - table->selectcount;
 
@@ -21084,7 +21279,8 @@ int cpl_table_is_selected(const cpl_table *table, cpl_size row)
     if (table->selectcount == table->nr)
         return 1;
 
-    return table->select[row];
+    return (table->select[CPL_TABLE_SELECT_WORD(row)]
+            & CPL_TABLE_SELECT_BIT(row)) != 0;
 
 }
 
@@ -21153,9 +21349,10 @@ cpl_size cpl_table_count_selected(const cpl_table *table)
 cpl_array *cpl_table_where_selected(const cpl_table *table)
 {
 
-    cpl_array *array;
-    cpl_size  *flags;
-    cpl_size   i;
+    cpl_array   *array;
+    cpl_size    *flags;
+    cpl_size     i, w;
+    cpl_bitmask  word;
 
 
     if (table == NULL) {
@@ -21172,9 +21369,11 @@ cpl_array *cpl_table_where_selected(const cpl_table *table)
         for (i = 0; i < table->nr; i++)
             *flags++ = i;
     else if (table->selectcount > 0)
-        for (i = 0; i < table->nr; i++)
-            if (table->select[i])
-                *flags++ = i;
+        for (w = 0; w < CPL_TABLE_SELECT_WORDS(table->nr); w++)
+            for (word = table->select[w], i = w * CPL_TABLE_SELECT_BITS;
+                 word; word >>= 1, i++)
+                if (word & 1)
+                    *flags++ = i;
 
     return array;
 
@@ -21240,7 +21439,8 @@ cpl_table *cpl_table_extract_selected(const cpl_table *table)
     i = 0;
     while (i < table->nr) {
 
-        if (table->select[i]) {
+        if (table->select[CPL_TABLE_SELECT_WORD(i)]
+            & CPL_TABLE_SELECT_BIT(i)) {
             if (count == 0)
                 from_row = i;
             count++;
@@ -21542,6 +21742,133 @@ cpl_error_code cpl_table_sort(cpl_table *table, const cpl_propertylist *reflist)
 }
 
 
+/*
+ * Read the rows of a numerical array column into newly created arrays.
+ * The rows are read in chunks, each one with a single CFITSIO call,
+ * rather than with one call per row. Rows containing only invalid
+ * elements are left NULL, as it was done when the rows were read one
+ * by one. The CFITSIO status is returned in status, as for the calls
+ * this replaces.
+ */
+
+static void cpl_table_load_column_array(fitsfile *fptr, int colnum,
+                                        int datatype, cpl_type type,
+                                        cpl_size firstrow, cpl_size nrow,
+                                        cpl_size depth, int check_nulls,
+                                        cpl_array **array, int *status)
+{
+
+    const size_t size = cpl_type_get_sizeof(type);
+
+    char     *buffer;
+    char     *nullarray = NULL;
+    cpl_size  chunk;
+    cpl_size  first;
+    cpl_size  j, z;
+
+
+    /*
+     * Chunks of about 4 MB, and at least one row
+     */
+
+    chunk = (4 << 20) / (size * depth);
+
+    if (chunk < 1)
+        chunk = 1;
+
+    if (chunk > nrow)
+        chunk = nrow;
+
+    if (chunk < 1)
+        return;
+
+    buffer = cpl_malloc(chunk * depth * size);
+
+    if (check_nulls)
+        nullarray = cpl_malloc(chunk * depth * sizeof(char));
+
+    for (first = 0; first < nrow && *status == 0; first += chunk) {
+
+        int anynul = 0;
+
+
+        if (chunk > nrow - first)
+            chunk = nrow - first;
+
+        if (check_nulls) {
+            fits_read_colnull(fptr, datatype, colnum, firstrow + first + 1, 1,
+                              chunk * depth, buffer, nullarray, &anynul,
+                              status);
+        }
+        else {
+            fits_read_col(fptr, datatype, colnum, firstrow + first + 1, 1,
+                          chunk * depth, 0, buffer, &anynul, status);
+        }
+
+        if (*status)
+            break;
+
+        for (j = 0; j < chunk; j++) {
+
+            cpl_size    nullcount = 0;
+            cpl_column *acolumn;
+            void       *data;
+
+
+            if (anynul) {
+                for (z = 0; z < depth; z++)
+                    if (nullarray[j * depth + z])
+                        nullcount++;
+            }
+
+            if (nullcount == depth) {
+                array[first + j] = NULL;
+                continue;
+            }
+
+            array[first + j] = cpl_array_new(depth, type);
+            acolumn = cpl_array_get_column(array[first + j]);
+
+            switch (type) {
+            case CPL_TYPE_INT:
+                data = cpl_column_get_data_int(acolumn);
+                break;
+            case CPL_TYPE_LONG_LONG:
+                data = cpl_column_get_data_long_long(acolumn);
+                break;
+            case CPL_TYPE_FLOAT:
+                data = cpl_column_get_data_float(acolumn);
+                break;
+            default:
+                data = cpl_column_get_data_double(acolumn);
+                break;
+            }
+
+            memcpy(data, buffer + j * depth * size, depth * size);
+
+            if (nullcount) {
+
+                cpl_column_flag *nulldata =
+                    cpl_malloc(depth * sizeof(cpl_column_flag));
+
+                for (z = 0; z < depth; z++)
+                    nulldata[z] = nullarray[j * depth + z];
+                cpl_column_set_data_invalid(acolumn, nulldata, nullcount);
+            }
+            else {
+                cpl_column_set_data_invalid(acolumn, NULL, 0);
+            }
+        }
+    }
+
+    cpl_free(nullarray);
+    cpl_free(buffer);
+
+    return;
+
+}
+
+
 static cpl_table *cpl_table_overload_window(const char *filename, int xtnum, 
                                             int check_nulls,
                                             const cpl_array *selcol,
@@ -22048,50 +22375,9 @@ static cpl_table *cpl_table_overload_window(const char *filename, int xtnum,
                 cpl_table_new_column_array(table, colname,
                                            CPL_TYPE_INT, depth);
                 array = cpl_table_get_data_array(table, colname);
-                nullarray = cpl_malloc(depth * sizeof(char));
-
-                for (j = 0; j < nrow; j++) {
-
-                    int *icolumn = NULL;
-
-                    array[j] = cpl_array_new(depth, CPL_TYPE_INT);
-                    acolumn = cpl_array_get_column(array[j]);
-
-                    icolumn = cpl_column_get_data_int(acolumn);
-                    if (check_nulls) {
-                        fits_read_colnull(fptr, TINT, i + 1, firstrow + j + 1, 
-                                          1, depth, icolumn, nullarray, 
-                                          &anynul, &status);
-                        nullcount = 0;
-                        if (anynul) {
-                            for (z = 0; z < depth; z++)
-                                if (nullarray[z])
-                                    nullcount++;
-    
-                            if (nullcount == depth) {
-                                cpl_array_delete(array[j]);
-                                array[j] = NULL;
-                            }
-                            else {
-                                nulldata = 
-                                cpl_malloc(depth * sizeof(cpl_column_flag));
-                                for (z = 0; z < depth; z++)
-                                    nulldata[z] = nullarray[z];
-                                cpl_column_set_data_invalid(acolumn, nulldata, 
-                                                            nullcount);
-                            }
-                        }
-                        else {
-                            cpl_column_set_data_invalid(acolumn, NULL, 0);
-                        }
-                    }
-                    else {
-                        fits_read_col(fptr, TINT, i + 1, firstrow + j + 1, 1, 
-                                      depth, 0, icolumn, &anynul, &status);
-                        cpl_column_set_data_invalid(acolumn, NULL, 0);
-                    }
-                }
-                cpl_free(nullarray);
+                cpl_table_load_column_array(fptr, i + 1, TINT, CPL_TYPE_INT,
+                                            firstrow, nrow, depth,
+                                            check_nulls, array, &status);
             }
             else {
 
@@ -22134,51 +22420,10 @@ static cpl_table *cpl_table_overload_window(const char *filename, int xtnum,
                 cpl_table_new_column_array(table, colname,
                                            CPL_TYPE_LONG_LONG, depth);
                 array = cpl_table_get_data_array(table, colname);
-                nullarray = cpl_malloc(depth * sizeof(char));
-
-                for (j = 0; j < nrow; j++) {
-
-                    long long *llcolumn = NULL;
-
-                    array[j] = cpl_array_new(depth, CPL_TYPE_LONG_LONG);
-                    acolumn = cpl_array_get_column(array[j]);
-
-                    llcolumn = cpl_column_get_data_long_long(acolumn);
-                    if (check_nulls) {
-                        fits_read_colnull(fptr, TLONGLONG, i + 1,
-                                          firstrow + j + 1, 1, depth,
-                                          llcolumn, nullarray,
-                                          &anynul, &status);
-                        nullcount = 0;
-                        if (anynul) {
-                            for (z = 0; z < depth; z++)
-                                if (nullarray[z])
-                                    nullcount++;
-
-                            if (nullcount == depth) {
-                                cpl_array_delete(array[j]);
-                                array[j] = NULL;
-                            }
-                            else {
-                                nulldata =
-                                cpl_malloc(depth * sizeof(cpl_column_flag));
-                                for (z = 0; z < depth; z++)
-                                    nulldata[z] = nullarray[z];
-                                cpl_column_set_data_invalid(acolumn, nulldata,
-                                                            nullcount);
-                            }
-                        }
-                        else {
-                            cpl_column_set_data_invalid(acolumn, NULL, 0);
-                        }
-                    }
-                    else {
-                        fits_read_col(fptr, TLONGLONG, i + 1, firstrow + j + 1,
-                                      1, depth, 0, llcolumn, &anynul, &status);
-                        cpl_column_set_data_invalid(acolumn, NULL, 0);
-                    }
-                }
-                cpl_free(nullarray);
+                cpl_table_load_column_array(fptr, i + 1, TLONGLONG,
+                                            CPL_TYPE_LONG_LONG, firstrow,
+                                            nrow, depth, check_nulls, array,
+                                            &status);
             }
             else {
 
@@ -22221,50 +22466,9 @@ static cpl_table *cpl_table_overload_window(const char *filename, int xtnum,
                 cpl_table_new_column_array(table, colname,
                                            CPL_TYPE_FLOAT, depth);
                 array = cpl_table_get_data_array(table, colname);
-                nullarray = cpl_malloc(depth * sizeof(char));
-
-                for (j = 0; j < nrow; j++) {
-
-                    float *fcolumn = NULL;
-
-                    array[j] = cpl_array_new(depth, CPL_TYPE_FLOAT);
-                    acolumn = cpl_array_get_column(array[j]);
-
-                    fcolumn = cpl_column_get_data_float(acolumn);
-                    if (check_nulls) {
-                        fits_read_colnull(fptr, TFLOAT, i + 1, 
-                                          firstrow + j + 1, 1, depth, fcolumn, 
-                                          nullarray, &anynul, &status);
-                        nullcount = 0;
-                        if (anynul) {
-                            for (z = 0; z < depth; z++)
-                                if (nullarray[z])
-                                    nullcount++;
-
-                            if (nullcount == depth) {
-                                cpl_array_delete(array[j]);
-                                array[j] = NULL;
-                            }
-                            else {
-                                nulldata = 
-                                cpl_malloc(depth * sizeof(cpl_column_flag));
-                                for (z = 0; z < depth; z++)
-                                    nulldata[z] = nullarray[z];
-                                cpl_column_set_data_invalid(acolumn, nulldata,
-                                                            nullcount);
-                            }
-                        }
-                        else {
-                            cpl_column_set_data_invalid(acolumn, NULL, 0);
-                        }
-                    }
-                    else {
-                        fits_read_col(fptr, TFLOAT, i + 1, firstrow + j + 1, 
-                                      1, depth, 0, fcolumn, &anynul, &status);
-                        cpl_column_set_data_invalid(acolumn, NULL, 0);
-                    }
-                }
-                cpl_free(nullarray);
+                cpl_table_load_column_array(fptr, i + 1, TFLOAT, CPL_TYPE_FLOAT,
+                                            firstrow, nrow, depth,
+                                            check_nulls, array, &status);
             }
             else {
 
@@ -22307,50 +22511,9 @@ static cpl_table *cpl_table_overload_window(const char *filename, int xtnum,
                 cpl_table_new_column_array(table, colname,
                                            CPL_TYPE_DOUBLE, depth);
                 array = cpl_table_get_data_array(table, colname);
-                nullarray = cpl_malloc(depth * sizeof(char));
-
-                for (j = 0; j < nrow; j++) {
-
-                    double *dcolumn = NULL;
-
-                    array[j] = cpl_array_new(depth, CPL_TYPE_DOUBLE);
-                    acolumn = cpl_array_get_column(array[j]);
-
-                    dcolumn = cpl_column_get_data_double(acolumn);
-                    if (check_nulls) {
-                        fits_read_colnull(fptr, TDOUBLE, i + 1, 
-                                          firstrow + j + 1, 1, depth, dcolumn, 
-                                          nullarray, &anynul, &status);
-                        nullcount = 0;
-                        if (anynul) { 
-                            for (z = 0; z < depth; z++)
-                                if (nullarray[z])
-                                    nullcount++;
-
-                            if (nullcount == depth) {
-                                cpl_array_delete(array[j]);
-                                array[j] = NULL;
-                            }
-                            else {
-                                nulldata = 
-                                cpl_malloc(depth * sizeof(cpl_column_flag));
-                                for (z = 0; z < depth; z++)
-                                    nulldata[z] = nullarray[z];
-                                cpl_column_set_data_invalid(acolumn, nulldata,
-                                                            nullcount);
-                            }
-                        }
-                        else {
-                            cpl_column_set_data_invalid(acolumn, NULL, 0);
-                        }
-                    }
-                    else {
-                        fits_read_col(fptr, TDOUBLE, i + 1, firstrow + j + 1, 
-                                      1, depth, 0, dcolumn, &anynul, &status);
-                        cpl_column_set_data_invalid(acolumn, NULL, 0);
-                    }
-                }
-                cpl_free(nullarray);
+                cpl_table_load_column_array(fptr, i + 1, TDOUBLE, CPL_TYPE_DOUBLE,
+                                            firstrow, nrow, depth,
+                                            check_nulls, array, &status);
             }
             else {
 
@@ -24340,11 +24503,68 @@ _cpl_table_write_column_array(fitsfile *outfile, cpl_size trow,
     }
 
 
-    for (irow = 0; irow < nrows; ++irow) {
+    /*
+     * Write all rows with a single call. String and complex rows were
+     * already converted into one contiguous buffer, while the rows of
+     * the other types are gathered here, unless they happen to be
+     * stored contiguously.
+     */
+
+    {
+
+        const char *first = tdata[0];
+        char       *rows  = NULL;
+
+        size_t rsize = layout->depth[icol];
+
+
+        switch (layout->value_type[icol]) {
+            case CPL_TYPE_STRING:
+                rsize *= sizeof(const char *);
+                break;
+            case CPL_TYPE_INT:
+                rsize *= sizeof(int);
+                break;
+            case CPL_TYPE_LONG_LONG:
+                rsize *= sizeof(long long);
+                break;
+            case CPL_TYPE_FLOAT:
+                rsize *= sizeof(float);
+                break;
+            case CPL_TYPE_DOUBLE:
+                rsize *= sizeof(double);
+                break;
+            case CPL_TYPE_FLOAT_COMPLEX:
+                rsize *= 2 * sizeof(float);
+                break;
+            default:
+                rsize *= 2 * sizeof(double);
+                break;
+        }
+
+        for (irow = 1; irow < nrows; ++irow) {
+            if ((const char *)tdata[irow] != first + irow * rsize) {
+                break;
+            }
+        }
+
+        if (irow < nrows) {
+
+            rows = cpl_malloc(nrows * rsize);
+
+            for (irow = 0; irow < nrows; ++irow) {
+                memcpy(rows + irow * rsize, tdata[irow], rsize);
+            }
+
+            first = rows;
+
+        }
 
         cpl_fits_write_colnull(outfile, layout->native_type[icol], icol + 1,
-                               trow + irow + 1, 1, layout->depth[icol],
-                               tdata[irow], tnull, &status);
+                               trow + 1, 1, nrows * layout->depth[icol],
+                               first, tnull, &status);
+
+        cpl_free(rows);
 
     }
 
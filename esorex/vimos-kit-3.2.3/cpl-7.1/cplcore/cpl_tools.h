@@ -76,7 +76,8 @@ CPL_BEGIN_DECLS
 #define CPL_FITS_COMPRKEYS  "^(" "ZIMAGE|ZCMPTYPE|ZNAXIS" \
         "|ZTENSION|ZPCOUNT|ZGCOUNT|ZNAME[0-9]|ZVAL[0-9]"  \
         "|ZTILE[0-9]|ZBITPIX|ZNAXIS[0-9]|ZSCALE|ZZERO"    \
-        "|ZBLANK|ZHECKSUM|ZDATASUM" ")$"
+        "|ZBLANK|ZHECKSUM|ZDATASUM|ZSIMPLE|ZEXTEND"       \
+        "|ZBLOCKED|ZTHEAP|ZQUANTIZ|ZDITHER0" ")$"
 
 /**
    @internal
@@ -42,6 +42,7 @@
 static double cpl_image_get_precision(cpl_type, cpl_type, double);
 static void cpl_image_fill_int_test(void);
 static void cpl_image_save_compression_test(void);
+static void cpl_image_load_window_test(void);
 
 /*-----------------------------------------------------------------------------
                                   Main
@@ -969,6 +970,9 @@ int main(void)
     /* Image compression tests */
     cpl_image_save_compression_test();
 
+    /* Windowed loading from a file opened only for reading */
+    cpl_image_load_window_test();
+
     cpl_test_zero( remove(FILENAME) );
 
     if (stream != stdout) cpl_test_zero( fclose(stream) );
@@ -1055,6 +1059,105 @@ static void cpl_image_fill_int_test(void)
 
 }
 
+/*----------------------------------------------------------------------------*/
+/**
+  @internal
+  @brief    Test windowed loading from a read-only, uncompressed file
+  @return   void
+  @see cpl_image_load_window()
+  @note The FITS cache is restarted before each load, so the file is opened
+        read-only and the data may be mapped directly instead of read via
+        the CFITSIO buffers.
+ */
+/*----------------------------------------------------------------------------*/
+static void cpl_image_load_window_test(void)
+{
+    const cpl_type bpps[]  = {CPL_TYPE_SHORT, CPL_TYPE_USHORT, CPL_TYPE_INT,
+                              CPL_TYPE_FLOAT, CPL_TYPE_DOUBLE};
+    const cpl_type types[] = {CPL_TYPE_INT, CPL_TYPE_FLOAT, CPL_TYPE_DOUBLE};
+    const double   minval[] = {-32768.0, 0.0, -2147483647.0,
+                               -65535.0, -2147483647.0};
+    const double   maxval[] = {32767.0, 65535.0, 2147483647.0,
+                               65535.0, 2147483647.0};
+    const cpl_size nx = 3 * IMAGESZ + 1;
+    const cpl_size ny = 2 * IMAGESZ - 1;
+    const size_t   nbpp  = sizeof(bpps)/sizeof(bpps[0]);
+    const size_t   ntype = sizeof(types)/sizeof(types[0]);
+    size_t         ibpp, itype;
+
+    for (ibpp = 0; ibpp < nbpp; ibpp++) {
+        const cpl_type type = bpps[ibpp] == CPL_TYPE_FLOAT ||
+            bpps[ibpp] == CPL_TYPE_DOUBLE ? bpps[ibpp] : CPL_TYPE_INT;
+        cpl_imagelist * list = cpl_imagelist_new();
+        cpl_size        ipl;
+        cpl_error_code  error;
+
+        for (ipl = 0; ipl < 3; ipl++) {
+            cpl_image * img = cpl_image_new(nx, ny, type);
+
+            error = cpl_image_fill_noise_uniform(img, minval[ibpp],
+                                                 maxval[ibpp]);
+            cpl_test_eq_error(error, CPL_ERROR_NONE);
+            if (type == CPL_TYPE_INT) {
+                /* Cover the extreme values of the on-disk type */
+                error = cpl_image_set(img, 1, 1, minval[ibpp]);
+                cpl_test_eq_error(error, CPL_ERROR_NONE);
+                error = cpl_image_set(img, nx, ny, maxval[ibpp]);
+                cpl_test_eq_error(error, CPL_ERROR_NONE);
+            }
+            cpl_imagelist_set(list, img, ipl);
+        }
+
+        error = cpl_imagelist_save(list, FILENAME, bpps[ibpp], NULL,
+                                   CPL_IO_CREATE);
+        cpl_test_eq_error(error, CPL_ERROR_NONE);
+        cpl_test_fits(FILENAME);
+
+        for (itype = 0; itype < ntype; itype++) {
+            const cpl_size win[][4] = {{1, 1, nx, ny},
+                                       {3, 5, nx - 7, ny - 2},
+                                       {nx, ny, nx, ny}};
+            size_t iwin;
+
+            for (iwin = 0; iwin < sizeof(win)/sizeof(win[0]); iwin++) {
+                const cpl_image * img =
+                    cpl_imagelist_get_const(list, (cpl_size)iwin);
+                cpl_image * load;
+                cpl_image * ref;
+                cpl_image * cast;
+
+                error = cpl_fits_set_mode(CPL_FITS_RESTART_CACHING);
+                cpl_test_eq_error(error, CPL_ERROR_NONE);
+
+                load = cpl_image_load_window(FILENAME, types[itype],
+                                             (cpl_size)iwin, 0,
+                                             win[iwin][0], win[iwin][1],
+                                             win[iwin][2], win[iwin][3]);
+                cpl_test_error(CPL_ERROR_NONE);
+                cpl_test_nonnull(load);
+                cpl_test_eq(cpl_image_get_type(load), types[itype]);
+
+                ref = cpl_image_extract(img, win[iwin][0], win[iwin][1],
+                                        win[iwin][2], win[iwin][3]);
+                cast = cpl_image_cast(ref, types[itype]);
+
+                if (types[itype] == CPL_TYPE_FLOAT &&
+                    type != CPL_TYPE_FLOAT) {
+                    cpl_test_image_rel(cast, load, FLT_EPSILON);
+                } else {
+                    cpl_test_image_abs(cast, load, 0.0);
+                }
+
+                cpl_image_delete(load);
+                cpl_image_delete(ref);
+                cpl_image_delete(cast);
+            }
+        }
+
+        cpl_imagelist_delete(list);
+    }
+}
+
 /*----------------------------------------------------------------------------*/
 /**
   @brief    Test saving with compression
@@ -1653,8 +1653,10 @@ int main(void)
     cpl_propertylist_set_comment(plist, "ZNAXIS1", "compressed NAXIS1");
     cpl_propertylist_append_long(plist, "ZNAXIS2", 1024);
     cpl_propertylist_set_comment(plist, "ZNAXIS2", "compressed NAXIS2");
+    cpl_propertylist_append_string(plist, "ZQUANTIZ", "SUBTRACTIVE_DITHER_1");
+    cpl_propertylist_append_long(plist, "ZDITHER0", 42);
     cpl_test_zero(cpl_propertylist_is_empty(plist));
-    cpl_test_eq(cpl_propertylist_get_size(plist), 4);
+    cpl_test_eq(cpl_propertylist_get_size(plist), 6);
 
 
     /* Save it in disk and check if compression keywords are removed */
@@ -1674,6 +1676,8 @@ int main(void)
     /* extension header */
     plist2 = cpl_propertylist_load(BASE "_24.fits", 1);
     cpl_test_zero(cpl_propertylist_has(plist2, "ZNAXIS"));
+    cpl_test_zero(cpl_propertylist_has(plist2, "ZQUANTIZ"));
+    cpl_test_zero(cpl_propertylist_has(plist2, "ZDITHER0"));
     cpl_propertylist_delete(plist2);
 
 
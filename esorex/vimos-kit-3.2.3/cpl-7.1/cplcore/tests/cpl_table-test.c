@@ -183,6 +183,9 @@
 
 static void cpl_table_test_zero_one(void);
 static void cpl_table_test_large(cpl_size);
+static void cpl_table_test_array_io(void);
+static void cpl_table_test_select(void);
+static void cpl_table_test_wide(int, int);
 static int cpl_table_test_main(void);
 static int cpl_table_test_rest(void);
 
@@ -210,6 +213,12 @@ int main(void)
 
     cpl_table_test_large(NROWS_LARGE);
 
+    cpl_table_test_array_io();
+
+    cpl_table_test_select();
+
+    cpl_table_test_wide(400, cpl_msg_get_level() <= CPL_MSG_INFO ? 10000 : 10);
+
     return cpl_test_end(0);
 
 
@@ -4790,6 +4799,336 @@ static void cpl_table_test_large(cpl_size nrows)
 
 }
 
+/*----------------------------------------------------------------------------*/
+/**
+  @internal
+  @brief    Test and benchmark column access in a table with many columns
+  @param ncol   The number of columns
+  @param nloop  The number of times all columns are accessed
+  @return   void
+  @note The columns are looked up through a name index, that must follow
+        the columns as they are erased, renamed and duplicated.
+ */
+/*----------------------------------------------------------------------------*/
+static void cpl_table_test_wide(int ncol, int nloop)
+{
+
+    const cpl_size nrows = 10;
+    cpl_table *table;
+    cpl_table *copy;
+    char       name[32];
+    double     secs;
+    long long  sum;
+    int        nulls;
+    int        i, j;
+
+
+    table = cpl_table_new(nrows);
+    cpl_test_nonnull(table);
+
+    for (i = 0; i < ncol; i++) {
+        sprintf(name, "f%d", i + 1);
+        cpl_test_zero(cpl_table_new_column(table, name, CPL_TYPE_INT));
+        cpl_test_zero(cpl_table_fill_column_window_int(table, name, 0,
+                                                       nrows, i));
+    }
+    cpl_test_eq(cpl_table_get_ncol(table), ncol);
+
+    secs = cpl_test_get_cputime();
+
+    sum = nulls = 0;
+    for (j = 0; j < nloop; j++) {
+        for (i = 0; i < ncol; i++) {
+            int null;
+
+            sprintf(name, "f%d", i + 1);
+            sum += cpl_table_get_int(table, name, j % nrows, &null);
+            nulls += null;
+        }
+    }
+
+    secs = cpl_test_get_cputime() - secs;
+
+    cpl_msg_info(cpl_func, "Time spent reading %d X %d columns [s]: %g",
+                 nloop, ncol, secs);
+
+    cpl_test_error(CPL_ERROR_NONE);
+    cpl_test_eq(sum, (long long)nloop * ncol * (ncol - 1) / 2);
+    cpl_test_zero(nulls);
+
+    /* Erase every third column, and rename every fifth */
+
+    for (i = 0; i < ncol; i += 3) {
+        sprintf(name, "f%d", i + 1);
+        cpl_test_zero(cpl_table_erase_column(table, name));
+    }
+    for (i = 1; i < ncol; i += 5) {
+        char new_name[32];
+
+        if (i % 3 == 0)
+            continue;
+        sprintf(name, "f%d", i + 1);
+        sprintf(new_name, "s%d", i + 1);
+        cpl_test_zero(cpl_table_name_column(table, name, new_name));
+    }
+
+    copy = cpl_table_duplicate(table);
+    cpl_test_nonnull(copy);
+
+    for (i = 0; i < ncol; i++) {
+        sprintf(name, "%c%d", i % 5 == 1 ? 's' : 'f', i + 1);
+        if (i % 3 == 0) {
+            cpl_test_zero(cpl_table_has_column(table, name));
+            cpl_test_zero(cpl_table_has_column(copy, name));
+        }
+        else {
+            cpl_test_eq(cpl_table_get_int(table, name, 0, NULL), i);
+            cpl_test_eq(cpl_table_get_int(copy, name, 0, NULL), i);
+        }
+        if (i % 5 == 1) {
+            sprintf(name, "f%d", i + 1);
+            cpl_test_zero(cpl_table_has_column(table, name));
+        }
+    }
+    cpl_test_error(CPL_ERROR_NONE);
+
+    cpl_table_delete(copy);
+    cpl_table_delete(table);
+
+}
+
+
+/*----------------------------------------------------------------------------*/
+/**
+  @internal
+  @brief    Test row selections spanning several selection words
+  @return   void
+  @note The selection flags are bit-packed, so windows are chosen to
+        start and end on, and in between, word boundaries. Each step is
+        checked against a reference selection kept in a plain array.
+ */
+/*----------------------------------------------------------------------------*/
+static void cpl_table_test_select(void)
+{
+
+    const cpl_size nrows = 203;
+    const cpl_size windows[][2] = {{0, 64}, {63, 2}, {64, 64}, {5, 190},
+                                   {130, 73}, {127, 1}, {1, 62}, {70, 0},
+                                   {200, 10}, {0, 203}};
+    const int      nwindows = (int)(sizeof(windows) / sizeof(windows[0]));
+    cpl_table *table;
+    cpl_table *extracted;
+    cpl_array *where;
+    int        reference[203];
+    cpl_size   count;
+    cpl_size   i;
+    int        w, k;
+
+
+    table = cpl_table_new(nrows);
+    cpl_test_nonnull(table);
+
+    cpl_test_zero(cpl_table_new_column(table, "Row", CPL_TYPE_INT));
+    for (i = 0; i < nrows; i++)
+        cpl_table_set_int(table, "Row", i, (int)i);
+
+    for (i = 0; i < nrows; i++)
+        reference[i] = 1;
+
+    for (w = 0; w < 3 * nwindows; w++) {
+
+        const cpl_size start = windows[w % nwindows][0];
+        const cpl_size size  = windows[w % nwindows][1];
+        const int      op    = w % 3;
+        cpl_size       stop  = start + size > nrows ? nrows : start + size;
+
+        if (op == 0) {
+            count = cpl_table_and_selected_window(table, start, size);
+            for (i = 0; i < nrows; i++)
+                if (i < start || i >= stop)
+                    reference[i] = 0;
+        }
+        else if (op == 1) {
+            count = cpl_table_or_selected_window(table, start, size);
+            for (i = start; i < stop; i++)
+                reference[i] = 1;
+        }
+        else {
+            count = cpl_table_not_selected(table);
+            for (i = 0; i < nrows; i++)
+                reference[i] = !reference[i];
+            cpl_test_zero(cpl_table_unselect_row(table, start));
+            reference[start] = 0;
+            cpl_test_zero(cpl_table_select_row(table, stop - 1));
+            reference[stop - 1] = 1;
+            count = cpl_table_count_selected(table);
+        }
+        cpl_test_error(CPL_ERROR_NONE);
+
+        k = 0;
+        for (i = 0; i < nrows; i++) {
+            cpl_test_eq(cpl_table_is_selected(table, i), reference[i]);
+            k += reference[i];
+        }
+        cpl_test_eq(count, k);
+
+        where = cpl_table_where_selected(table);
+        cpl_test_eq(cpl_array_get_size(where), k);
+        k = 0;
+        for (i = 0; i < nrows; i++)
+            if (reference[i]) {
+                cpl_test_eq(cpl_array_get_cplsize(where, k, NULL), i);
+                k++;
+            }
+        cpl_array_delete(where);
+
+        extracted = cpl_table_extract_selected(table);
+        cpl_test_eq(cpl_table_get_nrow(extracted), count);
+        k = 0;
+        for (i = 0; i < nrows; i++)
+            if (reference[i]) {
+                cpl_test_eq(cpl_table_get_int(extracted, "Row", k, NULL), i);
+                k++;
+            }
+        cpl_table_delete(extracted);
+
+    }
+
+    count = cpl_table_count_selected(table);
+    cpl_test_zero(cpl_table_erase_selected(table));
+    cpl_test_eq(cpl_table_get_nrow(table), nrows - count);
+    k = 0;
+    for (i = 0; i < nrows; i++)
+        if (!reference[i]) {
+            cpl_test_eq(cpl_table_get_int(table, "Row", k, NULL), i);
+            k++;
+        }
+    cpl_test_eq(cpl_table_count_selected(table), nrows - count);
+
+    cpl_table_delete(table);
+
+}
+
+
+/*----------------------------------------------------------------------------*/
+/**
+  @internal
+  @brief    Test saving and loading array columns larger than one I/O chunk
+  @return   void
+  @note Array columns are read and written in chunks of many rows. Rows
+        with invalid elements, and invalid rows, must survive the trip.
+ */
+/*----------------------------------------------------------------------------*/
+static void cpl_table_test_array_io(void)
+{
+
+    const cpl_size nrows = 3001;
+    const cpl_size depth = 401;
+    const char *names[] = {"AInt", "ALongLong", "AFloat", "ADouble"};
+    const cpl_type types[] = {CPL_TYPE_INT, CPL_TYPE_LONG_LONG,
+                              CPL_TYPE_FLOAT, CPL_TYPE_DOUBLE};
+    cpl_table *table;
+    cpl_table *loaded;
+    cpl_error_code error;
+    cpl_size i, j;
+    int c, check_nulls;
+
+
+    table = cpl_table_new(nrows);
+    cpl_test_nonnull(table);
+
+    for (c = 0; c < 4; c++) {
+
+        error = cpl_table_new_column_array(table, names[c], types[c], depth);
+        cpl_test_eq_error(error, CPL_ERROR_NONE);
+
+        for (i = 0; i < nrows; i++) {
+
+            cpl_array *array;
+
+            if (i % 97 == 5) {
+                continue;       /* Invalid row */
+            }
+
+            array = cpl_array_new(depth, types[c]);
+            for (j = 0; j < depth; j++) {
+                if ((i + j) % 53 != 0 || types[c] == CPL_TYPE_INT ||
+                    types[c] == CPL_TYPE_LONG_LONG) {
+                    cpl_array_set(array, j, (double)(i * depth + j + 1));
+                }
+            }
+            error = cpl_table_set_array(table, names[c], i, array);
+            cpl_test_eq_error(error, CPL_ERROR_NONE);
+            cpl_array_delete(array);
+        }
+    }
+
+    error = cpl_table_save(table, NULL, NULL, BASE "27.fits", CPL_IO_CREATE);
+    cpl_test_eq_error(error, CPL_ERROR_NONE);
+    cpl_test_fits(BASE "27.fits");
+
+    for (check_nulls = 0; check_nulls < 2; check_nulls++) {
+
+        loaded = cpl_table_load(BASE "27.fits", 1, check_nulls);
+        cpl_test_nonnull(loaded);
+        cpl_test_eq(cpl_table_get_nrow(loaded), nrows);
+
+        for (c = 0; c < 4; c++) {
+
+            const cpl_array **arrays =
+                cpl_table_get_data_array_const(loaded, names[c]);
+            const cpl_array **expect =
+                cpl_table_get_data_array_const(table, names[c]);
+
+            cpl_size mismatch = 0;
+
+            cpl_test_nonnull(arrays);
+            cpl_test_eq(cpl_table_get_column_depth(loaded, names[c]), depth);
+
+            for (i = 0; i < nrows; i++) {
+
+                /*
+                 * Rows with all elements invalid are loaded as invalid
+                 * rows when nulls are checked.
+                 */
+
+                if (expect[i] == NULL ||
+                    cpl_array_count_invalid(expect[i]) == depth) {
+                    if (check_nulls && arrays[i] != NULL) {
+                        mismatch++;
+                    }
+                    continue;
+                }
+
+                if (arrays[i] == NULL) {
+                    mismatch++;
+                    continue;
+                }
+
+                for (j = 0; j < depth; j++) {
+
+                    int null1, null2;
+                    const double v1 = cpl_array_get(arrays[i], j, &null1);
+                    const double v2 = cpl_array_get(expect[i], j, &null2);
+
+                    if ((check_nulls && null1 != null2) ||
+                        (!null2 && v1 != v2)) {
+                        mismatch++;
+                    }
+                }
+            }
+
+            cpl_test_zero(mismatch);
+        }
+
+        cpl_table_delete(loaded);
+    }
+
+    cpl_table_delete(table);
+    cpl_test_zero(remove(BASE "27.fits"));
+
+}
+
 
 /*----------------------------------------------------------------------------*/
 /**
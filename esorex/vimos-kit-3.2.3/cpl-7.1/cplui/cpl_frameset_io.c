@@ -30,6 +30,7 @@
 #include "cpl_errorstate.h"
 #include "cpl_error_impl.h"
 #include "cpl_io_fits.h"
+#include "cpl_memory.h"
 
 #include <cxmessages.h>
 #include <cxutils.h>
@@ -57,6 +58,9 @@
  */
 
 
+static cpl_error_code
+cpl_imagelist_append_from_frame(cpl_imagelist *, cpl_size *, const char *,
+                                cpl_type, cpl_size, cpl_size);
 static cpl_error_code
 cpl_imagelist_append_from_file(cpl_imagelist *, cpl_size *, const char *,
                                cpl_type, cpl_size, cpl_size);
@@ -71,6 +75,11 @@ cpl_imagelist_append_from_file(cpl_imagelist *, cpl_size *, const char *,
   @return   the loaded list of images or NULL on error.
   @note The returned cpl_imagelist must be deallocated using cpl_imagelist_delete()
 
+  When CPL is built with OpenMP support the files of the frameset are read
+  concurrently, one file per thread. Each file has its own CFITSIO handle and
+  I/O buffers, so the reads of distinct files do not serialize. The images
+  are inserted into the returned list in the order of the frames.
+
   Possible #_cpl_error_code_ set in this function:
   - CPL_ERROR_NULL_INPUT if fset is NULL
   - CPL_ERROR_ILLEGAL_INPUT if pnum is negative, xtnum is lower than -1
@@ -82,9 +91,15 @@ cpl_imagelist * cpl_imagelist_load_frameset(const cpl_frameset * fset,
                                             cpl_size             pnum, 
                                             cpl_size             xtnum) 
 {
-    cpl_imagelist   * self;
-    const cpl_frame * cur_frame;
-    cpl_size          selfsize;
+    cpl_imagelist         * self;
+    cpl_imagelist        ** lists;
+    const char           ** filenames;
+    cpl_error_code        * codes;
+    cpl_frameset_iterator * it;
+    const cpl_frame       * cur_frame;
+    cpl_size                nframes;
+    cpl_size                selfsize;
+    cpl_size                i, k;
 
 
     /* Test entries */
@@ -92,175 +107,271 @@ cpl_imagelist * cpl_imagelist_load_frameset(const cpl_frameset * fset,
     cpl_ensure(pnum  >= 0,    CPL_ERROR_ILLEGAL_INPUT, NULL);
     cpl_ensure(xtnum >= -1,   CPL_ERROR_ILLEGAL_INPUT, NULL);
 
-    /* Create empty output image list */
-    self = cpl_imagelist_new();
-    selfsize = 0;
+    nframes = cpl_frameset_get_size(fset);
 
-    cpl_frameset_iterator *it = cpl_frameset_iterator_new(fset);
+    if (nframes == 0) {
+        (void)cpl_error_set_message_(CPL_ERROR_ILLEGAL_INPUT, "file=<NULL>, "
+                                     "im_type=%d, pnum=%" CPL_SIZE_FORMAT
+                                     ", xtnum=%" CPL_SIZE_FORMAT,
+                                     im_type, pnum, xtnum);
+        return NULL;
+    }
 
-    while ((cur_frame = cpl_frameset_iterator_get_const(it)) != NULL) {
-        const char * filename = cpl_frame_get_filename(cur_frame);
+    /* Collect the file names in frameset order */
+    filenames = cpl_malloc((size_t)nframes * sizeof(*filenames));
+    lists     = cpl_calloc((size_t)nframes, sizeof(*lists));
+    codes     = cpl_calloc((size_t)nframes, sizeof(*codes));
 
+    it = cpl_frameset_iterator_new(fset);
+    for (i = 0; i < nframes; i++) {
         cpl_errorstate prestate;
 
-        if (xtnum < 0) {
-            /* Image(s) from all extensions requested.
-             */
+        cur_frame = cpl_frameset_iterator_get_const(it);
+        filenames[i] = cpl_frame_get_filename(cur_frame);
 
-            int            nextensions, ixtnum;
-            const cpl_size presize = selfsize;
+        prestate = cpl_errorstate_get();
+        cpl_frameset_iterator_advance(it, 1);
+        if (!cpl_errorstate_is_equal(prestate) &&
+            cpl_error_get_code() == CPL_ERROR_ACCESS_OUT_OF_RANGE) {
+            cpl_errorstate_set(prestate);
+        }
+    }
+    cpl_frameset_iterator_delete(it);
 
-            fitsfile     * fptr;
-            int            error = 0;
+    /* Load each file into its own list. The error state is thread private,
+       so only the error code of a failed load is passed on */
+#ifdef _OPENMP
+#pragma omp parallel for private(i) schedule(dynamic) if (nframes > 1)
+#endif
+    for (i = 0; i < nframes; i++) {
+        const cpl_errorstate prestate = cpl_errorstate_get();
+        cpl_imagelist      * onelist  = cpl_imagelist_new();
+        cpl_size             onesize  = 0;
+
+        if (cpl_imagelist_append_from_frame(onelist, &onesize, filenames[i],
+                                            im_type, pnum, xtnum)) {
+            codes[i] = cpl_error_get_code();
+            cpl_imagelist_delete(onelist);
+            onelist = NULL;
+        }
+        cpl_errorstate_set(prestate);
 
-            prestate = cpl_errorstate_get();
+        lists[i] = onelist;
+    }
 
-            /* Initialize to indicate that they need to be read from the file */
-            int             naxis = 0;
-            CPL_FITSIO_TYPE naxes[3] ={0, 0, 0};
-            cpl_type        pix_type = im_type;
+    /* Move the images to the output list, in frameset order */
+    self = cpl_imagelist_new();
+    selfsize = 0;
 
-            /* FIXME: Version 3.2 of fits_open_diskfile() seg-faults on NULL.
-               If fixed in CFITSIO, this check should be removed */
+    for (i = 0; i < nframes; i++) {
+        cpl_size j, onesize;
 
-            if (filename == NULL) {
-                cpl_frameset_iterator_delete(it);
-                cpl_error_set(cpl_func, CPL_ERROR_NULL_INPUT);
-                return NULL;
-            }
+        if (lists[i] == NULL) break;
 
-            if (cpl_io_fits_open_diskfile(&fptr, filename, READONLY, &error)) {
-                (void)cpl_error_set_fits(CPL_ERROR_ILLEGAL_INPUT, error,
-                                         fits_open_diskfile, "filename='%s', "
-                                         "im_type=%u, pnum=%" CPL_SIZE_FORMAT
-                                         ", xtnum=%" CPL_SIZE_FORMAT, filename,
-                                         (unsigned)im_type, pnum, xtnum);
+        onesize = cpl_imagelist_get_size(lists[i]);
+        for (j = 0; j < onesize; j++) {
+            cpl_image * img = cpl_imagelist_unset(lists[i], 0);
+
+            if (cpl_imagelist_set(self, img, selfsize)) {
+                /* Type or size could differ */
+                cpl_image_delete(img);
+                codes[i] = CPL_ERROR_ILLEGAL_INPUT;
                 break;
             }
+            selfsize++;
+        }
+        if (j < onesize) break;
+    }
+
+    for (k = 0; k < nframes; k++) {
+        cpl_imagelist_delete(lists[k]);
+    }
+    cpl_free(lists);
+
+    if (i < nframes) {
+        const char * filename = filenames[i];
 
-            /* Get the number of extensions (the primary HDU counts as one) */
-            if (fits_get_num_hdus(fptr, &nextensions, &error)) {
-                (void)cpl_error_set_fits(CPL_ERROR_ILLEGAL_INPUT, error,
-                                         fits_get_num_hdus, "filename='%s', "
+        cpl_imagelist_delete(self);
+        if (xtnum < 0 && filename == NULL) {
+            (void)cpl_error_set_(CPL_ERROR_NULL_INPUT);
+        } else {
+            (void)cpl_error_set_message_(CPL_ERROR_ILLEGAL_INPUT, "file=%s, "
                                          "im_type=%u, pnum=%" CPL_SIZE_FORMAT
-                                         ", xtnum=%" CPL_SIZE_FORMAT, filename,
+                                         ", xtnum=%" CPL_SIZE_FORMAT,
+                                         filename ? filename : "<NULL>",
                                          (unsigned)im_type, pnum, xtnum);
-                /* Ensure that the file is closed below */
-                error = nextensions = 0;
-            }
+        }
+        cpl_free(filenames);
+        cpl_free(codes);
+        return NULL;
+    }
 
-            for (ixtnum = 0; ixtnum < nextensions; ixtnum++) {
-                /* If all planes are to be read, start with the first one */
-                cpl_size iplane = pnum ? pnum - 1 : pnum;
-
-                /* Load 1 image from the extension. This will set naxis and
-                   naxes[] (and optionally the pixel type) for use in
-                   subsequent calls */
-                cpl_image * image = cpl_image_load_(fptr, &naxis, naxes,
-                                                    &pix_type, filename,
-                                                    iplane, ixtnum,
-                                                    CPL_FALSE, 0, 0, 0, 0);
-
-                if (!cpl_errorstate_is_equal(prestate)) {
-                    if (cpl_error_get_code() == CPL_ERROR_DATA_NOT_FOUND
-                        && ixtnum == 0) {
-                        /* Main HDU allowed to not have image data */
-                        cpl_errorstate_set(prestate);
-                        continue;
-                    }
-                    break;
-                }
+    cpl_free(filenames);
+    cpl_free(codes);
 
-                if (cpl_imagelist_set(self, image, selfsize)) {
-                    cpl_image_delete(image);
-                    break;
-                }
+    cx_assert(cpl_imagelist_get_size(self) == selfsize);
 
-                selfsize++;
+    /* Require created imagelist to be non-empty */
+    if (selfsize == 0) {
+        cpl_imagelist_delete(self);
+        (void)cpl_error_set_message_(CPL_ERROR_ILLEGAL_INPUT, "file=<NULL>, "
+                                     "im_type=%d, pnum=%" CPL_SIZE_FORMAT
+                                     ", xtnum=%" CPL_SIZE_FORMAT,
+                                     im_type, pnum, xtnum);
+        return NULL;
+    }
 
-                if (pnum == 0 && naxis == 3) {
-                    /* Handle other planes in this extension, if any */
-                    for (iplane = 1; iplane < naxes[2]; iplane++) {
-                        image = cpl_image_load_(fptr, &naxis, naxes, &pix_type,
-                                                filename, iplane, ixtnum,
-                                                CPL_FALSE, 0, 0, 0, 0);
-                        if (image == NULL) break;
+    return self;
 
-                        if (cpl_imagelist_set(self, image, selfsize)) {
-                            cpl_image_delete(image);
-                            break;
-                        }
+}
 
-                        selfsize++;
-                    }
-                    if (iplane < naxes[2]) break;
-                }
-            }
+/**@}*/
 
-            if (cpl_io_fits_close_file(fptr, &error)) {
-                (void)cpl_error_set_fits(CPL_ERROR_BAD_FILE_FORMAT, error,
-                                         fits_close_file, "filename='%s', "
-                                         "im_type=%u, pnum=%" CPL_SIZE_FORMAT
-                                         ", xtnum=%" CPL_SIZE_FORMAT, filename,
-                                         (unsigned)im_type, pnum, xtnum);
-            }
 
-            if (ixtnum < nextensions || selfsize == presize) break;
+/*----------------------------------------------------------------------------*/
+/**
+  @internal
+  @brief    Append the images of one frame to an imagelist
+  @param    self      The imagelist to append to
+  @param    pselfsize Increase with number of images appended
+  @param    filename  The file to read from
+  @param    im_type   The required image type
+  @param    pnum      The plane number, 1 for first, 0 for all planes
+  @param    xtnum     The extension number, 0 for primary, n for nth, -1 for all
+  @return   CPL_ERROR_NONE, or the relevant error code on error
+  @see cpl_imagelist_load_frameset()
+  @note This function only accesses the given file, so it may be called
+        concurrently for distinct files
 
-        } else {
-            if (cpl_imagelist_append_from_file(self, &selfsize, filename,
-                                               im_type, pnum, xtnum)) break;
+  Possible #_cpl_error_code_ set in this function:
+  - CPL_ERROR_NULL_INPUT if filename is NULL
+  - CPL_ERROR_ILLEGAL_INPUT if no image can be loaded as specified
+ */
+/*----------------------------------------------------------------------------*/
+static cpl_error_code cpl_imagelist_append_from_frame(cpl_imagelist * self,
+                                                      cpl_size      * pselfsize,
+                                                      const char    * filename,
+                                                      cpl_type        im_type,
+                                                      cpl_size        pnum,
+                                                      cpl_size        xtnum)
+{
+
+    /* FIXME: Version 3.2 of fits_open_diskfile() seg-faults on NULL.
+       If fixed in CFITSIO, this check should be removed */
+    cpl_ensure_code(filename != NULL, CPL_ERROR_NULL_INPUT);
+
+    if (xtnum < 0) {
+        /* Image(s) from all extensions requested.
+         */
+
+        int            nextensions, ixtnum;
+        const cpl_size presize = *pselfsize;
+        cpl_size       selfsize = presize;
+
+        fitsfile     * fptr;
+        int            error = 0;
+
+        const cpl_errorstate prestate = cpl_errorstate_get();
+
+        /* Initialize to indicate that they need to be read from the file */
+        int             naxis = 0;
+        CPL_FITSIO_TYPE naxes[3] ={0, 0, 0};
+        cpl_type        pix_type = im_type;
+
+        if (cpl_io_fits_open_diskfile(&fptr, filename, READONLY, &error)) {
+            return cpl_error_set_fits(CPL_ERROR_ILLEGAL_INPUT, error,
+                                      fits_open_diskfile, "filename='%s', "
+                                      "im_type=%u, pnum=%" CPL_SIZE_FORMAT
+                                      ", xtnum=%" CPL_SIZE_FORMAT, filename,
+                                      (unsigned)im_type, pnum, xtnum);
         }
 
-        prestate = cpl_errorstate_get();
+        /* Get the number of extensions (the primary HDU counts as one) */
+        if (fits_get_num_hdus(fptr, &nextensions, &error)) {
+            (void)cpl_error_set_fits(CPL_ERROR_ILLEGAL_INPUT, error,
+                                     fits_get_num_hdus, "filename='%s', "
+                                     "im_type=%u, pnum=%" CPL_SIZE_FORMAT
+                                     ", xtnum=%" CPL_SIZE_FORMAT, filename,
+                                     (unsigned)im_type, pnum, xtnum);
+            /* Ensure that the file is closed below */
+            error = nextensions = 0;
+        }
 
-        cpl_frameset_iterator_advance(it, 1);
+        for (ixtnum = 0; ixtnum < nextensions; ixtnum++) {
+            /* If all planes are to be read, start with the first one */
+            cpl_size iplane = pnum ? pnum - 1 : pnum;
 
-        if (!cpl_errorstate_is_equal(prestate)) {
-            if (cpl_error_get_code() == CPL_ERROR_ACCESS_OUT_OF_RANGE) {
-                cpl_errorstate_set(prestate);
+            /* Load 1 image from the extension. This will set naxis and
+               naxes[] (and optionally the pixel type) for use in
+               subsequent calls */
+            cpl_image * image = cpl_image_load_(fptr, &naxis, naxes,
+                                                &pix_type, filename,
+                                                iplane, ixtnum,
+                                                CPL_FALSE, 0, 0, 0, 0);
+
+            if (!cpl_errorstate_is_equal(prestate)) {
+                if (cpl_error_get_code() == CPL_ERROR_DATA_NOT_FOUND
+                    && ixtnum == 0) {
+                    /* Main HDU allowed to not have image data */
+                    cpl_errorstate_set(prestate);
+                    continue;
+                }
+                break;
             }
-        }
 
-    }
+            if (cpl_imagelist_set(self, image, selfsize)) {
+                cpl_image_delete(image);
+                break;
+            }
 
+            selfsize++;
 
-    if (cur_frame != NULL) {
-        const char * filename = cpl_frame_get_filename(cur_frame);
-        cpl_imagelist_delete(self);
-        (void)cpl_error_set_message_(CPL_ERROR_ILLEGAL_INPUT, "file=%s, "
+            if (pnum == 0 && naxis == 3) {
+                /* Handle other planes in this extension, if any */
+                for (iplane = 1; iplane < naxes[2]; iplane++) {
+                    image = cpl_image_load_(fptr, &naxis, naxes, &pix_type,
+                                            filename, iplane, ixtnum,
+                                            CPL_FALSE, 0, 0, 0, 0);
+                    if (image == NULL) break;
+
+                    if (cpl_imagelist_set(self, image, selfsize)) {
+                        cpl_image_delete(image);
+                        break;
+                    }
+
+                    selfsize++;
+                }
+                if (iplane < naxes[2]) break;
+            }
+        }
+
+        if (cpl_io_fits_close_file(fptr, &error)) {
+            (void)cpl_error_set_fits(CPL_ERROR_BAD_FILE_FORMAT, error,
+                                     fits_close_file, "filename='%s', "
                                      "im_type=%u, pnum=%" CPL_SIZE_FORMAT
-                                     ", xtnum=%" CPL_SIZE_FORMAT,
-                                     filename ? filename : "<NULL>",
+                                     ", xtnum=%" CPL_SIZE_FORMAT, filename,
                                      (unsigned)im_type, pnum, xtnum);
-        cpl_frameset_iterator_delete(it);
-        return NULL;
-    }
+        }
 
-    cx_assert(cpl_imagelist_get_size(self) == selfsize);
+        *pselfsize = selfsize;
 
-    /* Require created imagelist to be non-empty */
-    if (selfsize == 0) {
-        const char * filename = cpl_frame_get_filename(cur_frame);
-        cpl_imagelist_delete(self);
-        (void)cpl_error_set_message_(CPL_ERROR_ILLEGAL_INPUT, "file=%s, "
-                                     "im_type=%d, pnum=%" CPL_SIZE_FORMAT
-                                     ", xtnum=%" CPL_SIZE_FORMAT,
-                                     filename ? filename : "<NULL>",
-                                     im_type, pnum, xtnum);
-        cpl_frameset_iterator_delete(it);
-        return NULL;
-    }
+        if (ixtnum < nextensions || selfsize == presize) {
+            return cpl_error_set_message_(CPL_ERROR_ILLEGAL_INPUT,
+                                          "filename='%s', im_type=%u, pnum=%"
+                                          CPL_SIZE_FORMAT ", xtnum=%"
+                                          CPL_SIZE_FORMAT, filename,
+                                          (unsigned)im_type, pnum, xtnum);
+        }
 
-    cpl_frameset_iterator_delete(it);
+    } else if (cpl_imagelist_append_from_file(self, pselfsize, filename,
+                                              im_type, pnum, xtnum)) {
+        return cpl_error_set_where_();
+    }
 
-    return self;
+    return CPL_ERROR_NONE;
 
 }
 
-/**@}*/
-
-
 /*----------------------------------------------------------------------------*/
 /**
   @internal
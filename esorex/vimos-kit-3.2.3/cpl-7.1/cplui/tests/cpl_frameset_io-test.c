@@ -307,6 +307,37 @@ int main(void)
         }
     }
 
+    /* 
+     * Test 5: The files may be loaded concurrently, but the images must be
+               in the order of the frames.
+     */
+
+    for (i = 0; (cxsize)i < CX_N_ELEMENTS(names); i++) {
+        cpl_image * img = cpl_image_new(IMAGESZ, IMAGESZ, CPL_TYPE_FLOAT);
+
+        error = cpl_image_add_scalar(img, (double)i);
+        cpl_test_eq_error(error, CPL_ERROR_NONE);
+        error = cpl_image_save(img, names[i], CPL_TYPE_FLOAT, NULL,
+                               CPL_IO_CREATE);
+        cpl_test_eq_error(error, CPL_ERROR_NONE);
+        cpl_image_delete(img);
+    }
+
+    for (has_primary = -1; has_primary <= 0; has_primary++) {
+        imlist = cpl_imagelist_load_frameset(frameset, CPL_TYPE_FLOAT, 1,
+                                             has_primary);
+
+        cpl_test_error(CPL_ERROR_NONE);
+        cpl_test_eq(cpl_imagelist_get_size(imlist), CX_N_ELEMENTS(names));
+
+        for (i = 0; i < cpl_imagelist_get_size(imlist); i++) {
+            const cpl_image * img = cpl_imagelist_get_const(imlist, i);
+            cpl_test_abs(cpl_image_get_mean(img), (double)i, 0.0);
+        }
+
+        cpl_imagelist_delete(imlist);
+    }
+
     cpl_image_delete(img1);
     cpl_frameset_delete(frameset);
 
@@ -100,6 +100,28 @@ er_init_parameters(cpl_parameterlist *param_list)
     cpl_parameter_disable (p, CPL_PARAMETER_MODE_CFG);
     cpl_parameterlist_append (param_list, p);
 
+    /*
+     *  batch
+     */
+
+    p = cpl_parameter_new_value (PACKAGE_RESOURCE ".batch",
+                                 CPL_TYPE_STRING,
+                                 "File listing recipe invocations to be "
+                                 "executed one after the other by this "
+                                 "process. Each line has the form "
+                                 "'[options] recipe [recipe-options] "
+                                 "[sof]', where the options apply to "
+                                 "that step only, in addition to the "
+                                 "options given on the command line. "
+                                 "Empty lines and lines starting with '#' "
+                                 "are ignored. The execution stops at "
+                                 "the first step that fails.",
+                                 PACKAGE_RESOURCE, NULL);
+    cpl_parameter_set_alias (p, CPL_PARAMETER_MODE_CLI, "batch");
+    cpl_parameter_disable (p, CPL_PARAMETER_MODE_ENV);
+    cpl_parameter_disable (p, CPL_PARAMETER_MODE_CFG);
+    cpl_parameterlist_append (param_list, p);
+
     /*
      *      check-sof-exist
      */
@@ -565,6 +587,156 @@ er_print_header(void)
 }
 
 
+/*
+ * Returns non-zero if a command line argument is the --batch option.
+ */
+
+inline static int
+_esorex_is_batch_option(const char *arg)
+{
+
+    while (*arg == '-') {
+        ++arg;
+    }
+
+    return (strcmp(arg, "batch") == 0) || (strncmp(arg, "batch=", 6) == 0);
+
+}
+
+
+// Executes the recipe invocations listed in a batch file. Each step
+// is processed exactly like a separate EsoRex run, with the command
+// line options (except --batch) followed by the words of the step's
+// line, but CPL, the plugin loader and the plugin lookup cache stay
+// initialized from one step to the next.
+
+static int
+_esorex_batch_process(const char *batch_file,
+                      char *syscfg, char *cfg,
+                      int argc, char *argv[])
+{
+    const char *fn = "EsoRex";
+
+    char line[4 * MAXSTRLENCONF];
+
+    int iarg;
+    int nstep = 0;
+    int e_code = 0;
+
+    FILE *fp = fopen(batch_file, "r");
+
+
+    if (fp == NULL) {
+        cpl_msg_error(fn, "Cannot open batch file '%s'", batch_file);
+        return -1;
+    }
+
+    while ((e_code == 0) && (fgets(line, sizeof line, fp) != NULL)) {
+
+        char plugin_name[FILEMAX+2];
+        char *token;
+        char **_argv;
+
+        int _argc = 0;
+
+        size_t sz = strlen(line);
+
+        cpl_parameterlist *parameters;
+        er_stringarray_t *sof_filenames;
+
+
+        if ((sz > 0) && (line[sz - 1] != '\n') && !feof(fp)) {
+            cpl_msg_error(fn, "Line too long in batch file '%s'", batch_file);
+            e_code = -1;
+            break;
+        }
+
+        token = strtok(line, " \t\r\n");
+
+        if ((token == NULL) || (token[0] == '#')) {
+            continue;
+        }
+
+        ++nstep;
+
+
+        /*
+         * Build the argument vector of this step. The number of words
+         * on the line is at most half its length (plus one).
+         */
+
+        _argv = static_cast<char**>(cpl_calloc(argc + sz / 2 + 2,
+                                               sizeof(char *)));
+
+        for (iarg = 0; iarg < argc; ++iarg) {
+
+            if ((iarg > 0) && _esorex_is_batch_option(argv[iarg])) {
+                continue;
+            }
+
+            _argv[_argc++] = argv[iarg];
+
+        }
+
+        while (token != NULL) {
+            _argv[_argc++] = token;
+            token = strtok(NULL, " \t\r\n");
+        }
+
+
+        /*
+         * Every step starts from the EsoRex defaults, as a separate
+         * EsoRex run would.
+         */
+
+        (void) er_manage_sources(3, "", NULL);
+
+        parameters = cpl_parameterlist_new();
+        sof_filenames = er_stringarray_new();
+
+        er_init_parameters(parameters);
+
+        plugin_name[0] = '\0';
+        e_code = params_process_configuration(parameters, syscfg, cfg,
+                                              _argc, _argv, plugin_name,
+                                              sof_filenames);
+
+        if ((e_code == 0) && (plugin_name[0] != '\0')) {
+
+            cpl_msg_info(fn, "Batch step %d: %s", nstep, plugin_name);
+
+            e_code = plugin_process_plugin(parameters, plugin_name,
+                                           sof_filenames, _argc, _argv);
+
+            if (e_code != 0) {
+                cpl_msg_error(fn, "Batch step %d (%s) failed", nstep,
+                              plugin_name);
+            }
+
+        }
+        else if (e_code == 0) {
+            cpl_msg_error(fn, "No recipe given in batch step %d", nstep);
+            e_code = -1;
+        }
+        else if (e_code == -99999) {
+            e_code = 0;
+        }
+
+        cpl_error_reset();
+
+        cpl_parameterlist_delete(parameters);
+        er_stringarray_delete(sof_filenames);
+        cpl_free(_argv);
+
+    }
+
+    fclose(fp);
+
+    return e_code;
+
+}
+
+
 inline static int
 _esorex_config_value_get(FILE *fp, const char *key, char *value, size_t sz)
 {
@@ -824,6 +996,7 @@ int main(int argc, char *argv[])
     char  *conf_file_global=NULL, *conf_file_local=NULL;
 
     const char *cdescr;
+    const char *val_batch = NULL;
 
     cpl_parameter *p = NULL;
     cpl_parameterlist *caller_parameter_list = NULL;
@@ -899,9 +1072,27 @@ int main(int argc, char *argv[])
                                            plugin_name, set_of_frames_filenames);
 
 
-    /* Process Plugin */
+    /* Process a batch of recipe invocations, or the plugin */
 
-    if (e_code == 0 && plugin_name[0] != '\0')
+    p = cpl_parameterlist_find (caller_parameter_list,
+                                PACKAGE_RESOURCE ".batch");
+    val_batch = cpl_parameter_get_string (p);
+
+    if (e_code == 0 && val_batch != NULL && val_batch[0] != '\0')
+    {
+        if (plugin_name[0] != '\0')
+        {
+            cpl_msg_error (fn, "No recipe may be given together with "
+                           "option --batch");
+            e_code = -1;
+        }
+        else
+        {
+            e_code = _esorex_batch_process (val_batch, conf_file_global,
+                                            conf_file_local, argc, argv);
+        }
+    }
+    else if (e_code == 0 && plugin_name[0] != '\0')
     {
         // FIXME: Error handling is non-local here and hard to trace.
         //        This has to be improved!
@@ -973,6 +1164,7 @@ int main(int argc, char *argv[])
     }
 
     (void) er_help_free();
+    plugin_cache_clear();
     (void) er_manage_sources(3, "", NULL);  /* free buffer of sources */
 
 #ifdef ENABLE_PYTHON_RECIPES
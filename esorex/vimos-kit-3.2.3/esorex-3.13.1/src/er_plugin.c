@@ -53,6 +53,18 @@
 
 static cpl_frameset *holdme;
 
+/*
+ * Plugin lookup cache. When several recipes are executed by the same
+ * process (see the --batch option), the plugin libraries found in the
+ * recipe directories, and the library providing each recipe, are only
+ * searched for once.
+ */
+
+static char *cached_recipe_dirs = NULL;
+static er_stringarray_t *cached_pllib_names = NULL;
+static er_stringarray_t *cached_plugin_names = NULL;
+static er_stringarray_t *cached_plugin_paths = NULL;
+
 #define SIZE_A  2048
 #define SIZE_AA 2 * SIZE_A
 #define SIZE_B  128
@@ -811,6 +823,91 @@ _move_products (cpl_frameset * frameset,
 }                            
 
 
+/**********************************************************************/
+/**
+ * @brief  Gets the library path of a plugin, using the lookup cache
+ *
+ * @param recipe_dirs     Recipe directory search path, as given
+ * @param val_recipe_dirs Recipe directories split into an array
+ * @param plugin_name     Name of the plugin to look for
+ * @param[out] libpath    Filled with the library path string
+ *
+ * @returns the length of the library path found,
+ *          or 0, in the case that no suitable library was found
+ *
+ * This function returns the same result as er_pluginlist_get_libpath()
+ * for the list of plugin libraries found in @c val_recipe_dirs. The list
+ * and the libraries of the plugins already looked up are kept until the
+ * recipe search path changes, or plugin_cache_clear() is called.
+ */
+/**********************************************************************/
+
+static int plugin_cached_libpath (const char *recipe_dirs,
+                                  char **val_recipe_dirs,
+                                  const char *plugin_name, char *libpath)
+
+{
+    int i, sz;
+
+
+    if ((cached_recipe_dirs == NULL) ||
+        (strcmp(cached_recipe_dirs, recipe_dirs) != 0))
+    {
+        plugin_cache_clear ();
+
+        cached_pllib_names = er_pluginlist_create_list (val_recipe_dirs);
+        if (cached_pllib_names == NULL) return 0;
+
+        cached_recipe_dirs = cpl_strdup (recipe_dirs);
+        cached_plugin_names = er_stringarray_new ();
+        cached_plugin_paths = er_stringarray_new ();
+    }
+
+    for (i=0; i<er_stringarray_size (cached_plugin_names); i++)
+    {
+        if (strcmp(er_stringarray_get (cached_plugin_names, i),
+                   plugin_name) == 0)
+        {
+            (void) strcpy(libpath, er_stringarray_get (cached_plugin_paths, i));
+            return (int) strlen(libpath);
+        }
+    }
+
+    sz = er_pluginlist_get_libpath (cached_pllib_names, plugin_name, libpath);
+    if (sz > 0)
+    {
+        er_stringarray_append (cached_plugin_names, plugin_name);
+        er_stringarray_append (cached_plugin_paths, libpath);
+    }
+
+    return sz;
+}
+
+
+/**********************************************************************/
+/**
+ * @brief  Releases the plugin lookup cache
+ *
+ * This function frees the list of plugin libraries and the plugin
+ * locations remembered by plugin_process_plugin().
+ */
+/**********************************************************************/
+
+void plugin_cache_clear (void)
+
+{
+    if (cached_recipe_dirs != NULL) cpl_free (cached_recipe_dirs);
+    if (cached_pllib_names != NULL) er_stringarray_delete (cached_pllib_names);
+    if (cached_plugin_names != NULL) er_stringarray_delete (cached_plugin_names);
+    if (cached_plugin_paths != NULL) er_stringarray_delete (cached_plugin_paths);
+
+    cached_recipe_dirs = NULL;
+    cached_pllib_names = NULL;
+    cached_plugin_names = NULL;
+    cached_plugin_paths = NULL;
+}
+
+
 /**********************************************************************/
 /**
  * @brief Process the Plugin
@@ -895,8 +992,6 @@ int plugin_process_plugin (cpl_parameterlist *caller_parameters,
 
     cpl_error_code log_err;
 
-    er_stringarray_t *list_of_pllib_names = NULL;
-
 
     library_path[0] = '\0';
 
@@ -977,9 +1072,8 @@ int plugin_process_plugin (cpl_parameterlist *caller_parameters,
 
     if ((val_recipe_dirs != NULL) && (sz > 0))
     {
-        list_of_pllib_names = er_pluginlist_create_list (val_recipe_dirs);
-
-        sz = er_pluginlist_get_libpath (list_of_pllib_names, plugin_name, library_path);
+        sz = plugin_cached_libpath (val_string_tmp, val_recipe_dirs,
+                                    plugin_name, library_path);
         if (sz > 0)
         {
             tplugin = er_pluginlist_get_plugin (library_path, plugin_name, &module);
@@ -1609,7 +1703,6 @@ int plugin_process_plugin (cpl_parameterlist *caller_parameters,
     if (plugin_conf_file_local != NULL) cpl_free (plugin_conf_file_local);
 
     if (val_recipe_dirs != NULL) cx_strfreev (val_recipe_dirs);
-    if (list_of_pllib_names != NULL) er_stringarray_delete (list_of_pllib_names);
 
     if (tplugin != NULL) cpl_plugin_delete (tplugin);
 
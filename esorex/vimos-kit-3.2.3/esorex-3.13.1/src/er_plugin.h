@@ -32,6 +32,8 @@ CPL_BEGIN_DECLS
 extern int plugin_process_plugin(cpl_parameterlist *, char *,
                                  er_stringarray_t *, int, char **);
 
+extern void plugin_cache_clear(void);
+
 extern cpl_msg_severity message_severity(cpl_parameterlist *param_list,
                                          int flag);
 
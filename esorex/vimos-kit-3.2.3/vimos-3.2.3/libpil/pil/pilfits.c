@@ -29,6 +29,7 @@
 #include <config.h>
 #endif
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -69,6 +70,29 @@ struct _PIL_FITS_FILE_ {
 };
 
 
+/*
+ * Number of compressed FITS files kept open for reading
+ */
+
+#define PIL_FITS_CACHE_SIZE (8)
+
+
+/*
+ * Read-only handles to compressed FITS files. CFITSIO inflates a
+ * compressed file entirely into memory when it is opened, so these
+ * handles are kept and reopened, instead of decompressing the same
+ * raw frame each time it is accessed.
+ */
+
+typedef struct _PIL_FITS_CACHE_ENTRY_ {
+    char *name;
+    fitsfile *fptr;
+} PilFitsCacheEntry;
+
+static PilFitsCacheEntry pilFitsCache[PIL_FITS_CACHE_SIZE];
+static int pilFitsCacheNext = 0;
+
+
 /**
  * @defgroup pilFits pilFits
  *
@@ -128,6 +152,173 @@ pilFitsKeyType(PilFitsFile *fitsFile, const char *keyName)
 }
 
 
+/*
+ * @brief
+ *   Check whether a file is compressed.
+ *
+ * @param filename  File name.
+ *
+ * @return 1 if the file starts with the signature of one of the
+ *   compression formats CFITSIO can read, 0 otherwise.
+ */
+
+static int
+pilFitsIsCompressed(const char *filename)
+{
+
+    unsigned char magic[4];
+
+    size_t sz;
+
+    FILE *fp = fopen(filename, "rb");
+
+
+    if (!fp)
+        return 0;
+
+    sz = fread(magic, 1, sizeof magic, fp);
+    fclose(fp);
+
+    if (sz < 2)
+        return 0;
+
+    /*
+     * gzip, compress, pack and LZH signatures
+     */
+
+    if (magic[0] == 0x1f && (magic[1] == 0x8b || magic[1] == 0x9d ||
+                             magic[1] == 0x1e || magic[1] == 0xa0))
+        return 1;
+
+    /*
+     * pkzip signature
+     */
+
+    if (sz == 4 && memcmp(magic, "PK\003\004", 4) == 0)
+        return 1;
+
+    return 0;
+
+}
+
+
+/**
+ * @brief
+ *   Open a FITS file.
+ *
+ * @param fptr      Address of the CFITSIO file pointer to set.
+ * @param filename  File name.
+ * @param iomode    CFITSIO I/O mode, @c READONLY or @c READWRITE.
+ * @param status    CFITSIO status.
+ *
+ * @return The CFITSIO status.
+ *
+ * The function is a replacement for @b ffopen() with the same calling
+ * conventions. Compressed files (gzip, Unix compress, ...) opened in
+ * @c READONLY mode are decompressed into memory only the first time they
+ * are opened. The handle is kept in a small cache, and later calls for
+ * the same file return a new handle to the same uncompressed data,
+ * obtained with @b ffreopen(). The returned handle must be closed with
+ * @b ffclos() as usual. The memory is released when the file is evicted
+ * from the cache, or when @b pilFitsCacheClear() is called, and all
+ * handles to it have been closed.
+ *
+ * Uncompressed files, and files opened in @c READWRITE mode, are passed
+ * to @b ffopen() unchanged.
+ */
+
+int
+pilFitsOpen(fitsfile **fptr, const char *filename, int iomode, int *status)
+{
+
+    register int i;
+
+    PilFitsCacheEntry *entry;
+
+
+    if (*status)
+        return *status;
+
+    if (iomode != READONLY || !pilFitsIsCompressed(filename))
+        return ffopen(fptr, filename, iomode, status);
+
+    for (i = 0; i < PIL_FITS_CACHE_SIZE; i++) {
+        entry = &pilFitsCache[i];
+
+        if (entry->name && strcmp(entry->name, filename) == 0)
+            return ffreopen(entry->fptr, fptr, status);
+    }
+
+
+    /*
+     * Not yet cached: decompress the file, and replace the oldest
+     * entry of the cache.
+     */
+
+    entry = &pilFitsCache[pilFitsCacheNext];
+
+    if (entry->name) {
+        int _status = 0;
+
+        ffclos(entry->fptr, &_status);
+        pil_free(entry->name);
+
+        entry->name = NULL;
+        entry->fptr = NULL;
+    }
+
+    if (ffopen(&entry->fptr, filename, READONLY, status)) {
+        entry->fptr = NULL;
+        return *status;
+    }
+
+    entry->name = pil_strdup(filename);
+    pilFitsCacheNext = (pilFitsCacheNext + 1) % PIL_FITS_CACHE_SIZE;
+
+    return ffreopen(entry->fptr, fptr, status);
+
+}
+
+
+/**
+ * @brief
+ *   Release the cached compressed FITS files.
+ *
+ * @return Nothing.
+ *
+ * The function closes all the handles kept by @b pilFitsOpen(). The
+ * memory holding the uncompressed data of a file is released as soon as
+ * the last handle returned for it is closed.
+ */
+
+void
+pilFitsCacheClear(void)
+{
+
+    register int i;
+
+
+    for (i = 0; i < PIL_FITS_CACHE_SIZE; i++) {
+        PilFitsCacheEntry *entry = &pilFitsCache[i];
+
+        if (entry->name) {
+            int status = 0;
+
+            ffclos(entry->fptr, &status);
+            pil_free(entry->name);
+
+            entry->name = NULL;
+            entry->fptr = NULL;
+        }
+    }
+
+    pilFitsCacheNext = 0;
+
+    return;
+
+}
+
+
 /**
  * @brief
  *   Destroy a FITS file object.
@@ -208,7 +399,7 @@ newPilFitsFile(const char *filename, PilFitsIOMode mode)
               break;
       }
 
-      if (ffopen(&fitsFile->fptr, filename, io_mode, &status)) {
+      if (pilFitsOpen(&fitsFile->fptr, filename, io_mode, &status)) {
           deletePilFitsFile(fitsFile);
           return NULL;
       }
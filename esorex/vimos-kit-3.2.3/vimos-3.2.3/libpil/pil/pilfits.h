@@ -61,6 +61,13 @@ typedef struct _PIL_FITS_FILE_ PilFitsFile;
 PilFitsFile *newPilFitsFile(const char *, PilFitsIOMode);
 void deletePilFitsFile(PilFitsFile *);
 
+/*
+ * Opening FITS files
+ */
+
+int pilFitsOpen(fitsfile **, const char *, int, int *);
+void pilFitsCacheClear(void);
+
 /*
  * Methods
  */
@@ -33,6 +33,7 @@
  -----------------------------------------------------------------------------*/
 
 #include "hdrl_lacosmics.h"
+#include "hdrl_bpm_utils.h"
 #include "hdrl_utils.h"
 
 #include <math.h>
@@ -307,6 +308,139 @@ hdrl_parameter * hdrl_lacosmic_parameter_parse_parlist(
 
 
 
+/*----------------------------------------------------------------------------*/
+/**
+  @internal
+  @brief  Median of a buffer, with the convention of cpl_vector_get_median()
+  @param  w   The buffer, which is reordered
+  @param  n   The number of elements, at least one
+  @return The median, i.e. the mean of the two central values for even n
+ */
+/*----------------------------------------------------------------------------*/
+static double hdrl_lacosmic_median(double * w, intptr_t n)
+{
+    const intptr_t k = (n - 1) / 2;
+    intptr_t l = 0;
+    intptr_t m = n - 1;
+
+    while (l < m) {
+        const double x = w[k];
+        intptr_t i = l;
+        intptr_t j = m;
+        do {
+            while (w[i] < x) i++;
+            while (x < w[j]) j--;
+            if (i <= j) {
+                const double t = w[i];
+                w[i] = w[j];
+                w[j] = t;
+                i++;
+                j--;
+            }
+        } while (i <= j);
+        if (j < k) l = i;
+        if (k < i) m = j;
+    }
+
+    if (n & 1) {
+        return w[k];
+    }
+    else {
+        double u = w[k + 1];
+        for (intptr_t i = k + 2; i < n; i++) {
+            if (w[i] < u) u = w[i];
+        }
+        return w[k] + (u - w[k]) / 2.0;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/**
+  @internal
+  @brief  Median of the (2 h + 1) x (2 h + 1) window centred on one pixel
+  @param  data   The image buffer
+  @param  bpm    The bad pixels of the image or NULL
+  @param  nx     The image width
+  @param  ny     The image height
+  @param  x      The x position of the pixel (0 for the first)
+  @param  y      The y position of the pixel (0 for the first)
+  @param  h      The window half size
+  @param  w      Work buffer of (2 h + 1)^2 elements
+  @param  isbad  Set to CPL_BINARY_1 when the window has no good pixel
+  @return The median of the good pixels in the window, or 0
+
+  The result is the one of cpl_image_filter_mask() with CPL_FILTER_MEDIAN
+  and CPL_BORDER_FILTER, i.e. the window is truncated at the image edges.
+ */
+/*----------------------------------------------------------------------------*/
+static double hdrl_lacosmic_window_median(const double * data,
+                                          const cpl_binary * bpm,
+                                          intptr_t nx, intptr_t ny,
+                                          intptr_t x, intptr_t y, intptr_t h,
+                                          double * w, cpl_binary * isbad)
+{
+    const intptr_t x1 = CX_MAX(x - h, 0);
+    const intptr_t x2 = CX_MIN(x + h, nx - 1);
+    const intptr_t y1 = CX_MAX(y - h, 0);
+    const intptr_t y2 = CX_MIN(y + h, ny - 1);
+    intptr_t n = 0;
+
+    for (intptr_t j = y1; j <= y2; j++) {
+        for (intptr_t i = x1; i <= x2; i++) {
+            if (bpm == NULL || bpm[i + j * nx] == CPL_BINARY_0) {
+                w[n++] = data[i + j * nx];
+            }
+        }
+    }
+
+    if (n == 0) {
+        *isbad = CPL_BINARY_1;
+        return 0.0;
+    }
+
+    *isbad = CPL_BINARY_0;
+    return hdrl_lacosmic_median(w, n);
+}
+
+/*----------------------------------------------------------------------------*/
+/**
+  @internal
+  @brief  Positive Laplacian of the image super-sampled by a factor 2
+  @param  data   The image buffer
+  @param  nx     The image width
+  @param  ny     The image height
+  @param  x      The x position of the sub-pixel in the super-sampled image
+  @param  y      The y position of the sub-pixel in the super-sampled image
+  @return The Laplacian, or 0 where it is negative
+
+  The super-sampled image, where each pixel is replicated into 2 x 2
+  sub-pixels, is not built: the sub-pixel values are read from the
+  image. The border sub-pixels take the value of their inner neighbour.
+  The sum is done in the same order as cpl_image_filter() with the
+  Laplacian kernel, whose normalisation by the kernel weight 8 was
+  undone by the former implementation.
+ */
+/*----------------------------------------------------------------------------*/
+static inline double hdrl_lacosmic_laplacian(const double * data,
+                                             intptr_t nx, intptr_t ny,
+                                             intptr_t x, intptr_t y)
+{
+    double sum;
+
+    x = CX_MIN(CX_MAX(x, 1), 2 * nx - 2);
+    y = CX_MIN(CX_MAX(y, 1), 2 * ny - 2);
+
+#define HDRL_LACOSMIC_SUB(x_, y_) data[((x_) >> 1) + ((y_) >> 1) * nx]
+    sum  = -HDRL_LACOSMIC_SUB(x, y - 1);
+    sum -= HDRL_LACOSMIC_SUB(x - 1, y);
+    sum += 4.0 * HDRL_LACOSMIC_SUB(x, y);
+    sum -= HDRL_LACOSMIC_SUB(x + 1, y);
+    sum -= HDRL_LACOSMIC_SUB(x, y + 1);
+#undef HDRL_LACOSMIC_SUB
+
+    return sum < 0.0 ? 0.0 : sum;
+}
+
 /*----------------------------------------------------------------------------*/
 /**
   @brief Detect bad-pixels  / cosmic-rays on a single image.
@@ -348,34 +482,26 @@ cpl_mask * hdrl_lacosmic_edgedetect(
     cpl_image * sci_error = NULL;
     cpl_mask  * sci_mask = NULL;
     cpl_image * laplacian_redu_data = NULL; /* re-binned Laplacian */
-    cpl_image * subs2_data = NULL; /* Sub-sampled image by a factor of 2 */
     cpl_image * s_data = NULL;
-    cpl_image * f_data = NULL;
+    cpl_image * s2_data = NULL;
+    cpl_image * sci_median3_data = NULL;
     cpl_image * r_data = NULL;
 
-
-    intptr_t subs2_nx = 0;
-    intptr_t subs2_ny = 0;
-
     cpl_binary * psci_mask = NULL;
     cpl_binary * pout_mask = NULL;
+    cpl_binary * psci_median3_bpm = NULL;
+    const cpl_binary * pbad = NULL;
 
-    cpl_matrix * laplacian_kernel = NULL;
-
-    cpl_mask * median3_kernel = NULL;
-    cpl_mask * median5_kernel = NULL;
-    cpl_mask * median7_kernel = NULL;
     cpl_mask * lastiter_mask = NULL;
     cpl_mask * out_mask = NULL;
+    cpl_mask * candidates = NULL;
 
     double * psci_data = NULL;
     double * psci_error = NULL;
-    double * psubs2_data = NULL;
-    double * plaplacian_data = NULL;
     double * plaplacian_redu_data = NULL;
     double * psci_median3_data = NULL;
     double * ps_data = NULL;
-    double * pf_data = NULL;
+    double * ps2_data = NULL;
     double * pr_data = NULL;
 
     int nbiter = 1;
@@ -407,48 +533,20 @@ cpl_mask * hdrl_lacosmic_edgedetect(
     sci_error = cpl_image_cast(hdrl_image_get_error_const(ima_in),
             CPL_TYPE_DOUBLE);
 
-    /* Laplacian */
-    laplacian_kernel = cpl_matrix_new(3, 3);
-    cpl_matrix_set(laplacian_kernel, 0, 0, 0.0);
-    cpl_matrix_set(laplacian_kernel, 0, 1, -1.0);
-    cpl_matrix_set(laplacian_kernel, 0, 2, 0.0);
-    cpl_matrix_set(laplacian_kernel, 1, 0, -1.0);
-    cpl_matrix_set(laplacian_kernel, 1, 1, 4.0);
-    cpl_matrix_set(laplacian_kernel, 1, 2, -1.0);
-    cpl_matrix_set(laplacian_kernel, 2, 0, 0.0);
-    cpl_matrix_set(laplacian_kernel, 2, 1, -1.0);
-    cpl_matrix_set(laplacian_kernel, 2, 2, 0.0);
-
-    /* Median 3x3*/
-    median3_kernel = cpl_mask_new(3, 3);
-    cpl_mask_not(median3_kernel); /* All values set to unity */
-
-    /* Median 5x5 */
-    median5_kernel = cpl_mask_new(5, 5);
-    cpl_mask_not(median5_kernel); /* All values set to unity */
-
-    /* Median 7x7 */
-    median7_kernel = cpl_mask_new(7, 7);
-    cpl_mask_not(median7_kernel); /* All values set to unity */
-
     out_mask = cpl_mask_new(cpl_mask_get_size_x(sci_mask),
                     cpl_mask_get_size_y(sci_mask));
 
     nx = cpl_image_get_size_x(sci_data);
     ny = cpl_image_get_size_y(sci_data);
 
-    /* Preparing different kernels */
     psci_data = cpl_image_get_data_double(sci_data);
     psci_error = cpl_image_get_data_double(sci_error);
 
     psci_mask = cpl_mask_get_data(sci_mask);
     pout_mask = cpl_mask_get_data(out_mask);
 
-    subs2_nx = nx * 2;
-    subs2_ny = ny * 2;
-
-    subs2_data = cpl_image_new(subs2_nx, subs2_ny, CPL_TYPE_DOUBLE);
-    psubs2_data = cpl_image_get_data_double( subs2_data);
+    /* The median filters skip the bad pixels of the input image, if any */
+    pbad = cpl_mask_is_empty(sci_mask) ? NULL : psci_mask;
 
     laplacian_redu_data = cpl_image_new(nx, ny, CPL_TYPE_DOUBLE);
     plaplacian_redu_data = cpl_image_get_data_double( laplacian_redu_data);
@@ -456,8 +554,12 @@ cpl_mask * hdrl_lacosmic_edgedetect(
     s_data = cpl_image_new(nx, ny, CPL_TYPE_DOUBLE);
     ps_data = cpl_image_get_data_double( s_data);
 
-    f_data = cpl_image_new(nx, ny, CPL_TYPE_DOUBLE);
-    pf_data = cpl_image_get_data_double( f_data);
+    s2_data = cpl_image_new(nx, ny, CPL_TYPE_DOUBLE);
+    ps2_data = cpl_image_get_data_double( s2_data);
+
+    sci_median3_data = cpl_image_new(nx, ny, CPL_TYPE_DOUBLE);
+    psci_median3_data = cpl_image_get_data_double(sci_median3_data);
+    psci_median3_bpm = cpl_calloc(nx * ny, sizeof(cpl_binary));
 
     r_data = cpl_image_new(nx, ny, CPL_TYPE_DOUBLE);
     pr_data = cpl_image_get_data_double( r_data);
@@ -470,8 +572,10 @@ cpl_mask * hdrl_lacosmic_edgedetect(
      * stop if no new cosmic are found or max iter is reached */
     while (nbiter <= p_loc->max_iter) {
         cpl_vector * median;
-        double * psci_median3_7_data;
-        double * ps_median_data;
+        cpl_mask * needed3;
+        const cpl_binary * pcandidates;
+        const cpl_binary * pneeded3;
+        int nonnegative = 1;
 
         /* Stopping if the detections of the previus run are identical to
          *  the last run */
@@ -483,85 +587,32 @@ cpl_mask * hdrl_lacosmic_edgedetect(
         cpl_mask_delete(lastiter_mask);
         lastiter_mask = cpl_mask_duplicate(out_mask);
 
-        /* Super sample data:
-           Create a 2n x 2n images like this
-         | 1 | 2 |  =>  | 1 | 1 | 2 | 2 |
-         | 3 | 4 |      | 1 | 1 | 2 | 2 |
-                        | 3 | 3 | 4 | 4 |
-                        | 3 | 3 | 4 | 4 | */
-
-        for (intptr_t j = 0; j < ny; j++) {
-            intptr_t j_2_subs2_nx = j * 2 * subs2_nx;
-            intptr_t j_nx = j * nx;
-            for (intptr_t i = 0; i < nx; i++) {
-                double val = psci_data[i + j_nx];
-                intptr_t pix = i * 2 + j_2_subs2_nx;
-                psubs2_data[pix] = val;
-                psubs2_data[pix + subs2_nx] = val;
-                pix++;
-                psubs2_data[pix] = val;
-                psubs2_data[pix + subs2_nx] = val;
-            }
-        }
-
-        /* Doing the Laplacian convolution and set negative pixels to
-           0 in the Laplacian image
+        /* Laplacian of the data super sampled by a factor 2, with negative
+           pixels set to 0, and re-binned to the original size
           0  -1   0
          -1   4  -1
-          0  -1   0 */
-
-        cpl_image * laplacian_data = hdrl_parallel_filter_image(subs2_data,
-                                                    laplacian_kernel, NULL,
-                                                    CPL_FILTER_LINEAR);
-
-        plaplacian_data = cpl_image_get_data_double(laplacian_data);
-        for (intptr_t i = 0; i < subs2_nx * subs2_ny; i++) {
-            if (plaplacian_data[i] < 0.0) {
-                plaplacian_data[i] = 0.0;
-            } else {
-                /*TODO Where does this factor of 8 come from???*/
-                plaplacian_data[i] *= 8.0;
-            }
-        }
-
-        /* fix discontinuity at edges due to incomplete laplace kernel by
-         * mirroring the neighbouring pixel */
-        for (intptr_t i = 0; i < subs2_ny; i++) {
-            plaplacian_data[i * subs2_nx + 0] = plaplacian_data[i * subs2_nx + 1];
-            plaplacian_data[i * subs2_nx + subs2_nx - 1] =
-                plaplacian_data[i * subs2_nx +  + subs2_nx - 2];
-        }
-        for (intptr_t j = 0; j < subs2_nx; j++) {
-            plaplacian_data[0 * subs2_nx + j] = plaplacian_data[1 * subs2_nx + j];
-            plaplacian_data[(subs2_ny - 1) * subs2_nx + j] =
-                plaplacian_data[(subs2_ny - 2) * subs2_nx + j];
-        }
-
-#if REGDEBUG_FULL
-        cpl_image_save(laplacian_data, "Lpositive.fits", CPL_BPP_IEEE_DOUBLE, 
-                NULL, CPL_IO_DEFAULT);
-#endif
-
-        /* resample to the original size
-         | 1 | 1 | 2 | 2 |    | 1 | 2 |
-         | 1 | 1 | 2 | 2 |    | 3 | 4 |
-         | 3 | 3 | 4 | 4 | =>
-         | 3 | 3 | 4 | 4 |               */
+          0  -1   0
+           Each pixel of the super sampled image is one of 2 x 2 copies of
+           a data pixel, so that its Laplacian is computed directly from the
+           data (see hdrl_lacosmic_laplacian()).
+           A) Compute S image */
 
-HDRL_OMP(omp parallel for)
+HDRL_OMP(omp parallel for reduction(&&:nonnegative))
         for (intptr_t j = 0; j < ny; j++) {
-            intptr_t j_2_subs2_nx = j * 2 * subs2_nx;
             intptr_t j_nx = j * nx;
             for (intptr_t i = 0; i < nx; i++) {
-                intptr_t pix = i * 2 + j_2_subs2_nx;
                 plaplacian_redu_data[i + j_nx] =
-                    (plaplacian_data[pix] +
-                     plaplacian_data[pix + 1] +
-                     plaplacian_data[pix + subs2_nx] +
-                     plaplacian_data[pix + subs2_nx + 1]) * 0.25;
-                /* A) Compute S image */
+                    (hdrl_lacosmic_laplacian(psci_data, nx, ny,
+                                             2 * i, 2 * j) +
+                     hdrl_lacosmic_laplacian(psci_data, nx, ny,
+                                             2 * i + 1, 2 * j) +
+                     hdrl_lacosmic_laplacian(psci_data, nx, ny,
+                                             2 * i, 2 * j + 1) +
+                     hdrl_lacosmic_laplacian(psci_data, nx, ny,
+                                             2 * i + 1, 2 * j + 1)) * 0.25;
                 ps_data[i + j_nx] =
                    0.5 * plaplacian_redu_data[i + j_nx] / psci_error[i + j_nx];
+                nonnegative = nonnegative && ps_data[i + j_nx] >= 0.0;
             }
         }
 
@@ -570,61 +621,98 @@ HDRL_OMP(omp parallel for)
                        NULL, CPL_IO_DEFAULT);
 #endif
 
-        /* A) compute S median image */
-        cpl_image * s_median_data = hdrl_parallel_filter_image(s_data, NULL,
-                                                   median5_kernel,
-                                                   CPL_FILTER_MEDIAN);
-        ps_median_data = cpl_image_get_data_double( s_median_data);
-
+        /* B) Compute s2 = S - median5(S) -> denoted S' in the original paper.
+           Only its comparison with sigma_lim matters, and where S is not
+           above sigma_lim, neither is S', as the median of the non negative
+           S is non negative: there the 5x5 median is skipped. */
 
-        /* B) Compute s2 -> denoted S' in the original paper */
-        for (intptr_t i = 0; i < nx * ny; i++) {
-            ps_data[i] -= ps_median_data[i];
+HDRL_OMP(omp parallel for)
+        for (intptr_t j = 0; j < ny; j++) {
+            double w[25];
+            cpl_binary isbad;
+            for (intptr_t i = 0; i < nx; i++) {
+                const intptr_t pix = i + j * nx;
+                if (nonnegative && ps_data[pix] <= p_loc->sigma_lim) {
+                    ps2_data[pix] = ps_data[pix];
+                }
+                else {
+                    ps2_data[pix] = ps_data[pix] -
+                        hdrl_lacosmic_window_median(ps_data, NULL, nx, ny,
+                                                    i, j, 2, w, &isbad);
+                }
+            }
         }
 
 #if REGDEBUG_FULL
-        cpl_image_save( s_data, "S2.fits", CPL_BPP_IEEE_DOUBLE, NULL,
+        cpl_image_save( s2_data, "S2.fits", CPL_BPP_IEEE_DOUBLE, NULL,
                 CPL_IO_DEFAULT);
 #endif
 
+        /* The fine structure image F and the ratio R are only needed on the
+           good pixels where S' is not below sigma_lim: elsewhere neither the
+           detection nor the replacement below look at R. F needs the 3x3
+           median of the data on the 7x7 neighbourhood of those pixels. */
+
+        candidates = cpl_mask_new(nx, ny);
+        {
+            cpl_binary * pc = cpl_mask_get_data(candidates);
+HDRL_OMP(omp parallel for)
+            for (intptr_t i = 0; i < nx * ny; i++) {
+                pc[i] = psci_mask[i] == CPL_BINARY_0 &&
+                        !(ps2_data[i] <= p_loc->sigma_lim);
+            }
+        }
+        pcandidates = cpl_mask_get_data_const(candidates);
+
+        needed3 = hdrl_bpm_filter(candidates, 7, 7, CPL_FILTER_DILATION);
+        pneeded3 = cpl_mask_get_data_const(needed3);
+
         /* Apply 3x3 median filter on data */
-        cpl_image * sci_median3_data =
-            hdrl_parallel_filter_image(sci_data, NULL,
-                                       median3_kernel,
-                                       CPL_FILTER_MEDIAN);
-        psci_median3_data = cpl_image_get_data_double(sci_median3_data);
-
-        /* Apply 7x7 median filter */
-
-        cpl_image * sci_median3_7_data =
-            hdrl_parallel_filter_image(sci_median3_data, NULL,
-                                       median7_kernel,
-                                       CPL_FILTER_MEDIAN);
-        psci_median3_7_data = cpl_image_get_data_double(sci_median3_7_data);
-
-        /* C) Compute F, i.e. the fine structure image */
-        for (intptr_t i = 0; i < nx * ny; i++) {
-            pf_data[i] = psci_median3_data[i] - psci_median3_7_data[i];
-            /* TODO: why this setting?
-             * why one use an absolute number?
-             * pf_data may span on different ranges as it depends on the value
-             * of the difference psci_median3_data[i] - psci_median3_7_data[i]
-             */
-            if (pf_data[i] < 0.01) {
-                pf_data[i] = 0.01;
+
+HDRL_OMP(omp parallel for)
+        for (intptr_t j = 0; j < ny; j++) {
+            double w[9];
+            for (intptr_t i = 0; i < nx; i++) {
+                const intptr_t pix = i + j * nx;
+                if (pneeded3[pix]) {
+                    psci_median3_data[pix] =
+                        hdrl_lacosmic_window_median(psci_data, pbad, nx, ny,
+                                                    i, j, 1, w,
+                                                    psci_median3_bpm + pix);
+                }
             }
         }
 
-#if REGDEBUG_FULL
-        cpl_image_save( f_data, "F.fits", CPL_BPP_IEEE_DOUBLE, NULL,
-                       CPL_IO_DEFAULT);
-#endif
+        /* Apply 7x7 median filter on the 3x3 median, then
+           C) Compute F, i.e. the fine structure image, and
+           D) Compute R, i.e. the ratio of Laplacian and fine structure image */
 
-        /* D) Compute R, i.e. the ratio of Laplacian and fine structure image */
-        for (intptr_t i = 0; i < nx * ny; i++) {
-            pr_data[i] = plaplacian_redu_data[i] / pf_data[i];
+HDRL_OMP(omp parallel for)
+        for (intptr_t j = 0; j < ny; j++) {
+            double w[49];
+            cpl_binary isbad;
+            for (intptr_t i = 0; i < nx; i++) {
+                const intptr_t pix = i + j * nx;
+                double pf;
+                if (!pcandidates[pix]) continue;
+                pf = psci_median3_data[pix] -
+                    hdrl_lacosmic_window_median(psci_median3_data,
+                                                psci_median3_bpm, nx, ny,
+                                                i, j, 3, w, &isbad);
+                /* TODO: why this setting?
+                 * why one use an absolute number?
+                 * pf may span on different ranges as it depends on the value
+                 * of the difference psci_median3_data[i] - median7
+                 */
+                if (pf < 0.01) {
+                    pf = 0.01;
+                }
+                pr_data[pix] = plaplacian_redu_data[pix] / pf;
+            }
         }
 
+        cpl_mask_delete(needed3);
+
 #if REGDEBUG_FULL
         cpl_image_save( r_data, "R.fits", CPL_BPP_IEEE_DOUBLE, NULL,
                        CPL_IO_DEFAULT);
@@ -636,10 +724,9 @@ HDRL_OMP(omp parallel for)
             intptr_t j_nx = j * nx;
             for (intptr_t i = 0; i < nx - 1; i++) {
                 intptr_t i_plus_j_nx = i + j_nx;
-                if (ps_data[i_plus_j_nx] > p_loc->sigma_lim &&
-                    pr_data[i_plus_j_nx] > p_loc->f_lim &&
-                    /* check for bad pixels added here */
-                    psci_mask[i_plus_j_nx] == CPL_BINARY_0) {
+                if (pcandidates[i_plus_j_nx] &&
+                    ps2_data[i_plus_j_nx] > p_loc->sigma_lim &&
+                    pr_data[i_plus_j_nx] > p_loc->f_lim) {
                     double *data = NULL;
                     cpl_vector* med_vect = NULL;
                     intptr_t li, lj, ui, uj, m;
@@ -660,16 +747,15 @@ HDRL_OMP(omp parallel for)
                         intptr_t k_nx = k * nx;
                         for (intptr_t l = li; l < ui; l++) {
                             intptr_t l_plus_k_nx = l + k_nx;
-                            if (ps_data[l_plus_k_nx] <= p_loc->sigma_lim &&
+                            if (ps2_data[l_plus_k_nx] <= p_loc->sigma_lim &&
                                     /* check for bad pixels added here */
                                     psci_mask[l_plus_k_nx] == CPL_BINARY_0) {
                                 cpl_vector_set(median,m,psci_data[l_plus_k_nx]);
                                 m++;
                                 continue;
                             }
-                            if (pr_data[l_plus_k_nx] <= p_loc->f_lim &&
-                                    /* check for bad pixels added here */
-                                    psci_mask[l_plus_k_nx] == CPL_BINARY_0) {
+                            if (pcandidates[l_plus_k_nx] &&
+                                    pr_data[l_plus_k_nx] <= p_loc->f_lim) {
                                 cpl_vector_set(median,m,psci_data[l_plus_k_nx]);
                                 m++;
                             }
@@ -691,12 +777,9 @@ HDRL_OMP(omp parallel for)
         } /* end loop over image rows */
 
         cpl_vector_delete(median); median = NULL;
+        cpl_mask_delete(candidates); candidates = NULL;
 
         nbiter++;
-        cpl_image_delete(laplacian_data);
-        cpl_image_delete(sci_median3_7_data);
-        cpl_image_delete(sci_median3_data);
-        cpl_image_delete(s_median_data);
     }
 
 #if REGDEBUG_FULL
@@ -704,15 +787,12 @@ HDRL_OMP(omp parallel for)
 #endif
 
     /* Free memory */
-    cpl_matrix_delete(laplacian_kernel);
-    cpl_mask_delete(median3_kernel);
-    cpl_mask_delete(median5_kernel);
-    cpl_mask_delete(median7_kernel);
     cpl_mask_delete(lastiter_mask);
     cpl_image_delete(laplacian_redu_data);
-    cpl_image_delete(subs2_data);
     cpl_image_delete(s_data);
-    cpl_image_delete(f_data);
+    cpl_image_delete(s2_data);
+    cpl_image_delete(sci_median3_data);
+    cpl_free(psci_median3_bpm);
     cpl_image_delete(r_data);
     cpl_image_delete(sci_data);
     cpl_image_delete(sci_error);
@@ -488,6 +488,38 @@ static int vimos_calib_create(cpl_plugin *plugin)
     cpl_parameterlist_append(recipe->parameters, p);
 
 
+    /*
+     * Tile compression of the image products
+     */
+
+    p = cpl_parameter_new_enum("vimos.vmmoscalib.compress",
+                               CPL_TYPE_STRING,
+                               "Tile compression of the image products: "
+                               "integral images are always compressed "
+                               "losslessly, other images either losslessly "
+                               "or quantised",
+                               "vimos.vmmoscalib",
+                               "none", 3, "none", "lossless", "quantise");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "compress");
+    cpl_parameter_disable(p, CPL_PARAMETER_MODE_ENV);
+    cpl_parameterlist_append(recipe->parameters, p);
+
+
+    /*
+     * Quantisation level of the compressed image products
+     */
+
+    p = cpl_parameter_new_value("vimos.vmmoscalib.quantisation",
+                                CPL_TYPE_DOUBLE,
+                                "Quantisation level of quantised image "
+                                "products (noise sigma / quantisation step)",
+                                "vimos.vmmoscalib",
+                                16.0);
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "quantisation");
+    cpl_parameter_disable(p, CPL_PARAMETER_MODE_ENV);
+    cpl_parameterlist_append(recipe->parameters, p);
+
+
     return 0;
 }
 
@@ -516,6 +548,17 @@ static int vimos_calib_exec(cpl_plugin *plugin)
     try
     {
         status = vimos_calib(recipe->parameters, recipe->frames);
+
+        if (status == 0) {
+            const char *compress =
+                dfs_get_parameter_string_const(recipe->parameters,
+                                               "vimos.vmmoscalib.compress");
+            double level =
+                dfs_get_parameter_double_const(recipe->parameters,
+                                               "vimos.vmmoscalib.quantisation");
+
+            status = dfs_compress_products(recipe->frames, compress, level);
+        }
     }
     catch(std::exception& ex)
     {
@@ -549,6 +592,8 @@ static int vimos_calib_destroy(cpl_plugin *plugin)
 
     cpl_parameterlist_delete(recipe->parameters); 
 
+    dfs_cache_clear();
+
     return 0;
 }
 
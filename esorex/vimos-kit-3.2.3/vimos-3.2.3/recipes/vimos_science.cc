@@ -286,6 +286,62 @@ static int vimos_science_create(cpl_plugin *plugin)
     cpl_parameter_disable(p, CPL_PARAMETER_MODE_ENV);
     cpl_parameterlist_append(recipe->parameters, p);
 
+    /*
+     * Cosmic rays removal method
+     */
+
+    p = cpl_parameter_new_enum("vimos.vmmosscience.cosmics_method",
+                               CPL_TYPE_STRING,
+                               "Cosmic rays detection method, either the "
+                               "median filter of MIDAS FILTER/COSMIC or "
+                               "the Laplacian edge detection of LA-Cosmic",
+                               "vimos.vmmosscience",
+                               "filter", 2,
+                               "filter", "lacosmic");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "cosmics_method");
+    cpl_parameter_disable(p, CPL_PARAMETER_MODE_ENV);
+    cpl_parameterlist_append(recipe->parameters, p);
+
+    /*
+     * LA-Cosmic detection limit
+     */
+
+    p = cpl_parameter_new_value("vimos.vmmosscience.cosmics_sigma_lim",
+                                CPL_TYPE_DOUBLE,
+                                "LA-Cosmic detection limit, in noise sigmas",
+                                "vimos.vmmosscience",
+                                5.0);
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "cosmics_sigma_lim");
+    cpl_parameter_disable(p, CPL_PARAMETER_MODE_ENV);
+    cpl_parameterlist_append(recipe->parameters, p);
+
+    /*
+     * LA-Cosmic contrast limit
+     */
+
+    p = cpl_parameter_new_value("vimos.vmmosscience.cosmics_f_lim",
+                                CPL_TYPE_DOUBLE,
+                                "LA-Cosmic contrast limit between the "
+                                "Laplacian and the fine structure image",
+                                "vimos.vmmosscience",
+                                2.0);
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "cosmics_f_lim");
+    cpl_parameter_disable(p, CPL_PARAMETER_MODE_ENV);
+    cpl_parameterlist_append(recipe->parameters, p);
+
+    /*
+     * LA-Cosmic iterations
+     */
+
+    p = cpl_parameter_new_value("vimos.vmmosscience.cosmics_max_iter",
+                                CPL_TYPE_INT,
+                                "LA-Cosmic maximum number of iterations",
+                                "vimos.vmmosscience",
+                                5);
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "cosmics_max_iter");
+    cpl_parameter_disable(p, CPL_PARAMETER_MODE_ENV);
+    cpl_parameterlist_append(recipe->parameters, p);
+
     /*
      * Slit margin
      */
@@ -616,6 +672,38 @@ static int vimos_science_create(cpl_plugin *plugin)
     cpl_parameterlist_append(recipe->parameters, p);
 
 
+    /*
+     * Tile compression of the image products
+     */
+
+    p = cpl_parameter_new_enum("vimos.vmmosscience.compress",
+                               CPL_TYPE_STRING,
+                               "Tile compression of the image products: "
+                               "integral images are always compressed "
+                               "losslessly, other images either losslessly "
+                               "or quantised",
+                               "vimos.vmmosscience",
+                               "none", 3, "none", "lossless", "quantise");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "compress");
+    cpl_parameter_disable(p, CPL_PARAMETER_MODE_ENV);
+    cpl_parameterlist_append(recipe->parameters, p);
+
+
+    /*
+     * Quantisation level of the compressed image products
+     */
+
+    p = cpl_parameter_new_value("vimos.vmmosscience.quantisation",
+                                CPL_TYPE_DOUBLE,
+                                "Quantisation level of quantised image "
+                                "products (noise sigma / quantisation step)",
+                                "vimos.vmmosscience",
+                                16.0);
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "quantisation");
+    cpl_parameter_disable(p, CPL_PARAMETER_MODE_ENV);
+    cpl_parameterlist_append(recipe->parameters, p);
+
+
     return 0;
 }
 
@@ -644,6 +732,17 @@ static int vimos_science_exec(cpl_plugin *plugin)
     try
     {
         status = vimos_science_mult(recipe->parameters, recipe->frames); 
+
+        if (status == 0) {
+            const char *compress =
+                dfs_get_parameter_string_const(recipe->parameters,
+                                               "vimos.vmmosscience.compress");
+            double level =
+                dfs_get_parameter_double_const(recipe->parameters,
+                                               "vimos.vmmosscience.quantisation");
+
+            status = dfs_compress_products(recipe->frames, compress, level);
+        }
     }
     catch(std::exception& ex)
     {
@@ -677,6 +776,8 @@ static int vimos_science_destroy(cpl_plugin *plugin)
 
     cpl_parameterlist_delete(recipe->parameters); 
 
+    dfs_cache_clear();
+
     return 0;
 }
 
@@ -1223,6 +1324,10 @@ static int vimos_science(cpl_parameterlist *parlist, cpl_frameset *frameset,
         int               find_off;
         int               dither;
         int               cosmics;
+        const char       *cosmics_method;
+        double            cosmics_sigma_lim;
+        double            cosmics_f_lim;
+        int               cosmics_max_iter;
         int               slit_margin;
         int               ext_radius;
         int               cont_radius;
@@ -1293,6 +1398,27 @@ static int vimos_science(cpl_parameterlist *parlist, cpl_frameset *frameset,
         cosmics = dfs_get_parameter_bool(parlist,
                                          "vimos.vmmosscience.cosmics", NULL);
 
+        cosmics_method = dfs_get_parameter_string(parlist,
+                         "vimos.vmmosscience.cosmics_method", NULL);
+        cosmics_sigma_lim = dfs_get_parameter_double(parlist,
+                            "vimos.vmmosscience.cosmics_sigma_lim", NULL);
+        cosmics_f_lim = dfs_get_parameter_double(parlist,
+                        "vimos.vmmosscience.cosmics_f_lim", NULL);
+        cosmics_max_iter = dfs_get_parameter_int(parlist,
+                           "vimos.vmmosscience.cosmics_max_iter", NULL);
+
+        if (strcmp(cosmics_method, "lacosmic") == 0) {
+            if (cosmics_sigma_lim <= 0.0 || cosmics_f_lim <= 0.0) {
+                cpl_msg_error(recipe, "Invalid LA-Cosmic limits");
+                return -1;
+            }
+            if (cosmics_max_iter < 1) {
+                cpl_msg_error(recipe, "Invalid LA-Cosmic number of "
+                              "iterations");
+                return -1;
+            }
+        }
+
         alignment = dfs_get_parameter_string(parlist,
                     "vimos.vmmosscience.alignment", NULL);
 
@@ -2264,7 +2390,12 @@ static int vimos_science(cpl_parameterlist *parlist, cpl_frameset *frameset,
         }
         else {
             cpl_image *mapped_cleaned = cpl_image_duplicate(mapped);
-            mos_clean_cosmics(mapped_cleaned, gain, -1., -1.);
+            if (strcmp(cosmics_method, "lacosmic") == 0)
+                mos_clean_cosmics_lacosmic(mapped_cleaned, gain, -1.,
+                                           cosmics_sigma_lim, cosmics_f_lim,
+                                           cosmics_max_iter);
+            else
+                mos_clean_cosmics(mapped_cleaned, gain, -1., -1.);
             image = mos_detect_objects(mapped_cleaned, slits, slit_margin,
                                        ext_radius, cont_radius, detection);
 
@@ -294,6 +294,30 @@ vmbias_create(cpl_plugin *plugin)
 
 #endif
 
+    p = cpl_parameter_new_enum("vimos.Parameters.output.compress",
+                               CPL_TYPE_STRING,
+                               "Tile compression of the image products: "
+                               "integral images are always compressed "
+                               "losslessly, other images either losslessly "
+                               "or quantised",
+                               "vimos.Parameters",
+                               "none", 3, "none", "lossless", "quantise");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "CompressOutput");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CFG, "CompressOutput");
+    cpl_parameterlist_append(recipe->parameters, p);
+
+
+    p = cpl_parameter_new_value("vimos.Parameters.output.quantisation",
+                                CPL_TYPE_DOUBLE,
+                                "Quantisation level of quantised image "
+                                "products (noise sigma / quantisation step)",
+                                "vimos.Parameters",
+                                16.0);
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "QuantisationLevel");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CFG, "QuantisationLevel");
+    cpl_parameterlist_append(recipe->parameters, p);
+
+
     /*
      * Initialize the VIMOS recipe subsystems (configuration data base,
      * alias tables, messaging facilities) from the current CPL setup.
@@ -385,6 +409,21 @@ vmbias_exec(cpl_plugin *plugin)
              */
 
             status = vmCplFramesetImport(recipe->frames, sof);
+
+            /*
+             * Compress the image products, if requested.
+             */
+
+            if (status == 0) {
+                const char *compress =
+                    dfs_get_parameter_string_const(recipe->parameters,
+                                        "vimos.Parameters.output.compress");
+                double level =
+                    dfs_get_parameter_double_const(recipe->parameters,
+                                        "vimos.Parameters.output.quantisation");
+
+                status = dfs_compress_products(recipe->frames, compress, level);
+            }
         }
 
     }
@@ -625,6 +625,7 @@ vmdark(PilSetOfFrames *sof)
   char           comment[MAX_COMMENT_LENGTH];
 
   VimosBool      updateOK = VM_TRUE;
+  VimosImageStats stats;
 
   size_t         darkCount, goodFrames, minFrames;
 
@@ -1580,17 +1581,19 @@ vmdark(PilSetOfFrames *sof)
                                      pilTrnGetComment("ExposureTime"),
                                      "ESO*", 1));
 
+  imageStatistics(mDark, &stats);
+
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mDark->descs), 
                                      pilTrnGetKeyword("DataMin"),
-                                     imageMinimum(mDark), 
+                                     stats.minimum, 
                                      pilTrnGetComment("DataMin"),
                                      "ESO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mDark->descs), 
                                      pilTrnGetKeyword("DataMax"),
-                                     imageMaximum(mDark), 
+                                     stats.maximum, 
                                      pilTrnGetComment("DataMax"),
                                      "ESO*", 1));
 
@@ -1611,21 +1614,21 @@ vmdark(PilSetOfFrames *sof)
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mDark->descs), 
                                      pilTrnGetKeyword("DataMedian"),
-                                     imageMedian(mDark), 
+                                     stats.median, 
                                      pilTrnGetComment("DataMedian"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mDark->descs), 
                                      pilTrnGetKeyword("DataStdDeviation"),
-                                     imageSigma(mDark), 
+                                     stats.sigma, 
                                      pilTrnGetComment("DataStdDeviation"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mDark->descs), 
                                      pilTrnGetKeyword("DataMean"), 
-                                     imageMean(mDark), 
+                                     stats.mean, 
                                      pilTrnGetComment("DataMean"),
                                      "ESO PRO*", 1));
 
@@ -351,6 +351,30 @@ vmifucalib_create(cpl_plugin *plugin)
     cpl_parameterlist_append(recipe->parameters, p);
 
 
+    p = cpl_parameter_new_enum("vimos.Parameters.output.compress",
+                               CPL_TYPE_STRING,
+                               "Tile compression of the image products: "
+                               "integral images are always compressed "
+                               "losslessly, other images either losslessly "
+                               "or quantised",
+                               "vimos.Parameters",
+                               "none", 3, "none", "lossless", "quantise");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "CompressOutput");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CFG, "CompressOutput");
+    cpl_parameterlist_append(recipe->parameters, p);
+
+
+    p = cpl_parameter_new_value("vimos.Parameters.output.quantisation",
+                                CPL_TYPE_DOUBLE,
+                                "Quantisation level of quantised image "
+                                "products (noise sigma / quantisation step)",
+                                "vimos.Parameters",
+                                16.0);
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "QuantisationLevel");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CFG, "QuantisationLevel");
+    cpl_parameterlist_append(recipe->parameters, p);
+
+
     /*
      * Initialize the VIMOS recipe subsystems (configuration data base,
      * alias tables, messaging facilities) from the current CPL setup.
@@ -446,6 +470,21 @@ vmifucalib_exec(cpl_plugin *plugin)
              */
 
             status = vmCplFramesetImport(recipe->frames, sof);
+
+            /*
+             * Compress the image products, if requested.
+             */
+
+            if (status == 0) {
+                const char *compress =
+                    dfs_get_parameter_string_const(recipe->parameters,
+                                        "vimos.Parameters.output.compress");
+                double level =
+                    dfs_get_parameter_double_const(recipe->parameters,
+                                        "vimos.Parameters.output.quantisation");
+
+                status = dfs_compress_products(recipe->frames, compress, level);
+            }
         }
 
     }
@@ -555,6 +594,7 @@ vmifucalib(PilSetOfFrames *sof)
   char           colName[5];
 
   VimosBool      updateOK = VM_TRUE;
+  VimosImageStats stats;
 
   int            flatCount, arcCount, tracedCount, wavecalCount;
   int            minFrames;
@@ -1232,7 +1272,7 @@ vmifucalib(PilSetOfFrames *sof)
      */
 
     if (lineCatFrame) {
-      linecat = cpl_table_load((char *)pilFrmGetName(lineCatFrame), 1, 0);
+      linecat = dfs_load_table_cached(pilFrmGetName(lineCatFrame), 1, 0);
     }
     else {
       cpl_msg_error(task, "No input line catalog found");
@@ -1492,7 +1532,8 @@ vmifucalib(PilSetOfFrames *sof)
 
   if ((identFrame = pilSofLookup(sof, identTag))) {
     pilFrmSetType(identFrame, PIL_FRAME_TYPE_CALIB);
-    refimage = cpl_image_load(pilFrmGetName(identFrame), CPL_TYPE_FLOAT, 0, 0);
+    refimage = dfs_load_image_cached(pilFrmGetName(identFrame), 
+                                     CPL_TYPE_FLOAT, 0);
     if (refimage) {
       refdata  = cpl_image_get_data(refimage);
       reflength = cpl_image_get_size_x(refimage);
@@ -1503,8 +1544,8 @@ vmifucalib(PilSetOfFrames *sof)
           if (slit != 1)
             continue;
 
-        refident[slit] = cpl_table_load((char *)pilFrmGetName(identFrame), 
-                                        slit - firstSlit + 1, 0);
+        refident[slit] = dfs_load_table_cached(pilFrmGetName(identFrame), 
+                                               slit - firstSlit + 1, 0);
         if (!refident[slit]) {
           for (i = 0; i < 4; i++)
             if (refident[i])
@@ -2733,17 +2774,19 @@ vmifucalib(PilSetOfFrames *sof)
    * Update the master flat field header
    */
 
+  imageStatistics(mFlat, &stats);
+
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mFlat->descs), 
                                      pilTrnGetKeyword("DataMin"),
-                                     imageMinimum(mFlat), 
+                                     stats.minimum, 
                                      pilTrnGetComment("DataMin"),
                                      "ESO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mFlat->descs), 
                                      pilTrnGetKeyword("DataMax"),
-                                     imageMaximum(mFlat), 
+                                     stats.maximum, 
                                      pilTrnGetComment("DataMax"),
                                      "ESO*", 1));
 
@@ -2764,21 +2807,21 @@ vmifucalib(PilSetOfFrames *sof)
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mFlat->descs), 
                                      pilTrnGetKeyword("DataMedian"),
-                                     imageMedian(mFlat), 
+                                     stats.median, 
                                      pilTrnGetComment("DataMedian"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mFlat->descs), 
                                      pilTrnGetKeyword("DataStdDeviation"),
-                                     imageSigma(mFlat), 
+                                     stats.sigma, 
                                      pilTrnGetComment("DataStdDeviation"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mFlat->descs), 
                                      pilTrnGetKeyword("DataMean"), 
-                                     imageMean(mFlat), 
+                                     stats.mean, 
                                      pilTrnGetComment("DataMean"),
                                      "ESO PRO*", 1));
 
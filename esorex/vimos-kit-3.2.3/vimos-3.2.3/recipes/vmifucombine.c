@@ -286,6 +286,7 @@ vmifucombine(PilSetOfFrames *sof)
   const char    *fovFullTag = pilTrnGetCategory("IfuFullFov");
   char           fovName[PATHNAME_MAX + 1];
   VimosBool      updateOK = VM_TRUE;
+  VimosImageStats stats;
   int            fovCount, fovStdCount;
 
   int            i, j, q;
@@ -424,38 +425,40 @@ vmifucombine(PilSetOfFrames *sof)
    * Update the reconstructed FOV header
    */
 
+  imageStatistics(fovList[0], &stats);
+
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(fovList[0]->descs),
                                      pilTrnGetKeyword("DataMin"),
-                                     imageMinimum(fovList[0]),
+                                     stats.minimum,
                                      pilTrnGetComment("DataMin"),
                                      "ESO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(fovList[0]->descs),
                                      pilTrnGetKeyword("DataMax"),
-                                     imageMaximum(fovList[0]),
+                                     stats.maximum,
                                      pilTrnGetComment("DataMax"),
                                      "ESO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(fovList[0]->descs),
                                      pilTrnGetKeyword("DataMedian"),
-                                     imageMedian(fovList[0]),
+                                     stats.median,
                                      pilTrnGetComment("DataMedian"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(fovList[0]->descs),
                                      pilTrnGetKeyword("DataStdDeviation"),
-                                     imageSigma(fovList[0]),
+                                     stats.sigma,
                                      pilTrnGetComment("DataStdDeviation"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(fovList[0]->descs),
                                      pilTrnGetKeyword("DataMean"),
-                                     imageMean(fovList[0]),
+                                     stats.mean,
                                      pilTrnGetComment("DataMean"),
                                      "ESO PRO*", 1));
 
@@ -33,7 +33,11 @@
                                 Includes
  -----------------------------------------------------------------------------*/
 
+#include <fitsio.h>
+
+#include <stdio.h>
 #include <string.h>
+#include <float.h>
 #include <math.h>
 #include <cmath>
 
@@ -83,6 +87,12 @@ static int vmifucombinecube_create(cpl_plugin *) ;
 static int vmifucombinecube_exec(cpl_plugin *) ;
 static int vmifucombinecube_destroy(cpl_plugin *) ;
 static cxint vmifucombinecube(PilSetOfFrames *);
+static cpl_image *vmifucombinecube_load_tile(const char *, int, int, int,
+                                             int, double);
+static fitsfile *vmifucombinecube_create_cube(const char *,
+                                              const cpl_propertylist *,
+                                              int, int, int, int,
+                                              double, double);
 
 cpl_propertylist * vimos_ifu_combinecube_add_wcs
 (PilSetOfFrames * sof, const char *inputTag, int nx_fiber, int ny_fiber, 
@@ -112,7 +122,11 @@ static char vmifucombinecube_description[] =
 "(80x80xN) are produced when 3 or more quadrants are given in input\n"
 "(and when either quadrants 1 and 3, or 2 and 4, are input), and the\n"
 "shutter was off. Pixels belonging to missing quadrants are padded\n" 
-"with zeroes if necessary.\n\n";
+"with zeroes if necessary.\n\n"
+"The cube is assembled and written to disk in tiles of CubeTileSize\n"
+"wavelength planes, so that the memory needed does not depend on the\n"
+"cube length. With CubeEncoding set to int16 the cube is stored as 16 bit\n"
+"integers scaled with BSCALE/BZERO to the range of the input data.\n\n";
 
 /*-----------------------------------------------------------------------------
                                 Functions code
@@ -163,6 +177,8 @@ vmifucombinecube_create(cpl_plugin *plugin)
 
     cpl_recipe *recipe = (cpl_recipe *)plugin;
 
+    cpl_parameter *p;
+
     cxint status = 0;
 
 
@@ -179,9 +195,55 @@ vmifucombinecube_create(cpl_plugin *plugin)
 
     
     /*
-     * No parameter list
+     * Fill the parameter list
      */
 
+    p = cpl_parameter_new_enum("vimos.Parameters.output.compress",
+                               CPL_TYPE_STRING,
+                               "Tile compression of the image products: "
+                               "integral images are always compressed "
+                               "losslessly, other images either losslessly "
+                               "or quantised",
+                               "vimos.Parameters",
+                               "none", 3, "none", "lossless", "quantise");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "CompressOutput");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CFG, "CompressOutput");
+    cpl_parameterlist_append(recipe->parameters, p);
+
+
+    p = cpl_parameter_new_value("vimos.Parameters.output.quantisation",
+                                CPL_TYPE_DOUBLE,
+                                "Quantisation level of quantised image "
+                                "products (noise sigma / quantisation step)",
+                                "vimos.Parameters",
+                                16.0);
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "QuantisationLevel");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CFG, "QuantisationLevel");
+    cpl_parameterlist_append(recipe->parameters, p);
+
+
+    p = cpl_parameter_new_value("vimos.Parameters.cube.tile",
+                                CPL_TYPE_INT,
+                                "Number of wavelength planes assembled and "
+                                "written to disk at a time",
+                                "vimos.Parameters",
+                                256);
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "CubeTileSize");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CFG, "CubeTileSize");
+    cpl_parameterlist_append(recipe->parameters, p);
+
+
+    p = cpl_parameter_new_enum("vimos.Parameters.cube.encoding",
+                               CPL_TYPE_STRING,
+                               "Encoding of the cube data: 32 bit floating "
+                               "point, or 16 bit integers scaled with "
+                               "BSCALE/BZERO",
+                               "vimos.Parameters",
+                               "float", 2, "float", "int16");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "CubeEncoding");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CFG, "CubeEncoding");
+    cpl_parameterlist_append(recipe->parameters, p);
+
     /*
      * Initialize the VIMOS recipe subsystems (configuration data base,
      * alias tables, messaging facilities) from the current CPL setup.
@@ -278,6 +340,21 @@ vmifucombinecube_exec(cpl_plugin *plugin)
                  */
 
                 status = vmCplFramesetImport(recipe->frames, sof);
+
+                /*
+                 * Compress the image products, if requested.
+                 */
+
+                if (status == 0) {
+                    const char *compress =
+                        dfs_get_parameter_string_const(recipe->parameters,
+                                            "vimos.Parameters.output.compress");
+                    double level =
+                        dfs_get_parameter_double_const(recipe->parameters,
+                                            "vimos.Parameters.output.quantisation");
+
+                    status = dfs_compress_products(recipe->frames, compress, level);
+                }
             }
       }
       else
@@ -365,20 +442,29 @@ vmifucombinecube(PilSetOfFrames *sof)
   const char    *inputTag = NULL;
   const char    *tag;
   const char    *warning;
+  const char    *encoding;
+  const char    *names[4];
   char           cubeName[PATHNAME_MAX + 1];
   int            inputCount;
+  int            tileSize, scaled;
 
   int            firstSlit, lastSlit, slit;
   int            xlen, ylen;
   int            xref, yref;
   int            xlow, ylow, xhig, yhig;
   int            xl[4], yl[4], xh[4], yh[4]; 
+  int            nx, ny, nt, first;
   int            i, j, k, q;
+  int            quads[4], exts[4];
+  long           npix;
   double         spec_crpix1, spec_crval1, spec_cdelt1;
+  double         norms[4];
+  double         dmin, dmax;
+  double         bscale = 1.0;
+  double         bzero = 0.0;
 
   cpl_image     *extracted;
   cpl_image    **images;
-  cpl_imagelist *planes;
   PilFrame      *frame;
   PilFrame      *outputFrame;
 
@@ -388,10 +474,14 @@ vmifucombinecube(PilSetOfFrames *sof)
   const char    *astart;
   int            quadrant[] = {0, 0, 0, 0};
   double         refnorm = 1.0;
-  double         norm = 1.0;
   double        *integrals;
   double        *p;
   float         *data;
+  float         *buffer;
+  float          blank = -FLT_MAX;
+
+  fitsfile      *fptr;
+  int            fstatus = 0;
 
 
   /*
@@ -459,6 +549,16 @@ vmifucombinecube(PilSetOfFrames *sof)
     return EXIT_FAILURE;
   }
 
+  tileSize = pilDfsDbGetInt("Parameters", "CubeTileSize", 256);
+
+  if (tileSize < 1) {
+    cpl_msg_error(task, "Invalid cube tile size: %d", tileSize);
+    return EXIT_FAILURE;
+  }
+
+  encoding = pilDfsDbGetString("Parameters", "CubeEncoding");
+  scaled = encoding && strcmp(encoding, "int16") == 0;
+
   frame = pilSofLookupNext(sof, inputTag);
 
   header = cpl_propertylist_load_regexp(pilFrmGetName(frame), 0, 
@@ -485,6 +585,30 @@ vmifucombinecube(PilSetOfFrames *sof)
 
     quadrant[q] = 1;
 
+    names[i] = pilFrmGetName(frame);
+    quads[i] = q + 1;
+    exts[i] = dfs_product_extension(names[i], 0);
+
+    /*
+     * Inputs after the first are normalised to the flat field flux
+     * of the first one.
+     */
+
+    norms[i] = 1.0;
+
+    header = cpl_propertylist_load_regexp(pilFrmGetName(frame), 0,
+                                          "ESO QC IFU FLAT FLUX", 0);
+    if (header && cpl_propertylist_has(header, "ESO QC IFU FLAT FLUX")) {
+      if (i)
+        norms[i] = cpl_propertylist_get_double(header,
+                                               "ESO QC IFU FLAT FLUX")
+                 / refnorm;
+      else
+        refnorm = cpl_propertylist_get_double(header, "ESO QC IFU FLAT FLUX");
+    }
+
+    cpl_propertylist_delete(header);
+
     header = cpl_propertylist_load_regexp(pilFrmGetName(frame), 0, 
                                           "ESO TPL START", 0);
     astart = cpl_propertylist_get_string(header, "ESO TPL START");
@@ -594,7 +718,91 @@ vmifucombinecube(PilSetOfFrames *sof)
                "(IFU head from (%d,%d) to (%d,%d))", 
                xhig - xlow, yhig - ylow, xlen, xlow, ylow, xhig, yhig);
 
-  cpl_msg_info(task, "Loading input frames...");
+  nx = xhig - xlow;
+  ny = yhig - ylow;
+
+  if (tileSize > xlen)
+    tileSize = xlen;
+
+
+  /*
+   * The scaling of a 16 bit encoded cube must be known before the
+   * first tile is written, so the range of the (normalised) inputs
+   * is determined first. Zero is included, as the padding value of
+   * missing quadrants.
+   */
+
+  if (scaled) {
+
+    cpl_msg_info(task, "Determining the range of the input data...");
+
+    dmin = dmax = 0.0;
+
+    for (first = 0; first < xlen; first += tileSize) {
+      nt = xlen - first < tileSize ? xlen - first : tileSize;
+      for (i = 0; i < inputCount; i++) {
+        extracted = vmifucombinecube_load_tile(names[i], exts[i], first, nt,
+                                               ylen, norms[i]);
+        if (extracted == NULL) {
+          cpl_msg_error(task, "Failure loading %s frame %d",
+                        inputTag, i + 1);
+          return EXIT_FAILURE;
+        }
+
+        data = cpl_image_get_data_float(extracted);
+        for (k = 0; k < nt * ylen; k++) {
+          if (!isfinite(data[k]))
+            continue;
+          if (dmin > data[k])
+            dmin = data[k];
+          if (dmax < data[k])
+            dmax = data[k];
+        }
+
+        cpl_image_delete(extracted);
+      }
+    }
+
+    /*
+     * The value -32768 is reserved for BLANK pixels.
+     */
+
+    if (dmax > dmin) {
+      bscale = (dmax - dmin) / 65534.0;
+      bzero = 0.5 * (dmax + dmin);
+    }
+
+    cpl_msg_info(task, "Cube encoded as 16 bit integers: BSCALE = %g, "
+                 "BZERO = %g", bscale, bzero);
+  }
+
+
+  /* Compute the WCS keywords */
+  
+  cpl_propertylist * wcsheader = vimos_ifu_combinecube_add_wcs
+          (sof, inputTag, nx, ny, spec_crpix1, spec_crval1, spec_cdelt1);
+
+
+  /*
+   * Create the product file on disk, and write the cube into it
+   * tile by tile, a tile being a range of wavelength planes. 
+   */
+
+  vmstrlower(strcpy(cubeName, cubeTag));
+  strcat(cubeName, ".fits");
+
+  fptr = vmifucombinecube_create_cube(cubeName, wcsheader, nx, ny, xlen,
+                                      scaled, bscale, bzero);
+
+  cpl_propertylist_delete(wcsheader);
+
+  if (fptr == NULL) {
+    cpl_msg_error(task, "Cannot create local product file %s!", cubeName);
+    return EXIT_FAILURE;
+  }
+
+  cpl_msg_info(task, "Assembling the cube in tiles of %d planes...",
+               tileSize);
 
 
   /*
@@ -602,134 +810,206 @@ vmifucombinecube(PilSetOfFrames *sof)
    * (it doesn't allow images of different sizes).
    */
 
-  images = (cpl_image**)cpl_calloc(xlen, sizeof(cpl_image *));
+  images = (cpl_image**)cpl_calloc(tileSize, sizeof(cpl_image *));
   integrals = (double *)cpl_calloc(ylen, sizeof(double));
-  norm = 1.0;
+  buffer = (float *)cpl_malloc((size_t)nx * ny * tileSize * sizeof(float));
 
-  frame = pilSofLookupNext(sof, inputTag);
+  for (first = 0; first < xlen && fstatus == 0; first += tileSize) {
 
-  for (i = 0; i < inputCount; i++) {
+    nt = xlen - first < tileSize ? xlen - first : tileSize;
 
-    extracted = cpl_image_load(pilFrmGetName(frame), CPL_TYPE_FLOAT, 0, 0);
+    for (j = 0; j < nt; j++)
+      images[j] = cpl_image_new(80, 80, CPL_TYPE_FLOAT);
 
-    if (extracted) {
+    for (i = 0; i < inputCount; i++) {
 
-      header = cpl_propertylist_load_regexp(pilFrmGetName(frame), 0,
-                                            pilTrnGetKeyword("Quadrant"), 0);
-      q = cpl_propertylist_get_int(header, pilTrnGetKeyword("Quadrant"));
-      cpl_propertylist_delete(header);
+      extracted = vmifucombinecube_load_tile(names[i], exts[i], first, nt,
+                                             ylen, norms[i]);
 
-      header = cpl_propertylist_load_regexp(pilFrmGetName(frame), 0,
-                                            "ESO QC IFU FLAT FLUX", 0);
-      if (header && cpl_propertylist_has(header, "ESO QC IFU FLAT FLUX")) {
-        if (i) {
-          norm = cpl_propertylist_get_double(header, "ESO QC IFU FLAT FLUX");
-          norm /= refnorm;
-        }
-        else {
-          refnorm = cpl_propertylist_get_double(header, "ESO QC IFU FLAT FLUX");
-        }
-      }
-      else {
-        norm = 1.0;
+      if (extracted == NULL) {
+        cpl_msg_error(task, "Failure loading %s frame %d", inputTag, i + 1);
+        fstatus = READ_ERROR;
+        break;
       }
 
-      cpl_propertylist_delete(header);
-
-      if (i)
-        cpl_image_divide_scalar(extracted, norm);
+      for (j = 0; j < nt; j++) { /* Plane by plane = wave by wave */
 
-      for (j = 0; j < xlen; j++) { /* Plane by plane = wave by wave */
+        data = cpl_image_get_data_float(extracted);
 
-        data = (float *)cpl_image_get_data(extracted);
-
-        for (k = 0; k < ylen; k++, data += xlen) /* Spec by spec = row by row */
+        for (k = 0; k < ylen; k++, data += nt) /* Spec by spec = row by row */
           integrals[k] = data[j];
 
-        if (i == 0)
-          images[j] = cpl_image_new(80, 80, CPL_TYPE_FLOAT);
-
         p = integrals;
         for (slit = firstSlit; slit <= lastSlit; slit++, p += 400)
-          ifuImage(images[j], p, q, slit);
+          ifuImage(images[j], p, quads[i], slit);
       }
 
+      cpl_image_delete(extracted);
     }
-    else {
-      cpl_msg_error(task, "Failure loading %s frame %d", inputTag, i + 1);
-      cpl_free(integrals);
-      cpl_free(images);
-      return EXIT_FAILURE;
+
+    /*
+     * Store the tile into the smallest possible cube
+     */
+
+    for (j = 0; j < nt; j++) {
+      data = cpl_image_get_data_float(images[j]);
+      for (k = 0; k < ny; k++)
+        memcpy(buffer + ((size_t)j * ny + k) * nx,
+               data + (ylow + k) * 80 + xlow, nx * sizeof(float));
+      cpl_image_delete(images[j]);
     }
 
-    cpl_image_delete(extracted);
-    frame = pilSofLookupNext(sof, NULL);
+    npix = (long)nx * ny * nt;
 
+    if (fstatus == 0) {
+      if (scaled) {
+        for (k = 0; k < npix; k++)
+          if (!isfinite(buffer[k]))
+            buffer[k] = blank;
+        fits_write_imgnull(fptr, TFLOAT, (LONGLONG)first * nx * ny + 1,
+                           npix, buffer, &blank, &fstatus);
+      }
+      else {
+        fits_write_img(fptr, TFLOAT, (LONGLONG)first * nx * ny + 1,
+                       npix, buffer, &fstatus);
+      }
+    }
   }
 
+  cpl_free(buffer);
   cpl_free(integrals);
+  cpl_free(images);
 
-  /*
-   * Now store result into the smallest possible cube (if necessary)
-   */
-
-  planes = cpl_imagelist_new();
-  if (xhig - xlow != 80 || yhig - ylow != 80) {
-    for (j = 0; j < xlen; j++) { /* Plane by plane = wave by wave */
-      cpl_imagelist_set(planes, 
-                        cpl_image_extract(images[j], 
-                                          xlow + 1, ylow + 1, xhig, yhig), 
-                        j);
-      cpl_image_delete(images[j]);
-    }
-    cpl_free(images);
+  if (fstatus) {
+    k = 0;
+    fits_delete_file(fptr, &k);
+    return EXIT_FAILURE;
   }
-  else {
-    for (j = 0; j < xlen; j++) { /* Plane by plane = wave by wave */
-      cpl_imagelist_set(planes, images[j], j);
-    }
+
+  fits_close_file(fptr, &fstatus);
+
+  if (fstatus) {
+    cpl_msg_error(task, "Cannot write local product file %s!", cubeName);
+    return EXIT_FAILURE;
   }
 
-  /* Compute the WCS keywords */
-  
-  cpl_propertylist * wcsheader = vimos_ifu_combinecube_add_wcs
-          (sof, inputTag, xhig - xlow, yhig - ylow, 
-           spec_crpix1, spec_crval1, spec_cdelt1);
-  
+  outputFrame = newPilFrame(cubeName, cubeTag);
 
-  /*
-   * Create the product file on disk, set the product attributes and
-   * update the set of frames.
-   */
+  pilFrmSetType(outputFrame, PIL_FRAME_TYPE_PRODUCT);
+  pilFrmSetFormat(outputFrame, PIL_FRAME_FORMAT_IMAGE);
+  pilFrmSetProductLevel(outputFrame, PIL_PRODUCT_LEVEL_PRIMARY);
+  pilFrmSetProductType(outputFrame, PIL_PRODUCT_TYPE_REDUCED);
 
-  cpl_msg_info(cpl_func, "Saving the cube...");
-  vmstrlower(strcpy(cubeName, cubeTag));
-  strcat(cubeName, ".fits");
+  pilSofInsert(sof, outputFrame);
+
+  return EXIT_SUCCESS;
+}
+
+
+/*
+ * Load the columns first+1 to first+count (i.e. a range of wavelength
+ * planes) of an image of extracted spectra, normalised by norm.
+ */
+
+static cpl_image *
+vmifucombinecube_load_tile(const char *name, int ext, int first, int count,
+                           int ylen, double norm)
+{
 
+  cpl_image *tile = cpl_image_load_window(name, CPL_TYPE_FLOAT, 0, ext,
+                                          first + 1, 1, first + count, ylen);
 
-  if (CPL_ERROR_NONE == cpl_imagelist_save(planes, cubeName,
-                                           CPL_BPP_IEEE_FLOAT, wcsheader,
-                                           CPL_IO_DEFAULT)) {
-    outputFrame = newPilFrame(cubeName, cubeTag);
+  if (tile && norm != 1.0)
+    cpl_image_divide_scalar(tile, norm);
 
-    pilFrmSetType(outputFrame, PIL_FRAME_TYPE_PRODUCT);
-    pilFrmSetFormat(outputFrame, PIL_FRAME_FORMAT_IMAGE);
-    pilFrmSetProductLevel(outputFrame, PIL_PRODUCT_LEVEL_PRIMARY);
-    pilFrmSetProductType(outputFrame, PIL_PRODUCT_TYPE_REDUCED);
+  return tile;
+
+}
+
+
+/*
+ * Create a FITS file with an nx x ny x nz primary array, either of
+ * 32 bit floats or of scaled 16 bit integers, and the keywords in
+ * header. The file is left open for writing the data.
+ */
 
-    pilSofInsert(sof, outputFrame);
+static fitsfile *
+vmifucombinecube_create_cube(const char *name, const cpl_propertylist *header,
+                             int nx, int ny, int nz, int scaled,
+                             double bscale, double bzero)
+{
+
+  fitsfile            *fptr;
+  const cpl_property  *property;
+  long                 naxes[3];
+  int                  status = 0;
+  int                  ivalue;
+  double               dvalue;
+  cpl_size             i;
+
+
+  naxes[0] = nx;
+  naxes[1] = ny;
+  naxes[2] = nz;
+
+  /*
+   * Drop anything still cached by CPL for a previous product of
+   * the same name.
+   */
+
+  cpl_fits_set_mode(CPL_FITS_RESTART_CACHING);
+  remove(name);
+
+  if (fits_create_diskfile(&fptr, name, &status))
+    return NULL;
+
+  fits_create_img(fptr, scaled ? SHORT_IMG : FLOAT_IMG, 3, naxes, &status);
+
+  for (i = 0; i < cpl_propertylist_get_size(header); i++) {
+
+    property = cpl_propertylist_get_const(header, i);
+
+    switch (cpl_property_get_type(property)) {
+    case CPL_TYPE_DOUBLE:
+      dvalue = cpl_property_get_double(property);
+      fits_update_key(fptr, TDOUBLE, cpl_property_get_name(property),
+                      &dvalue, cpl_property_get_comment(property), &status);
+      break;
+    case CPL_TYPE_INT:
+      ivalue = cpl_property_get_int(property);
+      fits_update_key(fptr, TINT, cpl_property_get_name(property),
+                      &ivalue, cpl_property_get_comment(property), &status);
+      break;
+    case CPL_TYPE_STRING:
+      fits_update_key(fptr, TSTRING, cpl_property_get_name(property),
+                      (void *)cpl_property_get_string(property),
+                      cpl_property_get_comment(property), &status);
+      break;
+    default:
+      break;
+    }
   }
-  else {
-    cpl_msg_error(task, "Cannot create local product file %s!", cubeName);
-    cpl_propertylist_delete(wcsheader);
-    cpl_imagelist_delete(planes);
-    return EXIT_FAILURE;
+
+  if (scaled) {
+    fits_write_key_dbl(fptr, "BSCALE", bscale, -15,
+                       "Data value = BZERO + BSCALE * array value",
+                       &status);
+    fits_write_key_dbl(fptr, "BZERO", bzero, -15,
+                       "Data value = BZERO + BSCALE * array value",
+                       &status);
+    fits_write_key_lng(fptr, "BLANK", -32768, "Undefined pixels", &status);
+    fits_set_bscale(fptr, bscale, bzero, &status);
+    fits_set_imgnull(fptr, -32768, &status);
   }
 
-  cpl_propertylist_delete(wcsheader);
-  cpl_imagelist_delete(planes);
+  if (status) {
+    ivalue = 0;
+    fits_delete_file(fptr, &ivalue);
+    return NULL;
+  }
+
+  return fptr;
 
-  return EXIT_SUCCESS;
 }
 
 cpl_propertylist * vimos_ifu_combinecube_add_wcs
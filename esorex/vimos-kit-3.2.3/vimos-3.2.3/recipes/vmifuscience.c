@@ -65,9 +65,12 @@
 #include "vmspecphottable.h"
 #include "vmcpl.h"
 #include "vimos_dfs.h"
+#include "moses.h"
 
 
 static cxint vmifuscience(PilSetOfFrames *);
+static int vmifuscienceSaveTables(const char *, const char *,
+                                  cpl_table **, int);
 
 
 /*
@@ -195,6 +198,72 @@ vmifuscience_create(cpl_plugin *plugin)
     cpl_parameterlist_append(recipe->parameters, p);
 
 
+    p = cpl_parameter_new_enum("vimos.Parameters.cosmics.method",
+                               CPL_TYPE_STRING,
+                               "Cosmic rays removal from the science "
+                               "exposure.",
+                               "vimos.Parameters",
+                               "none", 2, "none", "lacosmic");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "CosmicsMethod");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CFG, "CosmicsMethod");
+    cpl_parameterlist_append(recipe->parameters, p);
+
+
+    p = cpl_parameter_new_value("vimos.Parameters.cosmics.sigma",
+                                CPL_TYPE_DOUBLE,
+                                "LA-Cosmic detection limit, in noise sigmas.",
+                                "vimos.Parameters",
+                                5.0);
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "CosmicsSigmaLim");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CFG, "CosmicsSigmaLim");
+    cpl_parameterlist_append(recipe->parameters, p);
+
+
+    p = cpl_parameter_new_value("vimos.Parameters.cosmics.contrast",
+                                CPL_TYPE_DOUBLE,
+                                "LA-Cosmic contrast limit between the "
+                                "Laplacian and the fine structure image.",
+                                "vimos.Parameters",
+                                2.0);
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "CosmicsFLim");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CFG, "CosmicsFLim");
+    cpl_parameterlist_append(recipe->parameters, p);
+
+
+    p = cpl_parameter_new_value("vimos.Parameters.cosmics.iterations",
+                                CPL_TYPE_INT,
+                                "LA-Cosmic maximum number of iterations.",
+                                "vimos.Parameters",
+                                5);
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "CosmicsMaxIter");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CFG, "CosmicsMaxIter");
+    cpl_parameterlist_append(recipe->parameters, p);
+
+
+    p = cpl_parameter_new_enum("vimos.Parameters.output.compress",
+                               CPL_TYPE_STRING,
+                               "Tile compression of the image products: "
+                               "integral images are always compressed "
+                               "losslessly, other images either losslessly "
+                               "or quantised",
+                               "vimos.Parameters",
+                               "none", 3, "none", "lossless", "quantise");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "CompressOutput");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CFG, "CompressOutput");
+    cpl_parameterlist_append(recipe->parameters, p);
+
+
+    p = cpl_parameter_new_value("vimos.Parameters.output.quantisation",
+                                CPL_TYPE_DOUBLE,
+                                "Quantisation level of quantised image "
+                                "products (noise sigma / quantisation step)",
+                                "vimos.Parameters",
+                                16.0);
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CLI, "QuantisationLevel");
+    cpl_parameter_set_alias(p, CPL_PARAMETER_MODE_CFG, "QuantisationLevel");
+    cpl_parameterlist_append(recipe->parameters, p);
+
+
     /*
      * Initialize the VIMOS recipe subsystems (configuration data base,
      * alias tables, messaging facilities) from the current CPL setup.
@@ -287,6 +356,21 @@ vmifuscience_exec(cpl_plugin *plugin)
              */
 
             status = vmCplFramesetImport(recipe->frames, sof);
+
+            /*
+             * Compress the image products, if requested.
+             */
+
+            if (status == 0) {
+                const char *compress =
+                    dfs_get_parameter_string_const(recipe->parameters,
+                                        "vimos.Parameters.output.compress");
+                double level =
+                    dfs_get_parameter_double_const(recipe->parameters,
+                                        "vimos.Parameters.output.quantisation");
+
+                status = dfs_compress_products(recipe->frames, compress, level);
+            }
         }
 
     }
@@ -383,6 +467,7 @@ vmifuscience(PilSetOfFrames *sof)
   const char  *fovTag             = pilTrnGetCategory("IfuFov");
 
   char        *biasMethodTag      = NULL;
+  char        *cosmicsMethodTag   = NULL;
 
   char        *idsName;
   char         outIdsName[PATHNAME_MAX + 1];
@@ -397,6 +482,7 @@ vmifuscience(PilSetOfFrames *sof)
   char         ifuShutter[10];
 
   VimosBool    updateOK = VM_TRUE;
+  VimosImageStats stats;
 
   size_t       scienceCount, traceCount, idsCount, transCount;
   size_t       detectedCount;
@@ -409,6 +495,7 @@ vmifuscience(PilSetOfFrames *sof)
   unsigned int useSkyIndividual; /* Added by Peter Weilbacher */
   unsigned int applyTrans;
   unsigned int computeQC;
+  unsigned int cleanCosmics;
   unsigned int error;
 
   int          biasMethodEntry;
@@ -454,6 +541,8 @@ vmifuscience(PilSetOfFrames *sof)
   double       startLambda, endLambda, stepLambda, lambda;
   double       startIntegral, endIntegral;
   double       norm = 1.0;
+  double       cosmicsSigmaLim, cosmicsFLim;
+  int          cosmicsMaxIter;
   double      *integrals;
   double      *p;
   double      *coeff = NULL;
@@ -471,6 +560,10 @@ vmifuscience(PilSetOfFrames *sof)
 
   cpl_table   *spectra;         /* Extracted science spectra                */
   cpl_table   *ids;             /* IDS coefficients for each fiber          */
+  cpl_table   *traceTables[8];  /* Tracings to write, two per pseudo-slit   */
+  cpl_table   *idsTables[4];    /* IDS to write, one per pseudo-slit        */
+  int          traceTablesCount = 0;
+  int          idsTablesCount = 0;
   cpl_table   *trans;           /* Transmission correction for each fiber   */
 
   cpl_table   *matches;         /* Flat fibers matching science fibers      */
@@ -555,6 +648,40 @@ vmifuscience(PilSetOfFrames *sof)
   computeQC = pilDfsDbGetBool("Parameters", "ComputeQC", 1);
 
 
+  /*
+   * Check if cosmic rays should be removed from the science exposure.
+   */
+
+  cosmicsMethodTag = (char *)pilDfsDbGetString(parameter, "CosmicsMethod");
+
+  if (strcmp(cosmicsMethodTag, "lacosmic") == 0) {
+    cleanCosmics = 1;
+  }
+  else if (strcmp(cosmicsMethodTag, "none") == 0) {
+    cleanCosmics = 0;
+  }
+  else {
+    cpl_msg_error(task, "%s: Invalid cosmic rays removal method.",
+                  cosmicsMethodTag);
+    return EXIT_FAILURE;
+  }
+
+  cosmicsSigmaLim = pilDfsDbGetDouble(parameter, "CosmicsSigmaLim", 5.0);
+  cosmicsFLim = pilDfsDbGetDouble(parameter, "CosmicsFLim", 2.0);
+  cosmicsMaxIter = pilDfsDbGetInt(parameter, "CosmicsMaxIter", 5);
+
+  if (cleanCosmics) {
+    if (cosmicsSigmaLim <= 0.0 || cosmicsFLim <= 0.0) {
+      cpl_msg_error(task, "Invalid LA-Cosmic limits.");
+      return EXIT_FAILURE;
+    }
+    if (cosmicsMaxIter < 1) {
+      cpl_msg_error(task, "Invalid LA-Cosmic number of iterations.");
+      return EXIT_FAILURE;
+    }
+  }
+
+
   /*
    * Make sure that the input dataset include the essential datasets.
    */
@@ -882,8 +1009,32 @@ vmifuscience(PilSetOfFrames *sof)
    *  is based on CPL.
    */
 
-  science = cpl_image_wrap_float(scienceImage->xlen, scienceImage->ylen, 
-                                 scienceImage->data);
+  science = vmCplImageImport(scienceImage);
+
+  if (cleanCosmics) {
+    double gain = getMeanGainFactor(scienceImage);
+    double ron = getAverageRon(scienceImage);
+
+    if (gain <= 0.0 || ron < 0.0) {
+      cpl_msg_error(task, "Cannot read gain and read-out noise from "
+                    "science exposure header");
+      cpl_image_unwrap(science);
+      cpl_image_delete(extracted);
+      deleteImage(scienceImage);
+      return EXIT_FAILURE;
+    }
+
+    cpl_msg_info(task, "Removing cosmic rays from science exposure...");
+    if (mos_clean_cosmics_lacosmic(science, gain, ron, cosmicsSigmaLim,
+                                   cosmicsFLim, cosmicsMaxIter)) {
+      cpl_msg_error(task, "Cannot remove cosmic rays: %s",
+                    cpl_error_get_message());
+      cpl_image_unwrap(science);
+      cpl_image_delete(extracted);
+      deleteImage(scienceImage);
+      return EXIT_FAILURE;
+    }
+  }
 
   for (slit = firstSlit; slit <= lastSlit; slit++) {
 
@@ -1027,32 +1178,17 @@ vmifuscience(PilSetOfFrames *sof)
 
     }
 
-    if (extension == 1) {
-        vmstrlower(strcpy(outTraceName, outTraceTag));
-        strcat(outTraceName, ".fits");
-        error = cpl_table_save(fcoeff, NULL, NULL, outTraceName, CPL_IO_DEFAULT);
-        if (error)
-          cpl_msg_error(task, "Cannot create local product file %s!",
-                        outTraceName);
-
-    }
-    else {
-        error = cpl_table_save(fcoeff, NULL, NULL, outTraceName, CPL_IO_EXTEND);
-        if (error)
-          cpl_msg_error(task, "Cannot extend local product file %s!",
-                        outTraceName);
-    }
-
     smodel = ifuAlign(short_fcoeff, fmodel, dc0, dc1);
     cpl_table_delete(smodel);
 
-    error = cpl_table_save(short_fcoeff, NULL, NULL,
-                           outTraceName, CPL_IO_EXTEND);
-    if (error)
-      cpl_msg_error(task, "Cannot extend local product file %s!", outTraceName);
+    /*
+     * The tracing tables are kept, and written to the local product
+     * once all the pseudo-slits are processed.
+     */
+
+    traceTables[traceTablesCount++] = fcoeff;
+    traceTables[traceTablesCount++] = short_fcoeff;
 
-    cpl_table_delete(fcoeff);
-    cpl_table_delete(short_fcoeff);
     cpl_image_delete(smo_science);
 
 
@@ -1112,29 +1248,6 @@ vmifuscience(PilSetOfFrames *sof)
       cpl_table_save(ids, NULL, NULL, tablename, CPL_IO_CREATE);
 #endif
 
-      if (extension == 1) {
-          vmstrlower(strcpy(outIdsName, outIdsTag));
-          strcat(outIdsName, ".fits");
-          error = cpl_table_save(ids, NULL, NULL, outIdsName, CPL_IO_DEFAULT);
-          if (error)
-            cpl_msg_error(task, "Cannot create local product file %s!",
-                          outIdsName);
-
-      }
-      else {
-          error = cpl_table_save(ids, NULL, NULL, outIdsName, CPL_IO_EXTEND);
-          if (error)
-            cpl_msg_error(task, "Cannot extend local product file %s!",
-                          outIdsName);
-      }
-      outputFrame = newPilFrame(outIdsName, outIdsTag);
-
-      pilFrmSetType(outputFrame, PIL_FRAME_TYPE_PRODUCT);
-      pilFrmSetFormat(outputFrame, PIL_FRAME_FORMAT_IMAGE);
-      pilFrmSetProductLevel(outputFrame, PIL_PRODUCT_LEVEL_SECONDARY);
-      pilFrmSetProductType(outputFrame, PIL_PRODUCT_TYPE_REDUCED);
-
-      pilSofInsert(sof, outputFrame);
     }
 
     cpl_msg_info(task, "Resample scientific spectra at constant wavelength "
@@ -1147,7 +1260,16 @@ vmifuscience(PilSetOfFrames *sof)
     cpl_table_save(ids, NULL, NULL, tablename, CPL_IO_CREATE);
 #endif
 
-    cpl_table_delete(ids);
+    /*
+     * The aligned wavelength calibrations are kept for the local
+     * product, the others are no longer needed.
+     */
+
+    if (useSkylines)
+      idsTables[idsTablesCount++] = ids;
+    else
+      cpl_table_delete(ids);
+
     cpl_table_delete(spectra);
 
     cpl_msg_indent_less();
@@ -1157,6 +1279,15 @@ vmifuscience(PilSetOfFrames *sof)
   cpl_image_unwrap(science);
 
 
+  /*
+   * Write the local products, each one in a single pass.
+   */
+
+  vmstrlower(strcpy(outTraceName, outTraceTag));
+  strcat(outTraceName, ".fits");
+
+  vmifuscienceSaveTables(task, outTraceName, traceTables, traceTablesCount);
+
   outputFrame = newPilFrame(outTraceName, outTraceTag);
   
   pilFrmSetType(outputFrame, PIL_FRAME_TYPE_PRODUCT);
@@ -1166,6 +1297,23 @@ vmifuscience(PilSetOfFrames *sof)
   
   pilSofInsert(sof, outputFrame);
 
+  if (idsTablesCount) {
+
+    vmstrlower(strcpy(outIdsName, outIdsTag));
+    strcat(outIdsName, ".fits");
+
+    vmifuscienceSaveTables(task, outIdsName, idsTables, idsTablesCount);
+
+    outputFrame = newPilFrame(outIdsName, outIdsTag);
+
+    pilFrmSetType(outputFrame, PIL_FRAME_TYPE_PRODUCT);
+    pilFrmSetFormat(outputFrame, PIL_FRAME_FORMAT_IMAGE);
+    pilFrmSetProductLevel(outputFrame, PIL_PRODUCT_LEVEL_SECONDARY);
+    pilFrmSetProductType(outputFrame, PIL_PRODUCT_TYPE_REDUCED);
+
+    pilSofInsert(sof, outputFrame);
+  }
+
   if (applyTrans) {
 
     /*
@@ -1288,8 +1436,7 @@ vmifuscience(PilSetOfFrames *sof)
    *  Then we add the descriptor header, and compute the QC1 parameters.
    */
 
-  data = (float *)cpl_image_get_data(fov);
-  sciFov = newImage(80, 80, data);
+  sciFov = vmCplImageExport(fov);
   copyAllDescriptors(scienceImage->descs, &(sciFov->descs));
 
   //cgarcia: I don't know why ESO ADA keywords where deleted, 
@@ -1309,8 +1456,7 @@ vmifuscience(PilSetOfFrames *sof)
   deleteSetOfDescriptors(&(sciFov->descs), "PCOUNT");  
   deleteSetOfDescriptors(&(sciFov->descs), "GCOUNT");  
 
-  data = (float *)cpl_image_get_data(extracted);
-  sciExtracted = newImage(xlen, ylen, data);
+  sciExtracted = vmCplImageExport(extracted);
   copyAllDescriptors(scienceImage->descs, &(sciExtracted->descs));
 
   //cgarcia: I don't know why ESO ADA keywords where deleted, 
@@ -1427,12 +1573,8 @@ vmifuscience(PilSetOfFrames *sof)
       cpl_msg_error(task, "Failure in opening spectro-photometric table");
 
     if (error) {
-      sciFov->data = NULL;
       deleteImage(sciFov);
-      cpl_image_delete(fov);
-      sciExtracted->data = NULL;
       deleteImage(sciExtracted);
-      cpl_image_delete(extracted);
       return EXIT_FAILURE;
     }
 
@@ -1463,12 +1605,8 @@ vmifuscience(PilSetOfFrames *sof)
 
     if (error) {
       deleteTable(sphotTable);
-      sciFov->data = NULL;
       deleteImage(sciFov);
-      cpl_image_delete(fov);
-      sciExtracted->data = NULL;
       deleteImage(sciExtracted);
-      cpl_image_delete(extracted);
       return EXIT_FAILURE;
     }
 
@@ -1497,38 +1635,40 @@ vmifuscience(PilSetOfFrames *sof)
    * Update the extracted spectra header
    */
 
+  imageStatistics(sciExtracted, &stats);
+
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(sciExtracted->descs), 
                                      pilTrnGetKeyword("DataMin"),
-                                     imageMinimum(sciExtracted), 
+                                     stats.minimum, 
                                      pilTrnGetComment("DataMin"),
                                      "ESO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(sciExtracted->descs), 
                                      pilTrnGetKeyword("DataMax"),
-                                     imageMaximum(sciExtracted), 
+                                     stats.maximum, 
                                      pilTrnGetComment("DataMax"),
                                      "ESO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(sciExtracted->descs), 
                                      pilTrnGetKeyword("DataMedian"),
-                                     imageMedian(sciExtracted), 
+                                     stats.median, 
                                      pilTrnGetComment("DataMedian"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(sciExtracted->descs), 
                                      pilTrnGetKeyword("DataStdDeviation"),
-                                     imageSigma(sciExtracted), 
+                                     stats.sigma, 
                                      pilTrnGetComment("DataStdDeviation"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(sciExtracted->descs), 
                                      pilTrnGetKeyword("DataMean"), 
-                                     imageMean(sciExtracted), 
+                                     stats.mean, 
                                      pilTrnGetComment("DataMean"),
                                      "ESO PRO*", 1));
 
@@ -1553,38 +1693,40 @@ vmifuscience(PilSetOfFrames *sof)
                                        pilTrnGetComment("ExposureTime"),
                                        "ESO*", 1));
 
+    imageStatistics(sciFluxExtracted, &stats);
+
     updateOK = (updateOK &&
                 insertDoubleDescriptor(&(sciFluxExtracted->descs),
                                        pilTrnGetKeyword("DataMin"),
-                                       imageMinimum(sciFluxExtracted),
+                                       stats.minimum,
                                        pilTrnGetComment("DataMin"),
                                        "ESO*", 1));
 
     updateOK = (updateOK &&
                 insertDoubleDescriptor(&(sciFluxExtracted->descs),
                                        pilTrnGetKeyword("DataMax"),
-                                       imageMaximum(sciFluxExtracted),
+                                       stats.maximum,
                                        pilTrnGetComment("DataMax"),
                                        "ESO*", 1));
 
     updateOK = (updateOK &&
                 insertDoubleDescriptor(&(sciFluxExtracted->descs),
                                        pilTrnGetKeyword("DataMedian"),
-                                       imageMedian(sciFluxExtracted),
+                                       stats.median,
                                        pilTrnGetComment("DataMedian"),
                                        "ESO PRO*", 1));
 
     updateOK = (updateOK &&
                 insertDoubleDescriptor(&(sciFluxExtracted->descs),
                                        pilTrnGetKeyword("DataStdDeviation"),
-                                       imageSigma(sciFluxExtracted),
+                                       stats.sigma,
                                        pilTrnGetComment("DataStdDeviation"),
                                        "ESO PRO*", 1));
 
     updateOK = (updateOK &&
                 insertDoubleDescriptor(&(sciFluxExtracted->descs),
                                        pilTrnGetKeyword("DataMean"),
-                                       imageMean(sciFluxExtracted),
+                                       stats.mean,
                                        pilTrnGetComment("DataMean"),
                                        "ESO PRO*", 1));
 
@@ -1607,38 +1749,40 @@ vmifuscience(PilSetOfFrames *sof)
    * Update the reconstructed FOV header
    */
 
+  imageStatistics(sciFov, &stats);
+
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(sciFov->descs),
                                      pilTrnGetKeyword("DataMin"),
-                                     imageMinimum(sciFov),
+                                     stats.minimum,
                                      pilTrnGetComment("DataMin"),
                                      "ESO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(sciFov->descs),
                                      pilTrnGetKeyword("DataMax"),
-                                     imageMaximum(sciFov),
+                                     stats.maximum,
                                      pilTrnGetComment("DataMax"),
                                      "ESO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(sciFov->descs),
                                      pilTrnGetKeyword("DataMedian"),
-                                     imageMedian(sciFov),
+                                     stats.median,
                                      pilTrnGetComment("DataMedian"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(sciFov->descs),
                                      pilTrnGetKeyword("DataStdDeviation"),
-                                     imageSigma(sciFov),
+                                     stats.sigma,
                                      pilTrnGetComment("DataStdDeviation"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(sciFov->descs),
                                      pilTrnGetKeyword("DataMean"),
-                                     imageMean(sciFov),
+                                     stats.mean,
                                      pilTrnGetComment("DataMean"),
                                      "ESO PRO*", 1));
 
@@ -1651,12 +1795,8 @@ vmifuscience(PilSetOfFrames *sof)
 
   if (!updateOK) {
     cpl_msg_error(task, "Failure updating product header");
-    sciFov->data = NULL;
     deleteImage(sciFov);
-    cpl_image_delete(fov);
-    sciExtracted->data = NULL;
     deleteImage(sciExtracted);
-    cpl_image_delete(extracted);
     deleteImage(sciFluxExtracted);
     return EXIT_FAILURE;
   }
@@ -1683,18 +1823,12 @@ vmifuscience(PilSetOfFrames *sof)
   else {
     cpl_msg_error(task, "Cannot create local product file %s!", reducedName);
     deleteImage(sciFluxExtracted);
-    sciFov->data = NULL;
     deleteImage(sciFov);
-    cpl_image_delete(fov);
-    sciExtracted->data = NULL;
     deleteImage(sciExtracted);
-    cpl_image_delete(extracted);
     return EXIT_FAILURE;
   }
 
-  sciExtracted->data = NULL;
   deleteImage(sciExtracted);
-  cpl_image_delete(extracted);
 
   vmstrlower(strcpy(fovName, fovTag));
   strcat(fovName, ".fits");
@@ -1712,15 +1846,11 @@ vmifuscience(PilSetOfFrames *sof)
   else {
     cpl_msg_error(task, "Cannot create local product file %s!", fovName);
     deleteImage(sciFluxExtracted);
-    sciFov->data = NULL;
     deleteImage(sciFov);
-    cpl_image_delete(fov);
     return EXIT_FAILURE;
   }
 
-  sciFov->data = NULL;
   deleteImage(sciFov);
-  cpl_image_delete(fov);
 
 
   if (calibrateFlux) {
@@ -1752,6 +1882,40 @@ vmifuscience(PilSetOfFrames *sof)
 }
 
 
+/*
+ * Write a list of tables to a local product file, one extension per
+ * table, and destroy them. The file is created with the first table,
+ * and extended with the others in sequence, so that the product is
+ * written in one pass while CPL keeps the file open. Returns 1 if the
+ * product could not be written completely.
+ */
+
+static int
+vmifuscienceSaveTables(const char *task, const char *name,
+                       cpl_table **tables, int count)
+{
+
+  int status = 0;
+  int i;
+
+
+  for (i = 0; i < count; i++) {
+    if (status == 0) {
+      if (cpl_table_save(tables[i], NULL, NULL, name,
+                         i ? CPL_IO_EXTEND : CPL_IO_DEFAULT)) {
+        cpl_msg_error(task, "Cannot %s local product file %s!",
+                      i ? "extend" : "create", name);
+        status = 1;
+      }
+    }
+    cpl_table_delete(tables[i]);
+  }
+
+  return status;
+
+}
+
+
 /*
  * Build table of contents, i.e. the list of available plugins, for
  * this module. This function is exported.
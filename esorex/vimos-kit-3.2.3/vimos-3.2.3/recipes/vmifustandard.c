@@ -384,6 +384,7 @@ vmifustandard(PilSetOfFrames *sof)
   char           ifuShutter[10];
 
   VimosBool      updateOK = VM_TRUE;
+  VimosImageStats stats;
 
   size_t         standardCount, traceCount, idsCount, transCount;
   size_t         detectedCount;
@@ -1908,38 +1909,40 @@ vmifustandard(PilSetOfFrames *sof)
    * Update the extracted spectra header
    */
 
+  imageStatistics(sciExtracted, &stats);
+
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(sciExtracted->descs), 
                                      pilTrnGetKeyword("DataMin"),
-                                     imageMinimum(sciExtracted), 
+                                     stats.minimum, 
                                      pilTrnGetComment("DataMin"),
                                      "ESO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(sciExtracted->descs), 
                                      pilTrnGetKeyword("DataMax"),
-                                     imageMaximum(sciExtracted), 
+                                     stats.maximum, 
                                      pilTrnGetComment("DataMax"),
                                      "ESO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(sciExtracted->descs), 
                                      pilTrnGetKeyword("DataMedian"),
-                                     imageMedian(sciExtracted), 
+                                     stats.median, 
                                      pilTrnGetComment("DataMedian"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(sciExtracted->descs), 
                                      pilTrnGetKeyword("DataStdDeviation"),
-                                     imageSigma(sciExtracted), 
+                                     stats.sigma, 
                                      pilTrnGetComment("DataStdDeviation"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(sciExtracted->descs), 
                                      pilTrnGetKeyword("DataMean"), 
-                                     imageMean(sciExtracted), 
+                                     stats.mean, 
                                      pilTrnGetComment("DataMean"),
                                      "ESO PRO*", 1));
 
@@ -1948,38 +1951,40 @@ vmifustandard(PilSetOfFrames *sof)
    * Update the reconstructed FOV header
    */
 
+  imageStatistics(sciFov, &stats);
+
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(sciFov->descs),
                                      pilTrnGetKeyword("DataMin"),
-                                     imageMinimum(sciFov),
+                                     stats.minimum,
                                      pilTrnGetComment("DataMin"),
                                      "ESO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(sciFov->descs),
                                      pilTrnGetKeyword("DataMax"),
-                                     imageMaximum(sciFov),
+                                     stats.maximum,
                                      pilTrnGetComment("DataMax"),
                                      "ESO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(sciFov->descs),
                                      pilTrnGetKeyword("DataMedian"),
-                                     imageMedian(sciFov),
+                                     stats.median,
                                      pilTrnGetComment("DataMedian"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(sciFov->descs),
                                      pilTrnGetKeyword("DataStdDeviation"),
-                                     imageSigma(sciFov),
+                                     stats.sigma,
                                      pilTrnGetComment("DataStdDeviation"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(sciFov->descs),
                                      pilTrnGetKeyword("DataMean"),
-                                     imageMean(sciFov),
+                                     stats.mean,
                                      pilTrnGetComment("DataMean"),
                                      "ESO PRO*", 1));
 
@@ -1988,38 +1993,40 @@ vmifustandard(PilSetOfFrames *sof)
    * Update the sky spectrum header
    */
 
+  imageStatistics(skyExtracted, &stats);
+
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(skyExtracted->descs),
                                      pilTrnGetKeyword("DataMin"),
-                                     imageMinimum(skyExtracted),
+                                     stats.minimum,
                                      pilTrnGetComment("DataMin"),
                                      "ESO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(skyExtracted->descs),
                                      pilTrnGetKeyword("DataMax"),
-                                     imageMaximum(skyExtracted),
+                                     stats.maximum,
                                      pilTrnGetComment("DataMax"),
                                      "ESO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(skyExtracted->descs),
                                      pilTrnGetKeyword("DataMedian"),
-                                     imageMedian(skyExtracted),
+                                     stats.median,
                                      pilTrnGetComment("DataMedian"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(skyExtracted->descs),
                                      pilTrnGetKeyword("DataStdDeviation"),
-                                     imageSigma(skyExtracted),
+                                     stats.sigma,
                                      pilTrnGetComment("DataStdDeviation"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(skyExtracted->descs),
                                      pilTrnGetKeyword("DataMean"),
-                                     imageMean(skyExtracted),
+                                     stats.mean,
                                      pilTrnGetComment("DataMean"),
                                      "ESO PRO*", 1));
 
@@ -2028,38 +2035,40 @@ vmifustandard(PilSetOfFrames *sof)
    * Update the standard star spectrum header
    */
 
+  imageStatistics(starExtracted, &stats);
+
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(starExtracted->descs),
                                      pilTrnGetKeyword("DataMin"),
-                                     imageMinimum(starExtracted),
+                                     stats.minimum,
                                      pilTrnGetComment("DataMin"),
                                      "ESO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(starExtracted->descs),
                                      pilTrnGetKeyword("DataMax"),
-                                     imageMaximum(starExtracted),
+                                     stats.maximum,
                                      pilTrnGetComment("DataMax"),
                                      "ESO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(starExtracted->descs),
                                      pilTrnGetKeyword("DataMedian"),
-                                     imageMedian(starExtracted),
+                                     stats.median,
                                      pilTrnGetComment("DataMedian"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(starExtracted->descs),
                                      pilTrnGetKeyword("DataStdDeviation"),
-                                     imageSigma(starExtracted),
+                                     stats.sigma,
                                      pilTrnGetComment("DataStdDeviation"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(starExtracted->descs),
                                      pilTrnGetKeyword("DataMean"),
-                                     imageMean(starExtracted),
+                                     stats.mean,
                                      pilTrnGetComment("DataMean"),
                                      "ESO PRO*", 1));
 
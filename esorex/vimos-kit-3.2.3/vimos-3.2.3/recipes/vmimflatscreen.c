@@ -681,6 +681,7 @@ vmimflatscreen(PilSetOfFrames *sof)
   char           comment[MAX_COMMENT_LENGTH];
 
   VimosBool      updateOK = VM_TRUE;
+  VimosImageStats stats;
 
   size_t         flatCount, goodFrames, minFrames;
 
@@ -1876,17 +1877,19 @@ vmimflatscreen(PilSetOfFrames *sof)
                                      pilTrnGetComment("ExposureTime"),
                                      "ESO*", 1));
 
+  imageStatistics(mFlatNorm, &stats);
+
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mFlatNorm->descs), 
                                      pilTrnGetKeyword("DataMin"), 
-                                     imageMinimum(mFlatNorm), 
+                                     stats.minimum, 
                                      pilTrnGetComment("DataMin"),
                                      "ESO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mFlatNorm->descs), 
                                      pilTrnGetKeyword("DataMax"), 
-                                     imageMaximum(mFlatNorm), 
+                                     stats.maximum, 
                                      pilTrnGetComment("DataMax"),
                                      "ESO*", 1));
 
@@ -1907,21 +1910,21 @@ vmimflatscreen(PilSetOfFrames *sof)
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mFlatNorm->descs), 
                                      pilTrnGetKeyword("DataMedian"),
-                                     imageMedian(mFlatNorm), 
+                                     stats.median, 
                                      pilTrnGetComment("DataMedian"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mFlatNorm->descs), 
                                      pilTrnGetKeyword("DataStdDeviation"),
-                                     imageSigma(mFlatNorm), 
+                                     stats.sigma, 
                                      pilTrnGetComment("DataStdDeviation"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mFlatNorm->descs), 
                                      pilTrnGetKeyword("DataMean"), 
-                                     imageMean(mFlatNorm), 
+                                     stats.mean, 
                                      pilTrnGetComment("DataMean"),
                                      "ESO PRO*", 1));
 
@@ -1970,17 +1973,19 @@ vmimflatscreen(PilSetOfFrames *sof)
                                      pilTrnGetComment("ExposureTime"),
                                      "ESO*", 1));
 
+  imageStatistics(mFlat, &stats);
+
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mFlat->descs), 
                                      pilTrnGetKeyword("DataMin"), 
-                                     imageMinimum(mFlat), 
+                                     stats.minimum, 
                                      pilTrnGetComment("DataMin"), 
                                      "ESO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mFlat->descs), 
                                      pilTrnGetKeyword("DataMax"), 
-                                     imageMaximum(mFlat),
+                                     stats.maximum,
                                      pilTrnGetComment("DataMax"),
                                      "ESO*", 1));
 
@@ -2001,21 +2006,21 @@ vmimflatscreen(PilSetOfFrames *sof)
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mFlat->descs), 
                                      pilTrnGetKeyword("DataMedian"),
-                                     imageMedian(mFlat), 
+                                     stats.median, 
                                      pilTrnGetComment("DataMedian"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mFlat->descs), 
                                      pilTrnGetKeyword("DataStdDeviation"),
-                                     imageSigma(mFlat), 
+                                     stats.sigma, 
                                      pilTrnGetComment("DataStdDeviation"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mFlat->descs), 
                                      pilTrnGetKeyword("DataMean"), 
-                                     imageMean(mFlat), 
+                                     stats.mean, 
                                      pilTrnGetComment("DataMean"),
                                      "ESO PRO*", 1));
 
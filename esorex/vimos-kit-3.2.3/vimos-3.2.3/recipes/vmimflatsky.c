@@ -692,6 +692,7 @@ vmimflatsky(PilSetOfFrames *sof)
   char           comment[MAX_COMMENT_LENGTH];
 
   VimosBool      updateOK = VM_TRUE;
+  VimosImageStats stats;
 
   size_t         flatCount, goodFrames, minFrames;
 
@@ -1916,17 +1917,19 @@ vmimflatsky(PilSetOfFrames *sof)
                                      pilTrnGetComment("ExposureTime"),
                                      "ESO*", 1));
 
+  imageStatistics(mFlatNorm, &stats);
+
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mFlatNorm->descs), 
                                      pilTrnGetKeyword("DataMin"), 
-                                     imageMinimum(mFlatNorm), 
+                                     stats.minimum, 
                                      pilTrnGetComment("DataMin"),
                                      "ESO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mFlatNorm->descs), 
                                      pilTrnGetKeyword("DataMax"), 
-                                     imageMaximum(mFlatNorm), 
+                                     stats.maximum, 
                                      pilTrnGetComment("DataMax"),
                                      "ESO*", 1));
 
@@ -1947,21 +1950,21 @@ vmimflatsky(PilSetOfFrames *sof)
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mFlatNorm->descs), 
                                      pilTrnGetKeyword("DataMedian"),
-                                     imageMedian(mFlatNorm), 
+                                     stats.median, 
                                      pilTrnGetComment("DataMedian"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mFlatNorm->descs), 
                                      pilTrnGetKeyword("DataStdDeviation"),
-                                     imageSigma(mFlatNorm), 
+                                     stats.sigma, 
                                      pilTrnGetComment("DataStdDeviation"),
                                      "ESO PRO*", 1));
 
   updateOK = (updateOK &&
               insertDoubleDescriptor(&(mFlatNorm->descs), 
                                      pilTrnGetKeyword("DataMean"), 
-                                     imageMean(mFlatNorm), 
+                                     stats.mean, 
                                      pilTrnGetComment("DataMean"),
                                      "ESO PRO*", 1));
 
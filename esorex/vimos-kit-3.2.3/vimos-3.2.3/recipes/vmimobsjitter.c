@@ -1125,6 +1125,7 @@ vmimobsjitter(PilSetOfFrames *sof)
     VimosImage **set;
     VimosImage *mosaic;
     VimosImage *imaFringes = 0L;
+    VimosImageStats stats;
 
     VimosImageArray *images;
 
@@ -2592,33 +2593,35 @@ vmimobsjitter(PilSetOfFrames *sof)
                         pilTrnGetComment("NFramesCombined"),
                         "ESO PRO*", 1);
 
+    imageStatistics(mosaic, &stats);
+
     insertDoubleDescriptor(&mosaic->descs,
                            pilTrnGetKeyword("DataMin"),
-                           imageMinimum(mosaic),
+                           stats.minimum,
                            pilTrnGetComment("DataMin"),
                            "ESO*", 1);
 
     insertDoubleDescriptor(&mosaic->descs,
                            pilTrnGetKeyword("DataMax"),
-                           imageMaximum(mosaic),
+                           stats.maximum,
                            pilTrnGetComment("DataMax"),
                            "ESO*", 1);
 
     insertDoubleDescriptor(&mosaic->descs,
                            pilTrnGetKeyword("DataMedian"),
-                           imageMedian(mosaic),
+                           stats.median,
                            pilTrnGetComment("DataMedian"),
                            "ESO PRO*", 1);
 
     insertDoubleDescriptor(&mosaic->descs,
                            pilTrnGetKeyword("DataStdDeviation"),
-                           imageSigma(mosaic), 
+                           stats.sigma, 
                            pilTrnGetComment("DataStdDeviation"),
                            "ESO PRO*", 1);
 
     insertDoubleDescriptor(&mosaic->descs,
                            pilTrnGetKeyword("DataMean"),
-                           imageMean(mosaic),
+                           stats.mean,
                            pilTrnGetComment("DataMean"),
                            "ESO PRO*", 1);
 
@@ -2717,33 +2720,35 @@ vmimobsjitter(PilSetOfFrames *sof)
                             pilTrnGetComment("NFramesCombined"),
                             "ESO PRO*", 1);
 
+        imageStatistics(imaFringes, &stats);
+
         insertDoubleDescriptor(&imaFringes->descs,
                                pilTrnGetKeyword("DataMin"),
-                               imageMinimum(imaFringes),
+                               stats.minimum,
                                pilTrnGetComment("DataMin"),
                                "ESO*", 1);
 
         insertDoubleDescriptor(&imaFringes->descs,
                                pilTrnGetKeyword("DataMax"),
-                               imageMaximum(imaFringes),
+                               stats.maximum,
                                pilTrnGetComment("DataMax"),
                                "ESO*", 1);
 
         insertDoubleDescriptor(&imaFringes->descs,
                                pilTrnGetKeyword("DataMedian"),
-                               imageMedian(imaFringes),
+                               stats.median,
                                pilTrnGetComment("DataMedian"),
                                "ESO PRO*", 1);
 
         insertDoubleDescriptor(&imaFringes->descs,
                                pilTrnGetKeyword("DataStdDeviation"),
-                               imageSigma(imaFringes), 
+                               stats.sigma, 
                                pilTrnGetComment("DataStdDeviation"),
                                "ESO PRO*", 1);
 
         insertDoubleDescriptor(&imaFringes->descs,
                                pilTrnGetKeyword("DataMean"),
-                               imageMean(imaFringes),
+                               stats.mean,
                                pilTrnGetComment("DataMean"),
                                "ESO PRO*", 1);
 
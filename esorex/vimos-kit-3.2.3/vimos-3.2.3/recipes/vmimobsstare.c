@@ -1117,6 +1117,7 @@ vmimobsstare(PilSetOfFrames *sof)
   VimosImage *resizedBias = 0;
   VimosImage *rawImageFF = 0;
   VimosImage *astFile;
+  VimosImageStats stats;
 
   VimosTable *ccdTable = 0;
   VimosTable *ipcTable = 0;
@@ -3064,33 +3065,35 @@ vmimobsstare(PilSetOfFrames *sof)
   strcat(productName, ".fits");
 
 
+  imageStatistics(rawImageFF, &stats);
+
   insertDoubleDescriptor(&rawImageFF->descs,
                          pilTrnGetKeyword("DataMin"),
-                         imageMinimum(rawImageFF),
+                         stats.minimum,
                          pilTrnGetComment("DataMin"),
                          "ESO*", 1);
 
   insertDoubleDescriptor(&rawImageFF->descs,
                          pilTrnGetKeyword("DataMax"),
-                         imageMaximum(rawImageFF),
+                         stats.maximum,
                          pilTrnGetComment("DataMax"),
                          "ESO*", 1);
 
   insertDoubleDescriptor(&rawImageFF->descs,
                          pilTrnGetKeyword("DataMedian"),
-                         imageMedian(rawImageFF), 
+                         stats.median, 
                          pilTrnGetComment("DataMedian"),
                          "ESO PRO*", 1);
 
   insertDoubleDescriptor(&rawImageFF->descs, 
                          pilTrnGetKeyword("DataStdDeviation"),
-                         imageSigma(rawImageFF),
+                         stats.sigma,
                          pilTrnGetComment("DataStdDeviation"),
                          "ESO PRO*", 1);
 
   insertDoubleDescriptor(&rawImageFF->descs,
                          pilTrnGetKeyword("DataMean"),
-                         imageMean(rawImageFF),
+                         stats.mean,
                          pilTrnGetComment("DataMean"),
                          "ESO PRO*", 1);
 
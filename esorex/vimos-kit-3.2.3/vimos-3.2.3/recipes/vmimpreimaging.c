@@ -413,6 +413,7 @@ vmimpreimaging(PilSetOfFrames *sof)
   VimosImage *biasImage, *flatImage;
   VimosImage *resizedBias = 0;
   VimosImage *rawImageFF = 0;
+  VimosImageStats stats;
 
   VimosTable *ccdTable = 0;
   VimosTable *ipcTable = 0;
@@ -837,33 +838,35 @@ vmimpreimaging(PilSetOfFrames *sof)
   strcat(productName, ".fits");
 
 
+  imageStatistics(rawImageFF, &stats);
+
   insertDoubleDescriptor(&rawImageFF->descs,
                          pilTrnGetKeyword("DataMin"),
-                         imageMinimum(rawImageFF),
+                         stats.minimum,
                          pilTrnGetComment("DataMin"),
                          "ESO*", 1);
 
   insertDoubleDescriptor(&rawImageFF->descs,
                          pilTrnGetKeyword("DataMax"),
-                         imageMaximum(rawImageFF),
+                         stats.maximum,
                          pilTrnGetComment("DataMax"),
                          "ESO*", 1);
 
   insertDoubleDescriptor(&rawImageFF->descs,
                          pilTrnGetKeyword("DataMedian"),
-                         imageMedian(rawImageFF), 
+                         stats.median, 
                          pilTrnGetComment("DataMedian"),
                          "ESO PRO*", 1);
 
   insertDoubleDescriptor(&rawImageFF->descs, 
                          pilTrnGetKeyword("DataStdDeviation"),
-                         imageSigma(rawImageFF),
+                         stats.sigma,
                          pilTrnGetComment("DataStdDeviation"),
                          "ESO PRO*", 1);
 
   insertDoubleDescriptor(&rawImageFF->descs,
                          pilTrnGetKeyword("DataMean"),
-                         imageMean(rawImageFF),
+                         stats.mean,
                          pilTrnGetComment("DataMean"),
                          "ESO PRO*", 1);
 
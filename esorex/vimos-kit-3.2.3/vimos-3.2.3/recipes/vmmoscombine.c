@@ -479,6 +479,7 @@ vmmoscombine(PilSetOfFrames *sof)
 
 
   VimosBool              updateOK = VM_TRUE;
+  VimosImageStats        stats;
 
   unsigned int           calibrateFlux;
   unsigned int           error;
@@ -1310,31 +1311,33 @@ vmmoscombine(PilSetOfFrames *sof)
                          pilTrnGetComment("NFramesCombined"),
                          "ESO*", 1);
 
+  imageStatistics(imaSpEx1D[0], &stats);
+
   updateOK = updateOK && insertDoubleDescriptor(&(imaSpEx1D[0]->descs),
                          pilTrnGetKeyword("DataMin"),
-                         imageMinimum(imaSpEx1D[0]),
+                         stats.minimum,
                          pilTrnGetComment("DataMin"), 
                          "ESO*", 1);
   
   updateOK = updateOK && insertDoubleDescriptor(&(imaSpEx1D[0]->descs),
                          pilTrnGetKeyword("DataMax"),
-                         imageMaximum(imaSpEx1D[0]),
+                         stats.maximum,
                          pilTrnGetComment("DataMax"), 
                          "ESO*", 1);
   
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1D[0]->descs),
                          pilTrnGetKeyword("DataMean"),
-                         imageMean(imaSpEx1D[0]),
+                         stats.mean,
                          pilTrnGetComment("DataMean"));
   
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1D[0]->descs),
                          pilTrnGetKeyword("DataStdDeviation"),
-                         imageSigma(imaSpEx1D[0]),
+                         stats.sigma,
                          pilTrnGetComment("DataStdDeviation"));
   
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1D[0]->descs),
                          pilTrnGetKeyword("DataMedian"),
-                         imageMedian(imaSpEx1D[0]),
+                         stats.median,
                          pilTrnGetComment("DataMedian")); 
   
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1D[0]->descs),
@@ -1419,31 +1422,33 @@ vmmoscombine(PilSetOfFrames *sof)
                            pilTrnGetComment("NFramesCombined"),
                            "ESO*", 1);
 
+    imageStatistics(imaSpEx1DCal, &stats);
+
     updateOK = updateOK && insertDoubleDescriptor(&(imaSpEx1DCal->descs),
                            pilTrnGetKeyword("DataMin"),
-                           imageMinimum(imaSpEx1DCal),
+                           stats.minimum,
                            pilTrnGetComment("DataMin"),
                            "ESO*", 1);
 
     updateOK = updateOK && insertDoubleDescriptor(&(imaSpEx1DCal->descs),
                            pilTrnGetKeyword("DataMax"),
-                           imageMaximum(imaSpEx1DCal),
+                           stats.maximum,
                            pilTrnGetComment("DataMax"),
                            "ESO*", 1);
 
     updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1DCal->descs),
                            pilTrnGetKeyword("DataMean"),
-                           imageMean(imaSpEx1DCal),
+                           stats.mean,
                            pilTrnGetComment("DataMean"));
 
     updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1DCal->descs),
                            pilTrnGetKeyword("DataStdDeviation"),
-                           imageSigma(imaSpEx1DCal),
+                           stats.sigma,
                            pilTrnGetComment("DataStdDeviation"));
 
     updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1DCal->descs),
                            pilTrnGetKeyword("DataMedian"),
-                           imageMedian(imaSpEx1DCal),
+                           stats.median,
                            pilTrnGetComment("DataMedian"));
   
     updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1DCal->descs),
@@ -1515,31 +1520,33 @@ vmmoscombine(PilSetOfFrames *sof)
                          pilTrnGetComment("NFramesCombined"),
                          "ESO*", 1);
 
+  imageStatistics(outSpSkyExStack[0], &stats);
+
   updateOK = updateOK && insertDoubleDescriptor(&(outSpSkyExStack[0]->descs),
                          pilTrnGetKeyword("DataMin"),
-                         imageMinimum(outSpSkyExStack[0]),
+                         stats.minimum,
                          pilTrnGetComment("DataMin"), 
                          "ESO*", 1);
   
   updateOK = updateOK && insertDoubleDescriptor(&(outSpSkyExStack[0]->descs),
                          pilTrnGetKeyword("DataMax"),
-                         imageMaximum(outSpSkyExStack[0]),
+                         stats.maximum,
                          pilTrnGetComment("DataMax"), 
                          "ESO*", 1);
   
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyExStack[0]->descs),
                          pilTrnGetKeyword("DataMean"),
-                         imageMean(outSpSkyExStack[0]),
+                         stats.mean,
                          pilTrnGetComment("DataMean"));
   
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyExStack[0]->descs),
                          pilTrnGetKeyword("DataStdDeviation"),
-                         imageSigma(outSpSkyExStack[0]),
+                         stats.sigma,
                          pilTrnGetComment("DataStdDeviation"));
   
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyExStack[0]->descs),
                          pilTrnGetKeyword("DataMedian"),
-                         imageMedian(outSpSkyExStack[0]),
+                         stats.median,
                          pilTrnGetComment("DataMedian"));
   
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyExStack[0]->descs),
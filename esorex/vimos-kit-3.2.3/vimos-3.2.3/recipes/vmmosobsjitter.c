@@ -978,6 +978,7 @@ vmmosobsjitter(PilSetOfFrames *sof)
   char                   tmpName[PATHNAME_MAX + 1];
 
   VimosBool              updateOK = VM_TRUE;
+  VimosImageStats        stats;
 
   unsigned int           cleanBadPixel;
   unsigned int           calibrateFlux;
@@ -2745,31 +2746,33 @@ vmmosobsjitter(PilSetOfFrames *sof)
                          pilTrnGetComment("NFramesCombined"),
                          "ESO*", 1);
 
+  imageStatistics(imaSpEx1D[0], &stats);
+
   updateOK = updateOK && insertDoubleDescriptor(&(imaSpEx1D[0]->descs),
                          pilTrnGetKeyword("DataMin"),
-                         imageMinimum(imaSpEx1D[0]),
+                         stats.minimum,
                          pilTrnGetComment("DataMin"), 
                          "ESO*", 1);
   
   updateOK = updateOK && insertDoubleDescriptor(&(imaSpEx1D[0]->descs),
                          pilTrnGetKeyword("DataMax"),
-                         imageMaximum(imaSpEx1D[0]),
+                         stats.maximum,
                          pilTrnGetComment("DataMax"), 
                          "ESO*", 1);
   
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1D[0]->descs),
                          pilTrnGetKeyword("DataMean"),
-                         imageMean(imaSpEx1D[0]),
+                         stats.mean,
                          pilTrnGetComment("DataMean"));
   
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1D[0]->descs),
                          pilTrnGetKeyword("DataStdDeviation"),
-                         imageSigma(imaSpEx1D[0]),
+                         stats.sigma,
                          pilTrnGetComment("DataStdDeviation"));
   
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1D[0]->descs),
                          pilTrnGetKeyword("DataMedian"),
-                         imageMedian(imaSpEx1D[0]),
+                         stats.median,
                          pilTrnGetComment("DataMedian")); 
   
 /*
@@ -2869,31 +2872,33 @@ vmmosobsjitter(PilSetOfFrames *sof)
                            pilTrnGetComment("NFramesCombined"),
                            "ESO*", 1);
 
+    imageStatistics(imaSpEx1DCal, &stats);
+
     updateOK = updateOK && insertDoubleDescriptor(&(imaSpEx1DCal->descs),
                            pilTrnGetKeyword("DataMin"),
-                           imageMinimum(imaSpEx1DCal),
+                           stats.minimum,
                            pilTrnGetComment("DataMin"),
                            "ESO*", 1);
 
     updateOK = updateOK && insertDoubleDescriptor(&(imaSpEx1DCal->descs),
                            pilTrnGetKeyword("DataMax"),
-                           imageMaximum(imaSpEx1DCal),
+                           stats.maximum,
                            pilTrnGetComment("DataMax"),
                            "ESO*", 1);
 
     updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1DCal->descs),
                            pilTrnGetKeyword("DataMean"),
-                           imageMean(imaSpEx1DCal),
+                           stats.mean,
                            pilTrnGetComment("DataMean"));
 
     updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1DCal->descs),
                            pilTrnGetKeyword("DataStdDeviation"),
-                           imageSigma(imaSpEx1DCal),
+                           stats.sigma,
                            pilTrnGetComment("DataStdDeviation"));
 
     updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1DCal->descs),
                            pilTrnGetKeyword("DataMedian"),
-                           imageMedian(imaSpEx1DCal),
+                           stats.median,
                            pilTrnGetComment("DataMedian"));
 
     updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1DCal->descs),
@@ -2987,31 +2992,33 @@ vmmosobsjitter(PilSetOfFrames *sof)
                          pilTrnGetComment("NFramesCombined"),
                          "ESO*", 1);
 
+  imageStatistics(outSpSkyExStack[0], &stats);
+
   updateOK = updateOK && insertDoubleDescriptor(&(outSpSkyExStack[0]->descs),
                          pilTrnGetKeyword("DataMin"),
-                         imageMinimum(outSpSkyExStack[0]),
+                         stats.minimum,
                          pilTrnGetComment("DataMin"), 
                          "ESO*", 1);
   
   updateOK = updateOK && insertDoubleDescriptor(&(outSpSkyExStack[0]->descs),
                          pilTrnGetKeyword("DataMax"),
-                         imageMaximum(outSpSkyExStack[0]),
+                         stats.maximum,
                          pilTrnGetComment("DataMax"), 
                          "ESO*", 1);
   
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyExStack[0]->descs),
                          pilTrnGetKeyword("DataMean"),
-                         imageMean(outSpSkyExStack[0]),
+                         stats.mean,
                          pilTrnGetComment("DataMean"));
   
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyExStack[0]->descs),
                          pilTrnGetKeyword("DataStdDeviation"),
-                         imageSigma(outSpSkyExStack[0]),
+                         stats.sigma,
                          pilTrnGetComment("DataStdDeviation"));
   
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyExStack[0]->descs),
                          pilTrnGetKeyword("DataMedian"),
-                         imageMedian(outSpSkyExStack[0]),
+                         stats.median,
                          pilTrnGetComment("DataMedian"));
   
 /*
@@ -3107,31 +3114,33 @@ vmmosobsjitter(PilSetOfFrames *sof)
                          pilTrnGetComment("NFramesCombined"),
                          "ESO*", 1);
 
+  imageStatistics(outSpSkyExStack[1], &stats);
+
   updateOK = updateOK && insertDoubleDescriptor(&(outSpSkyExStack[1]->descs),
                          pilTrnGetKeyword("DataMin"),
-                         imageMinimum(outSpSkyExStack[1]),
+                         stats.minimum,
                          pilTrnGetComment("DataMin"), 
                          "ESO*", 1);
 
   updateOK = updateOK && insertDoubleDescriptor(&(outSpSkyExStack[1]->descs),
                          pilTrnGetKeyword("DataMax"),
-                         imageMaximum(outSpSkyExStack[1]),
+                         stats.maximum,
                          pilTrnGetComment("DataMax"), 
                          "ESO*", 1);
 
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyExStack[1]->descs),
                          pilTrnGetKeyword("DataMean"),
-                         imageMean(outSpSkyExStack[1]),
+                         stats.mean,
                          pilTrnGetComment("DataMean"));
 
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyExStack[1]->descs),
                          pilTrnGetKeyword("DataStdDeviation"),
-                         imageSigma(outSpSkyExStack[1]),
+                         stats.sigma,
                          pilTrnGetComment("DataStdDeviation"));
 
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyExStack[1]->descs),
                          pilTrnGetKeyword("DataMedian"),
-                         imageMedian(outSpSkyExStack[1]),
+                         stats.median,
                          pilTrnGetComment("DataMedian"));
 
 /*
@@ -3317,31 +3326,33 @@ vmmosobsjitter(PilSetOfFrames *sof)
                          pilTrnGetComment("NFramesCombined"),
                          "ESO*", 1);
   
+  imageStatistics(imaSpEx1D[1], &stats);
+
   updateOK = updateOK && insertDoubleDescriptor(&(imaSpEx1D[1]->descs),
                          pilTrnGetKeyword("DataMin"),
-                         imageMinimum(imaSpEx1D[1]),
+                         stats.minimum,
                          pilTrnGetComment("DataMin"),
                          "ESO*", 1);
   
   updateOK = updateOK && insertDoubleDescriptor(&(imaSpEx1D[1]->descs),
                          pilTrnGetKeyword("DataMax"),
-                         imageMaximum(imaSpEx1D[1]),
+                         stats.maximum,
                          pilTrnGetComment("DataMax"),
                          "ESO*", 1);
   
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1D[1]->descs),
                          pilTrnGetKeyword("DataMean"),
-                         imageMean(imaSpEx1D[1]),
+                         stats.mean,
                          pilTrnGetComment("DataMean"));
 
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1D[1]->descs),
                          pilTrnGetKeyword("DataStdDeviation"),
-                         imageSigma(imaSpEx1D[1]),
+                         stats.sigma,
                          pilTrnGetComment("DataStdDeviation"));
 
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1D[1]->descs),
                          pilTrnGetKeyword("DataMedian"),
-                         imageMedian(imaSpEx1D[1]),
+                         stats.median,
                          pilTrnGetComment("DataMedian"));
 
 /*
@@ -3437,31 +3448,33 @@ vmmosobsjitter(PilSetOfFrames *sof)
                            pilTrnGetComment("NFramesCombined"),
                            "ESO*", 1);
 
+    imageStatistics(tmpImage, &stats);
+
     updateOK = updateOK && insertDoubleDescriptor(&(tmpImage->descs),
                            pilTrnGetKeyword("DataMin"),
-                           imageMinimum(tmpImage),
+                           stats.minimum,
                            pilTrnGetComment("DataMin"),
                            "ESO*", 1);
 
     updateOK = updateOK && insertDoubleDescriptor(&(tmpImage->descs),
                            pilTrnGetKeyword("DataMax"),
-                           imageMaximum(tmpImage),
+                           stats.maximum,
                            pilTrnGetComment("DataMax"),
                            "ESO*", 1);
 
     updateOK = updateOK && writeDoubleDescriptor(&(tmpImage->descs),
                            pilTrnGetKeyword("DataMean"),
-                           imageMean(tmpImage),
+                           stats.mean,
                            pilTrnGetComment("DataMean"));
 
     updateOK = updateOK && writeDoubleDescriptor(&(tmpImage->descs),
                            pilTrnGetKeyword("DataStdDeviation"),
-                           imageSigma(tmpImage),
+                           stats.sigma,
                            pilTrnGetComment("DataStdDeviation"));
   
     updateOK = updateOK && writeDoubleDescriptor(&(tmpImage->descs),
                            pilTrnGetKeyword("DataMedian"),
-                           imageMedian(tmpImage),
+                           stats.median,
                            pilTrnGetComment("DataMedian"));
 
     updateOK = updateOK && insertStringDescriptor(&(tmpImage->descs),
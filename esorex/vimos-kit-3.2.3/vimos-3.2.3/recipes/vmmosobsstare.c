@@ -707,6 +707,7 @@ vmmosobsstare(PilSetOfFrames *sof)
   char           windowTableName[PATHNAME_MAX + 1];
 
   VimosBool      updateOK = VM_TRUE;
+  VimosImageStats stats;
 
   unsigned int   cleanBadPixel;
   unsigned int   calibrateFlux;
@@ -1679,29 +1680,31 @@ vmmosobsstare(PilSetOfFrames *sof)
    */
 
 
+  imageStatistics(imaSpEx1D[0], &stats);
+
   updateOK = updateOK && insertDoubleDescriptor(&(imaSpEx1D[0]->descs),
                          pilTrnGetKeyword("DataMin"),
-                         imageMinimum(imaSpEx1D[0]),
+                         stats.minimum,
                          "Minimum pixel value", "ESO*", 1);
 
   updateOK = updateOK && insertDoubleDescriptor(&(imaSpEx1D[0]->descs),
                          pilTrnGetKeyword("DataMax"),
-                         imageMaximum(imaSpEx1D[0]),
+                         stats.maximum,
                          "Maximum pixel value", "ESO*", 1);
 
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1D[0]->descs),
                          pilTrnGetKeyword("DataMean"),
-                         imageMean(imaSpEx1D[0]),
+                         stats.mean,
                          "Mean pixel value");
 
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1D[0]->descs),
                          pilTrnGetKeyword("DataStdDeviation"),
-                         imageSigma(imaSpEx1D[0]),
+                         stats.sigma,
                          "Standard deviation of pixel values");
 
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1D[0]->descs),
                          pilTrnGetKeyword("DataMedian"),
-                         imageMedian(imaSpEx1D[0]),
+                         stats.median,
                          "Median pixel value");
 
 
@@ -1783,29 +1786,31 @@ vmmosobsstare(PilSetOfFrames *sof)
                            pilTrnGetComment("ExposureTime"),
                            "ESO*", 1);
 
+    imageStatistics(imaSpEx1DCal, &stats);
+
     updateOK = updateOK && insertDoubleDescriptor(&(imaSpEx1DCal->descs),
                            pilTrnGetKeyword("DataMin"),
-                           imageMinimum(imaSpEx1DCal),
+                           stats.minimum,
                            "Minimum pixel value", "ESO*", 1);
 
     updateOK = updateOK && insertDoubleDescriptor(&(imaSpEx1DCal->descs),
                            pilTrnGetKeyword("DataMax"),
-                           imageMaximum(imaSpEx1DCal),
+                           stats.maximum,
                            "Maximum pixel value", "ESO*", 1);
 
     updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1DCal->descs),
                            pilTrnGetKeyword("DataMean"),
-                           imageMean(imaSpEx1DCal),
+                           stats.mean,
                            "Mean pixel value");
 
     updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1DCal->descs),
                            pilTrnGetKeyword("DataStdDeviation"),
-                           imageSigma(imaSpEx1DCal),
+                           stats.sigma,
                            "Standard deviation of pixel values");
 
     updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1DCal->descs),
                            pilTrnGetKeyword("DataMedian"),
-                           imageMedian(imaSpEx1DCal),
+                           stats.median,
                            "Median pixel value");
 
     updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1DCal->descs),
@@ -1882,29 +1887,31 @@ vmmosobsstare(PilSetOfFrames *sof)
   }
 
 
+  imageStatistics(outSpSkyEx[0], &stats);
+
   updateOK = updateOK && insertDoubleDescriptor(&(outSpSkyEx[0]->descs),
                          pilTrnGetKeyword("DataMin"),
-                         imageMinimum(outSpSkyEx[0]),
+                         stats.minimum,
                          "Minimum pixel value", "ESO*", 1);
 
   updateOK = updateOK && insertDoubleDescriptor(&(outSpSkyEx[0]->descs),
                          pilTrnGetKeyword("DataMax"),
-                         imageMaximum(outSpSkyEx[0]),
+                         stats.maximum,
                          "Maximum pixel value", "ESO*", 1);
 
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyEx[0]->descs),
                          pilTrnGetKeyword("DataMean"),
-                         imageMean(outSpSkyEx[0]),
+                         stats.mean,
                          "Mean pixel value");
 
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyEx[0]->descs),
                          pilTrnGetKeyword("DataStdDeviation"),
-                         imageSigma(outSpSkyEx[0]),
+                         stats.sigma,
                          "Standard deviation of pixel values");
 
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyEx[0]->descs),
                          pilTrnGetKeyword("DataMedian"),
-                         imageMedian(outSpSkyEx[0]),
+                         stats.median,
                          "Median pixel value");
 
 
@@ -1974,29 +1981,31 @@ vmmosobsstare(PilSetOfFrames *sof)
   deleteImage(outSpSkyEx[0]);
 
 
+  imageStatistics(outSpSkyEx[1], &stats);
+
   updateOK = updateOK && insertDoubleDescriptor(&(outSpSkyEx[1]->descs),
                          pilTrnGetKeyword("DataMin"),
-                         imageMinimum(outSpSkyEx[1]),
+                         stats.minimum,
                          "Minimum pixel value", "ESO*", 1);
 
   updateOK = updateOK && insertDoubleDescriptor(&(outSpSkyEx[1]->descs),
                          pilTrnGetKeyword("DataMax"),
-                         imageMaximum(outSpSkyEx[1]),
+                         stats.maximum,
                          "Maximum pixel value", "ESO*", 1);
 
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyEx[1]->descs),
                          pilTrnGetKeyword("DataMean"),
-                         imageMean(outSpSkyEx[1]),
+                         stats.mean,
                          "Mean pixel value");
 
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyEx[1]->descs),
                          pilTrnGetKeyword("DataStdDeviation"),
-                         imageSigma(outSpSkyEx[1]),
+                         stats.sigma,
                          "Standard deviation of pixel values");
 
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyEx[1]->descs),
                          pilTrnGetKeyword("DataMedian"),
-                         imageMedian(outSpSkyEx[1]),
+                         stats.median,
                          "Median pixel value");
 
 
@@ -2153,29 +2162,31 @@ vmmosobsstare(PilSetOfFrames *sof)
     return EXIT_FAILURE;
   }
 
+  imageStatistics(imaSpEx1D[1], &stats);
+
   updateOK = updateOK && insertDoubleDescriptor(&(imaSpEx1D[1]->descs),
                          pilTrnGetKeyword("DataMin"), 
-                         imageMinimum(imaSpEx1D[1]),
+                         stats.minimum,
                          "Minimum pixel value", "ESO*", 1);
 
   updateOK = updateOK && insertDoubleDescriptor(&(imaSpEx1D[1]->descs),
                          pilTrnGetKeyword("DataMax"),
-                         imageMaximum(imaSpEx1D[1]),
+                         stats.maximum,
                          "Maximum pixel value", "ESO*", 1);
 
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1D[1]->descs),
                          pilTrnGetKeyword("DataMean"),
-                         imageMean(imaSpEx1D[1]),
+                         stats.mean,
                          "Mean pixel value");
 
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1D[1]->descs),
                          pilTrnGetKeyword("DataStdDeviation"),
-                         imageSigma(imaSpEx1D[1]),
+                         stats.sigma,
                          "Standard deviation of pixel values");
 
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1D[1]->descs),
                          pilTrnGetKeyword("DataMedian"),
-                         imageMedian(imaSpEx1D[1]),
+                         stats.median,
                          "Median pixel value");
 
   updateOK = updateOK && insertStringDescriptor(&(imaSpEx1D[1]->descs),
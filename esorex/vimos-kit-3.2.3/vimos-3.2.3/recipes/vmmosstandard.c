@@ -744,6 +744,7 @@ vmmosstandard(PilSetOfFrames *sof)
   char           parName[30]; 
 
   VimosBool      updateOK = VM_TRUE;
+  VimosImageStats stats;
 
   unsigned int   computeQC;
   unsigned int   cleanBadPixel;
@@ -2195,29 +2196,31 @@ vmmosstandard(PilSetOfFrames *sof)
    * This may change in future!
    */
 
+  imageStatistics(imaSpEx1DCal, &stats);
+
   updateOK = updateOK && insertDoubleDescriptor(&(imaSpEx1DCal->descs),
                          pilTrnGetKeyword("DataMin"),
-                         imageMinimum(imaSpEx1DCal),
+                         stats.minimum,
                          "Minimum pixel value", "ESO*", 1);
 
   updateOK = updateOK && insertDoubleDescriptor(&(imaSpEx1DCal->descs),
                          pilTrnGetKeyword("DataMax"),
-                         imageMaximum(imaSpEx1DCal),
+                         stats.maximum,
                          "Maximum pixel value", "ESO*", 1);
 
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1DCal->descs),
                          pilTrnGetKeyword("DataMean"),
-                         imageMean(imaSpEx1DCal),
+                         stats.mean,
                          "Mean pixel value");
 
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1DCal->descs),
                          pilTrnGetKeyword("DataStdDeviation"),
-                         imageSigma(imaSpEx1DCal),
+                         stats.sigma,
                          "Standard deviation of pixel values");
 
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1DCal->descs),
                          pilTrnGetKeyword("DataMedian"),
-                         imageMedian(imaSpEx1DCal),
+                         stats.median,
                          "Median pixel value");
 
   updateOK = updateOK && insertStringDescriptor(&(imaSpEx1DCal->descs),
@@ -2290,29 +2293,31 @@ vmmosstandard(PilSetOfFrames *sof)
   deleteImage(imaSpEx1DCal);
 
 
+  imageStatistics(outSpSkyEx[0], &stats);
+
   updateOK = updateOK && insertDoubleDescriptor(&(outSpSkyEx[0]->descs),
                          pilTrnGetKeyword("DataMin"),
-                         imageMinimum(outSpSkyEx[0]),
+                         stats.minimum,
                          "Minimum pixel value", "ESO*", 1);
 
   updateOK = updateOK && insertDoubleDescriptor(&(outSpSkyEx[0]->descs),
                          pilTrnGetKeyword("DataMax"),
-                         imageMaximum(outSpSkyEx[0]),
+                         stats.maximum,
                          "Maximum pixel value", "ESO*", 1);
 
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyEx[0]->descs),
                          pilTrnGetKeyword("DataMean"),
-                         imageMean(outSpSkyEx[0]),
+                         stats.mean,
                          "Mean pixel value");
 
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyEx[0]->descs),
                          pilTrnGetKeyword("DataStdDeviation"),
-                         imageSigma(outSpSkyEx[0]),
+                         stats.sigma,
                          "Standard deviation of pixel values");
 
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyEx[0]->descs),
                          pilTrnGetKeyword("DataMedian"),
-                         imageMedian(outSpSkyEx[0]),
+                         stats.median,
                          "Median pixel value");
 
 
@@ -2384,29 +2389,31 @@ vmmosstandard(PilSetOfFrames *sof)
   deleteImage(outSpSkyEx[0]);
 
 
+  imageStatistics(outSpSkyEx[1], &stats);
+
   updateOK = updateOK && insertDoubleDescriptor(&(outSpSkyEx[1]->descs),
                          pilTrnGetKeyword("DataMin"),
-                         imageMinimum(outSpSkyEx[1]),
+                         stats.minimum,
                          "Minimum pixel value", "ESO*", 1);
 
   updateOK = updateOK && insertDoubleDescriptor(&(outSpSkyEx[1]->descs),
                          pilTrnGetKeyword("DataMax"),
-                         imageMaximum(outSpSkyEx[1]),
+                         stats.maximum,
                          "Maximum pixel value", "ESO*", 1);
 
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyEx[1]->descs),
                          pilTrnGetKeyword("DataMean"),
-                         imageMean(outSpSkyEx[1]),
+                         stats.mean,
                          "Mean pixel value");
 
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyEx[1]->descs),
                          pilTrnGetKeyword("DataStdDeviation"),
-                         imageSigma(outSpSkyEx[1]),
+                         stats.sigma,
                          "Standard deviation of pixel values");
 
   updateOK = updateOK && writeDoubleDescriptor(&(outSpSkyEx[1]->descs),
                          pilTrnGetKeyword("DataMedian"),
-                         imageMedian(outSpSkyEx[1]),
+                         stats.median,
                          "Median pixel value");
 
 
@@ -2566,29 +2573,31 @@ vmmosstandard(PilSetOfFrames *sof)
     return EXIT_FAILURE;
   }
 
+  imageStatistics(imaSpEx1D[1], &stats);
+
   updateOK = updateOK && insertDoubleDescriptor(&(imaSpEx1D[1]->descs),
                          pilTrnGetKeyword("DataMin"), 
-                         imageMinimum(imaSpEx1D[1]),
+                         stats.minimum,
                          "Minimum pixel value", "ESO*", 1);
 
   updateOK = updateOK && insertDoubleDescriptor(&(imaSpEx1D[1]->descs),
                          pilTrnGetKeyword("DataMax"),
-                         imageMaximum(imaSpEx1D[1]),
+                         stats.maximum,
                          "Maximum pixel value", "ESO*", 1);
 
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1D[1]->descs),
                          pilTrnGetKeyword("DataMean"),
-                         imageMean(imaSpEx1D[1]),
+                         stats.mean,
                          "Mean pixel value");
 
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1D[1]->descs),
                          pilTrnGetKeyword("DataStdDeviation"),
-                         imageSigma(imaSpEx1D[1]),
+                         stats.sigma,
                          "Standard deviation of pixel values");
 
   updateOK = updateOK && writeDoubleDescriptor(&(imaSpEx1D[1]->descs),
                          pilTrnGetKeyword("DataMedian"),
-                         imageMedian(imaSpEx1D[1]),
+                         stats.median,
                          "Median pixel value");
 
   updateOK = updateOK && insertStringDescriptor(&(imaSpEx1D[1]->descs),
@@ -1044,6 +1044,7 @@ vmskyccd(PilSetOfFrames *sof)
   VimosImage *resizedBias = 0;
   VimosImage *rawImageBS = 0, *rawImageDK = 0, *rawImageFF = 0;
   VimosImage *astFile;
+  VimosImageStats stats;
 
   VimosTable  *starMatchTable;
   VimosTable *ccdTable = 0;
@@ -2241,23 +2242,25 @@ skip:
   * Reduced image
   */
 
+  imageStatistics(rawImageFF, &stats);
+
   productTag = reducedTag;
   vmstrlower(strcpy(productName, productTag));
   strcat(productName, ".fits");
   insertDoubleDescriptor(&rawImageFF->descs, pilTrnGetKeyword("DataMin"),
-                         imageMinimum(rawImageFF), pilTrnGetComment("DataMin"),
+                         stats.minimum, pilTrnGetComment("DataMin"),
                          "ESO*", 1);
   insertDoubleDescriptor(&rawImageFF->descs, pilTrnGetKeyword("DataMax"),
-                         imageMaximum(rawImageFF), pilTrnGetComment("DataMax"),
+                         stats.maximum, pilTrnGetComment("DataMax"),
                          "ESO*", 1);
   writeDoubleDescriptor(&rawImageFF->descs, pilTrnGetKeyword("DataMean"),
-                        imageMean(rawImageFF), pilTrnGetComment("DataMean"));
+                        stats.mean, pilTrnGetComment("DataMean"));
   writeDoubleDescriptor(&rawImageFF->descs,
                         pilTrnGetKeyword("DataStdDeviation"), 
-                        imageSigma(rawImageFF), 
+                        stats.sigma, 
                         pilTrnGetComment("DataStdDeviation"));
   writeDoubleDescriptor(&rawImageFF->descs, pilTrnGetKeyword("DataMedian"),
-                        imageMedian(rawImageFF),
+                        stats.median,
                         pilTrnGetComment("DataMedian"));
   writeIntDescriptor(&rawImageFF->descs, pilTrnGetKeyword("MatchNstars"),
                      numStars,
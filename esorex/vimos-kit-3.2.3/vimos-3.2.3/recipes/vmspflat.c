@@ -745,6 +745,7 @@ vmspflat(PilSetOfFrames *sof)
   char        comment[MAX_COMMENT_LENGTH];
 
   VimosBool   updateOK           = VM_TRUE;
+  VimosImageStats stats;
 
   int         flatCount, mosFlatCount, ifuFlatCount;
   int         minFrames;
@@ -2486,29 +2487,31 @@ vmspflat(PilSetOfFrames *sof)
   * Normalized master flat field first:
   */
 
+  imageStatistics(masterFlat, &stats);
+
   updateOK = updateOK && insertDoubleDescriptor(&(masterFlat->descs),
                          pilTrnGetKeyword("DataMin"),
-                         imageMinimum(masterFlat),
+                         stats.minimum,
                          "Minimum pixel value", "ESO*", 1);
 
   updateOK = updateOK && insertDoubleDescriptor(&(masterFlat->descs),
                          pilTrnGetKeyword("DataMax"),
-                         imageMaximum(masterFlat),
+                         stats.maximum,
                          "Maximum pixel value", "ESO*", 1);
 
   updateOK = updateOK && writeDoubleDescriptor(&(masterFlat->descs),
                          pilTrnGetKeyword("DataMean"),
-                         imageMean(masterFlat),
+                         stats.mean,
                          "Mean pixel value");
 
   updateOK = updateOK && writeDoubleDescriptor(&(masterFlat->descs),
                          pilTrnGetKeyword("DataStdDeviation"),
-                         imageSigma(masterFlat),
+                         stats.sigma,
                          "Standard deviation of pixel values");
 
   updateOK = updateOK && writeDoubleDescriptor(&(masterFlat->descs),
                          pilTrnGetKeyword("DataMedian"),
-                         imageMedian(masterFlat),
+                         stats.median,
                          "Median pixel value");
 
   updateOK = updateOK && writeIntDescriptor(&(masterFlat->descs),
@@ -2549,29 +2552,31 @@ vmspflat(PilSetOfFrames *sof)
     * NOT-normalized master flat field first:
     */
 
+    imageStatistics(stackImages[0], &stats);
+
     updateOK = updateOK && insertDoubleDescriptor(&(stackImages[0]->descs),
                            pilTrnGetKeyword("DataMin"),
-                           imageMinimum(stackImages[0]),
+                           stats.minimum,
                            "Minimum pixel value", "ESO*", 1);
   
     updateOK = updateOK && insertDoubleDescriptor(&(stackImages[0]->descs),
                            pilTrnGetKeyword("DataMax"),
-                           imageMaximum(stackImages[0]),
+                           stats.maximum,
                            "Maximum pixel value", "ESO*", 1);
   
     updateOK = updateOK && writeDoubleDescriptor(&(stackImages[0]->descs),
                            pilTrnGetKeyword("DataMean"),
-                           imageMean(stackImages[0]),
+                           stats.mean,
                            "Mean pixel value");
   
     updateOK = updateOK && writeDoubleDescriptor(&(stackImages[0]->descs),
                            pilTrnGetKeyword("DataStdDeviation"),
-                           imageSigma(stackImages[0]),
+                           stats.sigma,
                            "Standard deviation of pixel values");
   
     updateOK = updateOK && writeDoubleDescriptor(&(stackImages[0]->descs),
                            pilTrnGetKeyword("DataMedian"),
-                           imageMedian(stackImages[0]),
+                           stats.median,
                            "Median pixel value");
 
     updateOK = updateOK && writeIntDescriptor(&(stackImages[0]->descs),
@@ -2613,29 +2618,31 @@ vmspflat(PilSetOfFrames *sof)
     * Zero order frame:
     */
 
+    imageStatistics(stackImages[1], &stats);
+
     updateOK = updateOK && insertDoubleDescriptor(&(stackImages[1]->descs),
                            pilTrnGetKeyword("DataMin"),
-                           imageMinimum(stackImages[1]),
+                           stats.minimum,
                            "Minimum pixel value", "ESO*", 1);
 
     updateOK = updateOK && insertDoubleDescriptor(&(stackImages[1]->descs),
                            pilTrnGetKeyword("DataMax"),
-                           imageMaximum(stackImages[1]),
+                           stats.maximum,
                            "Maximum pixel value", "ESO*", 1);
 
     updateOK = updateOK && writeDoubleDescriptor(&(stackImages[1]->descs),
                            pilTrnGetKeyword("DataMean"),
-                           imageMean(stackImages[1]),
+                           stats.mean,
                            "Mean pixel value");
 
     updateOK = updateOK && writeDoubleDescriptor(&(stackImages[1]->descs),
                            pilTrnGetKeyword("DataStdDeviation"),
-                           imageSigma(stackImages[1]),
+                           stats.sigma,
                            "Standard deviation of pixel values");
 
     updateOK = updateOK && writeDoubleDescriptor(&(stackImages[1]->descs),
                            pilTrnGetKeyword("DataMedian"),
-                           imageMedian(stackImages[1]),
+                           stats.median,
                            "Median pixel value");
 
     updateOK = updateOK && writeIntDescriptor(&(stackImages[1]->descs),
@@ -300,6 +300,7 @@ vmspphot(PilSetOfFrames *sof)
   char                   output1DName[PATHNAME_MAX + 1];
 
   VimosBool              updateOK = VM_TRUE;
+  VimosImageStats        stats;
 
   unsigned int           calibrateFlux;
   unsigned int           error;
@@ -622,31 +623,33 @@ vmspphot(PilSetOfFrames *sof)
                              "ESO*", 1);
     }
 
+    imageStatistics(imaList[i], &stats);
+
     updateOK = updateOK && insertDoubleDescriptor(&(imaList[i]->descs),
                            pilTrnGetKeyword("DataMin"),
-                           imageMinimum(imaList[i]),
+                           stats.minimum,
                            pilTrnGetComment("DataMin"),
                            "ESO*", 1);
 
     updateOK = updateOK && insertDoubleDescriptor(&(imaList[i]->descs),
                            pilTrnGetKeyword("DataMax"),
-                           imageMaximum(imaList[i]),
+                           stats.maximum,
                            pilTrnGetComment("DataMax"),
                            "ESO*", 1);
 
     updateOK = updateOK && writeDoubleDescriptor(&(imaList[i]->descs),
                            pilTrnGetKeyword("DataMean"),
-                           imageMean(imaList[i]),
+                           stats.mean,
                            pilTrnGetComment("DataMean"));
 
     updateOK = updateOK && writeDoubleDescriptor(&(imaList[i]->descs),
                            pilTrnGetKeyword("DataStdDeviation"),
-                           imageSigma(imaList[i]),
+                           stats.sigma,
                            pilTrnGetComment("DataStdDeviation"));
 
     updateOK = updateOK && writeDoubleDescriptor(&(imaList[i]->descs),
                            pilTrnGetKeyword("DataMedian"),
-                           imageMedian(imaList[i]),
+                           stats.median,
                            pilTrnGetComment("DataMedian"));
   
     updateOK = updateOK && writeDoubleDescriptor(&(imaList[i]->descs),
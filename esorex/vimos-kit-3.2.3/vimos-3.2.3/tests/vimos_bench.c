@@ -0,0 +1,1024 @@
+/* $Id: vimos_bench.c,v 1.1 2016-05-18 09:12:40 cgarcia Exp $
+ *
+ * This file is part of the VIMOS Pipeline
+ * Copyright (C) 2002-2016 European Southern Observatory
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#define _DEFAULT_SOURCE /* wait4(), for the resource usage of one child */
+
+/*-----------------------------------------------------------------------------
+                                Includes
+ -----------------------------------------------------------------------------*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <dlfcn.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include <cpl.h>
+
+/*----------------------------------------------------------------------------*/
+/**
+ * @defgroup vimos_bench End-to-end performance benchmark of the recipes
+ *
+ * The benchmark generates a set of synthetic raw frames for one VIMOS
+ * quadrant (bias, screen flats, arc lamp and science exposures, in both
+ * IFU and MOS mode), and runs the recipes vmbias, vmifucalib, vmifuscience,
+ * vmifucombinecube, vmmoscalib and vmmosscience on them through the CPL
+ * plugin interface, feeding the products of each step to the following
+ * ones. Each recipe is executed in a child process so that its wall time
+ * and its peak resident memory can be measured separately.
+ *
+ * The results (status, wall time, peak memory, and the DATAMD5 of every
+ * product) are compared with a baseline file: any change in a product
+ * checksum, or any slowdown larger than the given tolerance, is reported
+ * as a regression.
+ *
+ * Usage:
+ * @code
+ *   vimos_bench [--plugindir DIR] [--caldir DIR] [--workdir DIR]
+ *               [--baseline FILE] [--update] [--tolerance FRACTION]
+ *               [--recipes NAME,NAME,...]
+ * @endcode
+ */
+/*----------------------------------------------------------------------------*/
+
+/**@{*/
+
+/*-----------------------------------------------------------------------------
+                                Defines
+ -----------------------------------------------------------------------------*/
+
+#define VIMOS_BENCH_NX          2148      /* Raw frame size, with pre- and */
+#define VIMOS_BENCH_NY          2440      /* overscan regions              */
+#define VIMOS_BENCH_PRSCX         50
+#define VIMOS_BENCH_OVSCX         50
+
+#define VIMOS_BENCH_BIAS_LEVEL  200.0
+#define VIMOS_BENCH_RON           3.0     /* ADU */
+#define VIMOS_BENCH_GAIN          1.9     /* e-/ADU */
+
+#define VIMOS_BENCH_NFIBERS     400       /* Fibers on one pseudo-slit    */
+#define VIMOS_BENCH_FIBER_BLOCK  80       /* Fibers per fiber module      */
+#define VIMOS_BENCH_FIBER_PITCH   5.08    /* Pixels between fibers        */
+#define VIMOS_BENCH_FIBER_SIGMA   1.2     /* Fiber profile sigma (pixels) */
+
+#define VIMOS_BENCH_NSLITS       24       /* MOS slits on the mask        */
+
+#define VIMOS_BENCH_LAMBDA0    4800.0     /* Wavelength at first row (MR) */
+#define VIMOS_BENCH_DISPERSION    2.5     /* Angstrom per pixel           */
+#define VIMOS_BENCH_LINE_SIGMA    1.3     /* Line profile sigma (pixels)  */
+
+#define VIMOS_BENCH_NBIAS         5
+#define VIMOS_BENCH_NFLAT         3
+
+#define VIMOS_BENCH_MAX_TAGS      8
+#define VIMOS_BENCH_MAX_PRODUCTS 64
+
+/*-----------------------------------------------------------------------------
+                            Structure definitions
+ -----------------------------------------------------------------------------*/
+
+/*
+ * One step of the reduction chain: the frames with the listed tags are
+ * taken from the pool of available frames (raw, static calibrations, and
+ * products of the previous steps). A step is skipped if any of its
+ * required tags is not available.
+ */
+
+typedef struct _vimos_bench_step_ {
+    const char *recipe;
+    const char *required[VIMOS_BENCH_MAX_TAGS];
+    const char *optional[VIMOS_BENCH_MAX_TAGS];
+} vimos_bench_step;
+
+typedef struct _vimos_bench_result_ {
+    const char *recipe;
+    const char *status;
+    double      walltime;
+    long        maxrss;
+    int         nproducts;
+    char        tag[VIMOS_BENCH_MAX_PRODUCTS][64];
+    char        md5[VIMOS_BENCH_MAX_PRODUCTS][64];
+} vimos_bench_result;
+
+static const vimos_bench_step vimos_bench_chain[] = {
+    {"vmbias",
+     {"BIAS", NULL},
+     {NULL}},
+    {"vmifucalib",
+     {"IFU_SCREEN_FLAT", "IFU_ARC_SPECTRUM", "LINE_CATALOG", "MASTER_BIAS",
+      NULL},
+     {"IFU_IDENT", "CCD_TABLE", NULL}},
+    {"vmifuscience",
+     {"IFU_SCIENCE", "MASTER_BIAS", "IFU_TRACE", "IFU_IDS",
+      "IFU_TRANSMISSION", NULL},
+     {"EXTINCT_TABLE", NULL}},
+    {"vmifucombinecube",
+     {"IFU_SCIENCE_REDUCED", NULL},
+     {NULL}},
+    {"vmmoscalib",
+     {"MOS_SCREEN_FLAT", "MOS_ARC_SPECTRUM", "MASTER_BIAS", "LINE_CATALOG",
+      NULL},
+     {"CONFIG_TABLE", NULL}},
+    {"vmmosscience",
+     {"MOS_SCIENCE", "MASTER_BIAS", "MOS_DISP_COEFF", "MOS_CURV_COEFF",
+      "MOS_SLIT_LOCATION", "EXTINCT_TABLE", NULL},
+     {"MOS_MASTER_SCREEN_FLAT", "CONFIG_TABLE", "STD_FLUX_TABLE", NULL}}
+};
+
+
+/*-----------------------------------------------------------------------------
+                            Functions prototypes
+ -----------------------------------------------------------------------------*/
+
+static double vimos_bench_gauss(void);
+static cpl_propertylist *vimos_bench_header(const char *, const char *,
+                                            const char *, const char *,
+                                            double);
+static int vimos_bench_save(cpl_image *, cpl_propertylist *, const char *,
+                            const char *, cpl_frameset *);
+static int vimos_bench_generate(const char *, cpl_frameset *);
+static int vimos_bench_run(void *, const vimos_bench_step *, cpl_frameset *,
+                           vimos_bench_result *);
+
+
+/*-----------------------------------------------------------------------------
+                                Functions code
+ -----------------------------------------------------------------------------*/
+
+/*
+ * A small deterministic random number generator (xorshift64*), so that
+ * the synthetic frames, and therefore the product checksums, do not
+ * depend on the C library implementation.
+ */
+
+static unsigned long long vimos_bench_seed = 0x9e3779b97f4a7c15ULL;
+
+static double
+vimos_bench_uniform(void)
+{
+    vimos_bench_seed ^= vimos_bench_seed >> 12;
+    vimos_bench_seed ^= vimos_bench_seed << 25;
+    vimos_bench_seed ^= vimos_bench_seed >> 27;
+
+    return ((vimos_bench_seed * 0x2545f4914f6cdd1dULL) >> 11)
+           * (1.0 / 9007199254740992.0);
+}
+
+static double
+vimos_bench_gauss(void)
+{
+    double u = vimos_bench_uniform();
+    double v = vimos_bench_uniform();
+
+    if (u < 1.e-300)
+        u = 1.e-300;
+
+    return sqrt(-2.0 * log(u)) * cos(2.0 * CPL_MATH_PI * v);
+}
+
+
+/*
+ * Header of a synthetic raw frame of quadrant 1, with the keywords that
+ * the VIMOS recipes read from the raw data.
+ */
+
+static cpl_propertylist *
+vimos_bench_header(const char *catg, const char *type, const char *tech,
+                   const char *mode, double exptime)
+{
+    cpl_propertylist *header = cpl_propertylist_new();
+    int               i;
+
+    cpl_propertylist_append_string(header, "INSTRUME", "VIMOS");
+    cpl_propertylist_append_string(header, "DATE-OBS",
+                                   "2003-06-02T03:08:10.004");
+    cpl_propertylist_append_double(header, "MJD-OBS", 52792.130671);
+    cpl_propertylist_append_double(header, "EXPTIME", exptime);
+    cpl_propertylist_append_string(header, "ARCFILE",
+                                   "VIMOS.2003-06-02T03:08:10.004.fits");
+
+    cpl_propertylist_append_string(header, "ESO DPR CATG", catg);
+    cpl_propertylist_append_string(header, "ESO DPR TYPE", type);
+    cpl_propertylist_append_string(header, "ESO DPR TECH", tech);
+    cpl_propertylist_append_int(header, "ESO TPL NEXP", 1);
+    cpl_propertylist_append_int(header, "ESO TPL EXPNO", 1);
+    cpl_propertylist_append_string(header, "ESO OBS PROG ID", "071.D-0000(A)");
+
+    cpl_propertylist_append_int(header, "ESO OCS CON QUAD", 1);
+    cpl_propertylist_append_string(header, "ESO INS MODE", mode);
+    cpl_propertylist_append_string(header, "ESO INS IFUS MODE", "ON");
+    cpl_propertylist_append_double(header, "ESO INS IFUE MAG", 0.33);
+    cpl_propertylist_append_string(header, "ESO INS GRIS1 NAME", "MR");
+    cpl_propertylist_append_string(header, "ESO INS GRIS1 ID", "vm-MR-1.2");
+    cpl_propertylist_append_string(header, "ESO INS FILT1 NAME", "GG475");
+    cpl_propertylist_append_string(header, "ESO INS FILT1 ID", "vm-GG475-1.1");
+    for (i = 1; i <= 4; i++) {
+        char *key = cpl_sprintf("ESO INS FOCU%d TEMP", i);
+        cpl_propertylist_append_double(header, key, 12.0);
+        cpl_free(key);
+    }
+    cpl_propertylist_append_string(header, "ESO ADA ABSROT START", "0.0");
+    cpl_propertylist_append_string(header, "ESO ADA ABSROT END", "0.0");
+    cpl_propertylist_append_double(header, "ESO TEL FOCU SCALE", 1.718);
+
+    cpl_propertylist_append_string(header, "ESO DET READ CLOCK",
+                                   "200kHz,1port,low gain");
+    cpl_propertylist_append_string(header, "ESO DET READ MODE", "normal");
+    cpl_propertylist_append_string(header, "ESO DET READ SPEED", "225kHz");
+    cpl_propertylist_append_int(header, "ESO DET WIN1 BINX", 1);
+    cpl_propertylist_append_int(header, "ESO DET WIN1 BINY", 1);
+    cpl_propertylist_append_int(header, "ESO DET WIN1 NX",
+                                VIMOS_BENCH_NX - VIMOS_BENCH_PRSCX
+                                               - VIMOS_BENCH_OVSCX);
+    cpl_propertylist_append_int(header, "ESO DET WIN1 NY", VIMOS_BENCH_NY);
+    cpl_propertylist_append_int(header, "ESO DET OUT1 PRSCX",
+                                VIMOS_BENCH_PRSCX);
+    cpl_propertylist_append_int(header, "ESO DET OUT1 OVSCX",
+                                VIMOS_BENCH_OVSCX);
+    cpl_propertylist_append_int(header, "ESO DET OUT1 PRSCY", 0);
+    cpl_propertylist_append_int(header, "ESO DET OUT1 OVSCY", 0);
+    cpl_propertylist_append_double(header, "ESO DET OUT1 CONAD",
+                                   VIMOS_BENCH_GAIN);
+    cpl_propertylist_append_double(header, "ESO DET OUT1 GAIN",
+                                   1.0 / VIMOS_BENCH_GAIN);
+    cpl_propertylist_append_double(header, "ESO DET OUT1 RON",
+                                   VIMOS_BENCH_RON * VIMOS_BENCH_GAIN);
+
+    return header;
+}
+
+
+/*
+ * Save a synthetic frame as 16-bit raw data, and register it in the
+ * frameset with the given tag.
+ */
+
+static int
+vimos_bench_save(cpl_image *image, cpl_propertylist *header,
+                 const char *filename, const char *tag, cpl_frameset *frames)
+{
+    cpl_frame *frame;
+
+    if (cpl_image_save(image, filename, CPL_TYPE_USHORT, header,
+                       CPL_IO_CREATE) != CPL_ERROR_NONE)
+        return 1;
+
+    frame = cpl_frame_new();
+    cpl_frame_set_filename(frame, filename);
+    cpl_frame_set_tag(frame, tag);
+    cpl_frame_set_type(frame, CPL_FRAME_TYPE_IMAGE);
+    cpl_frame_set_group(frame, CPL_FRAME_GROUP_RAW);
+    cpl_frameset_insert(frames, frame);
+
+    return 0;
+}
+
+
+/*
+ * Add bias level, readout noise and photon noise to an image of
+ * expected electron counts in the exposed area.
+ */
+
+static void
+vimos_bench_expose(cpl_image *image, const float *signal)
+{
+    float *data = cpl_image_get_data_float(image);
+    int    nx   = VIMOS_BENCH_NX - VIMOS_BENCH_PRSCX - VIMOS_BENCH_OVSCX;
+    int    i, j;
+
+    for (j = 0; j < VIMOS_BENCH_NY; j++) {
+        for (i = 0; i < VIMOS_BENCH_NX; i++) {
+            double value = VIMOS_BENCH_BIAS_LEVEL
+                         + VIMOS_BENCH_RON * vimos_bench_gauss();
+            int    x     = i - VIMOS_BENCH_PRSCX;
+
+            if (signal && x >= 0 && x < nx) {
+                double e = signal[x + j * nx];
+                value += (e + sqrt(e > 0.0 ? e : 0.0) * vimos_bench_gauss())
+                       / VIMOS_BENCH_GAIN;
+            }
+
+            if (value < 0.0)
+                value = 0.0;
+            if (value > 65535.0)
+                value = 65535.0;
+
+            data[i + j * VIMOS_BENCH_NX] = floor(value + 0.5);
+        }
+    }
+}
+
+
+/*
+ * Position of a fiber (or slit) centre along the spatial direction. The
+ * fibers are grouped in modules of 80, separated by small gaps, which
+ * is the pattern used by ifuIdentify() to find the block period.
+ */
+
+static double
+vimos_bench_fiber_position(int fiber)
+{
+    int block = fiber / VIMOS_BENCH_FIBER_BLOCK;
+
+    return 12.0 + fiber * VIMOS_BENCH_FIBER_PITCH + block * 2.5;
+}
+
+
+/*
+ * Accumulate on the exposed area the spectra of all fibers (IFU) or
+ * of all slits (MOS). The spectral profile is given per row, the
+ * spatial profile is Gaussian for fibers and flat for slits. The
+ * traces are slightly curved, as on real data.
+ */
+
+static void
+vimos_bench_spectra(float *signal, const double *spectrum,
+                    const double *weight, int ifu)
+{
+    int nx = VIMOS_BENCH_NX - VIMOS_BENCH_PRSCX - VIMOS_BENCH_OVSCX;
+    int nobj = ifu ? VIMOS_BENCH_NFIBERS : VIMOS_BENCH_NSLITS;
+    int k, i, j;
+
+    for (k = 0; k < nobj; k++) {
+        double x0;
+        double width;
+
+        if (ifu) {
+            x0 = vimos_bench_fiber_position(k);
+            width = 4.0 * VIMOS_BENCH_FIBER_SIGMA;
+        }
+        else {
+            x0 = 40.0 + k * (nx - 80.0) / VIMOS_BENCH_NSLITS;
+            width = 0.35 * (nx - 80.0) / VIMOS_BENCH_NSLITS;
+        }
+
+        for (j = 0; j < VIMOS_BENCH_NY; j++) {
+            double y  = (j - 0.5 * VIMOS_BENCH_NY) / VIMOS_BENCH_NY;
+            double xc = x0 + 3.0 * y * y;
+            int    i1 = (int)floor(xc - width);
+            int    i2 = (int)ceil(xc + width);
+
+            if (i1 < 0)
+                i1 = 0;
+            if (i2 >= nx)
+                i2 = nx - 1;
+
+            for (i = i1; i <= i2; i++) {
+                double d = (i - xc);
+                double p;
+
+                if (ifu)
+                    p = exp(-0.5 * d * d / (VIMOS_BENCH_FIBER_SIGMA
+                                          * VIMOS_BENCH_FIBER_SIGMA));
+                else
+                    p = fabs(d) < width ? 1.0 : 0.0;
+
+                signal[i + j * nx] += weight[k] * spectrum[j] * p;
+            }
+        }
+    }
+}
+
+
+/*
+ * Spectrum along the dispersion direction made of the lines of the
+ * catalog (arc lamp), or of a selection of them as sky emission lines,
+ * over a continuum.
+ */
+
+static void
+vimos_bench_line_spectrum(double *spectrum, const cpl_table *lines,
+                          double continuum, double scale, int step)
+{
+    cpl_size nlines = lines ? cpl_table_get_nrow(lines) : 0;
+    cpl_size n;
+    int      j;
+
+    for (j = 0; j < VIMOS_BENCH_NY; j++)
+        spectrum[j] = continuum;
+
+    for (n = 0; n < nlines; n += step) {
+        int    null;
+        double lambda = cpl_table_get(lines, "WLEN", n, &null);
+        double flux   = cpl_table_has_column(lines, "FLUX") ?
+                        cpl_table_get(lines, "FLUX", n, &null) : 1.0;
+        double yc = (lambda - VIMOS_BENCH_LAMBDA0) / VIMOS_BENCH_DISPERSION;
+        int    j1 = (int)floor(yc - 5 * VIMOS_BENCH_LINE_SIGMA);
+        int    j2 = (int)ceil(yc + 5 * VIMOS_BENCH_LINE_SIGMA);
+
+        if (null || flux <= 0.0)
+            flux = 1.0;
+
+        for (j = j1 < 0 ? 0 : j1; j <= j2 && j < VIMOS_BENCH_NY; j++) {
+            double d = (j - yc) / VIMOS_BENCH_LINE_SIGMA;
+            spectrum[j] += scale * flux * exp(-0.5 * d * d);
+        }
+    }
+}
+
+
+/*
+ * Generate all the synthetic raw frames in the current directory, and
+ * add the static calibrations found in the calibration directory.
+ */
+
+static int
+vimos_bench_generate(const char *caldir, cpl_frameset *frames)
+{
+    const char *statics[][2] = {{"lcat_MR.tfits",        "LINE_CATALOG"},
+                                {"extinct_table.tfits",  "EXTINCT_TABLE"},
+                                {"ltt7987.tfits",        "STD_FLUX_TABLE"}};
+    int         nx       = VIMOS_BENCH_NX - VIMOS_BENCH_PRSCX
+                                          - VIMOS_BENCH_OVSCX;
+    cpl_size    npix     = (cpl_size)nx * VIMOS_BENCH_NY;
+    cpl_table  *lines    = NULL;
+    cpl_image  *image;
+    float      *signal;
+    double     *spectrum;
+    double     *weight;
+    cpl_propertylist *header;
+    char       *name;
+    int         nobj;
+    int         i, k;
+
+
+    for (i = 0; i < (int)(sizeof statics / sizeof statics[0]); i++) {
+        cpl_frame *frame;
+
+        name = cpl_sprintf("%s/%s", caldir, statics[i][0]);
+        if (access(name, R_OK)) {
+            cpl_msg_warning(cpl_func, "Static calibration %s not found",
+                            name);
+            cpl_free(name);
+            continue;
+        }
+
+        frame = cpl_frame_new();
+        cpl_frame_set_filename(frame, name);
+        cpl_frame_set_tag(frame, statics[i][1]);
+        cpl_frame_set_group(frame, CPL_FRAME_GROUP_CALIB);
+        cpl_frameset_insert(frames, frame);
+
+        if (!strcmp(statics[i][1], "LINE_CATALOG"))
+            lines = cpl_table_load(name, 1, 1);
+
+        cpl_free(name);
+    }
+
+    image    = cpl_image_new(VIMOS_BENCH_NX, VIMOS_BENCH_NY, CPL_TYPE_FLOAT);
+    signal   = cpl_malloc(npix * sizeof(float));
+    spectrum = cpl_malloc(VIMOS_BENCH_NY * sizeof(double));
+    weight   = cpl_malloc(VIMOS_BENCH_NFIBERS * sizeof(double));
+
+
+    /*
+     * Bias exposures.
+     */
+
+    for (i = 0; i < VIMOS_BENCH_NBIAS; i++) {
+        header = vimos_bench_header("CALIB", "BIAS", "IMAGE", "MOS", 0.0);
+        vimos_bench_expose(image, NULL);
+        name = cpl_sprintf("bench_bias_%d.fits", i + 1);
+        vimos_bench_save(image, header, name, "BIAS", frames);
+        cpl_propertylist_delete(header);
+        cpl_free(name);
+    }
+
+
+    /*
+     * IFU and MOS exposures: screen flats, arc lamp, science. The fiber
+     * transmissions vary by a few percent, the science fibers see sky
+     * lines plus the continuum of stars of random brightness, as in a
+     * crowded field.
+     */
+
+    for (k = 0; k < 2; k++) {
+        int         ifu  = (k == 0);
+        const char *mode = ifu ? "IFU" : "MOS";
+        const char *tech = ifu ? "IFU" : "MOS";
+
+        nobj = ifu ? VIMOS_BENCH_NFIBERS : VIMOS_BENCH_NSLITS;
+
+        for (i = 0; i < nobj; i++)
+            weight[i] = 1.0 + 0.05 * vimos_bench_gauss();
+
+        for (i = 0; i < VIMOS_BENCH_NFLAT; i++) {
+            int j;
+
+            for (j = 0; j < VIMOS_BENCH_NY; j++)
+                spectrum[j] = 12000.0 * exp(-0.5 * pow((j - 1200.0) / 900.0,
+                                                       2.0));
+
+            memset(signal, 0, npix * sizeof(float));
+            vimos_bench_spectra(signal, spectrum, weight, ifu);
+            vimos_bench_expose(image, signal);
+
+            header = vimos_bench_header("CALIB", "FLAT,LAMP", tech, mode,
+                                        10.0);
+            name = cpl_sprintf("bench_%s_flat_%d.fits", ifu ? "ifu" : "mos",
+                               i + 1);
+            vimos_bench_save(image, header, name,
+                             ifu ? "IFU_SCREEN_FLAT" : "MOS_SCREEN_FLAT",
+                             frames);
+            cpl_propertylist_delete(header);
+            cpl_free(name);
+        }
+
+        vimos_bench_line_spectrum(spectrum, lines, 5.0, 30.0, 1);
+        memset(signal, 0, npix * sizeof(float));
+        vimos_bench_spectra(signal, spectrum, weight, ifu);
+        vimos_bench_expose(image, signal);
+
+        header = vimos_bench_header("CALIB", "WAVE,LAMP", tech, mode, 20.0);
+        name = cpl_sprintf("bench_%s_arc.fits", ifu ? "ifu" : "mos");
+        vimos_bench_save(image, header, name,
+                         ifu ? "IFU_ARC_SPECTRUM" : "MOS_ARC_SPECTRUM",
+                         frames);
+        cpl_propertylist_delete(header);
+        cpl_free(name);
+
+        vimos_bench_line_spectrum(spectrum, lines, 40.0, 4.0, 3);
+        memset(signal, 0, npix * sizeof(float));
+        vimos_bench_spectra(signal, spectrum, weight, ifu);
+
+        for (i = 0; i < nobj; i++) {
+            double u = vimos_bench_uniform();
+            weight[i] = 0.02 + pow(u, 6.0);
+        }
+        for (i = 0; i < VIMOS_BENCH_NY; i++)
+            spectrum[i] = 800.0;
+        vimos_bench_spectra(signal, spectrum, weight, ifu);
+        vimos_bench_expose(image, signal);
+
+        header = vimos_bench_header("SCIENCE", "OBJECT", tech, mode, 600.0);
+        name = cpl_sprintf("bench_%s_science.fits", ifu ? "ifu" : "mos");
+        vimos_bench_save(image, header, name,
+                         ifu ? "IFU_SCIENCE" : "MOS_SCIENCE", frames);
+        cpl_propertylist_delete(header);
+        cpl_free(name);
+    }
+
+    cpl_free(weight);
+    cpl_free(spectrum);
+    cpl_free(signal);
+    cpl_image_delete(image);
+    cpl_table_delete(lines);
+
+    return cpl_error_get_code() != CPL_ERROR_NONE;
+}
+
+
+/*
+ * Wall clock time in seconds.
+ */
+
+static double
+vimos_bench_walltime(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec + 1.e-6 * tv.tv_usec;
+}
+
+
+/*
+ * Execute a recipe in a child process. The child writes to a pipe one
+ * line per product, with its tag and its DATAMD5 signature.
+ */
+
+static int
+vimos_bench_run(void *module, const vimos_bench_step *step,
+                cpl_frameset *pool, vimos_bench_result *result)
+{
+    int          (*get_info)(cpl_pluginlist *);
+    cpl_frameset  *frames;
+    cpl_size       n;
+    int            channel[2];
+    pid_t          pid;
+    int            status;
+    struct rusage  usage;
+    double         start;
+    FILE          *stream;
+    char           line[256];
+    int            i;
+
+
+    result->recipe    = step->recipe;
+    result->status    = "SKIPPED";
+    result->walltime  = 0.0;
+    result->maxrss    = 0;
+    result->nproducts = 0;
+
+    *(void **)(&get_info) = dlsym(module, "cpl_plugin_get_info");
+    if (get_info == NULL) {
+        cpl_msg_error(step->recipe, "Not a recipe module: %s", dlerror());
+        result->status = "FAILED";
+        return 1;
+    }
+
+    frames = cpl_frameset_new();
+    for (i = 0; step->required[i]; i++) {
+        int found = 0;
+        for (n = 0; n < cpl_frameset_get_size(pool); n++) {
+            const cpl_frame *frame = cpl_frameset_get_position_const(pool, n);
+            if (!strcmp(cpl_frame_get_tag(frame), step->required[i])) {
+                cpl_frameset_insert(frames, cpl_frame_duplicate(frame));
+                found = 1;
+            }
+        }
+        if (!found) {
+            cpl_msg_warning(step->recipe, "Missing input %s: skipped",
+                            step->required[i]);
+            cpl_frameset_delete(frames);
+            return 0;
+        }
+    }
+    for (i = 0; step->optional[i]; i++) {
+        for (n = 0; n < cpl_frameset_get_size(pool); n++) {
+            const cpl_frame *frame = cpl_frameset_get_position_const(pool, n);
+            if (!strcmp(cpl_frame_get_tag(frame), step->optional[i]))
+                cpl_frameset_insert(frames, cpl_frame_duplicate(frame));
+        }
+    }
+
+    if (pipe(channel)) {
+        cpl_frameset_delete(frames);
+        result->status = "FAILED";
+        return 1;
+    }
+
+    start = vimos_bench_walltime();
+    pid = fork();
+
+    if (pid == 0) {
+
+        /*
+         * Child: the common plugin invocation sequence, followed by the
+         * product signature as done by esorex.
+         */
+
+        cpl_pluginlist *list = cpl_pluginlist_new();
+        cpl_plugin     *plugin;
+        cpl_recipe     *recipe;
+        int             code;
+
+        close(channel[0]);
+        stream = fdopen(channel[1], "w");
+
+        get_info(list);
+        plugin = cpl_pluginlist_find(list, step->recipe);
+        if (plugin == NULL)
+            _exit(2);
+
+        recipe = (cpl_recipe *)plugin;
+        cpl_plugin_get_init(plugin)(plugin);
+        recipe->frames = frames;
+
+        code = cpl_plugin_get_exec(plugin)(plugin);
+
+        if (code == 0) {
+            cpl_dfs_sign_products(recipe->frames, CPL_DFS_SIGNATURE_DATAMD5);
+            for (n = 0; n < cpl_frameset_get_size(recipe->frames); n++) {
+                const cpl_frame *frame =
+                    cpl_frameset_get_position_const(recipe->frames, n);
+                cpl_propertylist *header;
+
+                if (cpl_frame_get_group(frame) != CPL_FRAME_GROUP_PRODUCT)
+                    continue;
+
+                header = cpl_propertylist_load(cpl_frame_get_filename(frame),
+                                               0);
+                fprintf(stream, "%s %s %s\n", cpl_frame_get_tag(frame),
+                        cpl_frame_get_filename(frame),
+                        header && cpl_propertylist_has(header, "DATAMD5") ?
+                        cpl_propertylist_get_string(header, "DATAMD5") :
+                        "none");
+                cpl_propertylist_delete(header);
+            }
+        }
+
+        fclose(stream);
+        cpl_plugin_get_deinit(plugin)(plugin);
+        _exit(code == 0 ? 0 : 1);
+    }
+
+    close(channel[1]);
+    cpl_frameset_delete(frames);
+
+    if (pid < 0) {
+        close(channel[0]);
+        result->status = "FAILED";
+        return 1;
+    }
+
+    /*
+     * Parent: collect the products, and make them available to the
+     * following steps of the chain.
+     */
+
+    stream = fdopen(channel[0], "r");
+    while (fgets(line, sizeof line, stream)) {
+        char tag[64], filename[160], md5[64];
+
+        if (sscanf(line, "%63s %159s %63s", tag, filename, md5) != 3)
+            continue;
+
+        if (result->nproducts < VIMOS_BENCH_MAX_PRODUCTS) {
+            strcpy(result->tag[result->nproducts], tag);
+            strcpy(result->md5[result->nproducts], md5);
+            result->nproducts++;
+        }
+
+        {
+            cpl_frame *frame = cpl_frame_new();
+            cpl_frame_set_filename(frame, filename);
+            cpl_frame_set_tag(frame, tag);
+            cpl_frame_set_group(frame, CPL_FRAME_GROUP_CALIB);
+            cpl_frameset_insert(pool, frame);
+        }
+    }
+    fclose(stream);
+
+    wait4(pid, &status, 0, &usage);
+
+    result->walltime = vimos_bench_walltime() - start;
+    result->maxrss   = usage.ru_maxrss;
+    result->status   = WIFEXITED(status) && WEXITSTATUS(status) == 0 ?
+                       "OK" : "FAILED";
+
+    return strcmp(result->status, "OK") != 0;
+}
+
+
+/*
+ * Compare the results with the baseline file. Returns the number of
+ * regressions found.
+ */
+
+static int
+vimos_bench_compare(const char *baseline, const vimos_bench_result *results,
+                    int nresults, double tolerance)
+{
+    FILE *stream = fopen(baseline, "r");
+    char  line[256];
+    int   regressions = 0;
+    int   i, j;
+
+    if (stream == NULL) {
+        cpl_msg_warning(cpl_func, "No baseline %s: nothing to compare",
+                        baseline);
+        return 0;
+    }
+
+    while (fgets(line, sizeof line, stream)) {
+        char   recipe[64], what[64], value[64];
+        double walltime;
+
+        if (line[0] == '#')
+            continue;
+        if (sscanf(line, "%63s %63s %63s", recipe, what, value) != 3)
+            continue;
+
+        for (i = 0; i < nresults; i++) {
+            const vimos_bench_result *r = results + i;
+
+            if (strcmp(r->recipe, recipe) || !strcmp(r->status, "SKIPPED"))
+                continue;
+
+            if (!strcmp(what, "status")) {
+                if (strcmp(r->status, value)) {
+                    cpl_msg_error(recipe, "Status changed: %s (was %s)",
+                                  r->status, value);
+                    regressions++;
+                }
+            }
+            else if (!strcmp(what, "walltime")) {
+                walltime = atof(value);
+                if (r->walltime > walltime * (1.0 + tolerance)) {
+                    cpl_msg_error(recipe, "Slower: %.2f s (was %.2f s)",
+                                  r->walltime, walltime);
+                    regressions++;
+                }
+            }
+            else if (strcmp(what, "maxrss")) {
+                for (j = 0; j < r->nproducts; j++)
+                    if (!strcmp(r->tag[j], what))
+                        break;
+                if (j == r->nproducts) {
+                    cpl_msg_error(recipe, "Product %s missing", what);
+                    regressions++;
+                }
+                else if (strcmp(r->md5[j], value)) {
+                    cpl_msg_error(recipe, "Product %s changed: %s (was %s)",
+                                  what, r->md5[j], value);
+                    regressions++;
+                }
+            }
+        }
+    }
+
+    fclose(stream);
+
+    return regressions;
+}
+
+
+static int
+vimos_bench_write(const char *baseline, const vimos_bench_result *results,
+                  int nresults)
+{
+    FILE *stream = fopen(baseline, "w");
+    int   i, j;
+
+    if (stream == NULL) {
+        cpl_msg_error(cpl_func, "Cannot write baseline %s: %s", baseline,
+                      strerror(errno));
+        return 1;
+    }
+
+    fprintf(stream, "# VIMOS recipe benchmark baseline\n"
+                    "# recipe  walltime|maxrss|status|<product tag>  "
+                    "value\n");
+
+    for (i = 0; i < nresults; i++) {
+        const vimos_bench_result *r = results + i;
+
+        if (!strcmp(r->status, "SKIPPED"))
+            continue;
+
+        fprintf(stream, "%s status %s\n", r->recipe, r->status);
+        fprintf(stream, "%s walltime %.3f\n", r->recipe, r->walltime);
+        fprintf(stream, "%s maxrss %ld\n", r->recipe, r->maxrss);
+        for (j = 0; j < r->nproducts; j++)
+            fprintf(stream, "%s %s %s\n", r->recipe, r->tag[j], r->md5[j]);
+    }
+
+    fclose(stream);
+
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    const char *plugindir = "../recipes/.libs";
+    const char *caldir    = "../../vimos-calib-3.2.3/cal";
+    const char *workdir   = "bench";
+    const char *baseline  = NULL;
+    const char *selection = NULL;
+    double      tolerance = 0.2;
+    int         update    = 0;
+
+    int                 nsteps = sizeof vimos_bench_chain
+                               / sizeof vimos_bench_chain[0];
+    vimos_bench_result  results[sizeof vimos_bench_chain
+                                / sizeof vimos_bench_chain[0]];
+    cpl_frameset       *pool;
+    char               *path;
+    int                 regressions = 0;
+    int                 i;
+
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--update"))
+            update = 1;
+        else if (i + 1 < argc && !strcmp(argv[i], "--plugindir"))
+            plugindir = argv[++i];
+        else if (i + 1 < argc && !strcmp(argv[i], "--caldir"))
+            caldir = argv[++i];
+        else if (i + 1 < argc && !strcmp(argv[i], "--workdir"))
+            workdir = argv[++i];
+        else if (i + 1 < argc && !strcmp(argv[i], "--baseline"))
+            baseline = argv[++i];
+        else if (i + 1 < argc && !strcmp(argv[i], "--tolerance"))
+            tolerance = atof(argv[++i]);
+        else if (i + 1 < argc && !strcmp(argv[i], "--recipes"))
+            selection = argv[++i];
+        else {
+            fprintf(stderr, "Usage: %s [--plugindir DIR] [--caldir DIR] "
+                    "[--workdir DIR] [--baseline FILE] [--update] "
+                    "[--tolerance FRACTION] [--recipes NAME,...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    cpl_init(CPL_INIT_DEFAULT);
+    cpl_msg_set_level(CPL_MSG_WARNING);
+
+    /*
+     * Relative paths are given with respect to the starting directory,
+     * the benchmark runs inside the work directory.
+     */
+
+    plugindir = plugindir[0] == '/' ? cpl_sprintf("%s", plugindir) :
+                cpl_sprintf("%s/%s", getcwd(NULL, 0), plugindir);
+    caldir = caldir[0] == '/' ? cpl_sprintf("%s", caldir) :
+             cpl_sprintf("%s/%s", getcwd(NULL, 0), caldir);
+    if (baseline && baseline[0] != '/')
+        baseline = cpl_sprintf("%s/%s", getcwd(NULL, 0), baseline);
+
+    mkdir(workdir, 0755);
+    if (chdir(workdir)) {
+        cpl_msg_error(cpl_func, "Cannot enter %s: %s", workdir,
+                      strerror(errno));
+        return 1;
+    }
+
+    pool = cpl_frameset_new();
+
+    cpl_msg_info(cpl_func, "Generating synthetic raw frames...");
+    if (vimos_bench_generate(caldir, pool)) {
+        cpl_msg_error(cpl_func, "Cannot generate raw frames: %s",
+                      cpl_error_get_message());
+        return 1;
+    }
+
+    printf("%-18s %-8s %10s %12s %9s\n", "Recipe", "Status", "Time (s)",
+           "Peak (MB)", "Products");
+
+    for (i = 0; i < nsteps; i++) {
+        const vimos_bench_step *step = vimos_bench_chain + i;
+        void                   *module;
+
+        results[i].recipe    = step->recipe;
+        results[i].status    = "SKIPPED";
+        results[i].walltime  = 0.0;
+        results[i].maxrss    = 0;
+        results[i].nproducts = 0;
+
+        if (selection && !strstr(selection, step->recipe))
+            continue;
+
+        /*
+         * vmmoscalib and vmmosscience are built from vimos_calib.cc
+         * and vimos_science.cc, but the module is named after the recipe.
+         */
+
+        path = cpl_sprintf("%s/%s.so", plugindir, step->recipe);
+        module = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+        cpl_free(path);
+
+        if (module == NULL) {
+            cpl_msg_error(step->recipe, "Cannot load recipe: %s", dlerror());
+            results[i].status = "FAILED";
+        }
+        else {
+            vimos_bench_run(module, step, pool, results + i);
+            dlclose(module);
+        }
+
+        printf("%-18s %-8s %10.2f %12.1f %9d\n", results[i].recipe,
+               results[i].status, results[i].walltime,
+               results[i].maxrss / 1024.0, results[i].nproducts);
+        fflush(stdout);
+    }
+
+    if (baseline) {
+        if (update || access(baseline, R_OK))
+            regressions = vimos_bench_write(baseline, results, nsteps);
+        else
+            regressions = vimos_bench_compare(baseline, results, nsteps,
+                                              tolerance);
+    }
+
+    if (regressions)
+        printf("FAILED: %d regressions with respect to %s\n", regressions,
+               baseline);
+
+    cpl_frameset_delete(pool);
+    cpl_end();
+
+    return regressions ? 1 : 0;
+}
+/**@}*/
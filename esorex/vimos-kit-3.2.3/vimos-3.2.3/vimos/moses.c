@@ -38,6 +38,7 @@
 
 #include <fors_tools.h>
 #include <moses.h>
+#include <hdrl.h>
 
 /* Prototypes */
 static cpl_polynomial *read_global_distortion(cpl_table *global, cpl_size row);
@@ -49,14 +50,19 @@ static cpl_polynomial *read_global_distortion(cpl_table *global, cpl_size row);
  * in the CPL, or as soon as this module will be moved into the CPL. */
 
 float cpl_tools_get_median_float(float *, cpl_size);
+double cpl_tools_get_median_double(double *, cpl_size);
 
 #define MAX_COLNAME      (80)
 #define STRETCH_FACTOR   (1.20)
 
-// Related to mos_identify_peaks(), used in multiplex mode
+#define MOS_REGION_SIZE  (800)
 
-static int mos_multiplex   = -1;
-static int mos_region_size = 800;
+#define MOS_KSIGMA_TILE  (256)
+
+// Related to mos_identify_peaks(), used in multiplex mode: context
+// used by the functions not receiving one, set by mos_set_multiplex()
+
+static mos_context mos_default_context = {-1, MOS_REGION_SIZE};
 
 static double default_lines_hi[] = {   /* Default sky line catalog */
                     5577.338,          /* for high res data        */
@@ -4580,15 +4586,49 @@ cpl_vector *mos_refine_peaks(const float *spectrum, int length,
 }
 
 
+/**
+ * @brief
+ *   Initialise a calibration context
+ *
+ * @param context    Calibration context
+ * @param multiplex  CCD region to calibrate, or -1 to disable multiplexing
+ *
+ * The size of the CCD regions is set to its default (800 pixels). A
+ * context is only read by the functions receiving it, so that each
+ * multiplexed region can be calibrated with its own context at the 
+ * same time as the others.
+ */
+
+void mos_context_init(mos_context *context, int multiplex)
+{
+    context->multiplex   = multiplex;
+    context->region_size = MOS_REGION_SIZE;
+}
+
+
+/**
+ * @brief
+ *   Set the multiplex region of the default calibration context
+ *
+ * @param multiplex  CCD region to calibrate, or -1 to disable multiplexing
+ *
+ * The default context is used by the functions @c mos_identify_peaks(),
+ * @c mos_wavelength_calibration_raw(), and @c mos_identify_slits().
+ * Since it is shared, calibrations of different regions must then be
+ * run one after the other: the corresponding functions taking an
+ * explicit @c mos_context should be used instead.
+ */
+
 void mos_set_multiplex(int multiplex)
 {
-    mos_multiplex = multiplex;
+    mos_default_context.multiplex = multiplex;
 }
 
 /**
  * @brief
  *   Identify peak candidates
  *   
+ * @param context   Calibration context
  * @param peaks     List of peaks candidates
  * @param lines     List of wavelengths
  * @param min_disp  Min expected spectral dispersion (Angstrom/pixel)
@@ -4634,13 +4674,18 @@ void mos_set_multiplex(int multiplex)
  * pattern on the data, are solved by linear interpolation and extrapolation
  * of the safe identifications. 
  *
+ * If the @em context has multiplexing enabled, only the sequence of
+ * identified peaks lying for the most part in the CCD region selected
+ * by the context is returned.
+ *
  * More details about the applied algorithm can be found in the comments
  * to the function code.
  */
 
-cpl_bivector *mos_identify_peaks(cpl_vector *peaks, cpl_vector *lines,
-                                 double min_disp, double max_disp,
-                                 double tolerance)
+cpl_bivector *mos_identify_peaks_ctx(const mos_context *context,
+                                     cpl_vector *peaks, cpl_vector *lines,
+                                     double min_disp, double max_disp,
+                                     double tolerance)
 {
 
   int      i, j, k, l;
@@ -4989,7 +5034,7 @@ cpl_bivector *mos_identify_peaks(cpl_vector *peaks, cpl_vector *lines,
 
     maxpos = max = 0;
 
-    if (mos_multiplex < 0) {
+    if (context->multiplex < 0) {
       for (i = 0; i < nseq; i++) {
         if (seq_length[i] > max) {
           max = seq_length[i];
@@ -5001,7 +5046,7 @@ cpl_bivector *mos_identify_peaks(cpl_vector *peaks, cpl_vector *lines,
 
       /*
        * Now consider the sequence which lays in the specified 
-       * CCD region (indicated by mos_multiplex): that is, _most_ 
+       * CCD region (indicated by context->multiplex): that is, _most_ 
        * of its lines (more than half) must be in that region...
        */
 
@@ -5016,16 +5061,16 @@ cpl_bivector *mos_identify_peaks(cpl_vector *peaks, cpl_vector *lines,
 
           for (j = 0; j < n; j++)
             cpl_array_set_int(regions, j, 
-                              ((int)floor(xpos[nn + j])) / mos_region_size);
+                              ((int)floor(xpos[nn + j])) / context->region_size);
 
           region = (int)cpl_array_get_median(regions);
           cpl_array_delete(regions);
 
-          if (mos_multiplex == region) {
+          if (context->multiplex == region) {
             if (found) {
               cpl_msg_debug(cpl_func, "More than one spectrum found in "
                             "region %d (only the first one is extracted)", 
-                            mos_multiplex);
+                            context->multiplex);
               break;
             }
             found = 1;
@@ -5276,6 +5321,23 @@ cpl_bivector *mos_identify_peaks(cpl_vector *peaks, cpl_vector *lines,
                                    cpl_vector_wrap(n, lambda));
 }
 
+
+/**
+ * @brief
+ *   Identify peak candidates
+ *
+ * Same as @c mos_identify_peaks_ctx(), using the default calibration
+ * context set by @c mos_set_multiplex().
+ */
+
+cpl_bivector *mos_identify_peaks(cpl_vector *peaks, cpl_vector *lines,
+                                 double min_disp, double max_disp,
+                                 double tolerance)
+{
+    return mos_identify_peaks_ctx(&mos_default_context, peaks, lines,
+                                  min_disp, max_disp, tolerance);
+}
+
 /* 
  * This is an attempt to interface ppm to the new ppm function
  * of the CPL. Very slow, very inaccurate, probably the radius
@@ -5762,6 +5824,7 @@ cpl_bivector *mos_find_peaks(const float *spectrum, int length,
  * @brief
  *   Derive wavelength calibration from a raw arc lamp or sky exposure
  *
+ * @param context     Calibration context
  * @param image       An arc lamp or sky exposure
  * @param lines       List of reference lines wavelengths
  * @param dispersion  Expected value of the dispersion (wavelength units/pixel)
@@ -5791,7 +5854,7 @@ cpl_bivector *mos_find_peaks(const float *spectrum, int length,
  * @c mos_peak_candidates() and @c mos_refine_peaks() are used to create 
  * a list of positions of reference lines candidates along each @em image 
  * row. Only peaks above @em level are selected. Third, the function 
- * @c mos_identify_peaks() is applied to select from the found peaks 
+ * @c mos_identify_peaks_ctx() is applied to select from the found peaks 
  * the ones corresponding to reference lines, associating them to the 
  * appropriate wavelengths from the line catalog @em lines. The ensuing 
  * polynomial fit is adaptive: it is performed using the specified 
@@ -5880,21 +5943,23 @@ cpl_bivector *mos_find_peaks(const float *spectrum, int length,
  *  is returned. The table has to be allocated but empty.
  */
 
-cpl_image *mos_wavelength_calibration_raw(const cpl_image *image,
-                                          cpl_vector *lines,
-                                          double dispersion, float level,
-                                          int sradius, int order,
-                                          double reject, double refwave, 
-                                          double *wavestart, double *waveend,
-                                          int *nlines, double *error, 
-                                          cpl_table *idscoeff,
-                                          cpl_image *calibration,
-                                          cpl_image *residuals, 
-                                          cpl_table *restable,
-                                          cpl_mask *refmask,
-                                          cpl_table *detected_lines, 
-                                          double disp_tolerance,
-                                          double ratio_tolerance)
+cpl_image *mos_wavelength_calibration_raw_ctx(const mos_context *context,
+                                              const cpl_image *image,
+                                              cpl_vector *lines,
+                                              double dispersion, float level,
+                                              int sradius, int order,
+                                              double reject, double refwave, 
+                                              double *wavestart, 
+                                              double *waveend,
+                                              int *nlines, double *error, 
+                                              cpl_table *idscoeff,
+                                              cpl_image *calibration,
+                                              cpl_image *residuals, 
+                                              cpl_table *restable,
+                                              cpl_mask *refmask,
+                                              cpl_table *detected_lines, 
+                                              double disp_tolerance,
+                                              double ratio_tolerance)
 {
 
     const char *func = "mos_wavelength_calibration_raw";
@@ -6055,8 +6120,8 @@ cpl_image *mos_wavelength_calibration_raw(const cpl_image *image,
             peaks = mos_refine_peaks(sdata + i*nx, nx, peaks, width);
         }
         if (peaks) {
-            output = mos_identify_peaks(peaks, lines, 
-                                        min_disp, max_disp, r_toleran);
+            output = mos_identify_peaks_ctx(context, peaks, lines, 
+                                            min_disp, max_disp, r_toleran);
             if (output) {
                 cpl_bivector * peaks_ident_used_fit;
                 countLines = cpl_bivector_get_size(output);
@@ -6479,6 +6544,41 @@ cpl_image *mos_wavelength_calibration_raw(const cpl_image *image,
 }
 
 
+/**
+ * @brief
+ *   Derive wavelength calibration from a raw arc lamp or sky exposure
+ *
+ * Same as @c mos_wavelength_calibration_raw_ctx(), using the default
+ * calibration context set by @c mos_set_multiplex().
+ */
+
+cpl_image *mos_wavelength_calibration_raw(const cpl_image *image,
+                                          cpl_vector *lines,
+                                          double dispersion, float level,
+                                          int sradius, int order,
+                                          double reject, double refwave, 
+                                          double *wavestart, double *waveend,
+                                          int *nlines, double *error, 
+                                          cpl_table *idscoeff,
+                                          cpl_image *calibration,
+                                          cpl_image *residuals, 
+                                          cpl_table *restable,
+                                          cpl_mask *refmask,
+                                          cpl_table *detected_lines, 
+                                          double disp_tolerance,
+                                          double ratio_tolerance)
+{
+    return mos_wavelength_calibration_raw_ctx(&mos_default_context, image,
+                                              lines, dispersion, level,
+                                              sradius, order, reject, refwave,
+                                              wavestart, waveend, nlines,
+                                              error, idscoeff, calibration,
+                                              residuals, restable, refmask,
+                                              detected_lines, disp_tolerance,
+                                              ratio_tolerance);
+}
+
+
 /**
  * @brief
  *   Find the location of detected spectra on the CCD
@@ -6800,6 +6900,7 @@ cpl_error_code mos_rotate_slits(cpl_table *slits, int rotation, int nx, int ny)
  * @brief
  *   Identify slits listed in a slit location table
  *
+ * @param context   Calibration context
  * @param slits     Slit location on the camera focal plane (CCD pixels).
  * @param maskslits Slit location on the telescope focal plane (mask).
  * @param global    Global distortion table.
@@ -6851,10 +6952,15 @@ cpl_error_code mos_rotate_slits(cpl_table *slits, int rotation, int nx, int ny)
  * the coefficients of the bivariate polynomials describing the 
  * relation between mask and CCD coordinates (at reference wavelength)
  * are written to rows 0 and 7.
+ *
+ * If the @em context has multiplexing enabled, the pattern matching
+ * is based on the (at most 25) slits closest to the slits baricenter,
+ * and the "fast" method for masks with more than 200 slits is not used.
  */
 
-cpl_table *mos_identify_slits(cpl_table *slits, cpl_table *maskslits,
-                              cpl_table *global)
+cpl_table *mos_identify_slits_ctx(const mos_context *context,
+                                  cpl_table *slits, cpl_table *maskslits,
+                                  cpl_table *global)
 {
     cpl_array        *top_ident = NULL;;
     cpl_array        *bot_ident = NULL;;
@@ -6945,7 +7051,7 @@ cpl_table *mos_identify_slits(cpl_table *slits, cpl_table *maskslits,
         return NULL;
     }
 
-    if (nslits > 200 && mos_multiplex < 0) {
+    if (nslits > 200 && context->multiplex < 0) {
         cpl_msg_info(cpl_func, "Many slits: using 'fast' pattern matching...");
         positions = mos_identify_slits_fast(slits, maskslits, global);
         if (positions == NULL)
@@ -6959,7 +7065,7 @@ cpl_table *mos_identify_slits(cpl_table *slits, cpl_table *maskslits,
 
     sort_col = cpl_propertylist_new();
 
-    if (mos_multiplex < 0) {
+    if (context->multiplex < 0) {
         cpl_propertylist_append_bool(sort_col, "ytop", 1);
         cpl_table_sort(slits, sort_col);
         cpl_table_sort(maskslits, sort_col);
@@ -7089,7 +7195,7 @@ cpl_table *mos_identify_slits(cpl_table *slits, cpl_table *maskslits,
     for (i = 0; i < nmaskslits; i++)
         cpl_matrix_set(bot_pattern, 1, i, ymbot[i]);
 
-    if (mos_multiplex < 0) {
+    if (context->multiplex < 0) {
         if (nmaskslits > nslits) { // Safety no longer necessary with CPL 6.+
             use_pattern = nslits;
             use_data = nslits;
@@ -7134,7 +7240,7 @@ cpl_table *mos_identify_slits(cpl_table *slits, cpl_table *maskslits,
 // cpl_table_dump(slits, 0, nslits, NULL);
 // cpl_table_dump(maskslits, 0, use_pattern, NULL);
 
-    if (mos_multiplex >= 0) {
+    if (context->multiplex >= 0) {
         sort_col = cpl_propertylist_new();
         cpl_propertylist_append_bool(sort_col, "ytop", 1);
         cpl_table_sort(slits, sort_col);
@@ -7358,8 +7464,8 @@ cpl_table *mos_identify_slits(cpl_table *slits, cpl_table *maskslits,
         dpoint[0] = cpl_table_get_double(positions, "xmtop", i, NULL);
         dpoint[1] = cpl_table_get_double(positions, "ymtop", i, NULL);
         position  = cpl_polynomial_eval(xpoly, point);
-//        if (mos_multiplex >= 0) {
-//            if (mos_multiplex != ((int)floor(position)) / mos_region_size) {
+//        if (context->multiplex >= 0) {
+//            if (context->multiplex != ((int)floor(position)) / context->region_size) {
 //                cpl_table_unselect_row(positions, i);
 //                continue;
 //            }
@@ -7375,7 +7481,7 @@ cpl_table *mos_identify_slits(cpl_table *slits, cpl_table *maskslits,
         cpl_table_set_double(positions, "ybottom", i, position);
     }
 
-//    if (mos_multiplex >= 0) {
+//    if (context->multiplex >= 0) {
 //        cpl_table_not_selected(positions);
 //        cpl_table_erase_selected(positions);
 //        nmaskslits = cpl_table_get_nrow(positions);
@@ -7390,11 +7496,11 @@ cpl_table *mos_identify_slits(cpl_table *slits, cpl_table *maskslits,
     cpl_table_erase_column(positions, "xmbottom");
     cpl_table_erase_column(positions, "ymbottom");
 
-//    if (mos_multiplex >= 0) {
+//    if (context->multiplex >= 0) {
 //        msg_multiplex = 
 //        cpl_sprintf("in the CCD section between %d and %d pixel", 
-//                    mos_multiplex * mos_region_size, 
-//                    (mos_multiplex + 1) * mos_region_size);
+//                    context->multiplex * context->region_size, 
+//                    (context->multiplex + 1) * context->region_size);
 //    }
 
     if (nmaskslits > nslits)
@@ -7412,7 +7518,7 @@ cpl_table *mos_identify_slits(cpl_table *slits, cpl_table *maskslits,
                      "Finally identified slits: %d out of %d expected %s",
                      nmaskslits, nmaskslits, msg_multiplex);
 
-//    if (mos_multiplex >= 0) {
+//    if (context->multiplex >= 0) {
 //        cpl_free(msg_multiplex);
 //    }
 
@@ -7421,6 +7527,22 @@ cpl_table *mos_identify_slits(cpl_table *slits, cpl_table *maskslits,
 }
 
 
+/**
+ * @brief
+ *   Identify slits listed in a slit location table
+ *
+ * Same as @c mos_identify_slits_ctx(), using the default calibration
+ * context set by @c mos_set_multiplex().
+ */
+
+cpl_table *mos_identify_slits(cpl_table *slits, cpl_table *maskslits,
+                              cpl_table *global)
+{
+    return mos_identify_slits_ctx(&mos_default_context, slits, maskslits,
+                                  global);
+}
+
+
 cpl_table *mos_identify_slits_fast(cpl_table *slits, cpl_table *maskslits,
                                    cpl_table *global)
 {
@@ -9093,6 +9215,112 @@ cpl_error_code mos_global_trace(cpl_table *slits, cpl_table *polytraces,
 }
 
 
+/*
+ * Resample one slit spectrum for mos_spatial_calibration(). The top trace
+ * of the slit at the x pixel positions start_pixel to end_pixel - 1, and
+ * the size of its pseudo-pixels there, (top - bottom) / npseudo, are read
+ * from the trace[] table where they are stored in pairs. The spatially
+ * resampled values are written
+ * to the pixel buffer xdata[] of the slit image, with nx x (npseudo + 1)
+ * pixels. Each output pixel is written once, so the image is scanned
+ * along its rows, i.e. along the CCD rows as much as the spectral
+ * curvature allows.
+ */
+
+static void mos_spatial_resample_slit(const float *sdata, int nx, int ny,
+                                      const double *trace, int start_pixel,
+                                      int end_pixel, int npseudo, int flux,
+                                      float *xdata)
+{
+    double vtop, vbot, value;
+    double top;
+    double ypos, yfra;
+    double factor;
+    int    yint;
+    int    j, k;
+
+    for (k = 0; k <= npseudo; k++) {
+        for (j = start_pixel; j < end_pixel; j++) {
+            top = trace[2 * (j - start_pixel)];
+            factor = trace[2 * (j - start_pixel) + 1];
+            ypos = top - k*factor;
+            yint = ypos;                       /* floor(ypos) */
+            if (yint > ypos)
+                yint--;
+            yfra = ypos - yint;
+            if (yint >= 0 && yint < ny-1) {
+                vtop = sdata[j + nx*yint];
+                vbot = sdata[j + nx*(yint+1)];
+
+                //This means that the top and bottom traces are crossing,
+                //which is physically impossible, so let's set it to 0. 
+                if(factor <= 0 )  
+                    value = 0;
+                else if(vtop == FLT_MAX || vbot == FLT_MAX)
+                    value = FLT_MAX;
+                else
+                {
+                    value = vtop*(1-yfra) + vbot*yfra;
+                    if (flux)
+                        value *= factor;
+                }
+                xdata[j + nx*(npseudo-k)] = value;
+            }
+        }
+    }
+}
+
+
+/*
+ * Write the spatial coordinates of one slit to the spatial calibration
+ * image of mos_spatial_calibration(), with the same trace[] table used
+ * by mos_spatial_resample_slit(). Pixels may be written more than once,
+ * but only by the pseudo-pixels of their own column, which are still
+ * taken from the top down when the image is scanned along its rows.
+ */
+
+static void mos_spatial_calibrate_slit(float *data, int nx, int ny,
+                                       const double *trace, int start_pixel,
+                                       int end_pixel, int npseudo)
+{
+    double top;
+    double ypos;
+    double factor;
+    int   *yprev;
+    int    yint;
+    int    j, k;
+
+    yprev = cpl_calloc(end_pixel - start_pixel + 1, sizeof(int));
+
+    for (k = 0; k <= npseudo; k++) {
+        for (j = start_pixel; j < end_pixel; j++) {
+            top = trace[2 * (j - start_pixel)];
+            factor = trace[2 * (j - start_pixel) + 1];
+            ypos = top - k*factor;
+            yint = floor(ypos);
+            if (yint >= 0 && yint < ny-1) {
+                data[j + nx*yint] = (top-yint)/factor;
+                if (k) {
+
+                    /*
+                     * This is added to recover lost pixels on
+                     * the CCD image (pixels are lost because
+                     * the CCD pixels are less than npseudo+1).
+                     */
+
+                    if (yprev[j - start_pixel] - yint > 1) {
+                        data[j + nx*(yint+1)] = (top-yint-1)/factor;
+                    }
+                }
+            }
+            yprev[j - start_pixel] = yint;
+        }
+    }
+
+    cpl_free(yprev);
+}
+
+
 /**
  * @brief
  *   Spatial remapping of CCD spectra eliminating the spectral curvature
@@ -9173,22 +9401,22 @@ cpl_image *mos_spatial_calibration(cpl_image *spectra, cpl_table *slits,
                                                  /* Max order is 5 */
     cpl_polynomial *polytop;
     cpl_polynomial *polybot;
-    cpl_image     **exslit;
     cpl_image      *resampled;
     float          *data;
     float          *sdata;
-    float          *xdata;
-    double          vtop, vbot, value;
+    float          *rdata;
+    double        **trace;
     double          top, bot;
     double          coeff;
     double          ytop, ybot;
-    double          ypos, yfra;
-    double          factor;
-    int             yint, ysize, yprev;
+    int             yint, ysize;
     int             nslits;
     int             npseudo;
     int            *slit_id;
     int            *length;
+    int            *first, *last;
+    int            *height;
+    int            *offset;
     int             nx, ny;
     int             pixel_above, pixel_below, refpixel, start_pixel, end_pixel;
     int             missing_top, missing_bot;
@@ -9245,7 +9473,11 @@ cpl_image *mos_spatial_calibration(cpl_image *spectra, cpl_table *slits,
     pixel_above = STRETCH_FACTOR * (red - reference) / dispersion;
     pixel_below = STRETCH_FACTOR * (reference - blue) / dispersion;
 
-    exslit = cpl_calloc(nslits, sizeof(cpl_image *));
+    height = cpl_calloc(nslits, sizeof(int));
+    offset = cpl_calloc(nslits, sizeof(int));
+    trace  = cpl_calloc(nslits, sizeof(double *));
+    first  = cpl_calloc(nslits, sizeof(int));
+    last   = cpl_calloc(nslits, sizeof(int));
 
     for (i = 0; i < nslits; i++) {
         
@@ -9358,86 +9590,61 @@ cpl_image *mos_spatial_calibration(cpl_image *spectra, cpl_table *slits,
             continue;
         }
 
-        exslit[i] = cpl_image_new(nx, npseudo+1, CPL_TYPE_FLOAT);
-        xdata = cpl_image_get_data(exslit[i]);
+        height[i] = npseudo + 1;
 
         /*
-         * Write interpolated values to slit image.
+         * Tabulate the top trace and the pseudo-pixel size at each x
+         * pixel position to resample.
          */
 
+        first[i] = start_pixel;
+        last[i] = end_pixel > start_pixel ? end_pixel : start_pixel;
+        trace[i] = cpl_malloc((2 * (last[i] - start_pixel) + 1)
+                              * sizeof(double));
+
         for (j = start_pixel; j < end_pixel; j++) {
             top = cpl_polynomial_eval_1d(polytop, j, NULL);
             bot = cpl_polynomial_eval_1d(polybot, j, NULL);
-            factor = (top-bot)/npseudo;
-            for (k = 0; k <= npseudo; k++) {
-                ypos = top - k*factor;
-                yint = floor(ypos);
-                yfra = ypos - yint;
-                if (yint >= 0 && yint < ny-1) {
-                    vtop = sdata[j + nx*yint];
-                    vbot = sdata[j + nx*(yint+1)];
-
-                    //This means that the top and bottom traces are crossing,
-                    //which is physically impossible, so let's set it to 0. 
-                    if(factor <= 0 )  
-                        value = 0;
-                    else if(vtop == FLT_MAX || vbot == FLT_MAX)
-                        value = FLT_MAX;
-                    else
-                    {
-                        value = vtop*(1-yfra) + vbot*yfra;
-                        if (flux)
-                            value *= factor;
-                    }
-                    xdata[j + nx*(npseudo-k)] = value;
-                    if (calibration) {
-                        data[j + nx*yint] = (top-yint)/factor;
-                        if (k) {
-
-                            /*
-                             * This is added to recover lost pixels on
-                             * the CCD image (pixels are lost because
-                             * the CCD pixels are less than npseudo+1).
-                             */
-
-                            if (yprev - yint > 1) {
-                                data[j + nx*(yint+1)] = (top-yint-1)/factor;
-                            }
-                        }
-                    }
-                }
-                yprev = yint;
-            }
+            trace[i][2 * (j - start_pixel)] = top;
+            trace[i][2 * (j - start_pixel) + 1] = (top-bot)/npseudo;
         }
+
         cpl_polynomial_delete(polytop);
         cpl_polynomial_delete(polybot);
     }
 
     /*
-     * Now all the slits images are copied to a single image
+     * The slit spectra are stacked on a single image, in reverse order
+     * from its top
      */
 
     ysize = 0;
     for (i = 0; i < nslits; i++)
-        if (exslit[i])
-            ysize += cpl_image_get_size_y(exslit[i]);
+        ysize += height[i];
 
-    if(ysize == 0)
+    if (ysize == 0) {
+        for (i = 0; i < nslits; i++)
+            cpl_free(trace[i]);
+        cpl_free(trace);
+        cpl_free(first);
+        cpl_free(last);
+        cpl_free(height);
+        cpl_free(offset);
         return NULL;
-    
+    }
+
     resampled = cpl_image_new(nx, ysize, CPL_TYPE_FLOAT);
+    rdata = cpl_image_get_data(resampled);
 
     yint = -1;
     for (i = 0; i < nslits; i++) {
-        if (exslit[i]) {
-            yint += cpl_image_get_size_y(exslit[i]);
-            cpl_image_copy(resampled, exslit[i], 1, ysize - yint);
+        if (height[i]) {
+            yint += height[i];
+            offset[i] = ysize - yint - 1;
             if (create_position) {
-                cpl_table_set_int(slits, "position", i, ysize - yint - 1);
-                cpl_table_set_int(slits, "length", i, 
-                                  cpl_image_get_size_y(exslit[i]));
+                cpl_table_set_int(slits, "position", i, offset[i]);
+                cpl_table_set_int(slits, "length", i, height[i]);
             }
-            cpl_image_delete(exslit[i]);
         }
         else if (create_position) {
             cpl_table_set_int(slits, "position", i, -1);
@@ -9445,6 +9652,45 @@ cpl_image *mos_spatial_calibration(cpl_image *spectra, cpl_table *slits,
         }
     }
 
+    /*
+     * Write interpolated values to the slit spectra. The slits are
+     * independent, and each one is written to its own rows.
+     */
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (i = 0; i < nslits; i++) {
+        if (height[i]) {
+            mos_spatial_resample_slit(sdata, nx, ny, trace[i],
+                                      first[i], last[i], height[i] - 1,
+                                      flux, rdata + nx * offset[i]);
+        }
+    }
+
+    /*
+     * The spatial calibration is written slit by slit, in the same
+     * order as the slits are processed, because the pixels at the
+     * edges of contiguous slits may be written by both.
+     */
+
+    if (calibration) {
+        for (i = 0; i < nslits; i++) {
+            if (height[i]) {
+                mos_spatial_calibrate_slit(data, nx, ny, trace[i],
+                                           first[i], last[i], height[i] - 1);
+            }
+        }
+    }
+
+    for (i = 0; i < nslits; i++)
+        cpl_free(trace[i]);
+    cpl_free(trace);
+    cpl_free(first);
+    cpl_free(last);
+    cpl_free(height);
+    cpl_free(offset);
+
 
     /*
      * Elimination of non-traced slits from slit position table: we cannot do
@@ -9461,8 +9707,6 @@ cpl_image *mos_spatial_calibration(cpl_image *spectra, cpl_table *slits,
 
     */
 
-    cpl_free(exslit);
-
     return resampled;
 
 }
@@ -9799,8 +10043,9 @@ cpl_image *mos_wavelength_calibration_final(cpl_image *image, cpl_table *slits,
                 peaks = mos_refine_peaks(sdata + i*nx, nx, peaks, width);
             }
             if (peaks) {
-                int keep_multiplex = mos_multiplex;
-                mos_multiplex = -1;
+                mos_context single;
+
+                mos_context_init(&single, -1);
                 if(detected_lines)
                 {
                     cpl_size newlines = cpl_vector_get_size(peaks); 
@@ -9822,9 +10067,8 @@ cpl_image *mos_wavelength_calibration_final(cpl_image *image, cpl_table *slits,
                                           oldsize + iline, 0);
                     }
                 }
-                peaks_ident = mos_identify_peaks(peaks, lines, 
+                peaks_ident = mos_identify_peaks_ctx(&single, peaks, lines, 
                                             min_disp, max_disp, r_toleran);
-                mos_multiplex = keep_multiplex;
                 if (peaks_ident) {
                     cpl_bivector * peaks_ident_used_fit;
                     countLines = cpl_bivector_get_size(peaks_ident);
@@ -12317,6 +12561,175 @@ cpl_image *mos_map_wavelengths(cpl_image *spatial, cpl_image *calibration,
     return remapped;
 }
 
+/*
+ * Remap one slit spectrum for mos_map_spectrum(). The top and bottom
+ * traces of the slit at the x pixel positions start_pixel to
+ * end_pixel - 1 are read from the trace[] table, where they are stored
+ * in pairs (top, bottom). The remapped values are written to the pixel
+ * buffer xdata[] of the slit image, with nlambda x (npseudo + 1) pixels.
+ */
+
+static void mos_map_slit(const float *data, const float *wdata,
+                         const float *sdata, int nx, int ny,
+                         const double *trace, int start_pixel, int end_pixel,
+                         int npseudo, int nlambda, double blue,
+                         double dispersion, float *xdata)
+{
+    double lambda00, lambda01, lambda10, lambda11, lambda;
+    double space00, space01, space10, space11, space;
+    double value00, value01, value10, value11, value0, value1, value;
+    double dL, dS;
+    double top, bot;
+    double xfrac, yfrac;
+    int    itop, ibot;
+    int    shift;
+    int    L, S;
+    int    x, y;
+
+    for (x = start_pixel; x < end_pixel; x++) {
+        top = trace[2 * (x - start_pixel)];
+        bot = trace[2 * (x - start_pixel) + 1];
+        itop = top + 1;
+        ibot = bot;
+        if (itop < 0)
+            itop = 0;
+        if (itop > ny - 1)
+            itop = ny - 1;
+        if (ibot < 0)
+            ibot = 0;
+        if (ibot > ny - 1)
+            ibot = ny - 1;
+        for (y = ibot; y < itop; y++) {
+             lambda11 = wdata[x + y*nx];
+             if (lambda11 < 1.0)        /* Impossible wavelength */
+                 continue;
+             space11 = sdata[x + y*nx];
+             if (space11 < 0.0)         /* Impossible spatial coordinate */
+                 continue;
+             lambda01 = wdata[x - 1 + y*nx];
+             if (lambda01 < 1.0)        /* Impossible wavelength */
+                 continue;
+             space01 = sdata[x - 1 + y*nx];
+             if (space01 < 0.0)         /* Impossible spatial coordinate */
+                 continue;
+
+             shift = 0;
+
+/****+
+             if (wdata[x + (y+1)*nx] > 1.0) {
+                 if (wdata[x + (y+1)*nx] - lambda11 > 0) {
+                     shift = -1;
+                     while (wdata[x + shift + (y+1)*nx] - lambda11 > 0)
+                         shift--;
+                     if (lambda11 - wdata[x + shift + (y+1)*nx] > 
+                         wdata[x + shift + 1 + (y+1)*nx] - lambda11) {
+                         shift++;
+                     }
+                 }
+                 else {
+                     shift = 1;
+                     while (wdata[x + shift + (y+1)*nx] - lambda11 < 0)
+                         shift++;
+                     if (wdata[x + shift + (y+1)*nx] - lambda11 >
+                         lambda11 - wdata[x + shift + 1 + (y+1)*nx]) {
+                         shift--;
+                     }
+                 }
+             }
+****/
+
+/****
+printf("y = %d, shift = %d\n", y, shift);
+****/
+
+             lambda10 = wdata[x + shift + (y+1)*nx];
+             if (lambda10 < 1.0)        /* Impossible wavelength */
+                 continue;
+             space10 = sdata[x + shift + (y+1)*nx];
+             if (space10 < 0.0)         /* Impossible spatial coordinate */
+                 continue;
+             lambda00 = wdata[x - 1 + shift + (y+1)*nx];
+             if (lambda00 < 1.0)        /* Impossible wavelength */
+                 continue;
+             space00 = sdata[x - 1 + shift + (y+1)*nx];
+             if (space00 < 0.0)         /* Impossible spatial coordinate */
+                 continue;
+             
+             /*
+              * Find the variation in lambda and space in this
+              * position for each CCD pixel (both quantities are 
+              * expected to be positive).
+              */
+
+             dL = lambda11 - lambda01;
+             dS = space11 - space10;
+
+             /*
+              * Find the position (L,S) of the output pixel 
+              * (by integer truncation).
+              */
+
+             L = (lambda11 - blue)/dispersion + 0.5;
+             S = space11 + 0.5;                   /* Counted from top! */
+
+             if (L < 0 || L >= nlambda)
+                 continue;
+             if (S < 0 || S > npseudo)
+                 continue;
+
+             /*
+              * Find the coordinate of pixel (L,S)
+              */
+
+             lambda = blue + L*dispersion;
+             space  = S;
+
+             /*
+              * Find the interpolation point on the CCD: it is
+              * defined as the (positive) distance from current
+              * CCD pixel (x,y) of the interpolation point (x',y'),
+              * measured in CCD pixels. The interpolation point
+              * is located between the four CCD pixels selected
+              * above.
+              */
+
+             xfrac = (lambda11-lambda)/dL;
+             yfrac = (space11-space)/dS;
+
+/*
+if (xfrac < 0.0 || xfrac > 1.0 || yfrac < 0.0 || yfrac > 1.0)
+printf("xyfrac = %f, %f\n", xfrac, yfrac);
+*/
+
+             /*
+              * Get the four values to interpolate
+              */
+
+             value11 = data[x + y*nx];
+             value01 = data[x - 1 + y*nx];
+             value10 = data[x + shift + (y+1)*nx];
+             value00 = data[x + shift - 1 + (y+1)*nx];
+
+             /*
+              * Interpolation
+              */
+
+             value1 = (1-xfrac)*value11 + xfrac*value01;
+             value0 = (1-xfrac)*value10 + xfrac*value00;
+             value  = (1-yfrac)*value1  + yfrac*value0;
+
+             /*
+              * Write this value to the appropriate (L,S) coordinate
+              * on output slit
+              */
+
+             xdata[L + nlambda*(npseudo-S)] = value;
+             
+        }
+    }
+}
+
+
 /**
  * @brief
  *   Remapping of slit spectra into a grid of lambda-space coordinates
@@ -12403,30 +12816,25 @@ cpl_image *mos_map_spectrum(cpl_image *spectra, cpl_image *wavecalib,
     cpl_polynomial *polytop;
     cpl_polynomial *polybot;
     cpl_image      *remapped;
-    cpl_image     **exslit;
     float          *data;
     float          *wdata;
     float          *sdata;
-    float          *xdata;
-    double          lambda00, lambda01, lambda10, lambda11, lambda;
-    double          space00, space01, space10, space11, space;
-    double          value00, value01, value10, value11, value0, value1, value;
-    double          dL, dS;
+    float          *rdata;
+    double        **trace;
     double          top, bot;
     double          coeff;
     double          ytop, ybot;
-    double          xfrac, yfrac;
     int             yint, ysize;
-    int             itop, ibot;
-    int             shift;
-    int             L, S;
     int             nslits;
     int             npseudo;
     int            *slit_id;
     int            *position;
     int            *length;
+    int            *first, *last;
+    int            *height;
+    int            *offset;
     int             nx, ny;
-    int             x, y;
+    int             x;
     int             nlambda;
     int             pixel_above, pixel_below, refpixel, start_pixel, end_pixel;
     int             missing_top, missing_bot; 
@@ -12479,7 +12887,11 @@ cpl_image *mos_map_spectrum(cpl_image *spectra, cpl_image *wavecalib,
     position = cpl_table_get_data_int(slits, "position");
     length   = cpl_table_get_data_int(slits, "length");
     
-    exslit = cpl_calloc(nslits, sizeof(cpl_image *));
+    height = cpl_calloc(nslits, sizeof(int));
+    offset = cpl_calloc(nslits, sizeof(int));
+    trace  = cpl_calloc(nslits, sizeof(double *));
+    first  = cpl_calloc(nslits, sizeof(int));
+    last   = cpl_calloc(nslits, sizeof(int));
 
     for (i = 0; i < nslits; i++) {
 
@@ -12590,186 +13002,153 @@ cpl_image *mos_map_spectrum(cpl_image *spectra, cpl_image *wavecalib,
             continue;
         }
 
-        exslit[i] = cpl_image_new(nlambda, npseudo+1, CPL_TYPE_FLOAT);
-        xdata = cpl_image_get_data(exslit[i]);
+        height[i] = npseudo + 1;
 
         /*
-         * Write interpolated spectral values to remapped slit spectrum.
+         * Tabulate the top and bottom traces at each x pixel position
+         * to remap.
          */
 
-        for (x = start_pixel; x < end_pixel; x++) {
-            top = cpl_polynomial_eval_1d(polytop, x, NULL);
-            bot = cpl_polynomial_eval_1d(polybot, x, NULL);
-            itop = top + 1;
-            ibot = bot;
-            if (itop < 0)
-                itop = 0;
-            if (itop > ny - 1)
-                itop = ny - 1;
-            if (ibot < 0)
-                ibot = 0;
-            if (ibot > ny - 1)
-                ibot = ny - 1;
-            for (y = ibot; y < itop; y++) {
-                 lambda11 = wdata[x + y*nx];
-                 if (lambda11 < 1.0)        /* Impossible wavelength */
-                     continue;
-                 space11 = sdata[x + y*nx];
-                 if (space11 < 0.0)         /* Impossible spatial coordinate */
-                     continue;
-                 lambda01 = wdata[x - 1 + y*nx];
-                 if (lambda01 < 1.0)        /* Impossible wavelength */
-                     continue;
-                 space01 = sdata[x - 1 + y*nx];
-                 if (space01 < 0.0)         /* Impossible spatial coordinate */
-                     continue;
-
-                 shift = 0;
-
-/****+
-                 if (wdata[x + (y+1)*nx] > 1.0) {
-                     if (wdata[x + (y+1)*nx] - lambda11 > 0) {
-                         shift = -1;
-                         while (wdata[x + shift + (y+1)*nx] - lambda11 > 0)
-                             shift--;
-                         if (lambda11 - wdata[x + shift + (y+1)*nx] > 
-                             wdata[x + shift + 1 + (y+1)*nx] - lambda11) {
-                             shift++;
-                         }
-                     }
-                     else {
-                         shift = 1;
-                         while (wdata[x + shift + (y+1)*nx] - lambda11 < 0)
-                             shift++;
-                         if (wdata[x + shift + (y+1)*nx] - lambda11 >
-                             lambda11 - wdata[x + shift + 1 + (y+1)*nx]) {
-                             shift--;
-                         }
-                     }
-                 }
-****/
-
-/****
-printf("y = %d, shift = %d\n", y, shift);
-****/
-
-                 lambda10 = wdata[x + shift + (y+1)*nx];
-                 if (lambda10 < 1.0)        /* Impossible wavelength */
-                     continue;
-                 space10 = sdata[x + shift + (y+1)*nx];
-                 if (space10 < 0.0)         /* Impossible spatial coordinate */
-                     continue;
-                 lambda00 = wdata[x - 1 + shift + (y+1)*nx];
-                 if (lambda00 < 1.0)        /* Impossible wavelength */
-                     continue;
-                 space00 = sdata[x - 1 + shift + (y+1)*nx];
-                 if (space00 < 0.0)         /* Impossible spatial coordinate */
-                     continue;
-                 
-                 /*
-                  * Find the variation in lambda and space in this
-                  * position for each CCD pixel (both quantities are 
-                  * expected to be positive).
-                  */
-
-                 dL = lambda11 - lambda01;
-                 dS = space11 - space10;
-
-                 /*
-                  * Find the position (L,S) of the output pixel 
-                  * (by integer truncation).
-                  */
-
-                 L = (lambda11 - blue)/dispersion + 0.5;
-                 S = space11 + 0.5;                   /* Counted from top! */
-
-                 if (L < 0 || L >= nlambda)
-                     continue;
-                 if (S < 0 || S > npseudo)
-                     continue;
-
-                 /*
-                  * Find the coordinate of pixel (L,S)
-                  */
-
-                 lambda = blue + L*dispersion;
-                 space  = S;
-
-                 /*
-                  * Find the interpolation point on the CCD: it is
-                  * defined as the (positive) distance from current
-                  * CCD pixel (x,y) of the interpolation point (x',y'),
-                  * measured in CCD pixels. The interpolation point
-                  * is located between the four CCD pixels selected
-                  * above.
-                  */
-
-                 xfrac = (lambda11-lambda)/dL;
-                 yfrac = (space11-space)/dS;
-
-/*
-if (xfrac < 0.0 || xfrac > 1.0 || yfrac < 0.0 || yfrac > 1.0)
-printf("xyfrac = %f, %f\n", xfrac, yfrac);
-*/
-
-                 /*
-                  * Get the four values to interpolate
-                  */
-
-                 value11 = data[x + y*nx];
-                 value01 = data[x - 1 + y*nx];
-                 value10 = data[x + shift + (y+1)*nx];
-                 value00 = data[x + shift - 1 + (y+1)*nx];
+        first[i] = start_pixel;
+        last[i] = end_pixel > start_pixel ? end_pixel : start_pixel;
+        trace[i] = cpl_malloc((2 * (last[i] - start_pixel) + 1)
+                              * sizeof(double));
 
-                 /*
-                  * Interpolation
-                  */
-
-                 value1 = (1-xfrac)*value11 + xfrac*value01;
-                 value0 = (1-xfrac)*value10 + xfrac*value00;
-                 value  = (1-yfrac)*value1  + yfrac*value0;
-
-                 /*
-                  * Write this value to the appropriate (L,S) coordinate
-                  * on output slit
-                  */
-
-                 xdata[L + nlambda*(npseudo-S)] = value;
-                 
-            }
+        for (x = start_pixel; x < end_pixel; x++) {
+            trace[i][2 * (x - start_pixel)] =
+                cpl_polynomial_eval_1d(polytop, x, NULL);
+            trace[i][2 * (x - start_pixel) + 1] =
+                cpl_polynomial_eval_1d(polybot, x, NULL);
         }
+
         cpl_polynomial_delete(polytop);
         cpl_polynomial_delete(polybot);
     }
 
     /*
-     * Now all the slits images are copied to a single image
+     * The slit spectra are stacked on a single image, in reverse order
+     * from its top
      */
 
     ysize = 0;
     for (i = 0; i < nslits; i++)
-        if (exslit[i])
-            ysize += cpl_image_get_size_y(exslit[i]);
+        ysize += height[i];
 
     remapped = cpl_image_new(nlambda, ysize, CPL_TYPE_FLOAT);
 
+    if (remapped == NULL) {
+        for (i = 0; i < nslits; i++)
+            cpl_free(trace[i]);
+        cpl_free(trace);
+        cpl_free(first);
+        cpl_free(last);
+        cpl_free(height);
+        cpl_free(offset);
+        return NULL;
+    }
+
+    rdata = cpl_image_get_data(remapped);
+
     yint = -1;
     for (i = 0; i < nslits; i++) {
-        if (exslit[i]) {
-            yint += cpl_image_get_size_y(exslit[i]);
-            cpl_image_copy(remapped, exslit[i], 1, ysize - yint);
-            cpl_image_delete(exslit[i]);
-            cpl_table_set_int(slits, "position", i, ysize - yint - 1);
+        if (height[i]) {
+            yint += height[i];
+            offset[i] = ysize - yint - 1;
+            cpl_table_set_int(slits, "position", i, offset[i]);
+        }
+    }
+
+    /*
+     * Write interpolated spectral values to remapped slit spectra.
+     * The slits are independent, and each one is written to its own
+     * rows.
+     */
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (i = 0; i < nslits; i++) {
+        if (height[i]) {
+            mos_map_slit(data, wdata, sdata, nx, ny, trace[i],
+                         first[i], last[i], height[i] - 1, nlambda,
+                         blue, dispersion, rdata + nlambda * offset[i]);
         }
     }
 
-    cpl_free(exslit);
+    for (i = 0; i < nslits; i++)
+        cpl_free(trace[i]);
+    cpl_free(trace);
+    cpl_free(first);
+    cpl_free(last);
+    cpl_free(height);
+    cpl_free(offset);
 
     return remapped;
 
 }
 
 
+/*
+ * Collect the values of all the valid pixels of a spectral image into
+ * their wavelength bins, using a single contiguous buffer. The bins are
+ * defined as in mos_sky_map() and mos_sky_map_super(), and count[] must
+ * contain the number of pixels falling in each bin. On return the values
+ * of bin i are found at positions offset[i] to offset[i+1] - 1 of the
+ * returned buffer, in image order, and if nwave is not zero the
+ * corresponding wavelengths are found at the same positions plus
+ * offset[nbin]. The returned buffer and the array of nbin + 1 offsets
+ * must be deallocated with cpl_free().
+ */
+
+static double *mos_sky_bins(const float *wave, const float *flux, int npix,
+                            double firstLambda, double dispersion,
+                            const int *count, int nbin, int nwave,
+                            int **offset)
+{
+    double *values;
+    int    *first;
+    int     total;
+    int     bin;
+    int     i, pos;
+
+
+    first = cpl_malloc((nbin + 1) * sizeof(int));
+
+    first[0] = 0;
+    for (i = 0; i < nbin; i++)
+        first[i + 1] = first[i] + count[i];
+
+    total = first[nbin];
+    values = cpl_malloc((nwave ? 2 * total : total) * sizeof(double));
+
+    /*
+     * While filling the buffer first[bin] is used as the insertion point
+     * of each bin, and it ends up at the start of the following bin.
+     */
+
+    for (i = 0; i < npix; i++) {
+        if (wave[i] < 1.0)
+            continue;
+        bin = (wave[i] - firstLambda) / dispersion;
+        if (bin < nbin) {                             /* Safer */
+            pos = first[bin]++;
+            values[pos] = flux[i];
+            if (nwave)
+                values[total + pos] = wave[i];
+        }
+    }
+
+    for (i = nbin; i > 0; i--)
+        first[i] = first[i - 1];
+    first[0] = 0;
+
+    *offset = first;
+
+    return values;
+
+}
+
+
 /** 
  * @brief
  *   Create a CCD median sky map
@@ -12808,8 +13187,8 @@ cpl_table *mos_sky_map_super(cpl_image *spectra, cpl_image *wavemap,
 {
     const char *func = "mos_sky_map_super";
 
-    cpl_vector **vector;
-    cpl_vector **wvector;
+    double      *values;
+    int         *offset;
     double       firstLambda, lastLambda;
     double       lambda, lambda1, lambda2;
     double       value, value1, value2;
@@ -12941,64 +13320,40 @@ cpl_table *mos_sky_map_super(cpl_image *spectra, cpl_image *wavemap,
     }
 
 
-    /*
-     * Allocate an array of vectors with the appropriate size, to
-     * contain a list of all the spectral pixels values. At the same
-     * time, reset the array of counters (because we will have to
-     * count again...).
-     */
-
-    vector = cpl_calloc(nbin, sizeof(cpl_vector *));
-    wvector = cpl_calloc(nbin, sizeof(cpl_vector *));
-    for (i = 0; i < nbin; i++) {
-        if (count[i] >= minpoints) {
-            vector[i] = cpl_vector_new(count[i]);
-            wvector[i] = cpl_vector_new(count[i]);
-        }
-        count[i] = 0;
-    }
-
-
     /*
      * Read the wavemap and the spectral images, and add the data values
-     * to the appropriate wavelength bins
+     * and their wavelengths to the appropriate wavelength bins
      */
 
     data  = cpl_image_get_data(wavemap);
     sdata = cpl_image_get_data(spectra);
 
-    for (i = 0; i < npix; i++) {
-        if (data[i] < 1.0)
-            continue;
-        bin = (data[i] - firstLambda) / dispersion;
-        if (bin < nbin) {                             /* Safer */
-            if (vector[bin]) {
-                cpl_vector_set(vector[bin], count[bin], sdata[i]);
-                cpl_vector_set(wvector[bin], count[bin], data[i]);
-            }
-            count[bin]++;
-        }
-    }
+    values = mos_sky_bins(data, sdata, npix, firstLambda, dispersion,
+                          count, nbin, 1, &offset);
 
 
     /*
-     * Compute the median flux for each wavelength bin, and destroy
-     * at the same time the used vectors
+     * Compute the median flux and wavelength for each wavelength bin.
+     * The bins are independent, and the medians are computed in place.
      */
 
     sky_spectrum = cpl_calloc(nbin, sizeof(double));
     sky_wave = cpl_calloc(nbin, sizeof(double));
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
     for (i = 0; i < nbin; i++) {
-        if (vector[i]) {
-            sky_spectrum[i] = cpl_vector_get_median_const(vector[i]);
-            sky_wave[i] = cpl_vector_get_median_const(wvector[i]);
-            cpl_vector_delete(vector[i]);
-            cpl_vector_delete(wvector[i]);
+        if (count[i] >= minpoints && count[i] > 0) {
+            sky_spectrum[i] = cpl_tools_get_median_double(values + offset[i],
+                                                          count[i]);
+            sky_wave[i] = cpl_tools_get_median_double(values + offset[nbin]
+                                                      + offset[i], count[i]);
         }
     }
 
-    cpl_free(vector);
-    cpl_free(wvector);
+    cpl_free(values);
+    cpl_free(offset);
 
 
     /*
@@ -13150,7 +13505,8 @@ cpl_table *mos_sky_map(cpl_image *spectra, cpl_image *wavemap,
 {
     const char *func = "mos_sky_map";
 
-    cpl_vector **vector;
+    double      *values;
+    int         *offset;
     double       firstLambda, lastLambda;
     double       lambda, lambda1, lambda2;
     double       value, value1, value2;
@@ -13244,23 +13600,6 @@ cpl_table *mos_sky_map(cpl_image *spectra, cpl_image *wavemap,
     }
 
 
-    /*
-     * Allocate an array of vectors with the appropriate size, to
-     * contain a list of all the spectral pixels values. At the same
-     * time, reset the array of counters (because we will have to
-     * count again...).
-     */
-
-    vector = cpl_calloc(nbin, sizeof(cpl_vector *));
-    for (i = 0; i < nbin; i++) {
-        if (count[i])
-            vector[i] = cpl_vector_new(count[i]);
-        else
-            vector[i] = NULL;
-        count[i] = 0;
-    }
-
-
     /*
      * Read the wavemap and the spectral images, and add the data values
      * to the appropriate wavelength bins
@@ -13269,31 +13608,26 @@ cpl_table *mos_sky_map(cpl_image *spectra, cpl_image *wavemap,
     data  = cpl_image_get_data(wavemap);
     sdata = cpl_image_get_data(spectra);
 
-    for (i = 0; i < npix; i++) {
-        if (data[i] < 1.0)
-            continue;
-        bin = (data[i] - firstLambda) / dispersion;
-        if (bin < nbin) {                             /* Safer */
-            cpl_vector_set(vector[bin], count[bin], sdata[i]);
-            count[bin]++;
-        }
-    }
+    values = mos_sky_bins(data, sdata, npix, firstLambda, dispersion,
+                          count, nbin, 0, &offset);
 
 
     /*
-     * Compute the median flux for each wavelength bin, and destroy
-     * at the same time the used vectors
+     * Compute the median flux for each wavelength bin
      */
 
     sky_spectrum = cpl_calloc(nbin, sizeof(double));
-    for (i = 0; i < nbin; i++) {
-        if (vector[i]) {
-            sky_spectrum[i] = cpl_vector_get_median_const(vector[i]);
-            cpl_vector_delete(vector[i]);
-        }
-    }
 
-    cpl_free(vector);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+    for (i = 0; i < nbin; i++)
+        if (count[i])
+            sky_spectrum[i] = cpl_tools_get_median_double(values + offset[i],
+                                                          count[i]);
+
+    cpl_free(values);
+    cpl_free(offset);
 
 
     /*
@@ -13336,6 +13670,8 @@ cpl_table *mos_sky_map(cpl_image *spectra, cpl_image *wavemap,
         if (lambda < 1.0)
             continue;
         bin = (lambda - firstLambda) / dispersion;
+        if (bin >= nbin)                               /* Safer */
+            continue;
         lambda1 = wdata[bin];
         value1 = sky_spectrum[bin];
         if (lambda1 < lambda) {
@@ -13823,6 +14159,124 @@ cpl_image *mos_sky_local(cpl_image *spectra, cpl_table *slits, int order)
 }
 
 
+/*
+ * Find the position of the maximum of a group of contiguous cosmic ray
+ * candidates, when the maximum value is reached by more than one pixel.
+ * The candidates of the group are given as runs (see mos_clean_cosmics()),
+ * linked through next[] starting from run "head". The group is grown
+ * again on a local grid exactly as originally done by mos_clean_cosmics()
+ * (a depth-first exploration of the 4 nearest neighbours, restarted
+ * from the leftovers in the search box), so that among equal maxima the
+ * first one reached by the exploration is selected.
+ */
+
+static void mos_cosmic_group_max(const float *idata, int xLen,
+                                 const int *run_y, const int *run_x0,
+                                 const int *run_x1, const int *next, int head,
+                                 int iMin, int iMax, int jMin, int jMax,
+                                 int *iPosMax, int *jPosMax)
+{
+    int    nx = iMax - iMin + 3;
+    int    ny = jMax - jMin + 3;
+    int   *flag = cpl_calloc(nx * ny, sizeof(int));
+    int    r, i, j, k, l, ii, jj, iii = 0, jjj = 0;
+    int    bMin, bMax, cMin, cMax;
+    int    foundContiguousCandidate;
+    float  fMax;
+
+
+    /*
+     * Local coordinates have a margin of one pixel around the group
+     */
+
+    for (r = head; r >= 0; r = next[r])
+        for (i = run_x0[r]; i <= run_x1[r]; i++)
+            flag[(i - iMin + 1) + (run_y[r] - jMin + 1) * nx] = -1;
+
+    i = run_x0[head] - iMin + 1;
+    j = run_y[head] - jMin + 1;
+    flag[i + j * nx] = 2;
+
+    bMin = bMax = *iPosMax = i;
+    cMin = cMax = *jPosMax = j;
+    fMax = idata[(i + iMin - 1) + (j + jMin - 1) * xLen];
+
+    do {
+        foundContiguousCandidate = 0;
+        for (l = 0; l <= 1; l++) {
+            for (k = 0; k <= 1; k++) {
+                ii = i + k - l;
+                jj = j + k + l - 1;
+                if (flag[ii + jj * nx] == -1) {
+                    foundContiguousCandidate = 1;
+                    flag[ii + jj * nx] = 2;
+                    iii = ii;
+                    jjj = jj;
+
+                    if (ii < bMin)
+                        bMin = ii;
+                    if (ii > bMax)
+                        bMax = ii;
+                    if (jj < cMin)
+                        cMin = jj;
+                    if (jj > cMax)
+                        cMax = jj;
+
+                    if (idata[(ii + iMin - 1) + (jj + jMin - 1) * xLen] 
+                        > fMax) {
+                        fMax = idata[(ii + iMin - 1) + (jj + jMin - 1) * xLen];
+                        *iPosMax = ii;
+                        *jPosMax = jj;
+                    }
+                }
+            }
+        }
+
+        flag[i + j * nx] = 3;
+
+        if (foundContiguousCandidate) {
+            i = iii;
+            j = jjj;
+            continue;
+        }
+
+        for (l = cMin; l <= cMax; l++) {
+            for (k = bMin; k <= bMax; k++) {
+                if (flag[k + l * nx] == 2) {
+                    i = k;
+                    j = l;
+                    foundContiguousCandidate = 1;
+                    break;
+                }
+            }
+            if (foundContiguousCandidate)
+                break;
+        }
+    } while (foundContiguousCandidate);
+
+    *iPosMax += iMin - 1;
+    *jPosMax += jMin - 1;
+
+    cpl_free(flag);
+}
+
+static int mos_cosmic_find(int *parent, int r)
+{
+    int root = r;
+
+    while (parent[root] != root)
+        root = parent[root];
+
+    while (parent[r] != root) {
+        int up = parent[r];
+        parent[r] = root;
+        r = up;
+    }
+
+    return root;
+}
+
+
 /**
  * @brief
  *   Remove cosmic rays from sky-subtracted CCD spectral exposure.
@@ -13849,43 +14303,48 @@ cpl_error_code mos_clean_cosmics(cpl_image *image, float gain,
 {
     const char *func = "mos_clean_cosmics";
 
-    cpl_image  *smoothImage;
-    cpl_table  *table;
-    cpl_matrix *kernel;
-    int        *xdata;
-    int        *ydata;
-    float      *idata;
-    float      *sdata;
-    float       sigma, sum, value, smoothValue;
-    double      noise;
-    int         count;
-    float       fMax;
-    int         iMin, iMax, jMin, jMax, iPosMax, jPosMax;
-    int         xLen;
-    int         yLen;
-    int         nPix;
-    int         first = 1;  /* position of first cosmic ray candidate
-                               encountered while scanning the image */
-    int         pos, i, j, k, l, ii, jj, iii = 0, jjj = 0;
-    int         numCosmic = 0;
-    int         found, foundContiguousCandidate;
-    int        *cosmic;
-  
+    cpl_image     *smoothImage;
+    cpl_table     *table;
+    cpl_matrix    *kernel;
+    int           *xdata;
+    int           *ydata;
+    float         *idata;
+    float         *sdata;
+    float          sigma, sum, value, smoothValue;
+    double         noise;
+    int            count;
+    int            xLen;
+    int            yLen;
+    int            nPix;
+    int            pos, i, j, k, l, r, q;
+    int            numCosmic = 0;
+    unsigned char *cosmic;
 
-    if (image == NULL)
-        return cpl_error_set(func, CPL_ERROR_NULL_INPUT);
+    /*
+     * Cosmic ray candidates, as runs of contiguous pixels along x
+     */
 
+    int           *run_y  = NULL;
+    int           *run_x0 = NULL;
+    int           *run_x1 = NULL;
+    int            nRuns = 0;
+    int            maxRuns = 0;
+    int            currFirst;
 
     /*
-     *  "cosmic" is a flags holder (initialized to zero):
-     *
-     *           -1 = candidate for cosmic ray
-     *            0 = not a cosmic
-     *            1 = a cosmic ray
-     *            2 = member of current group of contiguous candidates
-     *            3 = examined member of current group
+     * Groups of contiguous candidates, indexed by their root run
      */
 
+    int           *parent, *head, *tail, *next, *order;
+    int           *iMin, *iMax, *jMin, *jMax, *posMax;
+    char          *ties;
+    float         *fMax;
+    int            nGroups = 0;
+  
+
+    if (image == NULL)
+        return cpl_error_set(func, CPL_ERROR_NULL_INPUT);
+
     xLen = cpl_image_get_size_x(image);
     yLen = cpl_image_get_size_y(image);
 
@@ -13929,8 +14388,6 @@ cpl_error_code mos_clean_cosmics(cpl_image *image, float gain,
     noise /= count;
     noise *= 1.25;       /* Factor to convert average deviation to sigma */
 
-    cosmic = cpl_calloc(nPix, sizeof(int));
-
     if (threshold < 0.)
         threshold = 4.0;
     if (ratio < 0.)
@@ -13944,189 +14401,205 @@ cpl_error_code mos_clean_cosmics(cpl_image *image, float gain,
     
     /*
      *  Loop on images pixels, searching for cosmic rays candidates.
-     *  Border pixels are currently excluded (they cannot contain
-     *  candidates), to avoid that the search for groups of contiguous
-     *  pixels would ever go out of image boundaries. In future we may
-     *  overcome this limit, adding an appropriate check when contiguous
-     *  pixels are searched.
+     *  Border pixels are excluded (they cannot contain candidates).
+     *  The candidates are collected as runs along x, in raster order,
+     *  and each run is joined (union-find) with the runs of the previous
+     *  row that it touches: this labels all groups of 4-connected
+     *  candidates in a single pass.
      */
 
     sdata = cpl_image_get_data(smoothImage);
 
     for (j = 1; j < yLen - 1; j++) {
+        currFirst = nRuns;
         for (i = 1; i < xLen - 1; i++) {
             value = idata[i + j * xLen];
             smoothValue = sdata[i + j * xLen];
             if (smoothValue < 1.0)
                 smoothValue = 1.0;
             sigma = sqrt(noise * noise + smoothValue / gain);
-            if (value - smoothValue >= threshold * sigma) 
-                cosmic[i + j * xLen] = -1;
+            if (value - smoothValue >= threshold * sigma) {
+                if (nRuns > currFirst && run_x1[nRuns - 1] == i - 1) {
+                    run_x1[nRuns - 1] = i;
+                }
+                else {
+                    if (nRuns == maxRuns) {
+                        maxRuns = maxRuns ? 2 * maxRuns : 1024;
+                        run_y  = cpl_realloc(run_y,  maxRuns * sizeof(int));
+                        run_x0 = cpl_realloc(run_x0, maxRuns * sizeof(int));
+                        run_x1 = cpl_realloc(run_x1, maxRuns * sizeof(int));
+                    }
+                    run_y[nRuns] = j;
+                    run_x0[nRuns] = run_x1[nRuns] = i;
+                    nRuns++;
+                }
+            }
         }
     }
 
     cpl_image_delete(smoothImage);
 
+    cosmic = cpl_calloc((nPix + 7) / 8, 1);
 
-    /*
-     *  Search for groups of contiguous cosmic rays candidates.
-     */
-
-    do {
-        found = 0;
-        for (pos = first; pos < nPix; pos++) {
-            if (cosmic[pos] == -1) {
-                cosmic[pos] = 2;         /*  Candidate found.  */
-                i = pos % xLen;          /*  Its coordinates.  */
-                j = pos / xLen;
-                first = pos;
-                first++;      /* ???  really necessary? */
-                found = 1;
-                break;
-            }
-        }
-
-        if (found) {
-
-            /*
-             *  Determine new group of contiguous cosmic rays candidates.
-             *  Initialize the working box boundaries, iMin, iMax, jMin, jMax, 
-             *  and the value of the max pixel and its position, fMax, iPosMax,
-             *  jPosMax.
-             */
+    if (nRuns) {
 
-            iMin = iMax = iPosMax = i;
-            jMin = jMax = jPosMax = j;
-            fMax = idata[i + j * xLen];
+        parent = cpl_malloc(nRuns * sizeof(int));
+        next   = cpl_malloc(nRuns * sizeof(int));
+        head   = cpl_malloc(nRuns * sizeof(int));
+        tail   = cpl_malloc(nRuns * sizeof(int));
+        order  = cpl_malloc(nRuns * sizeof(int));
+        iMin   = cpl_malloc(nRuns * sizeof(int));
+        iMax   = cpl_malloc(nRuns * sizeof(int));
+        jMin   = cpl_malloc(nRuns * sizeof(int));
+        jMax   = cpl_malloc(nRuns * sizeof(int));
+        posMax = cpl_malloc(nRuns * sizeof(int));
+        fMax   = cpl_malloc(nRuns * sizeof(float));
+        ties   = cpl_malloc(nRuns * sizeof(char));
 
-            do {
-                foundContiguousCandidate = 0;
-                for (l = 0; l <= 1; l++) {
-                    for (k = 0; k <= 1; k++) {
+        for (r = 0; r < nRuns; r++) {
+            parent[r] = r;
+            head[r] = -1;
+        }
 
-                        /*
-                         *  Looping on 4 pixels to North, East, South and West
-                         */
+        /*
+         *  Join the runs overlapping in x with runs of the previous row.
+         */
 
-                        ii = i + k - l;
-                        jj = j + k + l - 1;
-                        if (cosmic[ii + jj * xLen] == -1) {
-                            foundContiguousCandidate = 1;
-                            cosmic[ii + jj * xLen] = 2;
-                                        /* Candidate belongs to current group */
-                            iii = ii;   /* Keep its position */
-                            jjj = jj;
-
-                            /*
-                             * Upgrade search box
-                             */
-
-                            if (ii < iMin)
-                                iMin = ii;
-                            if (ii > iMax)
-                                iMax = ii;
-                            if (jj < jMin)
-                                jMin = jj;
-                            if (jj > jMax)
-                                jMax = jj;
-
-                            if (idata[ii + jj * xLen] > fMax) {
-                                fMax = idata[ii + jj * xLen];
-                                iPosMax = ii;
-                                jPosMax = jj;
-                            }
-                        }
-                    }
+        for (r = 0, q = 0; r < nRuns; r++) {
+            while (q < r && (run_y[q] < run_y[r] - 1 || 
+                   (run_y[q] == run_y[r] - 1 && run_x1[q] < run_x0[r])))
+                q++;
+            for (k = q; k < r && run_y[k] == run_y[r] - 1 
+                 && run_x0[k] <= run_x1[r]; k++) {
+                int a = mos_cosmic_find(parent, k);
+                int b = mos_cosmic_find(parent, r);
+                if (a != b) {
+                    if (a < b)
+                        parent[b] = a;
+                    else
+                        parent[a] = b;
                 }
+            }
+        }
 
-                /*
-                 *  We are done exploring the "cross". Now mark as "examined"
-                 *  the current candidate (at the center of the cross):
-                 */
-
-                cosmic[i + j * xLen] = 3; /* It may probably be set to 1 now */
-
-                if (foundContiguousCandidate) {
-
-                    /*
-                     * Pass (arbitrarily) the coordinates of the LAST found 
-                     * candidate
-                     */
-
-                    i = iii;
-                    j = jjj;
+        /*
+         *  Collect the groups in the order of their first pixel, which
+         *  is the order in which a raster scan would meet them, with
+         *  their search box and their maximum.
+         */
 
-                    /* 
-                     * Skip the rest, continue loop on new candidate 
-                     */
+        for (r = 0; r < nRuns; r++) {
+            int g = mos_cosmic_find(parent, r);
+            int y = run_y[r];
+
+            if (head[g] < 0) {
+                order[nGroups++] = g;
+                head[g] = tail[g] = r;
+                iMin[g] = run_x0[r];
+                iMax[g] = run_x1[r];
+                jMin[g] = jMax[g] = y;
+                fMax[g] = idata[run_x0[r] + y * xLen];
+                posMax[g] = run_x0[r] + y * xLen;
+                ties[g] = 0;
+            }
+            else {
+                next[tail[g]] = r;
+                tail[g] = r;
+                if (run_x0[r] < iMin[g])
+                    iMin[g] = run_x0[r];
+                if (run_x1[r] > iMax[g])
+                    iMax[g] = run_x1[r];
+                if (y > jMax[g])
+                    jMax[g] = y;
+            }
+            next[r] = -1;
 
-                    continue; 
+            for (i = run_x0[r]; i <= run_x1[r]; i++) {
+                pos = i + y * xLen;
+                if (pos == posMax[g])
+                    continue;
+                if (idata[pos] > fMax[g]) {
+                    fMax[g] = idata[pos];
+                    posMax[g] = pos;
+                    ties[g] = 0;
                 }
-
-
-                /*
-                 *  Look for leftovers in the (growing!) search box
-                 */
-
-                for (l = jMin; l <= jMax; l++) {
-                    for (k = iMin; k <= iMax; k++) {
-                        if (cosmic[k + l * xLen] == 2) {
-                            i = k;
-                            j = l;
-                            foundContiguousCandidate = 1;
-                            break;
-                        }
-                    }
-                    if (foundContiguousCandidate) 
-                        break;
+                else if (idata[pos] == fMax[g]) {
+                    ties[g] = 1;
                 }
-            } while (foundContiguousCandidate);
+            }
+        }
 
+        /*
+         *  Decide for each group whether it is a cosmic ray or not.
+         *  A group that is not a cosmic ray also cancels the cosmic
+         *  rays found so far around its search box.
+         */
 
-            /*
-             *  No more contiguous candidates are found. Decide now
-             *  whether the current group is a cosmic ray or not.
-             */
+        for (k = 0; k < nGroups; k++) {
+            int g = order[k];
+            int iPosMax = posMax[g] % xLen;
+            int jPosMax = posMax[g] / xLen;
+
+            if (ties[g])
+                mos_cosmic_group_max(idata, xLen, run_y, run_x0, run_x1,
+                                     next, head[g], iMin[g], iMax[g],
+                                     jMin[g], jMax[g], &iPosMax, &jPosMax);
 
             sum = 0.;                /* Sum of 8 pixels around max position */
             for (l = -1; l <= 1; l++) {
-                for (k = -1; k <= 1; k++) {
-                    if (l != 0 || k != 0) {
-                        sum += idata[iPosMax + k + (jPosMax + l) * xLen];
+                for (i = -1; i <= 1; i++) {
+                    if (l != 0 || i != 0) {
+                        sum += idata[iPosMax + i + (jPosMax + l) * xLen];
                     }
                 }
             }
 
             sum /= 8.;
-            if (fMax > ratio * sum) {
-                for (l = jMin - 1; l <= jMax + 1; l++) {
-                    for (k = iMin - 1; k <= iMax + 1; k++) {
-                        if (cosmic[k + l * xLen] == 3) {
-                            cosmic[k + l * xLen] = 1;
-                            numCosmic++;
-                        }
+            if (fMax[g] > ratio * sum) {
+                for (r = head[g]; r >= 0; r = next[r]) {
+                    for (i = run_x0[r]; i <= run_x1[r]; i++) {
+                        pos = i + run_y[r] * xLen;
+                        cosmic[pos >> 3] |= 1 << (pos & 7);
                     }
                 }
             }
             else {
-                for (l = jMin - 1; l <= jMax + 1; l++) {
-                    for (k = iMin - 1; k <= iMax + 1; k++) {
-                        if (cosmic[k + l * xLen] != -1) {
-                            if (cosmic[k + l * xLen] == 1) 
-                                numCosmic--;
-                            cosmic[k + l * xLen] = 0;
-                        }
+                for (l = jMin[g] - 1; l <= jMax[g] + 1; l++) {
+                    for (i = iMin[g] - 1; i <= iMax[g] + 1; i++) {
+                        pos = i + l * xLen;
+                        cosmic[pos >> 3] &= ~(1 << (pos & 7));
                     }
                 }
             }
         }
-    } while (found);
+
+        cpl_free(parent);
+        cpl_free(next);
+        cpl_free(head);
+        cpl_free(tail);
+        cpl_free(order);
+        cpl_free(iMin);
+        cpl_free(iMax);
+        cpl_free(jMin);
+        cpl_free(jMax);
+        cpl_free(posMax);
+        cpl_free(fMax);
+        cpl_free(ties);
+    }
+
+    cpl_free(run_y);
+    cpl_free(run_x0);
+    cpl_free(run_x1);
 
 
     /*
      *  Prepare table containing cosmic rays coordinates. 
      */
 
+    for (pos = 0; pos < nPix; pos++)
+        if (cosmic[pos >> 3] & (1 << (pos & 7)))
+            numCosmic++;
+
     table = cpl_table_new(numCosmic);
     cpl_table_new_column(table, "x", CPL_TYPE_INT);
     cpl_table_new_column(table, "y", CPL_TYPE_INT);
@@ -14136,7 +14609,7 @@ cpl_error_code mos_clean_cosmics(cpl_image *image, float gain,
     ydata = cpl_table_get_data_int(table, "y");
 
     for (pos = 0, i = 0; pos < nPix; pos++) {
-        if (cosmic[pos] == 1) {
+        if (cosmic[pos >> 3] & (1 << (pos & 7))) {
             xdata[i] = (pos % xLen);
             ydata[i] = (pos / xLen);
             i++;
@@ -14153,6 +14626,165 @@ cpl_error_code mos_clean_cosmics(cpl_image *image, float gain,
 }
 
 
+/**
+ * @brief
+ *   Remove cosmic rays from sky-subtracted CCD spectral exposure (LA-Cosmic).
+ *
+ * @param image      Input image to be cleaned (in ADU)
+ * @param gain       Inverse gain factor (e-/ADU)
+ * @param ron        Read-out noise (ADU)
+ * @param sigma_lim  Laplacian detection limit, given in noise sigmas
+ * @param f_lim      Contrast limit between Laplacian and fine structure
+ * @param max_iter   Maximum number of iterations
+ *
+ * @return @c CPL_ERROR_NONE in case of success
+ *
+ * This is an alternative to mos_clean_cosmics(), based on the Laplacian
+ * edge detection of van Dokkum (2001) as implemented by
+ * hdrl_lacosmic_edgedetect(). If @em ron is negative, the image is
+ * assumed to be sky-subtracted and the noise model is the one used by
+ * mos_clean_cosmics(): the background noise is estimated from the
+ * negative pixels of the image. Otherwise the background noise is the
+ * read-out noise. In both cases the photon noise of the signal is added
+ * from the 3x3 median of the image. The detected
+ * pixels are then interpolated by mos_clean_bad_pixels(). As for
+ * mos_clean_cosmics(), images not larger than 3 pixels in either
+ * direction are returned unchanged without setting an error.
+ */
+
+cpl_error_code mos_clean_cosmics_lacosmic(cpl_image *image, float gain,
+                                          float ron, double sigma_lim,
+                                          double f_lim, int max_iter)
+{
+    const char *func = "mos_clean_cosmics_lacosmic";
+
+    cpl_image      *smoothImage;
+    cpl_image      *error;
+    cpl_mask       *kernel;
+    cpl_mask       *cosmics;
+    cpl_table      *table;
+    hdrl_image     *himage;
+    hdrl_parameter *params;
+    const cpl_binary *cdata;
+    float          *idata;
+    float          *sdata;
+    float          *edata;
+    int            *xdata;
+    int            *ydata;
+    double          noise;
+    int             count;
+    int             xLen, yLen, nPix;
+    int             i, pos;
+
+
+    if (image == NULL)
+        return cpl_error_set(func, CPL_ERROR_NULL_INPUT);
+
+    if (gain <= 0.0 || max_iter < 1)
+        return cpl_error_set(func, CPL_ERROR_ILLEGAL_INPUT);
+
+    if (cpl_image_get_type(image) != CPL_TYPE_FLOAT)
+        return cpl_error_set(func, CPL_ERROR_INVALID_TYPE);
+
+    xLen = cpl_image_get_size_x(image);
+    yLen = cpl_image_get_size_y(image);
+
+    if (xLen < 4 || yLen < 4)
+        return CPL_ERROR_NONE;
+
+    nPix = xLen * yLen;
+
+    if (ron < 0.) {
+
+        /*
+         * Noise estimation from negative offsets in image, as in
+         * mos_clean_cosmics().
+         */
+
+        idata = cpl_image_get_data_float(image);
+        noise = 0.0;
+        count = 0;
+
+        for (i = 0; i < nPix; i++) {
+            if (idata[i] < -0.00001) {
+                noise -= idata[i];
+                count++;
+            }
+        }
+
+        if (count == 0)
+            return cpl_error_set(func, CPL_ERROR_DATA_NOT_FOUND);
+
+        noise /= count;
+        noise *= 1.25;   /* Factor to convert average deviation to sigma */
+    }
+    else {
+        noise = ron;
+    }
+
+    kernel = cpl_mask_new(3, 3);
+    cpl_mask_not(kernel);
+    smoothImage = cpl_image_new(xLen, yLen, CPL_TYPE_FLOAT);
+    cpl_image_filter_mask(smoothImage, image, kernel, CPL_FILTER_MEDIAN,
+                          CPL_BORDER_FILTER);
+    cpl_mask_delete(kernel);
+
+    error = cpl_image_new(xLen, yLen, CPL_TYPE_FLOAT);
+    sdata = cpl_image_get_data_float(smoothImage);
+    edata = cpl_image_get_data_float(error);
+
+    for (i = 0; i < nPix; i++) {
+        float signal = sdata[i] > 0.0 ? sdata[i] : 0.0;
+        edata[i] = sqrt(noise * noise + signal / gain);
+    }
+
+    cpl_image_delete(smoothImage);
+
+    himage = hdrl_image_create(image, error);
+    cpl_image_delete(error);
+
+    params = hdrl_lacosmic_parameter_create(sigma_lim, f_lim, max_iter);
+    cosmics = hdrl_lacosmic_edgedetect(himage, params);
+    hdrl_parameter_delete(params);
+    hdrl_image_delete(himage);
+
+    if (cosmics == NULL)
+        return cpl_error_set_where(func);
+
+    /*
+     *  Prepare table containing cosmic rays coordinates.
+     */
+
+    table = cpl_table_new(cpl_mask_count(cosmics));
+    cpl_table_new_column(table, "x", CPL_TYPE_INT);
+    cpl_table_new_column(table, "y", CPL_TYPE_INT);
+    cpl_table_set_column_unit(table, "x", "pixel");
+    cpl_table_set_column_unit(table, "y", "pixel");
+    xdata = cpl_table_get_data_int(table, "x");
+    ydata = cpl_table_get_data_int(table, "y");
+    cdata = cpl_mask_get_data_const(cosmics);
+
+    for (pos = 0, i = 0; pos < nPix; pos++) {
+        if (cdata[pos] == CPL_BINARY_1) {
+            xdata[i] = (pos % xLen);
+            ydata[i] = (pos / xLen);
+            i++;
+        }
+    }
+
+    cpl_msg_debug(func, "%d cosmic ray pixels found", i);
+
+    if (i > 0)
+        mos_clean_bad_pixels(image, table, 1);
+
+    cpl_mask_delete(cosmics);
+    cpl_table_delete(table);
+
+    return CPL_ERROR_NONE;
+
+}
+
+
 cpl_error_code mos_clean_bad_pixels(cpl_image *image, cpl_table *table,
                                     int spectral)
 {
@@ -18910,14 +19542,23 @@ cpl_table *mos_photometric_calibration(cpl_image *spectra, double startwave,
     return table;
 }
 
-static double ksigma_vector(cpl_vector *values, 
+/*
+ * K-sigma clipped mean of n values. The values are permuted and
+ * overwritten. The mean and the standard deviation of the accepted
+ * values are accumulated while the values are compacted, with the
+ * same recurrence relation used by cpl_vector_get_mean() and
+ * cpl_vector_get_stdev(), so that the results do not depend on
+ * which of the two is used.
+ */
+
+static double ksigma_vector(double *data, int n,
                             double klow, double khigh, int kiter, int *good)
 {
-    cpl_vector *accepted;
     double  mean  = 0.0;
     double  sigma = 0.0;
-    double *data  = cpl_vector_get_data(values);
-    int     n     = cpl_vector_get_size(values);
+    double  amean;
+    double  varsum;
+    double  delta;
     int     ngood = n;
     int     count = 0;
     int     i;
@@ -18928,7 +19569,7 @@ static double ksigma_vector(cpl_vector *values,
      * standard deviation relative to this value is computed.
      */
 
-    mean = cpl_vector_get_median(values);
+    mean = cpl_tools_get_median_double(data, n);
 
     for (i = 0; i < n; i++) 
         sigma += (mean - data[i]) * (mean - data[i]);
@@ -18936,9 +19577,14 @@ static double ksigma_vector(cpl_vector *values,
     sigma = sqrt(sigma / (n - 1));
 
     while (kiter) {
-        count = 0;
+        count  = 0;
+        amean  = 0.0;
+        varsum = 0.0;
         for (i = 0; i < ngood; i++) {
             if (data[i]-mean < khigh*sigma && mean-data[i] < klow*sigma) {
+                delta   = data[i] - amean;
+                varsum += (double)count * delta * (delta / (double)(count + 1));
+                amean  += delta / (double)(count + 1);
                 data[count] = data[i];
                 ++count;
             }
@@ -18953,11 +19599,9 @@ static double ksigma_vector(cpl_vector *values,
          * of mean was computed.
          */
 
-        accepted = cpl_vector_wrap(count, data);
-        mean = cpl_vector_get_mean(accepted);
+        mean = amean;
         if (count > 1)
-            sigma = cpl_vector_get_stdev(accepted);
-        cpl_vector_unwrap(accepted);
+            sigma = sqrt(varsum / (double)(count - 1));
 
         if (count == ngood || count == 1)
             break;
@@ -18989,22 +19633,24 @@ static double ksigma_vector(cpl_vector *values,
  * next iterations the sigma is computed in the standard way. If 
  * at some iteration all points would be rejected, the mean computed
  * at the previous iteration is returned.
+ *
+ * The pixels are processed in tiles of MOS_KSIGMA_TILE consecutive
+ * positions: the values of a tile are read image by image, and stored
+ * position by position in a buffer private to the tile. The tiles are
+ * independent, and are stacked in parallel.
  */
 
 cpl_image *mos_ksigma_stack(cpl_imagelist *imlist, 
                             double klow, double khigh, int kiter,
                             cpl_image **good)
 {
-    int         ni, nx, ny, npix;
+    int         ni, nx, ny, npix, ntiles;
     cpl_image  *out_ima;
     float      *pout_ima;
-    float      *good_ima;
+    float      *good_ima = NULL;
     cpl_image  *image;
-    float     **data;
-    cpl_vector *time_line;
-    double     *ptime_line;
-    int         ngood;
-    int         i, j;
+    const float **data;
+    int         i, t;
 
 
     ni         = cpl_imagelist_get_size(imlist);
@@ -19013,6 +19659,7 @@ cpl_image *mos_ksigma_stack(cpl_imagelist *imlist,
     nx         = cpl_image_get_size_x(image);
     ny         = cpl_image_get_size_y(image);
     npix       = nx * ny;
+    ntiles     = (npix + MOS_KSIGMA_TILE - 1) / MOS_KSIGMA_TILE;
     
     out_ima    = cpl_image_new(nx, ny, CPL_TYPE_FLOAT);
     pout_ima   = cpl_image_get_data_float(out_ima);
@@ -19022,28 +19669,43 @@ cpl_image *mos_ksigma_stack(cpl_imagelist *imlist,
         good_ima = cpl_image_get_data_float(*good);
     }
 
-    time_line  = cpl_vector_new(ni);
-    ptime_line = cpl_vector_get_data(time_line);
-
     data = cpl_calloc(sizeof(float *), ni);
     
     for (i = 0; i < ni; i++) {
         image = cpl_imagelist_get(imlist, i);
-        data[i] = cpl_image_get_data_float(image);
+        data[i] = cpl_image_get_data_float_const(image);
     }
 
-    for (i = 0; i < npix; i++) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (t = 0; t < ntiles; t++) {
+        int     first = t * MOS_KSIGMA_TILE;
+        int     size  = npix - first < MOS_KSIGMA_TILE ? 
+                        npix - first : MOS_KSIGMA_TILE;
+        double *tile  = cpl_malloc(size * ni * sizeof(double));
+        int     ngood;
+        int     j, k;
+
         for (j = 0; j < ni; j++) {
-            ptime_line[j] = data[j][i];
+            const float *row = data[j] + first;
+            for (k = 0; k < size; k++) {
+                tile[k * ni + j] = row[k];
+            }
         }
-        pout_ima[i] = ksigma_vector(time_line, klow, khigh, kiter, &ngood);
-        if (good) {
-            good_ima[i] = ngood;
+
+        for (k = 0; k < size; k++) {
+            pout_ima[first + k] = ksigma_vector(tile + k * ni, ni, 
+                                                klow, khigh, kiter, &ngood);
+            if (good_ima) {
+                good_ima[first + k] = ngood;
+            }
         }
+
+        cpl_free(tile);
     }
 
     cpl_free(data);
-    cpl_vector_delete(time_line);
 
     return out_ima;
 
@@ -32,6 +32,16 @@
 
 CPL_BEGIN_DECLS
 
+/*
+ * Calibration context: the state read by the wavelength calibration
+ * and slit identification functions in multiplex mode.
+ */
+
+typedef struct _mos_context_ {
+    int multiplex;      /* CCD region to calibrate, or -1 if disabled */
+    int region_size;    /* Size of a multiplexed CCD region (pixels)  */
+} mos_context;
+
 cpl_table *mos_hough_table(cpl_table *, const char *, const char *);
 cpl_image *mos_remove_bias(cpl_image *, cpl_image *, cpl_table *);
 cpl_image *mos_normalise_flat(cpl_image *, cpl_image *, cpl_table *, 
@@ -43,9 +53,13 @@ cpl_image *mos_arc_background(cpl_image *, int, int);
 int mos_lines_width(const float *, int);
 cpl_vector *mos_peak_candidates(const float *, int, float, float);
 cpl_vector *mos_refine_peaks(const float *, int, cpl_vector *, int);
+void mos_context_init(mos_context *, int);
 void mos_set_multiplex(int);
 cpl_bivector *mos_identify_peaks(cpl_vector *, cpl_vector *,
                                  double, double, double);
+cpl_bivector *mos_identify_peaks_ctx(const mos_context *,
+                                     cpl_vector *, cpl_vector *,
+                                     double, double, double);
 cpl_bivector *mos_identify_peaks_new(cpl_vector *, cpl_vector *,
                                      double, double, double);
 cpl_bivector *mos_find_peaks(const float *, int, cpl_vector *,
@@ -64,6 +78,16 @@ cpl_image *mos_wavelength_calibration_raw(const cpl_image *, cpl_vector *,
                                           cpl_table *detected_lines, 
                                           double disp_tolerance,
                                           double ratio_tolerance);
+cpl_image *mos_wavelength_calibration_raw_ctx(const mos_context *,
+                                              const cpl_image *, cpl_vector *,
+                                              double, float, int, int, double, 
+                                              double, double *, double *, 
+                                              int *, double *, cpl_table *, 
+                                              cpl_image *, cpl_image *, 
+                                              cpl_table *, cpl_mask *,
+                                              cpl_table *detected_lines, 
+                                              double disp_tolerance,
+                                              double ratio_tolerance);
 cpl_error_code mos_interpolate_wavecalib_slit(cpl_table *, cpl_table *, 
                                               int, int);
 cpl_error_code mos_interpolate_wavecalib(cpl_table *, cpl_image *, int, int);
@@ -72,6 +96,8 @@ cpl_table *mos_locate_spectra(cpl_mask *);
 cpl_error_code mos_validate_slits(cpl_table *);
 cpl_error_code mos_rotate_slits(cpl_table *, int, int, int);
 cpl_table *mos_identify_slits(cpl_table *, cpl_table *, cpl_table *);
+cpl_table *mos_identify_slits_ctx(const mos_context *,
+                                  cpl_table *, cpl_table *, cpl_table *);
 cpl_table *mos_identify_slits_fast(cpl_table *, cpl_table *, cpl_table *);
 cpl_table *mos_identify_slits_linear(cpl_table *, cpl_table *);
 cpl_table *mos_trace_flat(cpl_image *, cpl_table *, double,
@@ -119,6 +145,8 @@ cpl_image *mos_sky_local_old(cpl_image *spectra, cpl_table *slits);
 cpl_image *mos_sky_local(cpl_image *, cpl_table *, int);
 
 cpl_error_code mos_clean_cosmics(cpl_image *, float, float, float);
+cpl_error_code mos_clean_cosmics_lacosmic(cpl_image *, float, float, double,
+                                          double, int);
 cpl_error_code mos_clean_bad_pixels(cpl_image *, cpl_table *, int);
 
 double mos_distortions_rms(cpl_image *, cpl_vector *, double, double, int, int);
@@ -83,6 +83,14 @@ cpl_free(wcoeff);                             \
 if(globals != NULL)                           \
   for (i = 0; i < nglobal; i++) cpl_table_delete(globals[i]); \
 cpl_free(globals);                            \
+if(chunkwaves != NULL)                        \
+  for (i = 0; i < nchunks; i++) cpl_image_delete(chunkwaves[i]); \
+cpl_free(chunkwaves);                         \
+if(chunkmasks != NULL)                        \
+  for (i = 0; i < nchunks; i++) cpl_mask_delete(chunkmasks[i]); \
+cpl_free(chunkmasks);                         \
+cpl_free(chunkstart);                         \
+cpl_free(chunkend);                           \
 cpl_image_delete(master_bias);                \
 cpl_image_delete(coordinate);                 \
 cpl_image_delete(checkwave);                  \
@@ -258,6 +266,11 @@ int vimos_calib_mult(cpl_frameset *frameset, cpl_parameterlist *parlist,
 
     cpl_mask         *refmask     = NULL;
 
+    cpl_image       **chunkwaves  = NULL;
+    cpl_mask        **chunkmasks  = NULL;
+    double           *chunkstart  = NULL;
+    double           *chunkend    = NULL;
+
     cpl_table        *grism_table = NULL;
     cpl_table        *idscoeff    = NULL;
     cpl_table        *restable    = NULL;
@@ -328,7 +341,7 @@ int vimos_calib_mult(cpl_frameset *frameset, cpl_parameterlist *parlist,
     int         ccd_xsize, ccd_ysize;
     int         cslit, cslit_id;
     double      xwidth, ywidth = 0;
-    const int   nchunks = 5; // This is ~CCD y size / mos_region_size (moses.c)
+    const int   nchunks = 5; // This is ~CCD y size / multiplex region size (moses.c)
     int         failures;
     int         rotate = 1;
     int         rotate_back = -1;
@@ -823,23 +836,59 @@ int vimos_calib_mult(cpl_frameset *frameset, cpl_parameterlist *parlist,
 
     failures = 0;
 
+    /*
+     * Each multiplexed chunk is calibrated with its own context, so
+     * that the chunks may be processed concurrently. The results are
+     * then collected in chunk order, as if processed one by one.
+     */
+
+    chunkwaves = (cpl_image **)cpl_calloc(nchunks, sizeof(cpl_image *));
+    chunkmasks = (cpl_mask **)cpl_calloc(nchunks, sizeof(cpl_mask *));
+    chunkstart = (double *)cpl_malloc(nchunks * sizeof(double));
+    chunkend = (double *)cpl_malloc(nchunks * sizeof(double));
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
     for (i = 0; i < nchunks; i++) {
 
-        mos_set_multiplex(i);
+        mos_context context;
+
+        mos_context_init(&context, i);
 
-        refmask = cpl_mask_new(nx, ny);
+        chunkstart[i] = startwavelength;
+        chunkend[i] = endwavelength;
+        chunkmasks[i] = cpl_mask_new(nx, ny);
 
-        checkwave = mos_wavelength_calibration_raw(spectra, lines, dispersion, 
+        chunkwaves[i] = mos_wavelength_calibration_raw_ctx(&context, spectra,
+                                                   lines, dispersion, 
                                                    peakdetection, wradius, 
                                                    wdegree, wreject, reference,
-                                                   &startwavelength, 
-                                                   &endwavelength,
+                                                   &chunkstart[i], 
+                                                   &chunkend[i],
                                                    NULL, NULL, NULL, NULL, 
-                                                   NULL, NULL, refmask, NULL,
-                                                   disp_tolerance,
+                                                   NULL, NULL, chunkmasks[i], 
+                                                   NULL, disp_tolerance,
                                                    ratio_tolerance);
+    }
+
+    /*
+     * All chunks derive the same spectral range from the line catalog
+     */
+
+    startwavelength = chunkstart[0];
+    endwavelength = chunkend[0];
+
+    cpl_free(chunkstart); chunkstart = NULL;
+    cpl_free(chunkend); chunkend = NULL;
+
+    for (i = 0; i < nchunks; i++) {
+
+        checkwave = chunkwaves[i]; chunkwaves[i] = NULL;
+        refmask = chunkmasks[i]; chunkmasks[i] = NULL;
 
         if (checkwave == NULL) {
+            cpl_mask_delete(refmask); refmask = NULL;
             failures++;
             continue;
         }
@@ -904,7 +953,8 @@ int vimos_calib_mult(cpl_frameset *frameset, cpl_parameterlist *parlist,
         }
     }
 
-    mos_set_multiplex(1);  // Active
+    cpl_free(chunkwaves); chunkwaves = NULL;
+    cpl_free(chunkmasks); chunkmasks = NULL;
 
     if (failures == nchunks) {
 
@@ -947,7 +997,11 @@ int vimos_calib_mult(cpl_frameset *frameset, cpl_parameterlist *parlist,
         cpl_msg_indent_more();
 
         mos_rotate_slits(allmaskslits, -rotate, 0, 0);
-        positions = mos_identify_slits(slits, allmaskslits, NULL);
+        mos_context context;
+
+        mos_context_init(&context, 1);  // Multiplex mode
+        positions = mos_identify_slits_ctx(&context, slits, allmaskslits, 
+                                           NULL);
 
         if (positions) {
             cpl_table_delete(slits);
@@ -977,8 +1031,6 @@ int vimos_calib_mult(cpl_frameset *frameset, cpl_parameterlist *parlist,
         }
     }
 
-    mos_set_multiplex(-1);  // Disabled
-
     /*
      * Now loop on all groups of un-multiplexed spectra.
      */
@@ -32,13 +32,17 @@
 #include <vimos_dfs.h>
 
 #include <cpl.h>
+#include <fitsio.h>
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
 #include <stdbool.h>
 #include <string.h>
+#include <math.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <sys/stat.h>
 
 /*----------------------------------------------------------------------------*/
 /**
@@ -58,6 +62,7 @@
  -----------------------------------------------------------------------------*/
 static void
 errorstate_dump_one(unsigned self, unsigned first, unsigned last);
+static int dfs_cache_key(const char *, char *);
 
 /*------------------------------------------------------------------------------
     Implementation
@@ -655,7 +660,10 @@ cpl_image *dfs_load_image(cpl_frameset *frameset, const char *category,
     frame = cpl_frameset_find(frameset, category);
 
     if (frame) {
-        image = cpl_image_load(cpl_frame_get_filename(frame), type, 0, ext);
+        const char *filename = cpl_frame_get_filename(frame);
+
+        image = cpl_image_load(filename, type, 0,
+                               dfs_product_extension(filename, ext));
         if (image == NULL) {
             cpl_msg_error(cpl_error_get_where(), "%s", cpl_error_get_message());
             cpl_msg_error(func, "Cannot load image %s",
@@ -688,7 +696,8 @@ cpl_image *dfs_load_image(cpl_frameset *frameset, const char *category,
  * typically are called every time a table should be loaded
  * by a recipe. Error checking and proper messaging are also
  * included here, to give a more readable look to the main
- * recipe code.
+ * recipe code. Tables are loaded through the static calibration
+ * cache, see @c dfs_load_table_cached().
  *
  * In case of any error, a @c NULL pointer is returned. The
  * error codes that are set in this case are the same set by
@@ -710,7 +719,7 @@ cpl_table *dfs_load_table(cpl_frameset *frameset, const char *category, int ext)
     frame = cpl_frameset_find(frameset, category);
 
     if (frame) {
-        table = cpl_table_load(cpl_frame_get_filename(frame), ext, 1);
+        table = dfs_load_table_cached(cpl_frame_get_filename(frame), ext, 1);
         if (table == NULL) {
             cpl_msg_error(cpl_error_get_where(), "%s", cpl_error_get_message());
             cpl_msg_error(func, "Cannot load table %s",
@@ -759,7 +768,12 @@ cpl_propertylist *dfs_load_header(cpl_frameset *frameset,
     frame = cpl_frameset_find(frameset, category);
 
     if (frame) {
-        plist = cpl_propertylist_load(cpl_frame_get_filename(frame), ext);
+        const char *filename = cpl_frame_get_filename(frame);
+
+        if (ext > 0)
+            ext = dfs_product_extension(filename, ext);
+
+        plist = cpl_propertylist_load(filename, ext);
         if (plist == NULL) {
             cpl_msg_error(cpl_error_get_where(), "%s", cpl_error_get_message());
             cpl_msg_error(func, "Cannot load header from %s",
@@ -770,6 +784,519 @@ cpl_propertylist *dfs_load_header(cpl_frameset *frameset,
     return plist;
 }
 
+
+/*
+ * Cache of static calibrations.
+ *
+ * Static calibrations (line catalogs, extinction and flux tables, the
+ * fiber identification reference, ...) are read again by every recipe
+ * run. Their content is identified by the DATAMD5 keyword of the primary
+ * header, which is read directly from the file without opening it with
+ * CFITSIO. Files without DATAMD5, like most of the calibrations delivered
+ * with the pipeline, are identified by device, inode, size and time of
+ * last modification instead. The loaded objects are kept in memory until
+ * the recipe stops (see dfs_cache_clear()), and if the environment
+ * variable VIMOS_STATIC_CACHE names a directory they are also stored
+ * there in a raw binary form, which any later recipe run can read back
+ * without parsing FITS.
+ */
+
+#define DFS_CACHE_MAGIC "VMCACHE1"
+
+typedef struct _dfs_cache_entry_ {
+    char       key[64];
+    int        ext;
+    int        flag;    /* check_nulls for tables, pixel type for images */
+    cpl_table *table;
+    cpl_image *image;
+    struct _dfs_cache_entry_ *next;
+} dfs_cache_entry;
+
+static dfs_cache_entry *dfs_cache = NULL;
+
+/*----------------------------------------------------------------------------*/
+/**
+ * @brief
+ *   Get the cache key of a FITS file.
+ *
+ * @param filename The FITS file name
+ * @param key      Output buffer of at least 64 characters
+ *
+ * @return 1 if a key could be made, 0 otherwise.
+ *
+ * The key is the DATAMD5 keyword of the primary header, whose cards are
+ * scanned directly. If the primary header has no valid DATAMD5 the key
+ * is made from the identity and the modification time of the file.
+ * Compressed files are not identified.
+ */
+/*----------------------------------------------------------------------------*/
+static int dfs_cache_key(const char *filename, char *key)
+{
+    FILE       *fp;
+    struct stat sb;
+    char        card[80];
+    int         ncard;
+    int         found = 0;
+
+
+    if (filename == NULL || stat(filename, &sb) ||
+        (fp = fopen(filename, "rb")) == NULL)
+        return 0;
+
+    /* Up to 100 header blocks of 36 cards each */
+
+    for (ncard = 0; ncard < 3600; ncard++) {
+        if (fread(card, 1, 80, fp) != 80)
+            break;
+        if (ncard == 0 && strncmp(card, "SIMPLE  =", 9))
+            break;
+        if (!strncmp(card, "END     ", 8))
+            break;
+        if (!strncmp(card, "DATAMD5 =", 9)) {
+            const char *q = memchr(card + 9, '\'', 71);
+            int         i;
+
+            if (q == NULL || q + 33 >= card + 80 || q[33] != '\'')
+                break;
+            for (i = 0; i < 32; i++)
+                if (!isxdigit((unsigned char)q[i + 1]))
+                    break;
+            if (i < 32)
+                break;
+            memcpy(key, q + 1, 32);
+            key[32] = '\0';
+            found = 1;
+            break;
+        }
+    }
+
+    fclose(fp);
+
+    if (ncard == 0)
+        return 0;
+
+    if (!found)
+        snprintf(key, 64, "%lx-%lx-%lx-%lx", (unsigned long)sb.st_dev,
+                 (unsigned long)sb.st_ino, (unsigned long)sb.st_size,
+                 (unsigned long)sb.st_mtime);
+
+    return 1;
+}
+
+static dfs_cache_entry *dfs_cache_find(const char *key, int ext, int flag,
+                                       int is_table)
+{
+    dfs_cache_entry *entry;
+
+    for (entry = dfs_cache; entry; entry = entry->next)
+        if (entry->ext == ext && entry->flag == flag &&
+            (is_table ? entry->table != NULL : entry->image != NULL) &&
+            !strcmp(entry->key, key))
+            return entry;
+
+    return NULL;
+}
+
+static void dfs_cache_insert(const char *key, int ext, int flag,
+                             cpl_table *table, cpl_image *image)
+{
+    dfs_cache_entry *entry = cpl_calloc(1, sizeof(dfs_cache_entry));
+
+    strcpy(entry->key, key);
+    entry->ext   = ext;
+    entry->flag  = flag;
+    entry->table = table;
+    entry->image = image;
+    entry->next  = dfs_cache;
+    dfs_cache    = entry;
+}
+
+static char *dfs_cache_path(const char *key, int ext, int flag,
+                            const char *suffix)
+{
+    const char *dir = getenv("VIMOS_STATIC_CACHE");
+
+    if (dir == NULL || dir[0] == '\0' || access(dir, W_OK | X_OK))
+        return NULL;
+
+    return cpl_sprintf("%s/%s-%d-%d.%s", dir, key, ext, flag, suffix);
+}
+
+static void *dfs_cache_column_data(cpl_table *table, const char *name,
+                                   cpl_type type)
+{
+    switch (type) {
+    case CPL_TYPE_INT:
+        return cpl_table_get_data_int(table, name);
+    case CPL_TYPE_FLOAT:
+        return cpl_table_get_data_float(table, name);
+    case CPL_TYPE_DOUBLE:
+        return cpl_table_get_data_double(table, name);
+    default:
+        return NULL;
+    }
+}
+
+static int dfs_cache_write_string(FILE *fp, const char *string)
+{
+    int32_t len = string ? (int32_t)strlen(string) : -1;
+
+    if (fwrite(&len, sizeof len, 1, fp) != 1)
+        return 1;
+    if (len > 0 && fwrite(string, 1, len, fp) != (size_t)len)
+        return 1;
+
+    return 0;
+}
+
+static char *dfs_cache_read_string(FILE *fp, int *error)
+{
+    int32_t len;
+    char   *string;
+
+    if (fread(&len, sizeof len, 1, fp) != 1 || len < -1) {
+        *error = 1;
+        return NULL;
+    }
+    if (len < 0)
+        return NULL;
+
+    string = cpl_malloc(len + 1);
+    if (len > 0 && fread(string, 1, len, fp) != (size_t)len) {
+        cpl_free(string);
+        *error = 1;
+        return NULL;
+    }
+    string[len] = '\0';
+
+    return string;
+}
+
+/*
+ * Write the cache file under a temporary name and rename it, so that
+ * concurrent recipe runs never read a partially written file.
+ */
+
+static void dfs_cache_write(const char *path, cpl_table *table,
+                            const cpl_image *image)
+{
+    char   *tmp = cpl_sprintf("%s.%ld", path, (long)getpid());
+    FILE   *fp  = fopen(tmp, "wb");
+    int     error = 0;
+
+
+    if (fp == NULL) {
+        cpl_free(tmp);
+        return;
+    }
+
+    error |= fwrite(DFS_CACHE_MAGIC, 1, 8, fp) != 8;
+
+    if (table) {
+        cpl_array *names = cpl_table_get_column_names(table);
+        int32_t    ncol  = cpl_table_get_ncol(table);
+        int64_t    nrow  = cpl_table_get_nrow(table);
+        char      *valid = cpl_malloc(nrow > 0 ? nrow : 1);
+        int32_t    i;
+        int64_t    j;
+
+        error |= fwrite(&ncol, sizeof ncol, 1, fp) != 1;
+        error |= fwrite(&nrow, sizeof nrow, 1, fp) != 1;
+
+        for (i = 0; i < ncol && !error; i++) {
+            const char *name = cpl_array_get_string(names, i);
+            int32_t     type = cpl_table_get_column_type(table, name);
+
+            error |= fwrite(&type, sizeof type, 1, fp) != 1;
+            error |= dfs_cache_write_string(fp, name);
+            error |= dfs_cache_write_string(fp,
+                                  cpl_table_get_column_unit(table, name));
+
+            for (j = 0; j < nrow; j++)
+                valid[j] = cpl_table_is_valid(table, name, j);
+            error |= fwrite(valid, 1, nrow, fp) != (size_t)nrow;
+
+            switch (type) {
+            case CPL_TYPE_INT:
+            case CPL_TYPE_FLOAT:
+            case CPL_TYPE_DOUBLE:
+                if (nrow > 0)
+                    error |= fwrite(dfs_cache_column_data(table, name, type),
+                                    cpl_type_get_sizeof(type), nrow, fp)
+                        != (size_t)nrow;
+                break;
+            case CPL_TYPE_STRING:
+                for (j = 0; j < nrow && !error; j++)
+                    error |= dfs_cache_write_string(fp, valid[j] ?
+                                 cpl_table_get_string(table, name, j) : NULL);
+                break;
+            default:
+                /* Array or other columns are not cached */
+                error = 1;
+            }
+        }
+
+        cpl_free(valid);
+        cpl_array_delete(names);
+    }
+    else {
+        int32_t type = cpl_image_get_type(image);
+        int64_t nx   = cpl_image_get_size_x(image);
+        int64_t ny   = cpl_image_get_size_y(image);
+
+        error |= fwrite(&type, sizeof type, 1, fp) != 1;
+        error |= fwrite(&nx, sizeof nx, 1, fp) != 1;
+        error |= fwrite(&ny, sizeof ny, 1, fp) != 1;
+        error |= fwrite(cpl_image_get_data_const(image),
+                        cpl_type_get_sizeof(type), nx * ny, fp)
+            != (size_t)(nx * ny);
+    }
+
+    error |= fclose(fp) != 0;
+
+    if (error || rename(tmp, path))
+        remove(tmp);
+
+    cpl_free(tmp);
+}
+
+static cpl_table *dfs_cache_read_table(const char *path)
+{
+    FILE      *fp = fopen(path, "rb");
+    cpl_table *table = NULL;
+    char       magic[8];
+    char      *valid = NULL;
+    int32_t    ncol, i;
+    int64_t    nrow, j;
+    int        error = 0;
+
+
+    if (fp == NULL)
+        return NULL;
+
+    if (fread(magic, 1, 8, fp) != 8 || memcmp(magic, DFS_CACHE_MAGIC, 8) ||
+        fread(&ncol, sizeof ncol, 1, fp) != 1 ||
+        fread(&nrow, sizeof nrow, 1, fp) != 1 || ncol < 0 || nrow < 0) {
+        fclose(fp);
+        return NULL;
+    }
+
+    table = cpl_table_new(nrow);
+    valid = cpl_malloc(nrow > 0 ? nrow : 1);
+
+    for (i = 0; i < ncol && !error; i++) {
+        int32_t type;
+        char   *name, *unit;
+
+        if (fread(&type, sizeof type, 1, fp) != 1) {
+            error = 1;
+            break;
+        }
+        name = dfs_cache_read_string(fp, &error);
+        unit = dfs_cache_read_string(fp, &error);
+        if (error || name == NULL ||
+            (type != CPL_TYPE_STRING && type != CPL_TYPE_INT &&
+             type != CPL_TYPE_FLOAT && type != CPL_TYPE_DOUBLE) ||
+            fread(valid, 1, nrow, fp) != (size_t)nrow ||
+            cpl_table_new_column(table, name, type)) {
+            cpl_free(name);
+            cpl_free(unit);
+            error = 1;
+            break;
+        }
+        if (unit)
+            cpl_table_set_column_unit(table, name, unit);
+
+        switch (type) {
+        case CPL_TYPE_INT:
+            cpl_table_fill_column_window_int(table, name, 0, nrow, 0);
+            break;
+        case CPL_TYPE_FLOAT:
+            cpl_table_fill_column_window_float(table, name, 0, nrow, 0.0);
+            break;
+        case CPL_TYPE_DOUBLE:
+            cpl_table_fill_column_window_double(table, name, 0, nrow, 0.0);
+            break;
+        default:
+            break;
+        }
+
+        if (type == CPL_TYPE_STRING) {
+            for (j = 0; j < nrow && !error; j++) {
+                char *value = dfs_cache_read_string(fp, &error);
+                if (value)
+                    cpl_table_set_string(table, name, j, value);
+                cpl_free(value);
+            }
+        }
+        else if (nrow > 0) {
+            error = fread(dfs_cache_column_data(table, name, type),
+                          cpl_type_get_sizeof(type), nrow, fp)
+                != (size_t)nrow;
+            for (j = 0; j < nrow && !error; j++)
+                if (!valid[j])
+                    cpl_table_set_invalid(table, name, j);
+        }
+
+        cpl_free(name);
+        cpl_free(unit);
+    }
+
+    cpl_free(valid);
+    fclose(fp);
+
+    if (error) {
+        cpl_table_delete(table);
+        return NULL;
+    }
+
+    return table;
+}
+
+static cpl_image *dfs_cache_read_image(const char *path, cpl_type type)
+{
+    FILE      *fp = fopen(path, "rb");
+    cpl_image *image = NULL;
+    char       magic[8];
+    int32_t    itype;
+    int64_t    nx, ny;
+
+
+    if (fp == NULL)
+        return NULL;
+
+    if (fread(magic, 1, 8, fp) == 8 && !memcmp(magic, DFS_CACHE_MAGIC, 8) &&
+        fread(&itype, sizeof itype, 1, fp) == 1 && itype == (int32_t)type &&
+        fread(&nx, sizeof nx, 1, fp) == 1 && nx > 0 &&
+        fread(&ny, sizeof ny, 1, fp) == 1 && ny > 0) {
+        image = cpl_image_new(nx, ny, type);
+        if (fread(cpl_image_get_data(image), cpl_type_get_sizeof(type),
+                  nx * ny, fp) != (size_t)(nx * ny)) {
+            cpl_image_delete(image);
+            image = NULL;
+        }
+    }
+
+    fclose(fp);
+
+    return image;
+}
+
+/*----------------------------------------------------------------------------*/
+/**
+ * @brief
+ *   Load a table, reusing a cached copy of identical content.
+ *
+ * @param filename    The FITS file name
+ * @param ext         The FITS file extension to access (first = 0)
+ * @param check_nulls As in @c cpl_table_load()
+ *
+ * @return The loaded table, to be deallocated with @c cpl_table_delete()
+ *
+ * Same as @c cpl_table_load(), but if the primary header carries the
+ * DATAMD5 keyword the table is taken from the static calibration cache
+ * when available there, and stored into it otherwise.
+ */
+/*----------------------------------------------------------------------------*/
+cpl_table *dfs_load_table_cached(const char *filename, int ext,
+                                 int check_nulls)
+{
+    dfs_cache_entry *entry;
+    cpl_table       *table;
+    char            *path;
+    char             key[33];
+
+
+    if (!dfs_cache_key(filename, key))
+        return cpl_table_load(filename, ext, check_nulls);
+
+    if ((entry = dfs_cache_find(key, ext, check_nulls, 1)))
+        return cpl_table_duplicate(entry->table);
+
+    path = dfs_cache_path(key, ext, check_nulls, "tbl");
+
+    if (path == NULL || (table = dfs_cache_read_table(path)) == NULL) {
+        table = cpl_table_load(filename, ext, check_nulls);
+        if (table && path)
+            dfs_cache_write(path, table, NULL);
+    }
+
+    cpl_free(path);
+
+    if (table)
+        dfs_cache_insert(key, ext, check_nulls, cpl_table_duplicate(table),
+                         NULL);
+
+    return table;
+}
+
+/*----------------------------------------------------------------------------*/
+/**
+ * @brief
+ *   Load an image, reusing a cached copy of identical content.
+ *
+ * @param filename The FITS file name
+ * @param type     The data type of the loaded image
+ * @param ext      The FITS file extension to access (first = 0)
+ *
+ * @return The loaded image, to be deallocated with @c cpl_image_delete()
+ *
+ * Same as @c cpl_image_load() of the first plane, with the caching
+ * described in @c dfs_load_table_cached(). This is meant for small
+ * static calibration images, not for raw data.
+ */
+/*----------------------------------------------------------------------------*/
+cpl_image *dfs_load_image_cached(const char *filename, cpl_type type, int ext)
+{
+    dfs_cache_entry *entry;
+    cpl_image       *image;
+    char            *path;
+    char             key[33];
+
+
+    if (!dfs_cache_key(filename, key))
+        return cpl_image_load(filename, type, 0, ext);
+
+    if ((entry = dfs_cache_find(key, ext, type, 0)))
+        return cpl_image_duplicate(entry->image);
+
+    path = dfs_cache_path(key, ext, type, "img");
+
+    if (path == NULL || type == CPL_TYPE_UNSPECIFIED ||
+        (image = dfs_cache_read_image(path, type)) == NULL) {
+        image = cpl_image_load(filename, type, 0, ext);
+        if (image && path && type != CPL_TYPE_UNSPECIFIED)
+            dfs_cache_write(path, NULL, image);
+    }
+
+    cpl_free(path);
+
+    if (image)
+        dfs_cache_insert(key, ext, type, NULL, cpl_image_duplicate(image));
+
+    return image;
+}
+
+/*----------------------------------------------------------------------------*/
+/**
+ * @brief
+ *   Release the in-memory static calibration cache.
+ *
+ * The files written to the VIMOS_STATIC_CACHE directory are kept.
+ */
+/*----------------------------------------------------------------------------*/
+void dfs_cache_clear(void)
+{
+    while (dfs_cache) {
+        dfs_cache_entry *next = dfs_cache->next;
+
+        cpl_table_delete(dfs_cache->table);
+        cpl_image_delete(dfs_cache->image);
+        cpl_free(dfs_cache);
+        dfs_cache = next;
+    }
+}
+
     
 /*----------------------------------------------------------------------------*/
 /**
@@ -1295,6 +1822,371 @@ cpl_error_code dfs_save_image_null(cpl_frameset * frameset,
     return error;
 }
 
+/*
+ * Tile compression of image products.
+ *
+ * The image HDUs of a product are rewritten as CFITSIO tile-compressed
+ * HDUs. Images holding only integral values (masks, maps, dummy images)
+ * are stored as 32 bit integers with the lossless Rice algorithm, all
+ * other images either losslessly (GZIP with byte shuffling) or quantised
+ * at a given fraction of the background noise and Rice compressed.
+ *
+ * A primary HDU cannot be compressed, so a product with a primary data
+ * array gets an empty primary HDU, which keeps the full DFS header, and
+ * its data are moved to the first extension. That extension is marked
+ * by PRIMDATA = T, and the loaders of this module use this to map
+ * extension numbers, see dfs_product_extension().
+ */
+
+#define DFS_COMPRESS_MAX_INT 2147483647.0
+
+/*----------------------------------------------------------------------------*/
+/**
+ * @brief
+ *   Map an extension number of an uncompressed product to its file.
+ *
+ * @param filename The FITS file name
+ * @param ext      The extension of the uncompressed product (first = 0)
+ *
+ * @return The extension to access in @em filename.
+ *
+ * For a product written by @c dfs_compress_product() whose primary
+ * data array was moved to the first extension, all extensions are
+ * shifted by one. Headers of the primary HDU are not affected by this,
+ * as the DFS header stays in the primary HDU. In any other case
+ * @em ext is returned unchanged.
+ */
+/*----------------------------------------------------------------------------*/
+int dfs_product_extension(const char *filename, int ext)
+{
+    fitsfile *fptr;
+    int       status = 0;
+    int       primdata = 0;
+
+
+    if (filename == NULL || ext < 0)
+        return ext;
+
+    if (fits_open_diskfile(&fptr, filename, READONLY, &status))
+        return ext;
+
+    if (fits_movabs_hdu(fptr, 2, NULL, &status) == 0)
+        fits_read_key(fptr, TLOGICAL, "PRIMDATA", &primdata, NULL, &status);
+
+    status = 0;
+    fits_close_file(fptr, &status);
+
+    return primdata ? ext + 1 : ext;
+}
+
+static void dfs_compress_copy_keywords(fitsfile *in, fitsfile *out,
+                                       int wcs_only, int *status)
+{
+    char card[FLEN_CARD];
+    int  nkeys;
+    int  i;
+
+
+    if (fits_get_hdrspace(in, &nkeys, NULL, status))
+        return;
+
+    for (i = 1; i <= nkeys && *status == 0; i++) {
+
+        int keyclass;
+
+        if (fits_read_record(in, i, card, status))
+            return;
+
+        keyclass = fits_get_keyclass(card);
+
+        if (wcs_only) {
+            if (keyclass != TYP_WCS_KEY)
+                continue;
+        }
+        else if (keyclass == TYP_STRUC_KEY || keyclass == TYP_CMPRS_KEY ||
+                 keyclass == TYP_SCAL_KEY || keyclass == TYP_CKSUM_KEY ||
+                 strstr(card, "FITS (Flexible Image Transport System)") ||
+                 strstr(card, "Astrophysics', volume 376, page 359")) {
+            continue;
+        }
+
+        fits_write_record(out, card, status);
+    }
+}
+
+/*
+ * Write the current image HDU of in as a compressed HDU of out. The
+ * primary header is copied to an empty primary HDU first if needed.
+ */
+
+static void dfs_compress_hdu(fitsfile *in, fitsfile *out, int primary,
+                             int lossless, double level, int *status)
+{
+    long      naxes[9] = {1, 1, 1, 1, 1, 1, 1, 1, 1};
+    long      npix = 1;
+    int       bitpix;
+    int       naxis;
+    int       integral = 1;
+    int       i;
+    float    *data;
+
+
+    if (fits_get_img_param(in, 9, &bitpix, &naxis, naxes, status))
+        return;
+
+    for (i = 0; i < naxis; i++)
+        npix *= naxes[i];
+
+    if (primary) {
+        fits_create_img(out, BYTE_IMG, 0, NULL, status);
+        dfs_compress_copy_keywords(in, out, 0, status);
+    }
+
+    if (bitpix == DOUBLE_IMG || bitpix == LONGLONG_IMG) {
+
+        /*
+         * There are none of these among the VIMOS products: they are
+         * copied rather than risking a loss of precision.
+         */
+
+        if (primary) {
+            *status = BAD_BITPIX;
+            return;
+        }
+
+        fits_copy_hdu(in, out, 0, status);
+        return;
+    }
+
+    data = cpl_malloc(npix * sizeof(float));
+
+    if (fits_read_img(in, TFLOAT, 1, npix, NULL, data, NULL, status)) {
+        cpl_free(data);
+        return;
+    }
+
+    if (bitpix == FLOAT_IMG) {
+        for (i = 0; i < npix; i++) {
+            if (data[i] != floorf(data[i]) ||
+                fabs(data[i]) > DFS_COMPRESS_MAX_INT) {
+                integral = 0;
+                break;
+            }
+        }
+    }
+
+    if (integral) {
+        fits_set_compression_type(out, RICE_1, status);
+        bitpix = LONG_IMG;
+    }
+    else if (lossless) {
+        fits_set_compression_type(out, GZIP_2, status);
+        fits_set_quantize_level(out, 0.0, status);
+    }
+    else {
+        fits_set_compression_type(out, RICE_1, status);
+        fits_set_quantize_method(out, SUBTRACTIVE_DITHER_1, status);
+        fits_set_quantize_level(out, level, status);
+    }
+
+    fits_create_img(out, bitpix, naxis, naxes, status);
+
+    if (primary) {
+        fits_write_key_log(out, "PRIMDATA", 1, "Primary data array "
+                           "of the product", status);
+        dfs_compress_copy_keywords(in, out, 1, status);
+    }
+    else {
+        dfs_compress_copy_keywords(in, out, 0, status);
+    }
+
+    fits_write_img(out, TFLOAT, 1, npix, data, status);
+
+    cpl_free(data);
+}
+
+/*----------------------------------------------------------------------------*/
+/**
+ * @brief
+ *   Rewrite the image HDUs of a product file tile-compressed.
+ *
+ * @param filename The product file name
+ * @param method   Compression of non integral images, "lossless"
+ *                 or "quantise"
+ * @param level    Quantisation level (noise sigma / quantisation step)
+ *
+ * @return 0 in case of success.
+ *
+ * The file is written to a temporary file next to it, which replaces
+ * the product only when all the HDUs are written. Table HDUs, empty
+ * image HDUs and already compressed images are copied unchanged.
+ */
+/*----------------------------------------------------------------------------*/
+int dfs_compress_product(const char *filename, const char *method,
+                         double level)
+{
+    const char *func = "dfs_compress_product";
+
+    fitsfile *in;
+    fitsfile *out;
+    char     *tmpname;
+    int       lossless;
+    int       status = 0;
+    int       nhdu;
+    int       i;
+
+
+    if (filename == NULL || method == NULL) {
+        cpl_error_set(func, CPL_ERROR_NULL_INPUT);
+        return -1;
+    }
+
+    lossless = strcmp(method, "lossless") == 0;
+
+    if (!lossless && (strcmp(method, "quantise") || level <= 0.0)) {
+        cpl_msg_error(func, "Invalid compression %s (level %g)",
+                      method, level);
+        cpl_error_set(func, CPL_ERROR_ILLEGAL_INPUT);
+        return -1;
+    }
+
+    if (fits_open_diskfile(&in, filename, READONLY, &status)) {
+        cpl_msg_error(func, "Cannot open product %s (CFITSIO error %d)",
+                      filename, status);
+        return -1;
+    }
+
+    tmpname = cpl_sprintf("!%s.tmp", filename);
+
+    if (fits_create_file(&out, tmpname, &status)) {
+        cpl_msg_error(func, "Cannot create %s (CFITSIO error %d)",
+                      tmpname + 1, status);
+        status = 0;
+        fits_close_file(in, &status);
+        cpl_free(tmpname);
+        return -1;
+    }
+
+    fits_get_num_hdus(in, &nhdu, &status);
+
+    for (i = 1; i <= nhdu && status == 0; i++) {
+
+        int hdutype;
+        int naxis = 0;
+
+        fits_movabs_hdu(in, i, &hdutype, &status);
+
+        if (hdutype == IMAGE_HDU && !fits_is_compressed_image(in, &status))
+            fits_get_img_dim(in, &naxis, &status);
+
+        if (naxis > 0)
+            dfs_compress_hdu(in, out, i == 1, lossless, level, &status);
+        else
+            fits_copy_hdu(in, out, 0, &status);
+    }
+
+    fits_close_file(in, &status);
+
+    if (status) {
+        cpl_msg_error(func, "Cannot compress product %s (CFITSIO error %d)",
+                      filename, status);
+        status = 0;
+        fits_delete_file(out, &status);
+        cpl_free(tmpname);
+        return -1;
+    }
+
+    fits_close_file(out, &status);
+
+    if (status || rename(tmpname + 1, filename)) {
+        cpl_msg_error(func, "Cannot replace product %s", filename);
+        unlink(tmpname + 1);
+        cpl_free(tmpname);
+        return -1;
+    }
+
+    cpl_free(tmpname);
+
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/**
+ * @brief
+ *   Tile-compress the image products of a recipe.
+ *
+ * @param frameset The recipe set-of-frames
+ * @param method   Product compression: "none", "lossless" or "quantise"
+ * @param level    Quantisation level for "quantise"
+ *
+ * @return 0 in case of success.
+ *
+ * All the image frames of the product group are compressed with
+ * @c dfs_compress_product(). This must be called at the end of the
+ * recipe, once all the products are complete. The products are
+ * compressed in parallel if CFITSIO is reentrant, since CFITSIO
+ * compresses the tiles of a single HDU sequentially.
+ */
+/*----------------------------------------------------------------------------*/
+int dfs_compress_products(cpl_frameset *frameset, const char *method,
+                          double level)
+{
+    const char *func = "dfs_compress_products";
+
+    const cpl_frame **products;
+    cpl_size          nproducts = 0;
+    cpl_size          i;
+    int               failed = 0;
+
+
+    if (frameset == NULL || method == NULL || strcmp(method, "none") == 0)
+        return 0;
+
+    products = cpl_malloc(cpl_frameset_get_size(frameset) *
+                          sizeof *products);
+
+    for (i = 0; i < cpl_frameset_get_size(frameset); i++) {
+
+        const cpl_frame *frame = cpl_frameset_get_position_const(frameset, i);
+
+        if (cpl_frame_get_group(frame) == CPL_FRAME_GROUP_PRODUCT &&
+            cpl_frame_get_type(frame) == CPL_FRAME_TYPE_IMAGE)
+            products[nproducts++] = frame;
+    }
+
+    if (nproducts == 0) {
+        cpl_free(products);
+        return 0;
+    }
+
+    cpl_msg_info(func, "Compressing %" CPL_SIZE_FORMAT " image products "
+                 "(%s)...", nproducts, method);
+
+    /*
+     * CPL keeps FITS files open between calls: they are closed here,
+     * so that no stale handle to the replaced files is reused.
+     */
+
+    cpl_fits_set_mode(CPL_FITS_RESTART_CACHING);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) if (fits_is_reentrant())
+#endif
+    for (i = 0; i < nproducts; i++) {
+        if (dfs_compress_product(cpl_frame_get_filename(products[i]),
+                                 method, level)) {
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+            failed++;
+        }
+    }
+
+    cpl_free(products);
+
+    return failed ? -1 : 0;
+}
+
 void
 vimos_dfs_set_groups(cpl_frameset * set)
 {
@@ -42,6 +42,9 @@ int dfs_save_table(cpl_frameset *, const cpl_table *, const char *,
 cpl_image *dfs_load_image(cpl_frameset *, const char *, cpl_type, int, int);
 cpl_table *dfs_load_table(cpl_frameset *, const char *, int);
 cpl_propertylist *dfs_load_header(cpl_frameset *, const char *, int);
+cpl_table *dfs_load_table_cached(const char *, int, int);
+cpl_image *dfs_load_image_cached(const char *, cpl_type, int);
+void dfs_cache_clear(void);
 int dfs_equal_keyword(cpl_frameset *frameset, const char *keyword);
 int dfs_get_parameter_bool(cpl_parameterlist *, const char *, 
                            const cpl_table *);
@@ -66,6 +69,10 @@ cpl_error_code dfs_save_image_null(cpl_frameset *,
 				   const char *, const char *,
 				   const char *);
 
+int dfs_product_extension(const char *, int);
+int dfs_compress_product(const char *, const char *, double);
+int dfs_compress_products(cpl_frameset *, const char *, double);
+
 void vimos_dfs_set_groups(cpl_frameset * set);
 
 cpl_frameset *
@@ -36,6 +36,7 @@
 #include <string>
 #include <sstream>
 #include <math.h>
+#include <string.h>
 #include <cpl.h>
 #include <moses.h>
 #include <fors_tools.h>
@@ -133,6 +134,10 @@ int vimos_science_impl(cpl_frameset *frameset, cpl_parameterlist *parlist,
     int         skylocal;
     int         skymedian;
     int         cosmics;
+    const char *cosmics_method;
+    double      cosmics_sigma_lim;
+    double      cosmics_f_lim;
+    int         cosmics_max_iter;
     int         slit_margin;
     int         ext_radius;
     int         cont_radius;
@@ -303,6 +308,22 @@ int vimos_science_impl(cpl_frameset *frameset, cpl_parameterlist *parlist,
             vimos_science_exit("Cosmic rays correction requires "
                               "either skylocal=true or skyglobal=true");
 
+    cosmics_method = dfs_get_parameter_string(parlist,
+                     "vimos.vmmosscience.cosmics_method", NULL);
+    cosmics_sigma_lim = dfs_get_parameter_double(parlist,
+                        "vimos.vmmosscience.cosmics_sigma_lim", NULL);
+    cosmics_f_lim = dfs_get_parameter_double(parlist,
+                    "vimos.vmmosscience.cosmics_f_lim", NULL);
+    cosmics_max_iter = dfs_get_parameter_int(parlist,
+                       "vimos.vmmosscience.cosmics_max_iter", NULL);
+
+    if (strcmp(cosmics_method, "lacosmic") == 0) {
+        if (cosmics_sigma_lim <= 0.0 || cosmics_f_lim <= 0.0)
+            vimos_science_exit("Invalid LA-Cosmic limits");
+        if (cosmics_max_iter < 1)
+            vimos_science_exit("Invalid LA-Cosmic number of iterations");
+    }
+
     slit_margin = dfs_get_parameter_int(parlist, 
                                         "vimos.vmmosscience.slit_margin",
                                         NULL);
@@ -1434,7 +1455,13 @@ int vimos_science_impl(cpl_frameset *frameset, cpl_parameterlist *parlist,
 
             if (cosmics) {
                 cpl_msg_info(recipe, "Removing cosmic rays...");
-                mos_clean_cosmics(science_ima_nosky, gain, -1., -1.);
+                if (strcmp(cosmics_method, "lacosmic") == 0)
+                    mos_clean_cosmics_lacosmic(science_ima_nosky, gain, -1.,
+                                               cosmics_sigma_lim,
+                                               cosmics_f_lim,
+                                               cosmics_max_iter);
+                else
+                    mos_clean_cosmics(science_ima_nosky, gain, -1., -1.);
             }
 
             if (dfs_save_image(frameset, science_ima_nosky, unmapped_science_tag,
@@ -1585,7 +1612,12 @@ int vimos_science_impl(cpl_frameset *frameset, cpl_parameterlist *parlist,
         }
         else {
             mapped_cleaned = cpl_image_duplicate(mapped);
-            mos_clean_cosmics(mapped_cleaned, gain, -1., -1.);
+            if (strcmp(cosmics_method, "lacosmic") == 0)
+                mos_clean_cosmics_lacosmic(mapped_cleaned, gain, -1.,
+                                           cosmics_sigma_lim, cosmics_f_lim,
+                                           cosmics_max_iter);
+            else
+                mos_clean_cosmics(mapped_cleaned, gain, -1., -1.);
             dummy = mos_detect_objects(mapped_cleaned, slits, slit_margin, 
                                        ext_radius, cont_radius, detection);
 
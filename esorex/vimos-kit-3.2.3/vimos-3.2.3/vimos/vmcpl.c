@@ -30,14 +30,18 @@
 #endif
 
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 
 #include <cxstring.h>
 
 #include <vmutils.h>
 #include <piltranslator.h>
 #include <pilrecipe.h>
+#include <pilfits.h>
 
 #include "vmcpl.h"
+#include "vimos_dfs.h"
 
 
 /* FIXME: This is used to compensate for a deficiency in CPL 1.0. Change
@@ -579,6 +583,340 @@ vmCplMsgSeverityExport(cpl_msg_severity level)
 }
 
 
+/*
+ * Transform a single VIMOS descriptor into a CPL property. Array
+ * descriptors have no header representation and are not converted.
+ */
+
+inline static cpl_property *
+_vmCplDescriptorImport(const VimosDescriptor *desc)
+{
+
+    cpl_property *self = NULL;
+
+
+    switch (desc->descType) {
+        case VM_INT:
+            self = cpl_property_new(desc->descName, CPL_TYPE_INT);
+            cpl_property_set_int(self, desc->descValue->i);
+            break;
+
+        case VM_BOOL:
+            self = cpl_property_new(desc->descName, CPL_TYPE_BOOL);
+            cpl_property_set_bool(self, desc->descValue->b == VM_TRUE);
+            break;
+
+        case VM_FLOAT:
+            self = cpl_property_new(desc->descName, CPL_TYPE_FLOAT);
+            cpl_property_set_float(self, desc->descValue->f);
+            break;
+
+        case VM_DOUBLE:
+            self = cpl_property_new(desc->descName, CPL_TYPE_DOUBLE);
+            cpl_property_set_double(self, desc->descValue->d);
+            break;
+
+        case VM_STRING:
+            self = cpl_property_new(desc->descName, CPL_TYPE_STRING);
+            cpl_property_set_string(self, desc->descValue->s);
+            break;
+
+        default:
+            return NULL;
+            break;
+    }
+
+    if (desc->descComment != NULL && desc->descComment[0] != '\0') {
+        cpl_property_set_comment(self, desc->descComment);
+    }
+
+    return self;
+
+}
+
+
+/*
+ * Transform a CPL property into a VIMOS descriptor. Integer properties
+ * which do not fit into an int are stored as doubles, and complex
+ * properties are not converted.
+ */
+
+inline static VimosDescriptor *
+_vmCplDescriptorExport(const cpl_property *property)
+{
+
+    const char *name = cpl_property_get_name(property);
+    const char *comment = cpl_property_get_comment(property);
+
+    char _comment[VM_DESC_LENGTH];
+    char value[2];
+
+    long long lvalue;
+
+
+    if (strlen(name) >= VM_DESC_LENGTH) {
+        return NULL;
+    }
+
+    if (comment == NULL) {
+        comment = "";
+    }
+
+    strncpy(_comment, comment, VM_DESC_LENGTH - 1);
+    _comment[VM_DESC_LENGTH - 1] = '\0';
+
+    switch (cpl_property_get_type(property)) {
+        case CPL_TYPE_BOOL:
+            return newBoolDescriptor(name, cpl_property_get_bool(property) ?
+                                     VM_TRUE : VM_FALSE, _comment);
+            break;
+
+        case CPL_TYPE_CHAR:
+            value[0] = cpl_property_get_char(property);
+            value[1] = '\0';
+            return newStringDescriptor(name, value, _comment);
+            break;
+
+        case CPL_TYPE_INT:
+            return newIntDescriptor(name, cpl_property_get_int(property),
+                                    _comment);
+            break;
+
+        case CPL_TYPE_LONG:
+        case CPL_TYPE_LONG_LONG:
+            lvalue = cpl_property_get_long_long(property);
+
+            if (lvalue >= INT_MIN && lvalue <= INT_MAX) {
+                return newIntDescriptor(name, (int)lvalue, _comment);
+            }
+            return newDoubleDescriptor(name, (double)lvalue, _comment);
+            break;
+
+        case CPL_TYPE_FLOAT:
+            return newFloatDescriptor(name, cpl_property_get_float(property),
+                                      _comment);
+            break;
+
+        case CPL_TYPE_DOUBLE:
+            return newDoubleDescriptor(name,
+                                       cpl_property_get_double(property),
+                                       _comment);
+            break;
+
+        case CPL_TYPE_STRING:
+            return newStringDescriptor(name,
+                                       cpl_property_get_string(property),
+                                       _comment);
+            break;
+
+        default:
+            break;
+    }
+
+    return NULL;
+
+}
+
+
+/**
+ * @brief
+ *   Import a VIMOS image into a CPL image.
+ *
+ * @param image  The VIMOS image to import.
+ *
+ * @return The CPL image sharing the pixel buffer of @em image, or @c NULL
+ *   if @em image has no pixel buffer.
+ *
+ * The function wraps the pixel buffer of @em image into a CPL image of
+ * type @c CPL_TYPE_FLOAT. The pixels are not copied, so that changes made
+ * through either image are seen by the other one. The VIMOS image keeps
+ * the ownership of the pixel buffer: the returned CPL image must be
+ * released using @b cpl_image_unwrap(), and it must not be used after
+ * @em image has been destroyed. The image descriptors are not imported,
+ * see @b vmCplDescriptorsImport().
+ */
+
+cpl_image *
+vmCplImageImport(VimosImage *image)
+{
+
+    if (image == NULL || image->data == NULL) {
+        return NULL;
+    }
+
+    return cpl_image_wrap_float(image->xlen, image->ylen, image->data);
+
+}
+
+
+/**
+ * @brief
+ *   Export a CPL image to a VIMOS image.
+ *
+ * @param image  The CPL image to export.
+ *
+ * @return The VIMOS image owning the pixel buffer of @em image, or @c NULL
+ *   in case of an error.
+ *
+ * The function transfers the pixel buffer of the CPL image @em image to
+ * a newly created VIMOS image, which must be destroyed using
+ * @b deleteImage(). The CPL image is consumed by this call and must not
+ * be used afterwards. If @em image is of type @c CPL_TYPE_FLOAT the pixels
+ * are not copied, otherwise they are converted to float first. The
+ * returned image has no descriptors, see @b vmCplDescriptorsExport().
+ */
+
+VimosImage *
+vmCplImageExport(cpl_image *image)
+{
+
+    VimosImage *self = NULL;
+
+    int xlen;
+    int ylen;
+
+    float *data;
+
+
+    if (image == NULL) {
+        return NULL;
+    }
+
+    if (cpl_image_get_type(image) != CPL_TYPE_FLOAT) {
+
+        cpl_image *_image = cpl_image_cast(image, CPL_TYPE_FLOAT);
+
+        if (_image == NULL) {
+            return NULL;
+        }
+
+        cpl_image_delete(image);
+        image = _image;
+
+    }
+
+    xlen = cpl_image_get_size_x(image);
+    ylen = cpl_image_get_size_y(image);
+
+    self = newImage(xlen, ylen, NULL);
+
+    if (self == NULL) {
+        cpl_image_delete(image);
+        return NULL;
+    }
+
+    data = cpl_image_get_data_float(image);
+    cpl_image_unwrap(image);
+
+    self->data = data;
+
+    return self;
+
+}
+
+
+/**
+ * @brief
+ *   Import a list of VIMOS descriptors into a CPL property list.
+ *
+ * @param desc  The first descriptor of the list to import.
+ *
+ * @return The newly created CPL property list.
+ *
+ * The function creates a property list with the contents of the descriptor
+ * list starting at @em desc, preserving the order of the descriptors.
+ * Array descriptors cannot be represented as properties and are skipped.
+ * The created property list must be destroyed by the caller using
+ * @b cpl_propertylist_delete(). If @em desc is @c NULL an empty property
+ * list is returned.
+ */
+
+cpl_propertylist *
+vmCplDescriptorsImport(const VimosDescriptor *desc)
+{
+
+    cpl_propertylist *self = cpl_propertylist_new();
+
+
+    while (desc != NULL) {
+
+        cpl_property *property = _vmCplDescriptorImport(desc);
+
+        if (property != NULL) {
+            cpl_propertylist_append_property(self, property);
+            cpl_property_delete(property);
+        }
+
+        desc = desc->next;
+
+    }
+
+    return self;
+
+}
+
+
+/**
+ * @brief
+ *   Export a CPL property list to a list of VIMOS descriptors.
+ *
+ * @param properties  The CPL property list to export.
+ *
+ * @return The first descriptor of the created list, or @c NULL if no
+ *   property could be exported.
+ *
+ * The function converts the properties of @em properties into a newly
+ * created list of descriptors, preserving their order. Properties with
+ * names too long for a descriptor, and complex valued properties, are
+ * skipped. The created list must be destroyed using
+ * @b deleteAllDescriptors().
+ */
+
+VimosDescriptor *
+vmCplDescriptorsExport(const cpl_propertylist *properties)
+{
+
+    VimosDescriptor *self = NULL;
+    VimosDescriptor *last = NULL;
+
+    cpl_size i;
+    cpl_size sz;
+
+
+    if (properties == NULL) {
+        return NULL;
+    }
+
+    sz = cpl_propertylist_get_size(properties);
+
+    for (i = 0; i < sz; i++) {
+
+        const cpl_property *property =
+            cpl_propertylist_get_const(properties, i);
+
+        VimosDescriptor *desc = _vmCplDescriptorExport(property);
+
+        if (desc == NULL) {
+            continue;
+        }
+
+        if (last == NULL) {
+            self = desc;
+        }
+        else {
+            last->next = desc;
+            desc->prev = last;
+        }
+
+        last = desc;
+
+    }
+
+    return self;
+
+}
+
+
 /**
  * @brief
  *   Start the recipe execution timer
@@ -802,6 +1140,9 @@ vmCplRecipeStop(void)
 
     pilDfsFreeDB();
 
+    dfs_cache_clear();
+    pilFitsCacheClear();
+
     if (pilMsgCloseLog() != EXIT_SUCCESS) {
         return 1;
     }
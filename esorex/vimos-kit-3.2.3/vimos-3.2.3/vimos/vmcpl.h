@@ -34,9 +34,13 @@
 #include <pilmessages.h>
 #include <piltimer.h>
 
+#include <vmimage.h>
+
 #include <cpl_frameset.h>
 #include <cpl_parameterlist.h>
 #include <cpl_msg.h>
+#include <cpl_image.h>
+#include <cpl_propertylist.h>
 
 
 PIL_BEGIN_DECLS
@@ -48,6 +52,16 @@ int vmCplParlistExport(const cpl_parameterlist *);
 
 PilMsgSeverity vmCplMsgSeverityExport(cpl_msg_severity);
 
+/*
+ * Image and descriptor conversion functions
+ */
+
+cpl_image *vmCplImageImport(VimosImage *);
+VimosImage *vmCplImageExport(cpl_image *);
+
+cpl_propertylist *vmCplDescriptorsImport(const VimosDescriptor *);
+VimosDescriptor *vmCplDescriptorsExport(const cpl_propertylist *);
+
 /*
  * Recipe timer functions
  */
@@ -33,6 +33,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <float.h>
 
 #include <pilmemory.h>
 #include <pilmessages.h>
@@ -58,6 +59,419 @@
 
 static VimosBool robustLinearFit(double*,double*,int,double*,double*,double*) ;
 
+/*
+---------------------------------------------------------------------------
+   Function	:  fitWorkspaceReserve()
+   In 		:  fit workspace, number of points, number of coefficients,
+                   highest power of a single variable
+   Out 		:  VM_TRUE on success
+   Job		:  make sure that the workspace buffers are large enough
+   Notice	:  buffers are only reallocated when they must grow
+---------------------------------------------------------------------------
+*/
+
+static VimosBool fitWorkspaceReserve(VimosFitWorkspace *ws, int np, int nc,
+                                     int maxDeg)
+{
+
+  if (np > ws->maxPoints || nc > ws->maxCoeffs) {
+    if (np > ws->maxPoints)
+      ws->maxPoints = np;
+    if (nc > ws->maxCoeffs)
+      ws->maxCoeffs = nc;
+    ws->design = cpl_realloc(ws->design, 
+                             ws->maxPoints * ws->maxCoeffs * sizeof(double));
+    ws->rhs = cpl_realloc(ws->rhs, ws->maxPoints * sizeof(double));
+    ws->rdiag = cpl_realloc(ws->rdiag, 2 * ws->maxCoeffs * sizeof(double));
+  }
+
+  if (maxDeg + 1 > ws->maxPowers) {
+    ws->maxPowers = maxDeg + 1;
+    ws->powers = cpl_realloc(ws->powers, 2 * ws->maxPowers * sizeof(double));
+  }
+
+  if (ws->design == NULL || ws->rhs == NULL || ws->rdiag == NULL ||
+      ws->powers == NULL)
+    return VM_FALSE;
+
+  return VM_TRUE;
+}
+
+
+/*
+---------------------------------------------------------------------------
+   Function	:  fitWorkspaceSolve()
+   In 		:  fit workspace holding a np x nc design matrix (column
+                   major) and the np values to fit, output coefficients
+   Out 		:  VM_TRUE on success, VM_FALSE if the system is singular
+   Job		:  least-squares solution by Householder QR decomposition
+   Notice	:  the design matrix and the values are overwritten
+---------------------------------------------------------------------------
+*/
+
+static VimosBool fitWorkspaceSolve(VimosFitWorkspace *ws, int np, int nc, 
+                                   double *coeffs)
+{
+  double *a = ws->design;
+  double *b = ws->rhs;
+  double *rdiag = ws->rdiag;
+  double *cnorm = ws->rdiag + ws->maxCoeffs;
+  double *v;
+  double  norm, alpha, scale, dot;
+  int     i, j, k;
+
+
+  for (k = 0; k < nc; k++) {
+    norm = 0.0;
+    for (i = 0; i < np; i++)
+      norm += a[i + k * np] * a[i + k * np];
+    cnorm[k] = sqrt(norm);
+  }
+
+  for (k = 0; k < nc; k++) {
+
+    /*
+     * Householder vector annihilating the column k below the diagonal
+     */
+
+    v = a + k + k * np;
+    norm = 0.0;
+    for (i = 0; i < np - k; i++)
+      norm += v[i] * v[i];
+    norm = sqrt(norm);
+
+    alpha = v[0] > 0.0 ? -norm : norm;
+    rdiag[k] = alpha;
+
+    if (fabs(alpha) <= 16 * DBL_EPSILON * cnorm[k])
+      return VM_FALSE;
+
+    /*
+     * Normalize v such that H = I - v v'
+     */
+
+    scale = sqrt(norm * (norm + fabs(v[0])));
+    v[0] -= alpha;
+    for (i = 0; i < np - k; i++)
+      v[i] /= scale;
+
+    for (j = k + 1; j < nc; j++) {
+      double *col = a + k + j * np;
+      dot = 0.0;
+      for (i = 0; i < np - k; i++)
+        dot += v[i] * col[i];
+      for (i = 0; i < np - k; i++)
+        col[i] -= dot * v[i];
+    }
+
+    dot = 0.0;
+    for (i = 0; i < np - k; i++)
+      dot += v[i] * b[k + i];
+    for (i = 0; i < np - k; i++)
+      b[k + i] -= dot * v[i];
+  }
+
+  /*
+   * Back substitution R c = Q'b
+   */
+
+  for (k = nc - 1; k >= 0; k--) {
+    dot = b[k];
+    for (j = k + 1; j < nc; j++)
+      dot -= a[k + j * np] * coeffs[j];
+    coeffs[k] = dot / rdiag[k];
+  }
+
+  return VM_TRUE;
+}
+
+
+/*
+---------------------------------------------------------------------------
+   Function	:  newFitWorkspace()
+   In 		:  expected maximum number of points and of coefficients
+   Out 		:  newly allocated fit workspace
+   Job		:  allocate the buffers used by the least-squares fits
+   Notice	:  the workspace grows as needed if larger fits are
+                   requested, so that it can be reused for any fit.
+                   A workspace must not be shared between threads.
+---------------------------------------------------------------------------
+*/
+
+VimosFitWorkspace *newFitWorkspace(int maxPoints, int maxCoeffs)
+{
+  VimosFitWorkspace *ws;
+
+  ws = cpl_calloc(1, sizeof(VimosFitWorkspace));
+
+  if (maxPoints < 1)
+    maxPoints = 1;
+  if (maxCoeffs < 1)
+    maxCoeffs = 1;
+
+  if (!fitWorkspaceReserve(ws, maxPoints, maxCoeffs, maxCoeffs - 1)) {
+    deleteFitWorkspace(ws);
+    return NULL;
+  }
+
+  return ws;
+}
+
+
+/*
+---------------------------------------------------------------------------
+   Function	:  deleteFitWorkspace()
+   In 		:  fit workspace
+   Out 		:  none
+   Job		:  deallocate a fit workspace
+---------------------------------------------------------------------------
+*/
+
+void deleteFitWorkspace(VimosFitWorkspace *ws)
+{
+  if (ws == NULL)
+    return;
+
+  cpl_free(ws->design);
+  cpl_free(ws->rhs);
+  cpl_free(ws->rdiag);
+  cpl_free(ws->powers);
+  cpl_free(ws);
+}
+
+
+/*
+---------------------------------------------------------------------------
+   Function	:  fitPolyWorkspace()
+   In 		:  fit workspace, requested polynomial degree
+                   a list of pixel positions + number of pixels in the list
+                   optional weights (NULL for unit weights)
+                   (out) polyDeg+1 fit coefficients
+                   (out) mean squared error, set to NULL if you do not want
+                   to compute it.
+   Out 		:  VM_TRUE on success
+   Job		:  same as fit1DPoly(), using a preallocated workspace
+   Notice	:  the solution is obtained by Householder QR decomposition
+                   of the Vandermonde matrix, which does not square its
+                   condition number as the normal equations do. With
+                   weights the weighted mean squared error is returned.
+---------------------------------------------------------------------------
+*/
+
+VimosBool fitPolyWorkspace(VimosFitWorkspace *ws, int polyDeg,
+                           VimosDpoint *list, int np, double *weights,
+                           double *coeffs, double *meanSquaredError)
+{
+  const char    modName[] = "fitPolyWorkspace";
+  int           i, k;
+  int           nc = polyDeg + 1;
+  double        w, xp, y, err, wsum;
+
+  if (np < nc) {
+    cpl_msg_debug(modName, 
+      "The number of pixel in the list is less then polynomial degree");
+    return VM_FALSE;
+  }
+
+  if (!fitWorkspaceReserve(ws, np, nc, polyDeg)) {
+    cpl_msg_debug(modName, "Allocation Error");
+    return VM_FALSE;
+  }
+
+  /*
+   * Vandermonde matrix, built by successive products (the same 
+   * values as ipow())
+   */
+
+  for (i = 0; i < np; i++) {
+    w = weights ? sqrt(weights[i]) : 1.0;
+    xp = w;
+    ws->design[i] = xp;
+    for (k = 1; k <= polyDeg; k++) {
+      xp *= list[i].x;
+      ws->design[i + k * np] = xp;
+    }
+    ws->rhs[i] = w * list[i].y;
+  }
+
+  if (!fitWorkspaceSolve(ws, np, nc, coeffs)) {
+    cpl_msg_debug(modName, "Singular system of equations");
+    return VM_FALSE;
+  }
+
+  /*
+   * If requested, compute (weighted) mean squared error
+   */
+
+  if (meanSquaredError != NULL) {
+    err = 0.0;
+    wsum = 0.0;
+    for (i = 0; i < np; i++) {
+      y = coeffs[polyDeg];
+      for (k = polyDeg - 1; k >= 0; k--)
+        y = y * list[i].x + coeffs[k];
+      w = weights ? weights[i] : 1.0;
+      err += w * (list[i].y - y) * (list[i].y - y);
+      wsum += w;
+    }
+    *meanSquaredError = wsum > 0.0 ? err / wsum : 0.0;
+  }
+
+  return VM_TRUE;
+}
+
+
+/*
+---------------------------------------------------------------------------
+   Function	:  fitPolyRejectWorkspace()
+   In 		:  fit workspace, requested polynomial degree
+                   a list of pixel positions + (in/out) number of pixels
+                   rejection threshold in sigmas, max rejection iterations
+                   (out) polyDeg+1 fit coefficients
+                   (out) mean squared error, or NULL
+   Out 		:  VM_TRUE on success
+   Job		:  polynomial fit with iterative rejection of the points
+                   deviating more than nSigma times the rms of the fit
+   Notice	:  rejected points are removed from the list in place, and
+                   the order of the remaining points is preserved.
+---------------------------------------------------------------------------
+*/
+
+VimosBool fitPolyRejectWorkspace(VimosFitWorkspace *ws, int polyDeg,
+                                 VimosDpoint *list, int *np, double nSigma,
+                                 int maxIter, double *coeffs,
+                                 double *meanSquaredError)
+{
+  int           i, k, n, iter;
+  double        y, mse, limit;
+
+  for (iter = 0; ; iter++) {
+
+    if (!fitPolyWorkspace(ws, polyDeg, list, *np, NULL, coeffs, &mse))
+      return VM_FALSE;
+
+    if (iter >= maxIter)
+      break;
+
+    /*
+     * Keep in place, preserving their order, the points within
+     * nSigma from the fit
+     */
+
+    limit = nSigma * sqrt(mse);
+    for (i = 0, n = 0; i < *np; i++) {
+      y = coeffs[polyDeg];
+      for (k = polyDeg - 1; k >= 0; k--)
+        y = y * list[i].x + coeffs[k];
+      if (fabs(list[i].y - y) <= limit) {
+        if (n != i) {
+          list[n].x = list[i].x;
+          list[n].y = list[i].y;
+        }
+        n++;
+      }
+    }
+
+    if (n == *np || n < polyDeg + 1)
+      break;
+
+    *np = n;
+  }
+
+  if (meanSquaredError != NULL)
+    *meanSquaredError = mse;
+
+  return VM_TRUE;
+}
+
+
+/*
+---------------------------------------------------------------------------
+   Function	:  fitSurfaceWorkspace()
+   In 		:  fit workspace, list of pixels, # of pixels in the list,
+                   number of coefficients and their degrees in x and y
+                   (see buildupPolytabFromString()), optional weights
+                   (out) nc fit coefficients
+                   (out) mean squared error, or NULL
+   Out 		:  VM_TRUE on success
+   Job		:  same as fitSurfacePolynomial(), using a preallocated
+                   workspace and a Householder QR solution
+---------------------------------------------------------------------------
+*/
+
+VimosBool fitSurfaceWorkspace(VimosFitWorkspace *ws, VimosPixel *surface, 
+                              int np, int nc, int *degxTab, int *degyTab,
+                              double *weights, double *coeffs,
+                              double *meanSquaredError)
+{
+  const char  modName[] = "fitSurfaceWorkspace";
+  double     *px;
+  double     *py;
+  double      w, z, err, wsum;
+  int         maxDeg = 0;
+  int         i, j;
+
+  if (np < nc) {
+    cpl_msg_debug(modName, 
+      "The number of pixel in the list is less then number of coefficients");
+    return VM_FALSE;
+  }
+
+  for (j = 0; j < nc; j++) {
+    if (degxTab[j] > maxDeg)
+      maxDeg = degxTab[j];
+    if (degyTab[j] > maxDeg)
+      maxDeg = degyTab[j];
+  }
+
+  if (!fitWorkspaceReserve(ws, np, nc, maxDeg)) {
+    cpl_msg_error(modName, "Allocation Error");
+    return VM_FALSE;
+  }
+
+  px = ws->powers;
+  py = ws->powers + ws->maxPowers;
+
+  for (i = 0; i < np; i++) {
+    px[0] = py[0] = 1.0;
+    for (j = 1; j <= maxDeg; j++) {
+      px[j] = px[j - 1] * surface[i].x;
+      py[j] = py[j - 1] * surface[i].y;
+    }
+    w = weights ? sqrt(weights[i]) : 1.0;
+    for (j = 0; j < nc; j++)
+      ws->design[i + j * np] = w * px[degxTab[j]] * py[degyTab[j]];
+    ws->rhs[i] = w * surface[i].i;
+  }
+
+  if (!fitWorkspaceSolve(ws, np, nc, coeffs)) {
+    cpl_msg_debug(modName, "Singular system of equations");
+    return VM_FALSE;
+  }
+
+  if (meanSquaredError != NULL) {
+    err = 0.0;
+    wsum = 0.0;
+    for (i = 0; i < np; i++) {
+      px[0] = py[0] = 1.0;
+      for (j = 1; j <= maxDeg; j++) {
+        px[j] = px[j - 1] * surface[i].x;
+        py[j] = py[j - 1] * surface[i].y;
+      }
+      z = 0.0;
+      for (j = 0; j < nc; j++)
+        z += coeffs[j] * px[degxTab[j]] * py[degyTab[j]];
+      w = weights ? weights[i] : 1.0;
+      err += w * (surface[i].i - z) * (surface[i].i - z);
+      wsum += w;
+    }
+    *meanSquaredError = wsum > 0.0 ? err / wsum : 0.0;
+  }
+
+  return VM_TRUE;
+}
+
+
 /*
 ---------------------------------------------------------------------------
    Function	:  fit_1d_poly()
@@ -78,12 +492,9 @@ static VimosBool robustLinearFit(double*,double*,int,double*,double*,double*) ;
 double *fit1DPoly(int polyDeg, VimosDpoint *list, int np, 
                   double *meanSquaredError)
 {
-  const char    modName[] = "fit1DPoly";
-  int           i, k;
-  VimosMatrix   *mA, *mB, *mX;
-  double        *c;
-  double        err;
-  double        xp, y;
+  const char        modName[] = "fit1DPoly";
+  VimosFitWorkspace *ws;
+  double            *c;
 
   if (np < polyDeg+1) {
     cpl_msg_debug(modName, 
@@ -91,93 +502,30 @@ double *fit1DPoly(int polyDeg, VimosDpoint *list, int np,
     return NULL;
   }
   
-  mA = newMatrix(polyDeg+1, np) ;
-  if (mA == NULL) {
-    cpl_msg_debug(modName, "The function newMatrix has returned NULL");
-    return(NULL);
-  }
-
-  mB = newMatrix(1, np) ;
-  
-  if (mB == NULL) {
-    cpl_msg_debug(modName, "The function newMatrix has returned NULL");
+  ws = newFitWorkspace(np, polyDeg+1);
+  if (ws == NULL) {
+    cpl_msg_debug(modName, "The function newFitWorkspace has returned NULL");
     return(NULL);
   }
 
-/*  c = cpl_malloc((polyDeg+1)*sizeof(double)) ; */
-/* */
-/* check if space was allocated */
-/*  if (c == NULL) { */
-/*    cpl_msg_debug(modName, "Allocation Error"); */
-/*    return(NULL); */
-/*  } */
-/* */
-/*  for (i = 0; i < (polyDeg+1); i++) { */
-/*    c[i] = 0.0; */
-/*  } */
-
-  for (i = 0; i < np; i++) {
-    mA->data[i] = 1.0;
-    for (k = 1; k <= polyDeg; k++) {
-      mA->data[i+k*np] = ipow(list[i].x, k);
-    }
-    mB->data[i] = list[i].y;
-  }
-  
-  /*
-   * Solve XA=B by a least-square solution (aka pseudo-inverse).
-   */
-  mX = lsqMatrix(mA, mB);
-  /*
-   * Delete input matrices
-   */
-  deleteMatrix(mA);
-  deleteMatrix(mB);
-  /*
-   * Examine result
-   */
-  if (mX == NULL) {
-    cpl_msg_debug(modName, "The function lsqMatrix has returned NULL");
-    return(NULL);
-  }
-  
   c = cpl_malloc((polyDeg+1)*sizeof(double)) ;
 
   /* check if space was allocated */
   if (c == NULL) {
     cpl_msg_debug(modName, "Allocation Error");
+    deleteFitWorkspace(ws);
     return(NULL);
   }
 
-  for (i = 0; i < (polyDeg+1); i++) {
-    c[i] = mX->data[i];
-  }
-  deleteMatrix(mX);
-  
-  /*
-   * If requested, compute mean squared error
-   */
-  if (meanSquaredError != NULL) {
-    err = 0.00 ;
-    for (i = 0 ; i < np ; i++) {
-      y = c[0] ;
-      /*
-       * Compute the value obtained through the fit
-       */
-      for (k = 1; k <= polyDeg; k++) {
-        xp = ipow(list[i].x, k) ;
-        y += c[k] * xp ; 
-      }
-      /*
-       * Subtract from the true value, square, accumulate
-       */
-      xp   = ipow(list[i].y - y, 2) ;
-      err += xp ; 
-    }
-    /* Average the error term */
-    err /= (double)np ;
-    *meanSquaredError = err ;
+  if (!fitPolyWorkspace(ws, polyDeg, list, np, NULL, c, meanSquaredError)) {
+    cpl_msg_debug(modName, "The function fitPolyWorkspace has failed");
+    deleteFitWorkspace(ws);
+    cpl_free(c);
+    return(NULL);
   }
+
+  deleteFitWorkspace(ws);
+
   return(c);
 }
 
@@ -235,13 +583,11 @@ double *fitSurfacePolynomial(VimosPixel *surface, int np, char *controlString,
 	int polyDeg, int *ncoeffs, double *meanSquaredError)
 {
   const char  modName[] = "fitSurfacePolynomial";
-  int         i, j;
+  int         i;
   int         degx, degy;
-  VimosMatrix *mA, *mB, *mX;
-  double      x, y, z;
+  VimosFitWorkspace *ws;
   int         nc;
   double      *c;
-  double      err;
   int         *degxTab;
   int         *degyTab;
   
@@ -286,61 +632,6 @@ double *fitSurfacePolynomial(VimosPixel *surface, int np, char *controlString,
     }  
   }
   
- /*
-  * Initialize matrices
-  * mA contains the polynomial terms in the order described
-  * above in each column, for each input point.
-  * mB contains the intensity (z-axis) values in a single line
-  */
-  
-  mA = newMatrix(nc, np) ;
-  if (mA == NULL) {
-    cpl_msg_error(modName, "The function newMatrix has returned NULL");
-    return(NULL);
-  }  
-
-  mB = newMatrix(1, np) ;
-  if (mB == NULL) {
-    cpl_msg_error(modName, "The function newMatrix has returned NULL");
-    return(NULL);
-  }  
-
- /*
-  * Fill up matrices
-  */
-  for (i = 0; i < np; i++) { /* loop over surface points */
-   /* Get x and y value for current point */
-    x    = surface[i].x ;
-    y    = surface[i].y ;
-    
-    for (j = 0; j < nc; j++) { /* loop over coefficients */
-     /*
-      * compute jth coefficient
-      */
-      mA->data[i+j*np] = ipow(x, degxTab[j]) * ipow(y, degyTab[j]) ; 
-    }
-    /* mB contains surface values (z-axis) */
-    mB->data[i] = surface[i].i ;
-  }
-  
- /*
-  * Solve XA=B by a least-square solution (aka pseudo-inverse).
-  */
-  mX = lsqMatrix(mA,mB) ;
-
- /*
-  * Delete input matrices
-  */
-  deleteMatrix(mA) ;
-  deleteMatrix(mB) ;
-
- /*
-  * Examine result
-  */
-  if (mX == NULL) {
-    cpl_msg_error(modName, "The function lsqMatrix has returned NULL"); 
-    return(NULL);
-  }
  /*
   * Store coefficients for output in a single array
   */
@@ -351,33 +642,28 @@ double *fitSurfacePolynomial(VimosPixel *surface, int np, char *controlString,
     return(NULL);
   }
 
-  for (i = 0; i < nc; i++) {
-    c[i] = mX->data[i] ;
+  ws = newFitWorkspace(np, nc);
+  if (ws == NULL) {
+    cpl_msg_error(modName, "The function newFitWorkspace has returned NULL");
+    cpl_free(c);
+    cpl_free(degxTab);
+    cpl_free(degyTab);
+    return(NULL);
+  }  
+
+  if (!fitSurfaceWorkspace(ws, surface, np, nc, degxTab, degyTab, NULL,
+                           c, meanSquaredError)) {
+    cpl_msg_error(modName, "The function fitSurfaceWorkspace has failed"); 
+    deleteFitWorkspace(ws);
+    cpl_free(c);
+    cpl_free(degxTab);
+    cpl_free(degyTab);
+    return(NULL);
   }
-  deleteMatrix(mX) ;
+
+  deleteFitWorkspace(ws);
   *ncoeffs = nc ;
   
- /*
-  * If requested, compute mean squared error
-  */
-  if (meanSquaredError != NULL) {
-    err = 0.00 ;
-    for (i = 0; i < np; i++) {
-      z = 0.00 ; 
-      for (j = 0; j < nc; j++) {
-        z += c[j] *
-          ipow(surface[i].x, degxTab[j]) *
-          ipow(surface[i].y, degyTab[j]);
-      }
-      /*
-        Subtract from the true value, square, accumulate
-      */
-      err += ipow(surface[i].i-z, 2) ;
-    }
-    /* Average the error term */
-    err /= (double)np ;
-    *meanSquaredError = err ;
-  }
   cpl_free(degxTab) ;
   cpl_free(degyTab) ;
   return c ;
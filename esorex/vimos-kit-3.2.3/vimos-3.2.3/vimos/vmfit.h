@@ -57,6 +57,89 @@ double *fit1DPoly(int polyDeg, VimosDpoint *list, int np,
 
 
 
+/*---------------------------------------------------------------------------
+   Type     :   VimosFitWorkspace
+   Job      :   buffers for repeated least-squares polynomial fits, to be
+                reused e.g. for fitting all the rows of an image without
+                allocating memory for each fit.
+ ---------------------------------------------------------------------------*/
+
+typedef struct _VIMOS_FIT_WORKSPACE_ {
+  int     maxPoints;
+  int     maxCoeffs;
+  int     maxPowers;
+  double *design;     /* maxPoints x maxCoeffs design matrix */
+  double *rhs;        /* maxPoints values to fit */
+  double *rdiag;      /* 2 x maxCoeffs, diagonal of R and column norms */
+  double *powers;     /* 2 x maxPowers, powers of x and y */
+} VimosFitWorkspace;
+
+
+/*---------------------------------------------------------------------------
+   Function :   newFitWorkspace()
+   In       :   expected maximum number of points and of coefficients
+   Out      :   newly allocated fit workspace
+   Job      :   allocate the buffers used by the least-squares fits
+   Notice   :   the workspace grows as needed if larger fits are
+                requested, so that it can be reused for any fit.
+                A workspace must not be shared between threads.
+ ---------------------------------------------------------------------------*/
+
+VimosFitWorkspace *newFitWorkspace(int maxPoints, int maxCoeffs);
+
+
+/*---------------------------------------------------------------------------
+   Function :   deleteFitWorkspace()
+   In       :   fit workspace
+   Out      :   none
+   Job      :   deallocate a fit workspace
+ ---------------------------------------------------------------------------*/
+
+void deleteFitWorkspace(VimosFitWorkspace *ws);
+
+
+/*---------------------------------------------------------------------------
+   Function :   fitPolyWorkspace()
+   In       :   fit workspace, requested polynomial degree
+                a list of pixel positions + number of pixels in the list
+                optional weights (NULL for unit weights)
+                (out) polyDeg+1 fit coefficients
+                (out) mean squared error, set to NULL if you do not want
+                to compute it.
+   Out      :   VM_TRUE on success
+   Job      :   same as fit1DPoly(), using a preallocated workspace
+   Notice   :   the solution is obtained by Householder QR decomposition
+                of the Vandermonde matrix, which does not square its
+                condition number as the normal equations do. With
+                weights the weighted mean squared error is returned.
+ ---------------------------------------------------------------------------*/
+
+VimosBool fitPolyWorkspace(VimosFitWorkspace *ws, int polyDeg,
+                           VimosDpoint *list, int np, double *weights,
+                           double *coeffs, double *meanSquaredError);
+
+
+/*---------------------------------------------------------------------------
+   Function :   fitPolyRejectWorkspace()
+   In       :   fit workspace, requested polynomial degree
+                a list of pixel positions + (in/out) number of pixels
+                rejection threshold in sigmas, max rejection iterations
+                (out) polyDeg+1 fit coefficients
+                (out) mean squared error, or NULL
+   Out      :   VM_TRUE on success
+   Job      :   polynomial fit with iterative rejection of the points
+                deviating more than nSigma times the rms of the fit
+   Notice   :   rejected points are removed from the list in place, and
+                the order of the remaining points is preserved.
+ ---------------------------------------------------------------------------*/
+
+VimosBool fitPolyRejectWorkspace(VimosFitWorkspace *ws, int polyDeg,
+                                 VimosDpoint *list, int *np, double nSigma,
+                                 int maxIter, double *coeffs,
+                                 double *meanSquaredError);
+
+
+
 /*---------------------------------------------------------------------------
    Function :   fit_surface_polynomial()
    In       :   list of pixels, # of pixels in the list.
@@ -110,6 +193,25 @@ double *fitSurfacePolynomial(VimosPixel *surface, int np,
                              double *meanSquaredError);
 
 
+
+/*---------------------------------------------------------------------------
+   Function :   fitSurfaceWorkspace()
+   In       :   fit workspace, list of pixels, # of pixels in the list,
+                number of coefficients and their degrees in x and y
+                (see buildupPolytabFromString()), optional weights
+                (out) nc fit coefficients
+                (out) mean squared error, or NULL
+   Out      :   VM_TRUE on success
+   Job      :   same as fitSurfacePolynomial(), using a preallocated
+                workspace and a Householder QR solution
+ ---------------------------------------------------------------------------*/
+
+VimosBool fitSurfaceWorkspace(VimosFitWorkspace *ws, VimosPixel *surface,
+                              int np, int nc, int *degxTab, int *degyTab,
+                              double *weights, double *coeffs,
+                              double *meanSquaredError);
+
+
 /*------------------------------------------------------------------------
    Function :   fitSurPolErrors
    In       :   list of pixels, # of pixels in the list.
@@ -34,6 +34,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <math.h>
+#include <complex.h>
 #include <float.h> /* for DBL_EPSILON, added by Peter Weilbacher */
 
 #include <vmmath.h>
@@ -46,10 +47,12 @@
 #include <cpl_type.h>
 #include <cpl_propertylist.h>
 #include <cpl_error.h>
+#include <cpl_errorstate.h>
 #include <cpl_memory.h>
 #include <pilmemory.h>
 #include <pilmessages.h>
 #include <cpl_msg.h>
+#include <cpl_fft.h>
 
 
 #define N_SLITS          (4)
@@ -126,33 +129,240 @@ static void drawModel(cpl_table *model,
 }
 
 
-static int countRejections(VimosDpoint *list, 
-                           int npix, double *c, int order, float tolerance)
+/*
+ * Shared normal equations for the polynomial fit of all fiber traces.
+ *
+ * All fiber traces are sampled at the same Y positions, so the powers
+ * of the (scaled) abscissa and the matrix A'A of the normal equations
+ * are computed just once. The fit of each trace then only needs the
+ * right hand side A'y, and the rows of the NULL or rejected points are
+ * subtracted (downdated) from a copy of the shared matrix. The abscissa
+ * is divided by its largest absolute value to keep A'A well conditioned,
+ * and the coefficients are scaled back before being returned.
+ */
+
+typedef struct {
+  int     order;
+  int     range;
+  double  scale;
+  double *powers;   /* range x (order + 1) powers of the scaled abscissa */
+  double *gram;     /* (order + 1) x (order + 1) matrix A'A              */
+  double *work;     /* Matrices and right hand sides of one fit          */
+  char   *mask;     /* Points excluded from one fit                      */
+} IfuTraceFit;
+
+static IfuTraceFit *newIfuTraceFit(const int *y, int range, int order)
 {
 
-  int    i, j;
-  int    rejected = 0;
-  double value;
+  IfuTraceFit *fit = cpl_malloc(sizeof(IfuTraceFit));
+  int          n = order + 1;
+  int          i, j, k;
 
 
-  j = 0;
-  for (i = 0; i < npix; i++) {
+  fit->order = order;
+  fit->range = range;
+  fit->scale = 0.0;
+  for (j = 0; j < range; j++)
+    if (fit->scale < abs(y[j]))
+      fit->scale = abs(y[j]);
+  if (fit->scale == 0.0)
+    fit->scale = 1.0;
+
+  fit->powers = cpl_malloc(range * n * sizeof(double));
+  fit->gram = cpl_calloc(n * n, sizeof(double));
+  fit->work = cpl_malloc((2 * n * n + 3 * n) * sizeof(double));
+  fit->mask = cpl_malloc(range * sizeof(char));
+
+  for (j = 0; j < range; j++) {
+    double *p = fit->powers + j * n;
+    double  t = y[j] / fit->scale;
+
+    p[0] = 1.0;
+    for (k = 1; k < n; k++)
+      p[k] = p[k - 1] * t;
+
+    for (i = 0; i < n; i++)
+      for (k = 0; k <= i; k++)
+        fit->gram[i * n + k] += p[i] * p[k];
+  }
+
+  for (i = 0; i < n; i++)
+    for (k = i + 1; k < n; k++)
+      fit->gram[i * n + k] = fit->gram[k * n + i];
+
+  return fit;
+
+}
+
+static void deleteIfuTraceFit(IfuTraceFit *fit)
+{
+
+  if (fit) {
+    cpl_free(fit->powers);
+    cpl_free(fit->gram);
+    cpl_free(fit->work);
+    cpl_free(fit->mask);
+    cpl_free(fit);
+  }
+
+}
+
+/*
+ * Solve the normal equations by Cholesky decomposition. The matrix
+ * and the right hand side are overwritten, the solution is written
+ * to d. Returns 0 on success.
+ */
+
+static int solveIfuTraceFit(double *m, double *b, double *d, int n)
+{
+
+  int    i, j, k;
+  double sum;
+
 
-    value = modelValue1D(c, order, list[i].x);
+  for (j = 0; j < n; j++) {
+    sum = m[j * n + j];
+    for (k = 0; k < j; k++)
+      sum -= m[j * n + k] * m[j * n + k];
+    if (sum <= DBL_EPSILON * fabs(m[j * n + j]) || sum <= 0.0)
+      return 1;
+    m[j * n + j] = sqrt(sum);
+    for (i = j + 1; i < n; i++) {
+      sum = m[i * n + j];
+      for (k = 0; k < j; k++)
+        sum -= m[i * n + k] * m[j * n + k];
+      m[i * n + j] = sum / m[j * n + j];
+    }
+  }
+
+  for (i = 0; i < n; i++) {
+    sum = b[i];
+    for (k = 0; k < i; k++)
+      sum -= m[i * n + k] * b[k];
+    b[i] = sum / m[i * n + i];
+  }
+
+  for (i = n - 1; i >= 0; i--) {
+    sum = b[i];
+    for (k = i + 1; k < n; k++)
+      sum -= m[k * n + i] * d[k];
+    d[i] = sum / m[i * n + i];
+  }
+
+  return 0;
+
+}
+
+/*
+ * Fit one trace. Points flagged in the optional null array are excluded,
+ * then all points deviating from the first fit more than tolerance are
+ * rejected and the fit is repeated. The total number of excluded points
+ * is returned in rejected; the fit is not attempted when it exceeds
+ * maxReject, or when there are not enough points. Returns 0 on success,
+ * with the coefficients written to c and the mean squared residual of
+ * the accepted points to rms (if not NULL).
+ */
 
-    if (fabs(list[i].y - value) > tolerance)
-      rejected++;
+static int ifuTraceFitOne(IfuTraceFit *fit, const float *trace, 
+                          const char *null, float tolerance, int maxReject,
+                          int *rejected, double *c, double *rms)
+{
+
+  int     n = fit->order + 1;
+  int     range = fit->range;
+  double *m = fit->work;
+  double *b = m + n * n;
+  double *mfit = b + n;
+  double *bfit = mfit + n * n;
+  double *d = bfit + n;
+  char   *mask = fit->mask;
+  double  value, sum;
+  int     count = 0;
+  int     more = 0;
+  int     i, j, k;
+
+
+  /*
+   * Right hand side, and downdate of the shared matrix for the NULLs.
+   */
+
+  memcpy(m, fit->gram, n * n * sizeof(double));
+  for (k = 0; k < n; k++)
+    b[k] = 0.0;
+
+  for (j = 0; j < range; j++) {
+    const double *p = fit->powers + j * n;
+    mask[j] = null ? null[j] : 0;
+    if (mask[j]) {
+      for (i = 0; i < n; i++)
+        for (k = 0; k < n; k++)
+          m[i * n + k] -= p[i] * p[k];
+      count++;
+    }
     else {
-      if (j < i) {
-        list[j].x = list[i].x;
-        list[j].y = list[i].y;
+      for (k = 0; k < n; k++)
+        b[k] += p[k] * trace[j];
+    }
+  }
+
+  *rejected = count;
+
+  if (count > maxReject || range - count < n)
+    return 1;
+
+  memcpy(mfit, m, n * n * sizeof(double));
+  memcpy(bfit, b, n * sizeof(double));
+  if (solveIfuTraceFit(mfit, bfit, d, n))
+    return 1;
+
+  /*
+   * Reject the outliers, removing their contribution to the normal
+   * equations instead of rebuilding them.
+   */
+
+  for (j = 0; j < range; j++) {
+    const double *p = fit->powers + j * n;
+    if (mask[j])
+      continue;
+    for (value = 0.0, k = 0; k < n; k++)
+      value += d[k] * p[k];
+    if (fabs(trace[j] - value) > tolerance) {
+      for (i = 0; i < n; i++) {
+        b[i] -= p[i] * trace[j];
+        for (k = 0; k < n; k++)
+          m[i * n + k] -= p[i] * p[k];
       }
-      j++;
+      mask[j] = 1;
+      more++;
     }
+  }
+
+  *rejected = count + more;
+
+  if (count + more > maxReject || range - count - more < n)
+    return 1;
 
+  if (more)
+    if (solveIfuTraceFit(m, b, d, n))
+      return 1;
+
+  if (rms) {
+    sum = 0.0;
+    for (j = 0; j < range; j++) {
+      const double *p = fit->powers + j * n;
+      if (mask[j])
+        continue;
+      for (value = 0.0, k = 0; k < n; k++)
+        value += d[k] * p[k];
+      sum += (trace[j] - value) * (trace[j] - value);
+    }
+    *rms = sum / (range - count - more);
   }
 
-  return rejected;
+  for (value = 1.0, k = 0; k < n; k++, value *= fit->scale)
+    c[k] = d[k] / value;
+
+  return 0;
 
 }
 
@@ -2105,6 +2315,102 @@ cpl_image *removeBiasLevel(cpl_image *image)
 }
 
 
+/*
+ * Cross-correlate a reference window with a data buffer, so that on
+ * return cross[j] = sum_k ref[k] * data[j + k], for j = 0 ... ncross - 1.
+ * The data buffer must hold nref + ncross - 1 values. For long lag
+ * intervals the correlation is obtained from the FFT of the zero-padded
+ * buffers, otherwise (or if CPL was built without FFT support) the sums
+ * are computed directly.
+ */
+
+static void ifuCrossCorrelate(const double *data, const double *ref, 
+                              int nref, double *cross, int ncross)
+{
+
+  int             ndata = nref + ncross - 1;
+  int             nfft  = 1;
+  int             nlog  = 0;
+  int             direct;
+  int             i, j;
+  double          sum;
+  double complex *dtrans;
+  double complex *rtrans;
+  cpl_image      *dimage;
+  cpl_image      *rimage;
+  cpl_image      *dfft;
+  cpl_image      *rfft;
+  cpl_errorstate  prestate = cpl_errorstate_get();
+
+
+  while (nfft < ndata) {
+    nfft <<= 1;
+    nlog++;
+  }
+
+  /*
+   *  The direct sums are cheaper as long as the number of lags is
+   *  small compared with the (planning included) cost of the FFT.
+   */
+
+  direct = (double)nref * ncross <= 16.0 * nfft * nlog;
+
+  if (!direct) {
+
+    dimage = cpl_image_new(nfft, 1, CPL_TYPE_DOUBLE);
+    rimage = cpl_image_new(nfft, 1, CPL_TYPE_DOUBLE);
+    dfft = cpl_image_new(nfft / 2 + 1, 1, CPL_TYPE_DOUBLE_COMPLEX);
+    rfft = cpl_image_new(nfft / 2 + 1, 1, CPL_TYPE_DOUBLE_COMPLEX);
+
+    memcpy(cpl_image_get_data_double(dimage), data, ndata * sizeof(double));
+    memcpy(cpl_image_get_data_double(rimage), ref, nref * sizeof(double));
+
+    /*
+     *  Correlation theorem: the transform of the cross-correlation
+     *  is the product of the data transform with the conjugate of
+     *  the reference transform. No wrap-around takes place within
+     *  the first ncross lags, since nfft >= ndata.
+     */
+
+    direct = 1;
+    if (cpl_fft_image(dfft, dimage, CPL_FFT_FORWARD) == CPL_ERROR_NONE &&
+        cpl_fft_image(rfft, rimage, CPL_FFT_FORWARD) == CPL_ERROR_NONE) {
+
+      dtrans = cpl_image_get_data_double_complex(dfft);
+      rtrans = cpl_image_get_data_double_complex(rfft);
+
+      for (i = 0; i <= nfft / 2; i++)
+        dtrans[i] *= conj(rtrans[i]);
+
+      if (cpl_fft_image(dimage, dfft, CPL_FFT_BACKWARD) == CPL_ERROR_NONE) {
+        memcpy(cross, cpl_image_get_data_double(dimage), 
+               ncross * sizeof(double));
+        direct = 0;
+      }
+    }
+
+    if (direct)
+      cpl_errorstate_set(prestate);
+
+    cpl_image_delete(dimage);
+    cpl_image_delete(rimage);
+    cpl_image_delete(dfft);
+    cpl_image_delete(rfft);
+
+  }
+
+  if (direct) {
+    for (j = 0; j < ncross; j++) {
+      sum = 0.0;
+      for (i = 0; i < nref; i++)
+        sum += ref[i] * data[j + i];
+      cross[j] = sum;
+    }
+  }
+
+}
+
+
 /**
  * @memo
  *   Identify fibers. 
@@ -2130,16 +2436,18 @@ cpl_image *removeBiasLevel(cpl_image *image)
  *   flat field image at the reference row, and the reference
  *   image consisting of a row of peaks where the corresponding
  *   fiber spectra were already identified. The flat field image 
- *   at the reference row is divided into 5 contiguous sections 
- *   of 409 pixels each. The first section begins at the second
+ *   at the reference row is divided into 3 contiguous sections 
+ *   of 680 pixels each. The first section begins at the second
  *   pixel on the left (pixel 1). The correlation window is twice
- *   the value of @em wradius plus 1. The correlation is made on
- *   an interval of twice the value of @em radius plus 1. For this
- *   reason, 2 * (@em radius + @em wradius ) + 1 must be less than
- *   409, or an error will be returned. The correlation is tried
- *   for each one of the sections. The median of the 5 offsets
- *   obtained from the correlations is applied to the positions
- *   listed in the @em ident table.
+ *   the value of @em wradius plus 1, and it is centered on each
+ *   section. The correlation is made on an interval of twice the 
+ *   value of @em radius plus 1, computed in a single pass through 
+ *   the FFT, so that its cost does not grow with @em radius. Data 
+ *   falling outside the image row are taken as zero, so that large 
+ *   values of @em radius may be used to recover large flexure 
+ *   offsets. The correlation is tried for each one of the sections. 
+ *   The median of the 3 offsets obtained from the correlations is 
+ *   applied to the positions listed in the @em ident table.
  *
  * @author C. Izzo
  */
@@ -2168,30 +2476,29 @@ int ifuIdentifyUpgrade(cpl_image *image, int refrow, float *refdata,
   float   dx;
   float  *posdata;
   int     maxpos;
-  double  sum;
   int     length   = 2 * radius + 1;
   int     wlength  = 2 * wradius + 1;
   int     start;
-  int     i, j, k;
+  int     i, j;
 
 
-  normdata = cpl_malloc(secSize * sizeof(double));
+  normdata = cpl_malloc((wlength + length - 1) * sizeof(double));
   normref = cpl_malloc(wlength * sizeof(double));
   cross = cpl_malloc(length * sizeof(double));
 
   for (i = 0; i < secCount; i++) {
 
     /*
-     *  Load data from current section, and normalize them.
+     *  Normalize to the maximum of the current section the data
+     *  that will be correlated, i.e., those within wradius + radius
+     *  pixels from the section center.
      */
 
     start = firstpix + i * secSize;
     max = line[start];
-    for (j = 0; j < secSize; j++) {
-      normdata[j] = line[start + j];
-      if (normdata[j] > max)
-        max = normdata[j];
-    }
+    for (j = 1; j < secSize; j++)
+      if (line[start + j] > max)
+        max = line[start + j];
 
     if (fabs(max) < 0.000001) {
       cpl_free(normdata);
@@ -2200,15 +2507,20 @@ int ifuIdentifyUpgrade(cpl_image *image, int refrow, float *refdata,
       return 1;
     }
 
-    for (j = 0; j < secSize; j++)
-      normdata[j] /= max;
+    start += secSize / 2 - wradius - radius;
+    for (j = 0; j < wlength + length - 1; j++) {
+      if (start + j >= 0 && start + j < nx)
+        normdata[j] = line[start + j] / max;
+      else
+        normdata[j] = 0.0;
+    }
 
     /*
      *  Load data from the corresponding reference image section,
      *  and normalize them.
      */
 
-    start += secSize / 2 - wradius;
+    start = firstpix + i * secSize + secSize / 2 - wradius;
     max = refdata[start];
     for (j = 0; j < wlength; j++) {
       normref[j] = refdata[start + j];
@@ -2230,13 +2542,7 @@ int ifuIdentifyUpgrade(cpl_image *image, int refrow, float *refdata,
      *  Cross-correlation of normalized data.
      */
 
-    start = secSize / 2 - wradius - radius;
-    for (j = 0; j < length; j++) {
-      sum = 0.0;
-      for (k = 0; k < wlength; k++) 
-        sum += normref[k] * normdata[start + j + k];
-      cross[j] = sum;
-    }
+    ifuCrossCorrelate(normdata, normref, wlength, cross, length);
 
     max = cross[0];
     maxpos = 0;
@@ -2387,7 +2693,7 @@ cpl_table *ifuIdentify(cpl_image *image, int refrow)
   double     level, plevel;
   char       colName[MAX_COLNAME];
 
-  float      fpos;
+  int       *status;
   float      max;
   float      candidate[20];
   int        peak[20];
@@ -2673,44 +2979,26 @@ cpl_table *ifuIdentify(cpl_image *image, int refrow)
   cpl_table_name_column(ident, "Position", "FirstGuess");
   cpl_table_cast_column(ident, "FirstGuess", "Position", CPL_TYPE_FLOAT);
 
-  for (i = 0; i < N_BLOCKS * FIBERS_PER_BLOCK; i++) {
-    fpos = cpl_table_get_float(ident, "Position", i, NULL);
-    if (!fiberPeak(image, refrow, &fpos, NULL))
-      cpl_table_set_float(ident, "Position", i, fpos);
-  }
+  status = cpl_malloc(N_BLOCKS * FIBERS_PER_BLOCK * sizeof(int));
+  fiberPeaks(image, refrow, N_BLOCKS * FIBERS_PER_BLOCK,
+             cpl_table_get_data_float(ident, "Position"), NULL, status);
+  cpl_free(status);
 
   return ident;
 
 }
 
 
-/**
- * @memo
- *   Improve peak position.
- *
- * @return 0 on success.
- *
- * @param image    Image of an IFU flat field exposure.
- * @param row      Image row where the peak is.
- * @param position First-guess position of the peak (pixel).
- *
- * @doc
- *   In the assumption of high S/N, the peak is obtained by parabolic
- *   interpolation of the three highest pixels values within the peak.
- *
- * @author C. Izzo
+/*
+ * Refine the position of a peak on an image row, as described for
+ * fiberPeak().
  */
 
-int fiberPeak(cpl_image *image, int row, float *position, float *max)
+static int linePeak(const float *line, int nx, float *position, float *max)
 {
 
   char    task[] = "fiberPeak";
 
-  int     nx   = cpl_image_get_size_x(image);
-  int     ny   = cpl_image_get_size_y(image);
-  float  *data = cpl_image_get_data(image);
-  float  *line = data + row * nx;
-
   int     pos = *position + 0.5;    /* Nearest integer */
   int     ipos = pos;
   int     step;
@@ -2718,11 +3006,6 @@ int fiberPeak(cpl_image *image, int row, float *position, float *max)
   float   rpos;
 
 
-  if (row < 0 || row >= ny) {
-    cpl_msg_debug(task, "Image row %d out of bounds.", row);
-    return 1;
-  }
-  
   if (!(pos > 0 && pos < nx - 1)) {
     cpl_msg_debug(task, "Peak position %f out of bounds.", *position);
     return 1;
@@ -2780,10 +3063,168 @@ int fiberPeak(cpl_image *image, int row, float *position, float *max)
   }
 
   return 0;
+
+}
+
+
+/**
+ * @memo
+ *   Improve peak position.
+ *
+ * @return 0 on success.
+ *
+ * @param image    Image of an IFU flat field exposure.
+ * @param row      Image row where the peak is.
+ * @param position First-guess position of the peak (pixel).
+ *
+ * @doc
+ *   In the assumption of high S/N, the peak is obtained by parabolic
+ *   interpolation of the three highest pixels values within the peak.
+ *
+ * @author C. Izzo
+ */
+
+int fiberPeak(cpl_image *image, int row, float *position, float *max)
+{
+
+  char    task[] = "fiberPeak";
+
+  int     nx   = cpl_image_get_size_x(image);
+  int     ny   = cpl_image_get_size_y(image);
+  float  *data = cpl_image_get_data(image);
+
+
+  if (row < 0 || row >= ny) {
+    cpl_msg_debug(task, "Image row %d out of bounds.", row);
+    return 1;
+  }
+
+  return linePeak(data + row * nx, nx, position, max);
   
 }
 
 
+/**
+ * @memo
+ *   Improve the positions of many peaks on the same image row.
+ *
+ * @return Number of peaks that could not be refined, or -1 on error.
+ *
+ * @param image    Image of an IFU flat field exposure.
+ * @param row      Image row where the peaks are.
+ * @param npeaks   Number of peaks.
+ * @param position First-guess positions of the peaks (pixel).
+ * @param max      Peak values, or NULL.
+ * @param status   Refinement status of each peak.
+ *
+ * @doc
+ *   Each peak is refined as by fiberPeak(), but all peaks are refined
+ *   in a single pass along the image row. The status of each peak is
+ *   set to 0 if its position (and value) was refined, and to 1 if the
+ *   peak was not found: in this case its position is left unchanged.
+ *
+ * @author C. Izzo
+ */
+
+int fiberPeaks(cpl_image *image, int row, int npeaks, float *position,
+               float *max, int *status)
+{
+
+  char    task[] = "fiberPeaks";
+
+  int     nx   = cpl_image_get_size_x(image);
+  int     ny   = cpl_image_get_size_y(image);
+  float  *data = cpl_image_get_data(image);
+  float  *line;
+  int     lost = 0;
+  int     i;
+
+
+  if (row < 0 || row >= ny) {
+    cpl_msg_debug(task, "Image row %d out of bounds.", row);
+    return -1;
+  }
+
+  line = data + row * nx;
+
+  for (i = 0; i < npeaks; i++) {
+    status[i] = linePeak(line, nx, position + i, max ? max + i : NULL);
+    lost += status[i];
+  }
+
+  return lost;
+
+}
+
+
+/*
+ * Follow the peaks of a set of spectra along the image rows, from the
+ * reference row up to row + above, and from row - step down to
+ * row - below, sampling one row every step. The tracing of each
+ * spectrum starts from its position on the reference row. All the
+ * peaks on a row are refined together with fiberPeaks(), so that each
+ * image row is scanned once. The positions are written to the arrays
+ * position[i] (and the peak values to value[i], if given), indexed by
+ * the image row minus offset. Where a peak is lost, or moves by more
+ * than tolerance from its previous position, the tracing of that
+ * spectrum is carried on from the previous position, and the flag
+ * of the spectrum at that row is set in the range x npeaks row-major
+ * array lost.
+ */
+
+static void ifuTraceRows(cpl_image *image, int row, int above, int below,
+                         int step, int offset, int npeaks, const float *start,
+                         double tolerance, float **position, float **value,
+                         char *lost)
+{
+
+  float *current  = cpl_malloc(npeaks * sizeof(float));
+  float *previous = cpl_malloc(npeaks * sizeof(float));
+  float *max      = cpl_malloc(npeaks * sizeof(float));
+  int   *status   = cpl_malloc(npeaks * sizeof(int));
+  int    i, j, k, pass;
+
+
+  for (pass = 0; pass < 2; pass++) {
+
+    int first = pass ? step : 0;
+    int last  = pass ? below : above;
+    int dk    = pass ? -step : step;
+
+    memcpy(current, start, npeaks * sizeof(float));
+
+    for (j = first, k = row + (pass ? -step : 0); j <= last; j += step, k += dk) {
+
+      char *flag = lost + (k - offset) * npeaks;
+
+      memcpy(previous, current, npeaks * sizeof(float));
+      fiberPeaks(image, k, npeaks, current, max, status);
+
+      for (i = 0; i < npeaks; i++) {
+        if (status[i]) {
+          flag[i] = 1;
+        }
+        else if (fabs(previous[i] - current[i]) < tolerance) {
+          position[i][k - offset] = current[i];
+          if (value)
+            value[i][k - offset] = max[i];
+        }
+        else {
+          flag[i] = 1;
+          current[i] = previous[i];
+        }
+      }
+    }
+  }
+
+  cpl_free(status);
+  cpl_free(max);
+  cpl_free(previous);
+  cpl_free(current);
+
+}
+
+
 /**
  * @memo
  *   Trace all fibers.
@@ -2818,15 +3259,15 @@ cpl_table **ifuTrace(cpl_image *image, int row, int above, int below,
   cpl_table  *signal;
   cpl_table **tables;
   float      *pdata;
-  float      *fdata;
-  float      *mdata;
+  float     **fdata;
+  float     **mdata;
   int        *idata;
+  char       *lost;
   int         ny     = cpl_image_get_size_y(image);
+  int         nfibers = N_BLOCKS * FIBERS_PER_BLOCK;
 
   int         i, j, k;
   int         range, offset;
-  float       position, prePosition;
-  float       max;
   char        colName[MAX_COLNAME];
 
   
@@ -2862,7 +3303,10 @@ cpl_table **ifuTrace(cpl_image *image, int row, int above, int below,
 
   pdata = cpl_table_get_data_float(ident, "Position");
 
-  for (i = 0; i < N_BLOCKS * FIBERS_PER_BLOCK; i++) {
+  fdata = cpl_malloc(nfibers * sizeof(float *));
+  mdata = cpl_malloc(nfibers * sizeof(float *));
+
+  for (i = 0; i < nfibers; i++) {
     snprintf(colName, MAX_COLNAME, "f%d", i + 1);
     cpl_table_new_column(trace, colName, CPL_TYPE_FLOAT);
 
@@ -2875,7 +3319,7 @@ cpl_table **ifuTrace(cpl_image *image, int row, int above, int below,
     else 
       cpl_table_fill_column_window_float(trace, colName, 0, range, 0.0);
 
-    fdata = cpl_table_get_data_float(trace, colName);
+    fdata[i] = cpl_table_get_data_float(trace, colName);
 
     cpl_table_new_column(signal, colName, CPL_TYPE_FLOAT);
 
@@ -2888,47 +3332,32 @@ cpl_table **ifuTrace(cpl_image *image, int row, int above, int below,
     else 
       cpl_table_fill_column_window_float(signal, colName, 0, range, 0.0);
 
-    mdata = cpl_table_get_data_float(signal, colName);
-    position = pdata[i];
-    for (j = 0, k = row; j <= above; j += step, k += step) {
-      prePosition = position;
-      if (fiberPeak(image, k, &position, &max)) {
-        cpl_table_set_invalid(trace, colName, k - offset);
-        cpl_table_set_invalid(signal, colName, k - offset);
-      }
-      else {
-        if (fabs(prePosition - position) < 0.9) {    /*  WAS 0.2, poi 0.4 */
-          fdata[k - offset] = position;
-          mdata[k - offset] = max;
-        }
-        else {
-          cpl_table_set_invalid(trace, colName, k - offset);
-          cpl_table_set_invalid(signal, colName, k - offset);
-          position = prePosition;
-        }
-      }
-    }
-    position = pdata[i];
-    for (j = step, k = row - step; j <= below; j += step, k -= step) {
-      prePosition = position;
-      if (fiberPeak(image, k, &position, &max)) {
-        cpl_table_set_invalid(trace, colName, k - offset);
-        cpl_table_set_invalid(signal, colName, k - offset);
-      }
-      else {
-        if (fabs(prePosition - position) < 0.9) {     /*  ERA 0.2, poi 0.4 */
-          fdata[k - offset] = position;
-          mdata[k - offset] = max;
-        }
-        else {
-          cpl_table_set_invalid(trace, colName, k - offset);
-          cpl_table_set_invalid(signal, colName, k - offset);
-          position = prePosition;
-        }
+    mdata[i] = cpl_table_get_data_float(signal, colName);
+  }
+
+  /*
+   *  All fibers are traced together, row by row.
+   */
+
+  lost = cpl_calloc(range * nfibers, sizeof(char));
+
+  ifuTraceRows(image, row, above, below, step, offset, nfibers, pdata,
+               0.9, fdata, mdata, lost);      /*  WAS 0.2, poi 0.4 */
+
+  for (i = 0; i < nfibers; i++) {
+    snprintf(colName, MAX_COLNAME, "f%d", i + 1);
+    for (k = 0; k < range; k++) {
+      if (lost[k * nfibers + i]) {
+        cpl_table_set_invalid(trace, colName, k);
+        cpl_table_set_invalid(signal, colName, k);
       }
     }
   }
 
+  cpl_free(lost);
+  cpl_free(mdata);
+  cpl_free(fdata);
+
 /*  cpl_image_save(image, "fibers.fits", -32, NULL);  */
 
   tables = cpl_malloc(2 * sizeof(cpl_table *));
@@ -3060,13 +3489,14 @@ cpl_table **ifuFit(cpl_table *trace, int order, float tolerance, int maxReject)
   cpl_table   *coeff;
   cpl_table   *model;
   cpl_table  **tables;
-  VimosDpoint *list;
-  double      *c = NULL;
+  IfuTraceFit *fit;
+  double      *c;
   double       rms;
   float       *fdata;
   int         *idata;
-  int          range, npix;
-  int          rejected, moreRejected;
+  char        *null;
+  int          range;
+  int          rejected;
   int          i, j, k;
   char         colName[MAX_COLNAME];
 
@@ -3084,9 +3514,14 @@ cpl_table **ifuFit(cpl_table *trace, int order, float tolerance, int maxReject)
   }
   cpl_table_new_column(coeff, "rms", CPL_TYPE_DOUBLE);
 
-  list = newDpoint(range);
+  /*
+   * All traces are sampled at the same Y positions: the normal
+   * equations are set up once for all fibers.
+   */
 
-  idata = cpl_table_get_data_int(trace, "y");
+  fit = newIfuTraceFit(idata, range, order);
+  null = cpl_malloc(range * sizeof(char));
+  c = cpl_malloc((order + 1) * sizeof(double));
 
   for (i = 0; i < N_BLOCKS * FIBERS_PER_BLOCK; i++) {
     snprintf(colName, MAX_COLNAME, "f%d", i + 1);
@@ -3100,53 +3535,30 @@ cpl_table **ifuFit(cpl_table *trace, int order, float tolerance, int maxReject)
 
     if (rejected) {
       cpl_table_fill_invalid_float(trace, colName, -1);
-      npix = 0;
-      for (j = 0; j < range; j++) {
-        if (fdata[j] < 0.)
-          continue;
-        list[npix].x = idata[j];
-        list[npix].y = fdata[j];
-        npix++;
-      }
-    }
-    else {
-      npix = range;
-      for (j = 0; j < npix; j++) {
-        list[j].x = idata[j];
-        list[j].y = fdata[j];
-      }
+      for (j = 0; j < range; j++)
+        null[j] = fdata[j] < 0.;
     }
 
-    c = fit1DPoly(order, list, npix, &rms);
-    if (c) {
-      moreRejected = countRejections(list, npix, c, order, tolerance);
-      if (rejected + moreRejected > maxReject) {
+    if (ifuTraceFitOne(fit, fdata, rejected ? null : NULL, tolerance,
+                       maxReject, &rejected, c, &rms)) {
+      if (rejected > maxReject)
         cpl_msg_debug(task, "Rejected fiber: %d (%d bad values)", 
-                   i + 1, rejected + moreRejected);
-        free(c);
-        c = NULL;
-        continue;
-      }
-      else if (moreRejected) {    /*  Iteration  */
-        free(c);
-        c = NULL;
-        c = fit1DPoly(order, list, npix - moreRejected, &rms);
-      }
-      if (c) {
-        drawModel(model, colName, c, order);
-        for (k = 0; k <= order; k++) {
-          snprintf(colName, MAX_COLNAME, "c%d", k);
-          cpl_table_set_double(coeff, colName, i, c[k]);
-        }
-        cpl_table_set_double(coeff, "rms", i, sqrt(rms));
-        free(c);
-        c = NULL;
-      }
+                      i + 1, rejected);
+      continue;
     }
 
+    drawModel(model, colName, c, order);
+    for (k = 0; k <= order; k++) {
+      snprintf(colName, MAX_COLNAME, "c%d", k);
+      cpl_table_set_double(coeff, colName, i, c[k]);
+    }
+    cpl_table_set_double(coeff, "rms", i, sqrt(rms));
+
   }
 
-  deleteDpoint(list);
+  cpl_free(c);
+  cpl_free(null);
+  deleteIfuTraceFit(fit);
 
   tables = cpl_malloc(2 * sizeof(cpl_table *));
 
@@ -3244,6 +3656,7 @@ cpl_image *ifuBack(cpl_image *image, int hr, cpl_table **coeffs,
   double      *ket;       /* Tracing coefficients for right limit */
   double      *c = NULL;  /* Generic tracing coefficients         */
   double      *b = NULL;  /* Background fit surface coefficients  */
+  VimosFitWorkspace *ws;  /* Reused by all the background fits  */
 
   int dir;
   int radius = 5;         /* In number of fibers                  */
@@ -3385,6 +3798,8 @@ cpl_image *ifuBack(cpl_image *image, int hr, cpl_table **coeffs,
   data = cpl_image_get_data(background);
 
   list = newDpoint(xlen);
+  ws = newFitWorkspace(xlen, order + 1);
+  b = cpl_malloc((order + 1) * sizeof(double));
 
   for (j = 0; j < ylen; j++) {
     for (i = 0, m = 0; i < xlen; i++) {
@@ -3397,17 +3812,17 @@ cpl_image *ifuBack(cpl_image *image, int hr, cpl_table **coeffs,
     }
 
     if (m > order + 1) {
-      b = fit1DPoly(order, list, m, NULL);
-      if (b) {
+      if (fitPolyWorkspace(ws, order, list, m, NULL, b, NULL)) {
         for (i = 0; i < xlen; i++)
           data[j * xlen + i] = modelValue1D(b, order, i);
-        free(b);
-        b = NULL;
       }
     }
 
   }
 
+  cpl_free(b);
+  b = NULL;
+  deleteFitWorkspace(ws);
   deleteDpoint(list);
 
   sbackground = cpl_image_general_median_filter(background, 1, 15, 0);
@@ -4264,6 +4679,7 @@ cpl_table *ifuDetect(cpl_image *image, int row, float minSignal)
   int       *idata;
   int       *mask1;
   int       *mask2;
+  int       *status;
 
   cpl_table *imageRow;
   cpl_table *ident;
@@ -4271,7 +4687,7 @@ cpl_table *ifuDetect(cpl_image *image, int row, float minSignal)
   char       colXpos[]   = "x";
   char       colSvalue[] = "svalue";
   char       colValue[]  = "value";
-  float      mean, fpos;
+  float      mean;
   /* float      minSignal   = 70.0;  Removed by Peter Weilbacher */
   int        hw          = 3;
   int        count, countTraceable;
@@ -4403,11 +4819,10 @@ cpl_table *ifuDetect(cpl_image *image, int row, float minSignal)
   cpl_table_name_column(ident, "Position", "FirstGuess");
   cpl_table_cast_column(ident, "FirstGuess", "Position", CPL_TYPE_FLOAT);
 
-  for (i = 0; i < countTraceable; i++) {
-    fpos = cpl_table_get_float(ident, "Position", i, NULL);
-    if (!fiberPeak(image, row, &fpos, NULL))
-      cpl_table_set_float(ident, "Position", i, fpos);
-  }
+  status = cpl_malloc(countTraceable * sizeof(int));
+  fiberPeaks(image, row, countTraceable,
+             cpl_table_get_data_float(ident, "Position"), NULL, status);
+  cpl_free(status);
 
   return ident;
 
@@ -4448,15 +4863,14 @@ cpl_table *ifuTraceDetected(cpl_image *image, int row, int above, int below,
 
   cpl_table  *trace;
   float      *pdata;
-  float      *fdata;
+  float     **fdata;
   int        *idata;
+  char       *lost;
   int         ny = cpl_image_get_size_y(image);
   int         countTraceable = cpl_table_get_nrow(ident);
 
   int         i, j, k;
   int         range, offset;
-  float       position, prePosition;
-  float       max;
   char        colName[MAX_COLNAME];
 
   
@@ -4481,6 +4895,8 @@ cpl_table *ifuTraceDetected(cpl_image *image, int row, int above, int below,
 
   pdata = cpl_table_get_data_float(ident, "Position");
 
+  fdata = cpl_malloc(countTraceable * sizeof(float *));
+
   for (i = 0; i < countTraceable; i++) {
     snprintf(colName, MAX_COLNAME, "t%d", i + 1);
     cpl_table_new_column(trace, colName, CPL_TYPE_FLOAT);
@@ -4494,42 +4910,28 @@ cpl_table *ifuTraceDetected(cpl_image *image, int row, int above, int below,
     else
       cpl_table_fill_column_window_float(trace, colName, 0, range, 0.0);
 
-    fdata = cpl_table_get_data_float(trace, colName);
+    fdata[i] = cpl_table_get_data_float(trace, colName);
+  }
 
-    position = pdata[i];
-    for (j = 0, k = row; j <= above; j += step, k += step) {
-      prePosition = position;
-      if (fiberPeak(image, k, &position, &max)) {
-        cpl_table_set_invalid(trace, colName, k - offset);
-      }
-      else {
-        if (fabs(prePosition - position) < 0.4) {    /*  ERA 0.2 */
-          fdata[k - offset] = position;
-        }
-        else {
-          cpl_table_set_invalid(trace, colName, k - offset);
-          position = prePosition;
-        }
-      }
-    }
-    position = pdata[i];
-    for (j = step, k = row - step; j <= below; j += step, k -= step) {
-      prePosition = position;
-      if (fiberPeak(image, k, &position, &max)) {
-        cpl_table_set_invalid(trace, colName, k - offset);
-      }
-      else {
-        if (fabs(prePosition - position) < 0.4) {     /*  ERA 0.2 */
-          fdata[k - offset] = position;
-        }
-        else {
-          cpl_table_set_invalid(trace, colName, k - offset);
-          position = prePosition;
-        }
-      }
-    }
+  /*
+   *  All detected spectra are traced together, row by row.
+   */
+
+  lost = cpl_calloc(range * countTraceable, sizeof(char));
+
+  ifuTraceRows(image, row, above, below, step, offset, countTraceable, pdata,
+               0.4, fdata, NULL, lost);      /*  ERA 0.2 */
+
+  for (i = 0; i < countTraceable; i++) {
+    snprintf(colName, MAX_COLNAME, "t%d", i + 1);
+    for (k = 0; k < range; k++)
+      if (lost[k * countTraceable + i])
+        cpl_table_set_invalid(trace, colName, k);
   }
 
+  cpl_free(lost);
+  cpl_free(fdata);
+
   return trace;
 
 }
@@ -4562,14 +4964,13 @@ cpl_table *ifuFitDetected(cpl_table *trace, int order,
 
   char task[] = "ifuFitDetected";
 
-  cpl_table   *oneTrace;
   cpl_table   *coeff;
-  VimosDpoint *list;
-  double      *c = NULL;
+  IfuTraceFit *fit;
+  double      *c;
   float       *fdata;
-  int         *idata;
-  int          range, npix;
-  int          rejected, moreRejected;
+  char        *null;
+  int          range;
+  int          rejected;
   int          countTraced = cpl_table_get_ncol(trace) - 1;
   int          i, j, k;
   char         colName[MAX_COLNAME];
@@ -4582,7 +4983,10 @@ cpl_table *ifuFitDetected(cpl_table *trace, int order,
   }
 
   range = cpl_table_get_nrow(trace);
-  list = newDpoint(range);
+
+  fit = newIfuTraceFit(cpl_table_get_data_int(trace, "y"), range, order);
+  null = cpl_malloc(range * sizeof(char));
+  c = cpl_malloc((order + 1) * sizeof(double));
 
   for (i = 0; i < countTraced; i++) {
     snprintf(colName, MAX_COLNAME, "t%d", i + 1);
@@ -4592,57 +4996,30 @@ cpl_table *ifuFitDetected(cpl_table *trace, int order,
       continue;
     }
 
-    if (rejected) {
-      oneTrace = cpl_table_new(range);
-      cpl_table_duplicate_column(oneTrace, "y", trace, "y");
-      cpl_table_duplicate_column(oneTrace, colName, trace, colName);
-      cpl_table_erase_invalid(oneTrace);
-      fdata = cpl_table_get_data_float(oneTrace, colName);
-      idata = cpl_table_get_data_int(oneTrace, "y");
-      npix = cpl_table_get_nrow(oneTrace);
-    }
-    else {
-      fdata = cpl_table_get_data_float(trace, colName);
-      idata = cpl_table_get_data_int(trace, "y");
-      npix = range;
-    }
-
-    for (j = 0; j < npix; j++) {
-      list[j].x = idata[j];
-      list[j].y = fdata[j];
-    }
+    fdata = cpl_table_get_data_float(trace, colName);
 
     if (rejected)
-      cpl_table_delete(oneTrace);
+      for (j = 0; j < range; j++)
+        null[j] = !cpl_table_is_valid(trace, colName, j);
 
-    c = fit1DPoly(order, list, npix, NULL);
-    if (c) {
-      moreRejected = countRejections(list, npix, c, order, tolerance);
-      if (rejected + moreRejected > maxReject) {
+    if (ifuTraceFitOne(fit, fdata, rejected ? null : NULL, tolerance,
+                       maxReject, &rejected, c, NULL)) {
+      if (rejected > maxReject)
         cpl_msg_debug(task, "Rejected fiber: %d (%d bad values)", 
-                   i + 1, rejected + moreRejected);
-        free(c);
-        c = NULL;
-        continue;
-      }
-      else if (moreRejected) {    /*  Iteration  */
-        free(c);
-        c = NULL;
-        c = fit1DPoly(order, list, npix - moreRejected, NULL);
-      }
-      if (c) {
-        for (k = 0; k <= order; k++) {
-          snprintf(colName, MAX_COLNAME, "c%d", k);
-          cpl_table_set_double(coeff, colName, i, c[k]);
-        }
-        free(c);
-        c = NULL;
-      }
+                      i + 1, rejected);
+      continue;
+    }
+
+    for (k = 0; k <= order; k++) {
+      snprintf(colName, MAX_COLNAME, "c%d", k);
+      cpl_table_set_double(coeff, colName, i, c[k]);
     }
 
   }
 
-  deleteDpoint(list);
+  cpl_free(c);
+  cpl_free(null);
+  deleteIfuTraceFit(fit);
 
   return coeff;
 
@@ -6794,50 +7171,226 @@ int findCentralFiber(cpl_table *short_coeff, int row)
 }
 
 
+/*
+ * Median of n values, obtained by selection in place. After kthSmallest()
+ * the values preceding the selected one are not greater than it, so for
+ * an even number of values the lower middle value is the largest of them.
+ * This gives the same result as median().
+ */
+
+static float ifuSkyMedian(float *value, int n)
+{
+
+  float high = kthSmallest(value, n, n / 2);
+  float low;
+  int   j;
+
+
+  if (n % 2)
+    return high;
+
+  low = value[0];
+  for (j = 1; j < n / 2; j++)
+    if (low < value[j])
+      low = value[j];
+
+  return 0.5 * (low + high);
+
+}
+
+
 /**
  * @memo
- *   Determine sky spectrum and subtract it from the data.
+ *   Estimate the sky spectrum from extracted spectra.
  *
  * @return Sky spectrum
  *
  * @param extracted Image of extracted spectra.
+ * @param exclude   Fraction of brightest spectra to ignore.
+ * @param nsigma    Rejection threshold, in sigma units.
+ * @param niter     Max number of rejection iterations.
  *
  * @doc
- *   This function finds the sky as the median value along the cross
- *   dispersion direction (y coordinate), and subtract it from the data.
- *   This method is appropriately applied on data where more than 50%
- *   of the extracted spectra are coming from the sky, typically on a
- *   standard star exposure.
+ *   The sky at each wavelength is the median of the extracted spectra
+ *   along the cross dispersion direction (y coordinate). The given
+ *   fraction of the spectra having the highest total flux, typically
+ *   the object spaxels, is excluded from the estimate. If niter is
+ *   positive, the values deviating from the median by more than nsigma
+ *   times the sigma derived from their mean absolute deviation are
+ *   rejected, and the median is recomputed, until no more values are
+ *   rejected or niter iterations are done. With no exclusion and no
+ *   rejection this is the plain median used by ifuSubtractSky().
+ *
+ *   The spectra are transposed in tiles into a single buffer, so that
+ *   the values of each wavelength bin are contiguous, and the wavelength
+ *   bins are processed in parallel when OpenMP is available.
  *
  * @author C. Izzo
  */
 
-cpl_image *ifuSubtractSky(cpl_image *extracted)
+cpl_image *ifuEstimateSky(cpl_image *extracted, double exclude,
+                          double nsigma, int niter)
 {
 
+  const int  tile = 64;
   float     *data = cpl_image_get_data(extracted);
   int        nx   = cpl_image_get_size_x(extracted);
   int        ny   = cpl_image_get_size_y(extracted);
   cpl_image *sky;
   float     *skydata;
-  float     *column;
-  int        i, j;
+  float     *columns;
+  int       *rows;
+  int        nrows;
+  int        i, j, ib, jb, iend, jend;
 
 
   sky = cpl_image_new(nx, 1, CPL_TYPE_FLOAT);
   skydata = cpl_image_get_data(sky);
 
-  column = cpl_malloc(ny * sizeof(float));
+  /*
+   * Select the spectra to use: all of them, or all but the brightest.
+   */
 
-  for (i = 0; i < nx; i++) {
+  rows = cpl_malloc(ny * sizeof(int));
+  nrows = ny;
+
+  if (exclude > 0.0) {
+
+    float *flux = cpl_malloc(ny * sizeof(float));
+    float *work = cpl_malloc(ny * sizeof(float));
+    float  threshold;
+    int    ties;
+
+    nrows = ny - (int)(exclude * ny);
+    if (nrows < 1)
+      nrows = 1;
+
+    for (j = 0; j < ny; j++) {
+      double value = 0.0;
+      for (i = 0; i < nx; i++)
+        value += data[i + j * nx];
+      flux[j] = work[j] = value;
+    }
+
+    /*
+     * Keep the spectra fainter than the nrows-th faintest one, and as
+     * many spectra as needed with a flux equal to it.
+     */
+
+    threshold = kthSmallest(work, ny, nrows - 1);
+
+    ties = nrows;
     for (j = 0; j < ny; j++)
-      column[j] = data[i + j * nx];
-    skydata[i] = median(column, ny);
+      if (flux[j] < threshold)
+        ties--;
+
+    nrows = 0;
+    for (j = 0; j < ny; j++) {
+      if (flux[j] < threshold) {
+        rows[nrows++] = j;
+      }
+      else if (flux[j] == threshold && ties > 0) {
+        rows[nrows++] = j;
+        ties--;
+      }
+    }
+
+    cpl_free(work);
+    cpl_free(flux);
+
+  }
+  else {
     for (j = 0; j < ny; j++)
-      data[i + j * nx] -= skydata[i];
+      rows[j] = j;
+  }
+
+  columns = cpl_malloc(nx * nrows * sizeof(float));
+
+  for (jb = 0; jb < nrows; jb += tile) {
+    jend = jb + tile < nrows ? jb + tile : nrows;
+    for (ib = 0; ib < nx; ib += tile) {
+      iend = ib + tile < nx ? ib + tile : nx;
+      for (j = jb; j < jend; j++) {
+        float *row = data + rows[j] * nx;
+        for (i = ib; i < iend; i++)
+          columns[j + i * nrows] = row[i];
+      }
+    }
+  }
+
+  cpl_free(rows);
+
+#ifdef _OPENMP
+#pragma omp parallel for private(j)
+#endif
+  for (i = 0; i < nx; i++) {
+    float *column = columns + i * nrows;
+    int    n      = nrows;
+    int    iter;
+    float  median = ifuSkyMedian(column, n);
+
+    for (iter = 0; iter < niter && nsigma > 0.0; iter++) {
+      double sigma = 0.0;
+      int    k = 0;
+
+      for (j = 0; j < n; j++)
+        sigma += fabs(column[j] - median);
+      sigma = MEANDEV_TO_SIGMA * nsigma * sigma / n;
+
+      for (j = 0; j < n; j++)
+        if (fabs(column[j] - median) <= sigma)
+          column[k++] = column[j];
+
+      if (k == n || k == 0)
+        break;
+
+      n = k;
+      median = ifuSkyMedian(column, n);
+    }
+
+    skydata[i] = median;
   }
 
-  cpl_free(column);
+  cpl_free(columns);
+
+  return sky;
+
+}
+
+
+/**
+ * @memo
+ *   Determine sky spectrum and subtract it from the data.
+ *
+ * @return Sky spectrum
+ *
+ * @param extracted Image of extracted spectra.
+ *
+ * @doc
+ *   This function finds the sky as the median value along the cross
+ *   dispersion direction (y coordinate), and subtract it from the data.
+ *   This method is appropriately applied on data where more than 50%
+ *   of the extracted spectra are coming from the sky, typically on a
+ *   standard star exposure. See ifuEstimateSky() for a more robust
+ *   estimate on crowded fields.
+ *
+ * @author C. Izzo
+ */
+
+cpl_image *ifuSubtractSky(cpl_image *extracted)
+{
+
+  float     *data = cpl_image_get_data(extracted);
+  int        nx   = cpl_image_get_size_x(extracted);
+  int        ny   = cpl_image_get_size_y(extracted);
+  cpl_image *sky  = ifuEstimateSky(extracted, 0.0, 0.0, 0);
+  float     *skydata = cpl_image_get_data(sky);
+  int        i, j;
+
+
+  for (j = 0; j < ny; j++)
+    for (i = 0; i < nx; i++)
+      data[i + j * nx] -= skydata[i];
 
   return sky;
 
@@ -6867,19 +7420,28 @@ cpl_image *ifuSumSpectrum(cpl_image *extracted)
   int        ny   = cpl_image_get_size_y(extracted);
   cpl_image *sum;
   float     *sumdata;
-  double     value;
+  double    *value;
   int        i, j;
 
 
   sum = cpl_image_new(nx, 1, CPL_TYPE_FLOAT);
   sumdata = cpl_image_get_data(sum);
 
-  for (i = 0; i < nx; i++) {
-    value = 0.0;
-    for (j = 0; j < ny; j++)
-      value += data[i + j * nx];
-    sumdata[i] = value;
-  }
+  /*
+   * The spectra are accumulated row by row, rather than summing each
+   * image column with a strided access.
+   */
+
+  value = cpl_calloc(nx, sizeof(double));
+
+  for (j = 0; j < ny; j++)
+    for (i = 0; i < nx; i++)
+      value[i] += data[i + j * nx];
+
+  for (i = 0; i < nx; i++)
+    sumdata[i] = value[i];
+
+  cpl_free(value);
 
   return sum;
 
@@ -44,6 +44,7 @@ cpl_image *cpl_image_vertical_median_filter(cpl_image *,
 cpl_image *removeBias(cpl_image *, cpl_image *);
 cpl_image *removeBiasLevel(cpl_image *image);
 int fiberPeak(cpl_image *, int, float *, float *);
+int fiberPeaks(cpl_image *, int, int, float *, float *, int *);
 cpl_table *ifuIdentify(cpl_image *, int);
 int ifuIdentifyUpgrade(cpl_image *, int, float *, cpl_table *, int, int);
 cpl_table **ifuTrace(cpl_image *, int, int, int, int, cpl_table *);
@@ -81,6 +82,7 @@ int ifuResampleSpectra(cpl_image *, cpl_table *, cpl_table *,
                        int, double, double, double);
 double ifuAlignSkylines(cpl_table *, cpl_table *, double, int);
 int findCentralFiber(cpl_table *, int);
+cpl_image *ifuEstimateSky(cpl_image *, double, double, int);
 cpl_image *ifuSubtractSky(cpl_image *);
 cpl_image *ifuSumSpectrum(cpl_image *);
 int extractIfuFlux(cpl_image *, double, double, double, double *, double *);
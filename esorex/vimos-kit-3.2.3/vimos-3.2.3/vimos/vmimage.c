@@ -42,6 +42,7 @@
 #include <pilmessages.h>
 #include <cpl_msg.h>
 #include <piltranslator.h>
+#include <pilfits.h>
 
 #include "vmtypes.h"
 #include "vmtable.h"
@@ -1987,16 +1988,140 @@ float imageMean(VimosImage *ima_in)
  * @param ima_in   input image
  *
  * @doc 
- *   Compute the median value of an image. Use median-wirth.
+ *   Compute the median value of an image. The median is selected
+ *   with median-wirth among the pixels falling in the histogram bin
+ *   that contains it, so that the image is never copied.
  *
  * @author P. Sartoretti
  */
 
+/*
+ * Number of histogram bins used for bounding the median search
+ */
+
+#define MEDIAN_BINS  (4096)
+
+/*
+ * Find the median of n pixel values within [minimum, maximum], i.e.,
+ * the same value returned by medianWirth(), without copying all of
+ * them. A histogram of the values is built to find the bin containing
+ * the median, and this is repeated within that bin while it still
+ * contains many values. Only the values falling into the last bin
+ * are then copied, and the median is selected from them with 
+ * kthSmallest(). If deviation is not NULL, the average deviation of 
+ * the values from level is also computed in the first pass, in the
+ * same order as in imageAverageDeviation(), to return the same result.
+ */
+
+static float histogramMedian(const float *data, VimosUlong32 n, 
+                             float minimum, float maximum, 
+                             float level, float *deviation)
+{
+  VimosUlong32  *count;
+  float         *low;
+  float         *high;
+  float         *buffer;
+  float          median;
+  float          averageDeviation = 0.;
+  double         scale, position;
+  VimosUlong32   rank, below, i, j;
+  int            bin, pass;
+
+
+  rank = (n & 1) ? n / 2 : n / 2 - 1;
+
+  if (minimum == maximum) {
+    if (deviation) {
+      for (i = 0; i < n; i++)
+        averageDeviation += fabs(data[i] - level);
+      *deviation = averageDeviation / n;
+    }
+    return minimum;
+  }
+
+  count = cpl_malloc(MEDIAN_BINS * sizeof(VimosUlong32));
+  low = cpl_calloc(MEDIAN_BINS, sizeof(float));
+  high = cpl_calloc(MEDIAN_BINS, sizeof(float));
+
+  /*
+   * The bin index is a non-decreasing function of the pixel value:
+   * the k-th smallest value is therefore found in the bin where
+   * the cumulative count exceeds k, and the values in that bin are
+   * exactly those between its smallest and its largest value, that
+   * become the interval histogrammed in the next pass.
+   */
+
+  below = 0;
+
+  for (pass = 0; ; pass++) {
+
+    memset(count, 0, MEDIAN_BINS * sizeof(VimosUlong32));
+    scale = MEDIAN_BINS / ((double)maximum - minimum);
+
+    for (i = 0; i < n; i++) {
+      if (pass == 0 && deviation)
+        averageDeviation += fabs(data[i] - level);
+      if (data[i] < minimum || data[i] > maximum)
+        continue;
+      position = (data[i] - (double)minimum) * scale;
+      if (position < MEDIAN_BINS)
+        bin = position > 0. ? position : 0;
+      else
+        bin = MEDIAN_BINS - 1;
+      if (count[bin]) {
+        if (data[i] < low[bin])
+          low[bin] = data[i];
+        else if (data[i] > high[bin])
+          high[bin] = data[i];
+      }
+      else
+        low[bin] = high[bin] = data[i];
+      count[bin]++;
+    }
+
+    if (pass == 0 && deviation)
+      *deviation = averageDeviation / n;
+
+    for (bin = 0; bin < MEDIAN_BINS - 1 && below + count[bin] <= rank; bin++)
+      below += count[bin];
+
+    minimum = low[bin];
+    maximum = high[bin];
+
+    if (minimum == maximum || pass == 3 || count[bin] <= MEDIAN_BINS ||
+        count[bin] <= n / MEDIAN_BINS)
+      break;
+
+  }
+
+  if (minimum == maximum) {
+    median = minimum;
+  }
+  else {
+    buffer = cpl_malloc(count[bin] * sizeof(float));
+    for (i = 0, j = 0; i < n; i++) {
+      if (data[i] >= minimum && data[i] <= maximum)
+        buffer[j++] = data[i];
+    }
+    if (rank - below < j)
+      median = kthSmallest(buffer, j, rank - below);
+    else                           /* Only with NaN values in the image */
+      median = maximum;
+    cpl_free(buffer);
+  }
+
+  cpl_free(count);
+  cpl_free(low);
+  cpl_free(high);
+
+  return median;
+}
+
+
 float imageMedian(VimosImage *ima_in)
 {
-  VimosImage    *copy;/* copy image because median_WIRTH modifies the input */
   VimosUlong32   i,nbpix;  
-  float                 median;
+  float          minimum, maximum;
   char           modName[] = "imageMedian";
   
   if (ima_in == NULL) {
@@ -2005,15 +2130,15 @@ float imageMedian(VimosImage *ima_in)
   }
   
   nbpix = ima_in->xlen * ima_in->ylen;
-  copy = newImageAndAlloc(ima_in->xlen,ima_in->ylen);
-  if (copy == NULL) {
-    cpl_msg_error(modName, "Cannot copy image: aborting median search");
-    return 0.;
+  minimum = maximum = ima_in->data[0];
+  for (i=1; i<nbpix; i++) {
+    if (ima_in->data[i] < minimum)
+      minimum = ima_in->data[i];
+    else if (ima_in->data[i] > maximum)
+      maximum = ima_in->data[i];
   }
-  for (i=0; i<nbpix; i++) copy->data[i] = ima_in->data[i]; 
-  median = medianWirth(copy->data, nbpix);
-  deleteImage(copy);
-  return median;
+
+  return histogramMedian(ima_in->data, nbpix, minimum, maximum, 0., NULL);
 }
 
 /**
@@ -2154,6 +2279,66 @@ float imageMaximum(VimosImage  *ima_in)
   }
   return maximum;
 }
+/**
+ * @memo
+ *   Compute several statistics of an image at once
+ *
+ * @return VM_TRUE on success, VM_FALSE on failure
+ *
+ * @param ima_in   input image
+ * @param stats    returned statistics
+ *
+ * @doc 
+ *   Compute mean, sigma, minimum, maximum and median of the pixel 
+ *   values of an image, with the same results of the functions
+ *   imageMean(), imageSigma(), imageMinimum(), imageMaximum() and
+ *   imageMedian(). Mean, minimum and maximum are obtained in a first
+ *   pass on the image, and the sigma and the histogram bounding the
+ *   median search in a second one: the image is then read just once
+ *   more to select the median, and not copied. Callers needing more 
+ *   than one of these values should use this function, and keep the
+ *   returned statistics until the image is modified.
+ *
+ * @author C. Izzo
+ */
+
+VimosBool imageStatistics(VimosImage *ima_in, VimosImageStats *stats)
+{
+  VimosUlong32  i;
+  VimosUlong32  nbpix;
+  float        *data;
+  float         mean, minimum, maximum;
+  char          modName[] = "imageStatistics";
+
+  if (ima_in == NULL || stats == NULL) {
+    cpl_msg_error(modName, "NULL input");
+    return VM_FALSE;
+  }
+
+  nbpix = ima_in->xlen * ima_in->ylen;
+  data = ima_in->data;
+
+  mean = 0.0;
+  minimum = maximum = data[0];
+  for (i=0; i<nbpix; i++) {
+    mean += data[i];
+    if (data[i] < minimum)
+      minimum = data[i];
+    else if (data[i] > maximum)
+      maximum = data[i];
+  }
+  mean /= nbpix;
+
+  stats->mean = mean;
+  stats->minimum = minimum;
+  stats->maximum = maximum;
+  stats->median = histogramMedian(data, nbpix, minimum, maximum, 
+                                  mean, &stats->sigma);
+
+  return VM_TRUE;
+}
+
+
 /**
  * @memo
  *   Compute image histogram
@@ -2765,7 +2950,7 @@ VimosImage *openOldFitsFile(const char *fileName, int imaFlag, int readFlag)
   status = 0;
 
   if (readFlag == 0) {
-    if (ffopen( &fptr, fileName, READONLY, &status)) {
+    if (pilFitsOpen(&fptr, fileName, READONLY, &status)) {
          cpl_msg_error(modName, "ffopen returned error %d)", status);
 	 return(NULL);
     }
@@ -2789,6 +2974,24 @@ VimosImage *openOldFitsFile(const char *fileName, int imaFlag, int readFlag)
 
   if(imaFlag == 1) 
   {
+    int primdata = 0;
+
+    /*
+     * A product compressed by dfs_compress_product() keeps its primary
+     * data array in the first extension, while the header remains in
+     * the primary HDU.
+     */
+
+    if (fits_movabs_hdu(fptr, 2, NULL, &status) == 0)
+      fits_read_key(fptr, TLOGICAL, "PRIMDATA", &primdata, NULL, &status);
+
+    status = 0;
+
+    if (!primdata && fits_movabs_hdu(fptr, 1, NULL, &status)) {
+      cpl_msg_error(modName, "fits_movabs_hdu returned error %d", status);
+      return(NULL);
+    }
+
     /* read the NAXIS1 and NAXIS2 keyword to get image size */
     if (fits_read_keys_lng(fptr, "NAXIS", 1, 2, naxes, &nfound, &status)) {
        cpl_msg_error(modName, "fits_read_keys_lng returned error %d", status);
@@ -2812,6 +3015,12 @@ VimosImage *openOldFitsFile(const char *fileName, int imaFlag, int readFlag)
       deleteImage(tImage);
       return(NULL);
     }
+
+    if (primdata && fits_movabs_hdu(fptr, 1, NULL, &status)) {
+      cpl_msg_error(modName, "fits_movabs_hdu returned error %d", status);
+      deleteImage(tImage);
+      return(NULL);
+    }
   
     tImage->xlen = naxes[0];
     tImage->ylen = naxes[1];
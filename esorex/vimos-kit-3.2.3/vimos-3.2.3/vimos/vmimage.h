@@ -59,6 +59,17 @@ typedef struct _VIMOS_IMAGE_
   fitsfile *fptr;
 } VimosImage;
 
+/* Statistics of the pixel values of an image, see imageStatistics() */
+
+typedef struct _VIMOS_IMAGE_STATS_
+{
+  float mean;
+  float sigma;       /* Average deviation from the mean, as imageSigma() */
+  float minimum;
+  float maximum;
+  float median;
+} VimosImageStats;
+
 typedef enum _COMB_METHOD_
 {
   COMB_UNDEF = 0,
@@ -240,6 +251,13 @@ float imageMaximum(VimosImage  *ima_in);
 float imageMinimum(VimosImage *ima_in);
 
 
+/* compute mean, sigma, minimum, maximum and median of an image at once,
+   without copying the image. The results are identical to those of the
+   corresponding single functions. */
+
+VimosBool imageStatistics(VimosImage *ima_in, VimosImageStats *stats);
+
+
 /* compute an image histogram. Input one image and the number of bins for
    the histogram. Output a list of [nbins] dpoints. x contains the central
    pixelvalue for each bin, y contains the number of pixels in this bin.
@@ -43,6 +43,7 @@
 #include <cpl_msg.h>
 #include <pilstrutils.h>
 #include <pilutils.h>
+#include <pilfits.h>
 
 #include "vmtypes.h"
 #include "vmimage.h"
@@ -3822,7 +3823,7 @@ VimosTable *openOldFitsTable(const char *tableName, int IOflag)
   tTable = newTable();
 
   if (IOflag == 0) {
-    ffopen(&(tTable->fptr), tableName, READONLY, &status);
+    pilFitsOpen(&(tTable->fptr), tableName, READONLY, &status);
   }
   if (IOflag == 1) {
     ffopen(&(tTable->fptr), tableName, READWRITE, &status);
@@ -243,6 +243,7 @@ UpdateProductDescriptors(VimosImage *image, const char *category)
 {
   char modName[] = "UpdateProductDescriptors";
   VimosDescriptor  *minDesc, *maxDesc;
+  VimosImageStats   stats;
 
 
   if ((image == NULL) || (image->descs == NULL)) {
@@ -250,40 +251,42 @@ UpdateProductDescriptors(VimosImage *image, const char *category)
     return EXIT_FAILURE;
   }
 
+  imageStatistics(image, &stats);
+
   /*
    * DATAMIN and DATAMAX are standard fits keys and are before
    * the hierarch keys
    */
 
   minDesc = newDoubleDescriptor(pilTrnGetKeyword("DataMin"),
-                       imageMinimum(image), "Minimum pixel value");
+                       stats.minimum, "Minimum pixel value");
   if (insertDescriptor(&(image->descs), "ESO*", minDesc, 1)==VM_FALSE) {
     cpl_msg_warning(modName, "Cannot write descriptor %s",
                   pilTrnGetKeyword("DataMin"));
   }
   
   maxDesc = newDoubleDescriptor(pilTrnGetKeyword("DataMax"),
-                       imageMaximum(image), "Maximum pixel value");
+                       stats.maximum, "Maximum pixel value");
   if (insertDescriptor(&(image->descs), "ESO*", maxDesc, 1)==VM_FALSE) {
     cpl_msg_warning(modName, "Cannot write descriptor %s",
                   pilTrnGetKeyword("DataMax"));
   }
 
   if ((writeDoubleDescriptor(&(image->descs), pilTrnGetKeyword("DataMean"),
-                     imageMean(image), "Mean pixel value"))==VM_FALSE) {
+                     stats.mean, "Mean pixel value"))==VM_FALSE) {
     cpl_msg_warning(modName, "Cannot write descriptor %s",
                   pilTrnGetKeyword("DataMean"));
   }
   if ((writeDoubleDescriptor(&(image->descs), 
                             pilTrnGetKeyword("DataStdDeviation"),
-                            imageSigma(image), 
+                            stats.sigma, 
                              "Standard deviation of pixel"))==VM_FALSE) {
     cpl_msg_warning(modName, "Cannot write descriptor %s",
                   pilTrnGetKeyword("DataStdDeviation"));
   }
 
   if ((writeDoubleDescriptor(&(image->descs), pilTrnGetKeyword("DataMedian"),
-                             imageMedian(image), "Median pixel value"))
+                             stats.median, "Median pixel value"))
       ==VM_FALSE) {
     cpl_msg_warning(modName, "Cannot write descriptor %s",
                   pilTrnGetKeyword("DataMedian"));
@@ -987,7 +990,7 @@ static PilFrame *get_raw_frame_time_sequence(PilSetOfFrames *framelist, int seq)
     while (frame != NULL) {
         if (pilFrmGetType(frame) == PIL_FRAME_TYPE_RAW
             || pilFrmGetType(frame) == PIL_FRAME_TYPE_UNDEF) {
-            if (ffopen(&fptr, pilFrmGetName(frame), READONLY, &status))
+            if (pilFitsOpen(&fptr, pilFrmGetName(frame), READONLY, &status))
             {
                 fits_get_errstatus(status, errText);
                 cpl_msg_error(fid, "Opening file %s: %s",
@@ -1022,7 +1025,7 @@ static PilFrame *get_raw_frame_time_sequence(PilSetOfFrames *framelist, int seq)
     while (frame != NULL) {
         if (pilFrmGetType(frame) == PIL_FRAME_TYPE_RAW
             || pilFrmGetType(frame) == PIL_FRAME_TYPE_UNDEF) {
-            if (ffopen(&fptr, pilFrmGetName(frame), READONLY, &status))
+            if (pilFitsOpen(&fptr, pilFrmGetName(frame), READONLY, &status))
             {
                 fits_get_errstatus(status, errText);
                 cpl_msg_error(fid, "Opening file %s: %s",
@@ -1168,7 +1171,7 @@ int vm_dfs_setup_product_header(PilFrame *proFrame, const char *recipename,
     while (frame != NULL) {
         if (pilFrmGetType(frame) == PIL_FRAME_TYPE_RAW 
             || pilFrmGetType(frame) == PIL_FRAME_TYPE_UNDEF) {
-            if (ffopen(&fptr, pilFrmGetName(frame), READONLY, &status))
+            if (pilFitsOpen(&fptr, pilFrmGetName(frame), READONLY, &status))
             {
                 fits_get_errstatus(status, errText);
                 cpl_msg_error(fid, "Opening file %s: %s",
@@ -1219,7 +1222,7 @@ int vm_dfs_setup_product_header(PilFrame *proFrame, const char *recipename,
      * product header.
      */
 
-    if (ffopen(&ifptr, pilFrmGetName(first_frame), READONLY, &status)) {
+    if (pilFitsOpen(&ifptr, pilFrmGetName(first_frame), READONLY, &status)) {
         fits_get_errstatus(status, errText);
         cpl_msg_error(fid, "Opening file %s: %s", 
                       pilFrmGetName(first_frame), errText);
@@ -1777,7 +1780,7 @@ int vm_dfs_setup_product_header(PilFrame *proFrame, const char *recipename,
 
             snprintf(cval, FLEN_CARD, PRO_REC_CALi_DATAMD5, ncal);
 
-            if (ffopen(&fptr, pilFrmGetName(frame), READONLY, &status))
+            if (pilFitsOpen(&fptr, pilFrmGetName(frame), READONLY, &status))
             {
                 fits_get_errstatus(status, errText);
                 cpl_msg_error(fid, "Opening file %s: %s",